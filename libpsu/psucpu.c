@@ -100,8 +100,8 @@ static psu_cpu_flags_t psu_cpu_dx_flags[] = {
     { 0, NULL, NULL }
 };
 
-void
-psu_cpu_get_info (uint32_t which, psu_cpuid_t *pcp)
+static void
+psu_cpuid (uint32_t which, psu_cpuid_t *pcp)
 {
     bzero(pcp, sizeof(*pcp));
 
@@ -113,11 +113,75 @@ psu_cpu_get_info (uint32_t which, psu_cpuid_t *pcp)
        : "a" (which), "c" (0));
 #endif /* _X86_ */
 #endif /* !__GCC__ */
+}
+
+void
+psu_cpu_get_info (uint32_t which, psu_cpuid_t *pcp)
+{
+    psu_cpuid(which, pcp);
 
     psu_log("cpu info(%u): %#x, %#x, %#x, %#x\n",
 	    which, pcp->pc_ax, pcp->pc_bx, pcp->pc_cx, pcp->pc_dx);
 }
 
+/*
+ * Return the register state the OS saves for us (XCR0)
+ */
+static uint64_t
+psu_cpu_xgetbv (void)
+{
+    uint32_t lo = 0, hi = 0;
+
+#if !defined(__GCC__) || __GCC__ >= 5 /* Limited gcc support */
+#if defined(__x86_64__) || defined(__i386__)
+    asm volatile ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+#endif /* _X86_ */
+#endif /* !__GCC__ */
+
+    return ((uint64_t) hi << 32) | lo;
+}
+
+uint32_t
+psu_cpu_features (void)
+{
+    static uint32_t features;
+    static int features_done;
+    psu_cpuid_t pc;
+    uint32_t max, res = 0;
+
+    if (features_done)
+	return features;
+
+    psu_cpuid(0, &pc);
+    max = pc.pc_ax;
+
+    if (max >= 1) {
+	psu_cpuid(1, &pc);
+	if (pc.pc_dx & CPU_DX_SSE2)
+	    res |= PSU_CPU_SSE2;
+	if (pc.pc_cx & CPU_CX_POPCNT)
+	    res |= PSU_CPU_POPCNT;
+	if (pc.pc_cx & CPU_CX_SSE42)
+	    res |= PSU_CPU_SSE42;
+
+	/*
+	 * AVX2 also needs the OS to save the XMM and YMM registers
+	 * for us (XCR0 bits 1 and 2) across context switches.
+	 */
+	if ((pc.pc_cx & CPU_CX_OSXSAVE) && (pc.pc_cx & CPU_CX_AVX)
+	    && (psu_cpu_xgetbv() & 0x6) == 0x6 && max >= 7) {
+	    psu_cpuid(7, &pc);
+	    if (pc.pc_bx & CPU_7_BX_AVX2)
+		res |= PSU_CPU_AVX2;
+	}
+    }
+
+    features = res;
+    features_done = 1;
+
+    return features;
+}
+
 static void
 psu_cpu_print_bits (const char *title, int verbose, uint32_t flags,
 		    psu_cpu_flags_t *cfp)
@@ -107,9 +107,28 @@ typedef struct psu_cpuid_s {
 #define CPU_DX_IA64 (1<<30) /* IA64 processor emulating x86 */
 #define CPU_DX_PBE (1<<31) /* Pending Break Enable (PBE# pin) wakeup support */
 
+/* Flags for "pc_bx" after cpuid leaf 7: */
+#define CPU_7_BX_AVX2 (1<<5) /* Advanced Vector Extensions 2 */
+
+/*
+ * Features that callers pick code paths by, as returned by
+ * psu_cpu_features()
+ */
+#define PSU_CPU_SSE2	(1<<0)	/* SSE2 instructions */
+#define PSU_CPU_POPCNT	(1<<1)	/* POPCNT instruction */
+#define PSU_CPU_AVX2	(1<<2)	/* AVX2 instructions, with OS support */
+#define PSU_CPU_SSE42	(1<<3)	/* SSE4.2 instructions (PCMPESTRM) */
+
 void
 psu_cpu_get_info (uint32_t which, psu_cpuid_t *pcp);
 
+/*
+ * Return the PSU_CPU_* features of the CPU we're running on.  The
+ * answer is computed once and cached.
+ */
+uint32_t
+psu_cpu_features (void);
+
 void
 psu_dump_cpu_info (int);
 
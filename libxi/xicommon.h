@@ -64,6 +64,8 @@ struct xi_rstate_s; typedef struct xi_rstate_s xi_rstate_t;
 struct xi_rule_s; typedef struct xi_rule_s xi_rule_t;
 struct xi_node_s; typedef struct xi_node_s xi_node_t;
 struct xi_workspace_s; typedef struct xi_workspace_s xi_workspace_t;
+struct xi_reader_s; typedef struct xi_reader_s xi_reader_t;
+struct xi_decomp_s; typedef struct xi_decomp_s xi_decomp_t;
 
 /* Used to test whether a byte is white space */
 extern char xi_space_test[256];
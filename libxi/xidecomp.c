@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Streaming decompression.  Each format has an ops table: its magic
+ * number, and a "step" function that turns as much of the buffered
+ * input into output as will fit.  xi_decomp_read() keeps the input
+ * buffer topped up from the fd and drives the step function.
+ * Formats we can't decompress still have their magic numbers here,
+ * so we can say so instead of handing the tokenizer binary junk.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <libpsu/psucommon.h>
+#include <libxi/xicommon.h>
+#include <libxi/xidecomp.h>
+#include <libxi/xireader.h>
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#define XI_DECOMP_HAVE_GZIP 1
+#define ZLIB_CONST
+#include <zlib.h>
+#endif /* HAVE_ZLIB_H && HAVE_LIBZ */
+
+#if defined(HAVE_ZSTD_H) && defined(HAVE_LIBZSTD)
+#define XI_DECOMP_HAVE_ZSTD 1
+#include <zstd.h>
+#endif /* HAVE_ZSTD_H && HAVE_LIBZSTD */
+
+typedef struct xi_decomp_ops_s {
+    const char *xdo_name;	/* Name of this format */
+    const char *xdo_magic;	/* Magic number at the start */
+    unsigned xdo_magic_len;	/* Length of xdo_magic */
+    int (*xdo_init)(xi_decomp_t *); /* Set up (NULL if unsupported) */
+    int (*xdo_step)(xi_decomp_t *, char *, size_t, size_t *); /* Inflate */
+    void (*xdo_fini)(xi_decomp_t *); /* Tear down */
+} xi_decomp_ops_t;
+
+struct xi_decomp_s {
+    const xi_decomp_ops_t *xd_ops; /* Our format */
+    int xd_fd;			/* Where compressed data comes from */
+    char *xd_in;		/* Compressed input buffer */
+    size_t xd_in_size;		/* Size of xd_in */
+    const char *xd_inp;		/* Next compressed byte */
+    size_t xd_in_left;		/* Compressed bytes left in xd_in */
+    int xd_eof;			/* Seen EOF on xd_fd */
+    int xd_ended;		/* At the end of a stream (member/frame) */
+    int xd_more;		/* Last step filled its output; may be more */
+#ifdef XI_DECOMP_HAVE_GZIP
+    z_stream xd_zstream;	/* zlib's state */
+#endif /* XI_DECOMP_HAVE_GZIP */
+#ifdef XI_DECOMP_HAVE_ZSTD
+    ZSTD_DStream *xd_zstd;	/* libzstd's state */
+#endif /* XI_DECOMP_HAVE_ZSTD */
+}; /* xi_decomp_t */
+
+/* Move past "len" bytes of input */
+static inline void
+xi_decomp_consume (xi_decomp_t *xdp, size_t len)
+{
+    xdp->xd_inp += len;
+    xdp->xd_in_left -= len;
+}
+
+#ifdef XI_DECOMP_HAVE_GZIP
+
+static int
+xi_decomp_gzip_init (xi_decomp_t *xdp)
+{
+    /* 16 + MAX_WBITS means gzip wrapper only */
+    return (inflateInit2(&xdp->xd_zstream, 16 + MAX_WBITS) == Z_OK) ? 0 : -1;
+}
+
+/*
+ * A gzip file can be several members, one after another, so at the
+ * end of one we start again if there's more input
+ */
+static int
+xi_decomp_gzip_step (xi_decomp_t *xdp, char *buf, size_t size,
+		     size_t *outp)
+{
+    z_stream *zsp = &xdp->xd_zstream;
+    uInt in_len, out_len;
+    int rc;
+
+    *outp = 0;
+
+    if (xdp->xd_ended) {
+	if (xdp->xd_in_left == 0)
+	    return 0;		/* Nothing more (yet) */
+
+	if (inflateReset(zsp) != Z_OK)
+	    return -1;
+	xdp->xd_ended = FALSE;
+    }
+
+    in_len = (xdp->xd_in_left < UINT_MAX) ? xdp->xd_in_left : UINT_MAX;
+    out_len = (size < UINT_MAX) ? size : UINT_MAX;
+
+    zsp->next_in = (const Bytef *) xdp->xd_inp;
+    zsp->avail_in = in_len;
+    zsp->next_out = (Bytef *) buf;
+    zsp->avail_out = out_len;
+
+    rc = inflate(zsp, Z_NO_FLUSH);
+
+    xi_decomp_consume(xdp, in_len - zsp->avail_in);
+    *outp = out_len - zsp->avail_out;
+
+    switch (rc) {
+    case Z_STREAM_END:
+	xdp->xd_ended = TRUE;
+	/* FALLTHRU */
+    case Z_OK:
+    case Z_BUF_ERROR:		/* Just means no progress was possible */
+	return 0;
+    }
+
+    return -1;
+}
+
+static void
+xi_decomp_gzip_fini (xi_decomp_t *xdp)
+{
+    inflateEnd(&xdp->xd_zstream);
+}
+
+#define XI_DECOMP_GZIP_OPS \
+    xi_decomp_gzip_init, xi_decomp_gzip_step, xi_decomp_gzip_fini
+
+#else /* XI_DECOMP_HAVE_GZIP */
+#define XI_DECOMP_GZIP_OPS NULL, NULL, NULL
+#endif /* XI_DECOMP_HAVE_GZIP */
+
+#ifdef XI_DECOMP_HAVE_ZSTD
+
+static int
+xi_decomp_zstd_init (xi_decomp_t *xdp)
+{
+    xdp->xd_zstd = ZSTD_createDStream();
+    if (xdp->xd_zstd == NULL)
+	return -1;
+
+    return ZSTD_isError(ZSTD_initDStream(xdp->xd_zstd)) ? -1 : 0;
+}
+
+/*
+ * libzstd moves from one frame to the next by itself; a zero return
+ * means a frame is done and fully flushed
+ */
+static int
+xi_decomp_zstd_step (xi_decomp_t *xdp, char *buf, size_t size,
+		     size_t *outp)
+{
+    ZSTD_inBuffer in = { xdp->xd_inp, xdp->xd_in_left, 0 };
+    ZSTD_outBuffer out = { buf, size, 0 };
+    size_t rc;
+
+    rc = ZSTD_decompressStream(xdp->xd_zstd, &out, &in);
+
+    xi_decomp_consume(xdp, in.pos);
+    *outp = out.pos;
+
+    if (ZSTD_isError(rc))
+	return -1;
+
+    xdp->xd_ended = (rc == 0);
+    return 0;
+}
+
+static void
+xi_decomp_zstd_fini (xi_decomp_t *xdp)
+{
+    if (xdp->xd_zstd)
+	ZSTD_freeDStream(xdp->xd_zstd);
+}
+
+#define XI_DECOMP_ZSTD_OPS \
+    xi_decomp_zstd_init, xi_decomp_zstd_step, xi_decomp_zstd_fini
+
+#else /* XI_DECOMP_HAVE_ZSTD */
+#define XI_DECOMP_ZSTD_OPS NULL, NULL, NULL
+#endif /* XI_DECOMP_HAVE_ZSTD */
+
+static const xi_decomp_ops_t xi_decomp_ops_gzip = {
+    "gzip", "\x1f\x8b", 2, XI_DECOMP_GZIP_OPS
+};
+
+static const xi_decomp_ops_t xi_decomp_ops_zstd = {
+    "zstd", "\x28\xb5\x2f\xfd", 4, XI_DECOMP_ZSTD_OPS
+};
+
+/* Indexed by XI_DECOMP_* */
+static const xi_decomp_ops_t *xi_decomp_ops_list[] = {
+    [XI_DECOMP_NONE] = NULL,
+    [XI_DECOMP_GZIP] = &xi_decomp_ops_gzip,
+    [XI_DECOMP_ZSTD] = &xi_decomp_ops_zstd,
+};
+
+#define XI_DECOMP_FORMATS \
+    (sizeof(xi_decomp_ops_list) / sizeof(xi_decomp_ops_list[0]))
+
+int
+xi_decomp_check (const char *buf, size_t len)
+{
+    const xi_decomp_ops_t *ops;
+    int partial = FALSE;
+    unsigned i;
+
+    for (i = 0; i < XI_DECOMP_FORMATS; i++) {
+	ops = xi_decomp_ops_list[i];
+	if (ops == NULL)
+	    continue;
+
+	if (len >= ops->xdo_magic_len) {
+	    if (memcmp(buf, ops->xdo_magic, ops->xdo_magic_len) == 0)
+		return i;
+	} else if (memcmp(buf, ops->xdo_magic, len) == 0)
+	    partial = TRUE;
+    }
+
+    return partial ? -1 : XI_DECOMP_NONE;
+}
+
+const char *
+xi_decomp_name (int format)
+{
+    if (format <= XI_DECOMP_NONE || (unsigned) format >= XI_DECOMP_FORMATS)
+	return "uncompressed";
+
+    return xi_decomp_ops_list[format]->xdo_name;
+}
+
+xi_decomp_t *
+xi_decomp_create (int format, int fd, const char *buf, size_t len)
+{
+    const xi_decomp_ops_t *ops;
+    xi_decomp_t *xdp;
+
+    if (format <= XI_DECOMP_NONE || (unsigned) format >= XI_DECOMP_FORMATS)
+	return NULL;
+
+    ops = xi_decomp_ops_list[format];
+    if (ops->xdo_init == NULL)
+	return NULL;		/* Not built with this one */
+
+    xdp = calloc(1, sizeof(*xdp));
+    if (xdp == NULL)
+	return NULL;
+
+    xdp->xd_ops = ops;
+    xdp->xd_fd = fd;
+    xdp->xd_in_size = (len > XI_DECOMP_INSIZ) ? len : XI_DECOMP_INSIZ;
+    xdp->xd_in = malloc(xdp->xd_in_size);
+    if (xdp->xd_in == NULL) {
+	free(xdp);
+	return NULL;
+    }
+
+    /* What's been read already is our first input */
+    memcpy(xdp->xd_in, buf, len);
+    xdp->xd_inp = xdp->xd_in;
+    xdp->xd_in_left = len;
+
+    if (ops->xdo_init(xdp) < 0) {
+	xi_decomp_destroy(xdp);
+	return NULL;
+    }
+
+    return xdp;
+}
+
+ssize_t
+xi_decomp_read (xi_decomp_t *xdp, char *buf, size_t size)
+{
+    size_t done = 0, out, left;
+    ssize_t rc;
+
+    while (done < size) {
+	if (xdp->xd_in_left == 0 && !xdp->xd_more) {
+	    if (done > 0 || xdp->xd_eof)
+		break;		/* Hand over what we've got before waiting */
+
+	    rc = xi_reader_read(xdp->xd_fd, xdp->xd_in, xdp->xd_in_size);
+	    if (rc < 0)
+		return -1;
+	    if (rc == 0) {
+		xdp->xd_eof = TRUE;
+		break;
+	    }
+
+	    xdp->xd_inp = xdp->xd_in;
+	    xdp->xd_in_left = rc;
+	}
+
+	left = xdp->xd_in_left;
+	if (xdp->xd_ops->xdo_step(xdp, buf + done, size - done, &out) < 0) {
+	    errno = EIO;	/* Corrupt data */
+	    return -1;
+	}
+
+	/* A full buffer may mean there's more where that came from */
+	xdp->xd_more = (out == size - done && !xdp->xd_ended);
+	done += out;
+
+	if (left > 0 && left == xdp->xd_in_left && out == 0
+	    && !xdp->xd_ended) {
+	    errno = EIO;	/* Input, but no progress */
+	    return -1;
+	}
+    }
+
+    if (done == 0 && xdp->xd_eof && !xdp->xd_ended) {
+	errno = EIO;		/* Input ends in the middle of a stream */
+	return -1;
+    }
+
+    return done;
+}
+
+void
+xi_decomp_destroy (xi_decomp_t *xdp)
+{
+    if (xdp->xd_ops->xdo_fini)
+	xdp->xd_ops->xdo_fini(xdp);
+
+    free(xdp->xd_in);
+    free(xdp);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Streaming decompression for compressed inputs (gzip, and zstd when
+ * we've got libzstd), recognized by their magic numbers.  The
+ * xi_decomp_t is opaque, since its innards depend on which libraries
+ * we were built with.
+ */
+
+#ifndef LIBSLAX_XI_DECOMP_H
+#define LIBSLAX_XI_DECOMP_H
+
+#include <libxi/xicommon.h>
+
+/* Formats we can recognize (even if we can't decompress them) */
+#define XI_DECOMP_NONE	0	/* Not compressed (that we know of) */
+#define XI_DECOMP_GZIP	1	/* gzip (RFC 1952) */
+#define XI_DECOMP_ZSTD	2	/* zstd (RFC 8878) */
+
+#define XI_DECOMP_INSIZ	(64 << 10) /* Compressed bytes read at a time */
+
+/*
+ * Look at the first "len" bytes of the input and return the format
+ * (XI_DECOMP_*), or -1 if they're too few to tell (that is, they
+ * could be the start of a magic number)
+ */
+int
+xi_decomp_check (const char *buf, size_t len);
+
+/*
+ * Return the name of a format
+ */
+const char *
+xi_decomp_name (int format);
+
+/*
+ * Make a decompressor for input of the given format, which starts
+ * with the "len" bytes at "buf" (already read) and continues with
+ * whatever can be read from "fd".  Returns NULL if we weren't built
+ * to handle this format, or we're out of memory.
+ */
+xi_decomp_t *
+xi_decomp_create (int format, int fd, const char *buf, size_t len);
+
+/*
+ * Decompress up to "size" bytes into "buf", only waiting for more
+ * input if we've nothing to give back.  Returns the number of bytes,
+ * zero at EOF, or -1 (with errno set) on error, like read().  Data
+ * that's corrupt or ends mid-stream gives EIO.
+ */
+ssize_t
+xi_decomp_read (xi_decomp_t *xdp, char *buf, size_t size);
+
+/*
+ * Release a decompressor.  The fd is left open.
+ */
+void
+xi_decomp_destroy (xi_decomp_t *xdp);
+
+#endif /* LIBSLAX_XI_DECOMP_H */
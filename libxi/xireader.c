@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Read-ahead thread for streaming inputs.  See xireader.h for the
+ * shape of the ring.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <libpsu/psucommon.h>
+#include <libxi/xicommon.h>
+#include <libxi/xireader.h>
+#include <libxi/xidecomp.h>
+
+#ifdef HAVE_PTHREAD_H
+
+#define XI_READER_SPINS	64	/* Looks before we sleep */
+
+/*
+ * Wait for "*watchp" to move from "seen".  We look a few times before
+ * going to sleep; the sleeper count is bumped before we look again,
+ * and the other side bumps its counter before it looks at the
+ * sleeper count, so one of us is sure to see the other.
+ */
+static void
+xi_reader_wait (xi_reader_t *xrp, unsigned *watchp, unsigned seen)
+{
+    unsigned spins;
+
+    for (spins = 0; spins < XI_READER_SPINS; spins++)
+	if (__atomic_load_n(watchp, __ATOMIC_ACQUIRE) != seen)
+	    return;
+
+    pthread_mutex_lock(&xrp->xr_mutex);
+    __atomic_add_fetch(&xrp->xr_sleepers, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(watchp, __ATOMIC_SEQ_CST) == seen
+	   && !__atomic_load_n(&xrp->xr_stop, __ATOMIC_SEQ_CST))
+	pthread_cond_wait(&xrp->xr_cond, &xrp->xr_mutex);
+
+    __atomic_sub_fetch(&xrp->xr_sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&xrp->xr_mutex);
+}
+
+static void
+xi_reader_wake (xi_reader_t *xrp)
+{
+    if (__atomic_load_n(&xrp->xr_sleepers, __ATOMIC_SEQ_CST) == 0)
+	return;
+
+    pthread_mutex_lock(&xrp->xr_mutex);
+    pthread_cond_broadcast(&xrp->xr_cond);
+    pthread_mutex_unlock(&xrp->xr_mutex);
+}
+
+ssize_t
+xi_reader_read (int fd, char *buf, size_t size)
+{
+    ssize_t rc;
+    int old;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old);
+    do {
+	rc = read(fd, buf, size);
+    } while (rc < 0 && errno == EINTR);
+    pthread_setcancelstate(old, &old);
+
+    return rc;
+}
+
+/*
+ * The reader thread: fill a free slot with whatever one read() (or
+ * the decompressor) gives us, and hand it over.  A zero-length slot
+ * marks EOF (or an error), after which we're done.  We can only be
+ * cancelled inside xi_reader_read().
+ */
+static void *
+xi_reader_main (void *arg)
+{
+    xi_reader_t *xrp = arg;
+    xi_reader_slot_t *slotp;
+    unsigned head = xrp->xr_head, tail;
+    ssize_t rc;
+    int old;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old);
+
+    for (;;) {
+	for (;;) {
+	    if (__atomic_load_n(&xrp->xr_stop, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	    tail = __atomic_load_n(&xrp->xr_tail, __ATOMIC_ACQUIRE);
+	    if (head - tail < xrp->xr_slots)
+		break;
+
+	    xi_reader_wait(xrp, &xrp->xr_tail, tail); /* Ring is full */
+	}
+
+	slotp = &xrp->xr_ring[head % xrp->xr_slots];
+
+	if (xrp->xr_decomp)
+	    rc = xi_decomp_read(xrp->xr_decomp, slotp->xrs_data,
+				xrp->xr_chunk);
+	else
+	    rc = xi_reader_read(xrp->xr_fd, slotp->xrs_data, xrp->xr_chunk);
+
+	slotp->xrs_len = (rc > 0) ? (size_t) rc : 0;
+	slotp->xrs_errno = (rc < 0) ? errno : 0;
+
+	head += 1;
+	__atomic_store_n(&xrp->xr_head, head, __ATOMIC_SEQ_CST);
+	xi_reader_wake(xrp);
+
+	if (rc <= 0)
+	    return NULL;
+    }
+}
+
+static void
+xi_reader_free (xi_reader_t *xrp)
+{
+    unsigned i;
+
+    if (xrp->xr_ring) {
+	for (i = 0; i < xrp->xr_slots; i++)
+	    free(xrp->xr_ring[i].xrs_data);
+	free(xrp->xr_ring);
+    }
+
+    pthread_cond_destroy(&xrp->xr_cond);
+    pthread_mutex_destroy(&xrp->xr_mutex);
+    free(xrp);
+}
+
+xi_reader_t *
+xi_reader_start (int fd, xi_decomp_t *decomp, size_t chunk, unsigned slots)
+{
+    xi_reader_t *xrp;
+    unsigned i;
+
+    xrp = calloc(1, sizeof(*xrp));
+    if (xrp == NULL)
+	return NULL;
+
+    xrp->xr_fd = fd;
+    xrp->xr_decomp = decomp;
+    xrp->xr_chunk = chunk ?: XI_READER_CHUNK;
+    xrp->xr_slots = slots ?: XI_READER_SLOTS;
+    pthread_mutex_init(&xrp->xr_mutex, NULL);
+    pthread_cond_init(&xrp->xr_cond, NULL);
+
+    xrp->xr_ring = calloc(xrp->xr_slots, sizeof(*xrp->xr_ring));
+    if (xrp->xr_ring == NULL)
+	goto fail;
+
+    for (i = 0; i < xrp->xr_slots; i++) {
+	xrp->xr_ring[i].xrs_data = malloc(xrp->xr_chunk);
+	if (xrp->xr_ring[i].xrs_data == NULL)
+	    goto fail;
+    }
+
+    if (pthread_create(&xrp->xr_thread, NULL, xi_reader_main, xrp) != 0)
+	goto fail;
+
+    return xrp;
+
+ fail:
+    xi_reader_free(xrp);
+    return NULL;
+}
+
+ssize_t
+xi_reader_get (xi_reader_t *xrp, char *buf, size_t size)
+{
+    xi_reader_slot_t *slotp;
+    unsigned head, tail = xrp->xr_tail;
+    size_t done = 0, len;
+
+    if (xrp->xr_eof)
+	return 0;
+
+    for (;;) {
+	head = __atomic_load_n(&xrp->xr_head, __ATOMIC_ACQUIRE);
+	if (head != tail)
+	    break;
+
+	xi_reader_wait(xrp, &xrp->xr_head, tail); /* Ring is empty */
+    }
+
+    /* Take what's there, without waiting for more */
+    while (tail != head && done < size) {
+	slotp = &xrp->xr_ring[tail % xrp->xr_slots];
+
+	if (slotp->xrs_len == 0) {
+	    if (done)
+		break;		/* Give them the data; EOF comes next */
+
+	    xrp->xr_eof = TRUE;
+	    if (slotp->xrs_errno) {
+		errno = slotp->xrs_errno;
+		return -1;
+	    }
+	    return 0;
+	}
+
+	len = slotp->xrs_len - xrp->xr_off;
+	if (len > size - done)
+	    len = size - done;
+
+	memcpy(buf + done, slotp->xrs_data + xrp->xr_off, len);
+	done += len;
+	xrp->xr_off += len;
+
+	if (xrp->xr_off == slotp->xrs_len) {
+	    /* Done with this chunk; give it back */
+	    xrp->xr_off = 0;
+	    tail += 1;
+	    __atomic_store_n(&xrp->xr_tail, tail, __ATOMIC_SEQ_CST);
+	    xi_reader_wake(xrp);
+	}
+    }
+
+    return done;
+}
+
+void
+xi_reader_stop (xi_reader_t *xrp)
+{
+    __atomic_store_n(&xrp->xr_stop, TRUE, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&xrp->xr_mutex);
+    pthread_cond_broadcast(&xrp->xr_cond);
+    pthread_mutex_unlock(&xrp->xr_mutex);
+
+    /* If it's blocked in read(), this is the only way out */
+    pthread_cancel(xrp->xr_thread);
+    pthread_join(xrp->xr_thread, NULL);
+
+    xi_reader_free(xrp);
+}
+
+#else /* HAVE_PTHREAD_H */
+
+xi_reader_t *
+xi_reader_start (int fd UNUSED, xi_decomp_t *decomp UNUSED,
+		 size_t chunk UNUSED, unsigned slots UNUSED)
+{
+    return NULL;		/* No threads, no read-ahead */
+}
+
+ssize_t
+xi_reader_read (int fd, char *buf, size_t size)
+{
+    ssize_t rc;
+
+    do {
+	rc = read(fd, buf, size);
+    } while (rc < 0 && errno == EINTR);
+
+    return rc;
+}
+
+ssize_t
+xi_reader_get (xi_reader_t *xrp UNUSED, char *buf UNUSED,
+	       size_t size UNUSED)
+{
+    errno = EINVAL;
+    return -1;
+}
+
+void
+xi_reader_stop (xi_reader_t *xrp UNUSED)
+{
+    return;
+}
+
+#endif /* HAVE_PTHREAD_H */
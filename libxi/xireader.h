@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Read-ahead for streaming inputs (pipes, sockets): a thread reads
+ * the fd into a ring of chunks while the tokenizer works on the
+ * ones before, so I/O and parsing overlap.  For compressed input,
+ * the thread fills the chunks from a decompressor instead, so
+ * decompression overlaps too.
+ */
+
+#ifndef LIBSLAX_XI_READER_H
+#define LIBSLAX_XI_READER_H
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
+
+#include <libxi/xicommon.h>
+
+#define XI_READER_CHUNK	(64 << 10) /* Default bytes per chunk */
+#define XI_READER_SLOTS	8	/* Default chunks in the ring */
+
+/*
+ * The ring is single-producer (the reader thread), single-consumer
+ * (the tokenizer).  The producer owns xr_head and the consumer owns
+ * xr_tail; each only reads the other's, so a chunk changes hands
+ * with a release store and an acquire load, and no lock.  The mutex
+ * and condition variable are only used to sleep when the ring is
+ * empty (or full), and only if the other side is known to be
+ * asleep.
+ */
+typedef struct xi_reader_slot_s {
+    char *xrs_data;		/* The chunk */
+    size_t xrs_len;		/* Bytes in the chunk; zero means EOF */
+    int xrs_errno;		/* errno, if the read at EOF failed */
+} xi_reader_slot_t;
+
+struct xi_reader_s {
+    int xr_fd;			/* File we're reading */
+    xi_decomp_t *xr_decomp;	/* Decompressor to read thru (if any) */
+    size_t xr_chunk;		/* Size of each chunk */
+    unsigned xr_slots;		/* Number of slots in the ring */
+    unsigned xr_head;		/* Chunks filled (producer's) */
+    unsigned xr_tail;		/* Chunks drained (consumer's) */
+    size_t xr_off;		/* Bytes used from the tail chunk */
+    int xr_stop;		/* Consumer wants the producer to quit */
+    int xr_eof;			/* Consumer has seen the EOF chunk */
+    unsigned xr_sleepers;	/* Threads sleeping on xr_cond */
+#ifdef HAVE_PTHREAD_H
+    pthread_t xr_thread;	/* The reader thread */
+    pthread_mutex_t xr_mutex;	/* Lock for sleeping */
+    pthread_cond_t xr_cond;	/* Sleep here */
+#endif /* HAVE_PTHREAD_H */
+    xi_reader_slot_t *xr_ring;	/* The slots (xr_slots of them) */
+}; /* xi_reader_t */
+
+/*
+ * Start a reader thread on "fd" (or "decomp", if not NULL), with
+ * "slots" chunks of "chunk" bytes (zero for the defaults).  Returns
+ * NULL if we can't, in which case the caller should just read() the
+ * fd (or decomp) itself.  The decompressor stays the caller's, but
+ * mustn't be touched until xi_reader_stop().
+ */
+xi_reader_t *
+xi_reader_start (int fd, xi_decomp_t *decomp, size_t chunk, unsigned slots);
+
+/*
+ * Copy up to "size" bytes of input into "buf", waiting only if
+ * nothing's been read yet.  Returns the number of bytes copied, zero
+ * at EOF, or -1 (with errno set) on error, like read().
+ */
+ssize_t
+xi_reader_get (xi_reader_t *xrp, char *buf, size_t size);
+
+/*
+ * read() "fd", retrying on EINTR.  The read-ahead thread can only be
+ * cancelled in here, so anything it calls that reads the fd (like
+ * xi_decomp_read) must use this.  It's just read() for any other
+ * thread.
+ */
+ssize_t
+xi_reader_read (int fd, char *buf, size_t size);
+
+/*
+ * Stop the reader thread and release everything.  The fd is left
+ * open.
+ */
+void
+xi_reader_stop (xi_reader_t *xrp);
+
+#endif /* LIBSLAX_XI_READER_H */
@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Delimiter scanning.  Each kernel classifies a 64-byte block at a
+ * time into a bit mask (one bit per byte) and picks the answer out
+ * with a count-trailing-zeros.  Delimiters in XML are often only a
+ * few bytes apart, so the first few bytes are tested a byte at a
+ * time before we bother with vectors.  The kernel set is picked at
+ * first use, via psu_cpu_features().
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psucpu.h>
+#include <libxi/xicommon.h>
+#include <libxi/xiscan.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XI_SCAN_X86 1
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 */
+
+#define XI_SCAN_BLOCK	64	/* Bytes classified at a time */
+#define XI_SCAN_HEAD	8	/* Bytes tested one at a time first */
+#define XI_SCAN_PAGE	4096	/* Smallest page size we might run on */
+#define XI_SCAN_MAX_CHARS 16	/* Most bytes in one set (fits an xmm) */
+
+/*
+ * The bytes that make up one combination of classes, both as a list
+ * (for the vector kernels) and as a table (for the scalar one)
+ */
+typedef struct xi_scan_set_s {
+    char xss_chars[XI_SCAN_MAX_CHARS]; /* Bytes in the set, NUL padded */
+    unsigned xss_count;		/* Number of bytes in xss_chars */
+    uint8_t xss_table[256];	/* Non-zero for bytes in the set */
+} xi_scan_set_t;
+
+static xi_scan_set_t xi_scan_sets[XI_SCAN_ALL + 1];
+static int xi_scan_sets_built;
+
+/*
+ * A kernel returns the offset of the first byte in the set (or, when
+ * "skip" is set, the first byte not in the set), or "len" if there's
+ * no such byte.
+ */
+typedef size_t (*xi_scan_func_t)(const char *cp, size_t len,
+				 const xi_scan_set_t *setp, int skip);
+
+typedef struct xi_scan_ops_s {
+    const char *xso_name;	/* Name of this kernel set */
+    uint32_t xso_needs;		/* PSU_CPU_* features we need */
+    xi_scan_func_t xso_scan;	/* Find the first hit */
+} xi_scan_ops_t;
+
+static void
+xi_scan_sets_build (void)
+{
+    static const char *class_chars[] = {
+	"<", ">", "&", "\"'", " \t\r\n", "=",
+    };
+    xi_scan_set_t *setp;
+    unsigned classes, i, ch;
+    const char *cp;
+
+    for (classes = 0; classes <= XI_SCAN_ALL; classes++) {
+	setp = &xi_scan_sets[classes];
+
+	for (i = 0; i < sizeof(class_chars) / sizeof(class_chars[0]); i++)
+	    if (classes & (1 << i))
+		for (cp = class_chars[i]; *cp; cp++)
+		    setp->xss_table[(uint8_t) *cp] = 1;
+
+	for (ch = 0; ch < 256; ch++)
+	    if (setp->xss_table[ch])
+		setp->xss_chars[setp->xss_count++] = ch;
+    }
+
+    xi_scan_sets_built = TRUE;
+}
+
+static size_t
+xi_scan_scalar (const char *cp, size_t len, const xi_scan_set_t *setp,
+		int skip)
+{
+    const uint8_t *up = (const uint8_t *) cp;
+    size_t off;
+
+    for (off = 0; off < len; off++)
+	if ((setp->xss_table[up[off]] != 0) != skip)
+	    return off;
+
+    return len;
+}
+
+static const xi_scan_ops_t xi_scan_ops_scalar = {
+    "scalar", 0, xi_scan_scalar,
+};
+
+#ifdef XI_SCAN_X86
+
+/*
+ * A last, partial block can be classified whole if it doesn't cross
+ * into the next page, since then the bytes past the end of the
+ * buffer can't fault; we mask off their bits.
+ */
+static inline int
+xi_scan_overread_ok (const char *cp)
+{
+    return ((uintptr_t) cp & (XI_SCAN_PAGE - 1))
+	<= XI_SCAN_PAGE - XI_SCAN_BLOCK;
+}
+
+/*
+ * The body of a vector kernel, around a "_block" expression that
+ * classifies the 64 bytes at "cp + off"
+ */
+#define XI_SCAN_DRIVER(_block)						\
+    uint64_t mask;							\
+    size_t off, rem;							\
+									\
+    rem = (len < XI_SCAN_HEAD) ? len : XI_SCAN_HEAD;			\
+    off = xi_scan_scalar(cp, rem, setp, skip);				\
+    if (off < rem)							\
+	return off;							\
+									\
+    for ( ; off < len; off += XI_SCAN_BLOCK) {				\
+	rem = len - off;						\
+	if (rem < XI_SCAN_BLOCK && !xi_scan_overread_ok(cp + off))	\
+	    return off + xi_scan_scalar(cp + off, rem, setp, skip);	\
+									\
+	mask = (_block);						\
+	if (skip)							\
+	    mask = ~mask;						\
+	if (rem < XI_SCAN_BLOCK)					\
+	    mask &= (1ULL << rem) - 1;					\
+	if (mask)							\
+	    return off + __builtin_ctzll(mask);				\
+    }									\
+									\
+    return len
+
+/*
+ * SSE4.2 kernel: PCMPESTRM compares each byte against the whole set
+ * at once, sixteen bytes at a time
+ */
+#define XI_SCAN_SSE42_MODE \
+    (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)
+
+__attribute__((target("sse4.2")))
+static inline uint64_t
+xi_scan_block_sse42 (const char *cp, __m128i set, int count)
+{
+    uint64_t mask = 0;
+    __m128i v;
+    unsigned i;
+
+    for (i = 0; i < XI_SCAN_BLOCK; i += 16) {
+	v = _mm_loadu_si128((const __m128i *) (cp + i));
+	v = _mm_cmpestrm(set, count, v, 16, XI_SCAN_SSE42_MODE);
+	mask |= (uint64_t) (uint16_t) _mm_cvtsi128_si32(v) << i;
+    }
+
+    return mask;
+}
+
+__attribute__((target("sse4.2")))
+static size_t
+xi_scan_sse42 (const char *cp, size_t len, const xi_scan_set_t *setp,
+	       int skip)
+{
+    __m128i set = _mm_loadu_si128((const __m128i *) setp->xss_chars);
+    int count = setp->xss_count;
+
+    XI_SCAN_DRIVER(xi_scan_block_sse42(cp + off, set, count));
+}
+
+static const xi_scan_ops_t xi_scan_ops_sse42 = {
+    "sse42", PSU_CPU_SSE42, xi_scan_sse42,
+};
+
+/*
+ * AVX2 kernel: compare two 32-byte halves against each byte in the
+ * set, or-ing the results together
+ */
+__attribute__((target("avx2")))
+static inline uint64_t
+xi_scan_block_avx2 (const char *cp, const __m256i *chars, unsigned count)
+{
+    __m256i lo, hi, mlo, mhi;
+    unsigned i;
+
+    lo = _mm256_loadu_si256((const __m256i *) cp);
+    hi = _mm256_loadu_si256((const __m256i *) (cp + 32));
+    mlo = mhi = _mm256_setzero_si256();
+
+    for (i = 0; i < count; i++) {
+	mlo = _mm256_or_si256(mlo, _mm256_cmpeq_epi8(lo, chars[i]));
+	mhi = _mm256_or_si256(mhi, _mm256_cmpeq_epi8(hi, chars[i]));
+    }
+
+    return (uint32_t) _mm256_movemask_epi8(mlo)
+	| ((uint64_t) (uint32_t) _mm256_movemask_epi8(mhi) << 32);
+}
+
+__attribute__((target("avx2")))
+static size_t
+xi_scan_avx2 (const char *cp, size_t len, const xi_scan_set_t *setp,
+	      int skip)
+{
+    __m256i chars[XI_SCAN_MAX_CHARS];
+    unsigned count = setp->xss_count, i;
+
+    for (i = 0; i < count; i++)
+	chars[i] = _mm256_set1_epi8(setp->xss_chars[i]);
+
+    XI_SCAN_DRIVER(xi_scan_block_avx2(cp + off, chars, count));
+}
+
+static const xi_scan_ops_t xi_scan_ops_avx2 = {
+    "avx2", PSU_CPU_AVX2, xi_scan_avx2,
+};
+
+#endif /* XI_SCAN_X86 */
+
+/* Kernel sets, best first */
+static const xi_scan_ops_t *xi_scan_ops_list[] = {
+#ifdef XI_SCAN_X86
+    &xi_scan_ops_avx2,
+    &xi_scan_ops_sse42,
+#endif /* XI_SCAN_X86 */
+    &xi_scan_ops_scalar,
+    NULL
+};
+
+static const xi_scan_ops_t *xi_scan_ops;	/* Kernel set in use */
+
+psu_boolean_t
+xi_scan_impl_select (const char *name)
+{
+    const xi_scan_ops_t **opsp;
+    uint32_t features = psu_cpu_features();
+
+    if (!xi_scan_sets_built)
+	xi_scan_sets_build();
+
+    for (opsp = xi_scan_ops_list; *opsp; opsp++) {
+	if (((*opsp)->xso_needs & features) != (*opsp)->xso_needs)
+	    continue;
+
+	if (name == NULL || strcmp(name, (*opsp)->xso_name) == 0) {
+	    xi_scan_ops = *opsp;
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+static inline const xi_scan_ops_t *
+xi_scan_ops_get (void)
+{
+    if (xi_scan_ops == NULL)
+	xi_scan_impl_select(NULL);
+
+    return xi_scan_ops;
+}
+
+const char *
+xi_scan_impl_name (void)
+{
+    return xi_scan_ops_get()->xso_name;
+}
+
+const char **
+xi_scan_impl_list (void)
+{
+    static const char *names[sizeof(xi_scan_ops_list)
+			     / sizeof(xi_scan_ops_list[0])];
+    unsigned i;
+
+    for (i = 0; xi_scan_ops_list[i]; i++)
+	names[i] = xi_scan_ops_list[i]->xso_name;
+    names[i] = NULL;
+
+    return names;
+}
+
+char *
+xi_scan_find (const char *cp, size_t len, unsigned classes)
+{
+    const xi_scan_ops_t *ops = xi_scan_ops_get();
+    size_t off;
+
+    off = ops->xso_scan(cp, len, &xi_scan_sets[classes & XI_SCAN_ALL], 0);
+    return (off < len) ? const_drop(cp + off) : NULL;
+}
+
+char *
+xi_scan_skip (const char *cp, size_t len, unsigned classes)
+{
+    const xi_scan_ops_t *ops = xi_scan_ops_get();
+    size_t off;
+
+    off = ops->xso_scan(cp, len, &xi_scan_sets[classes & XI_SCAN_ALL], 1);
+    return (off < len) ? const_drop(cp + off) : NULL;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Delimiter scanning for the tokenizer.  Rather than test input a
+ * byte at a time, we classify a block of bytes at once against a set
+ * of delimiter classes, using the widest kernel the CPU supports.
+ */
+
+#ifndef LIBSLAX_XI_SCAN_H
+#define LIBSLAX_XI_SCAN_H
+
+/* Classes of bytes we scan for (for "classes" arguments) */
+#define XI_SCAN_LT	(1<<0)	/* '<' */
+#define XI_SCAN_GT	(1<<1)	/* '>' */
+#define XI_SCAN_AMP	(1<<2)	/* '&' */
+#define XI_SCAN_QUOTE	(1<<3)	/* '"' and '\'' */
+#define XI_SCAN_WS	(1<<4)	/* Whitespace, as xi_isspace() sees it */
+#define XI_SCAN_EQ	(1<<5)	/* '=' */
+
+#define XI_SCAN_ALL	((1<<6) - 1) /* All classes */
+
+/*
+ * Return a pointer to the first of "len" bytes at "cp" that falls in
+ * one of the given classes, or NULL if none does.
+ */
+char *
+xi_scan_find (const char *cp, size_t len, unsigned classes);
+
+/*
+ * Return a pointer to the first of "len" bytes at "cp" that falls
+ * outside all of the given classes, or NULL if they all fall inside.
+ * xi_scan_skip(cp, len, XI_SCAN_WS) is a wide xi_skipws(cp, len, 1).
+ */
+char *
+xi_scan_skip (const char *cp, size_t len, unsigned classes);
+
+/*
+ * The scanner uses the best kernels the CPU supports ("avx2",
+ * "sse42", or "scalar").  xi_scan_impl_select() forces a particular
+ * set, which is handy for testing and benchmarking; NULL returns to
+ * the best one.  It returns FALSE if the CPU can't run that set.
+ * xi_scan_impl_list() returns the names of all sets, NULL terminated,
+ * whether or not this CPU can run them.
+ */
+psu_boolean_t
+xi_scan_impl_select (const char *name);
+
+const char *
+xi_scan_impl_name (void);
+
+const char **
+xi_scan_impl_list (void);
+
+#endif /* LIBSLAX_XI_SCAN_H */
@@ -36,11 +36,15 @@
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
+#include <errno.h>
 
 #include <libpsu/psucommon.h>
 #include <parrotdb/pacommon.h>
 #include <libxi/xicommon.h>
 #include <libxi/xisource.h>
+#include <libxi/xiscan.h>
+#include <libxi/xireader.h>
+#include <libxi/xidecomp.h>
 
 #define XI_PI	"processing instruction"
 
@@ -61,12 +65,12 @@ xi_source_failure (xi_source_t *srcp, int errnum, const char *fmt, ...)
 
     if (srcp) {
 	if (srcp->xps_flags & XPSF_LINE_NO) {
-	    fprintf(stderr, "%s:%u:(%u): ",
-		    srcp->xps_filename ?: "input",
-		    srcp->xps_lineno, srcp->xps_offset);
+	    fprintf(stderr, "%s:%u:(%llu): ",
+		    srcp->xps_filename ?: "input", srcp->xps_lineno,
+		    (unsigned long long) srcp->xps_offset);
 	} else {
-	    fprintf(stderr, "%s:(%u): ",
-		    srcp->xps_filename ?: "input", srcp->xps_offset);
+	    fprintf(stderr, "%s:(%llu): ", srcp->xps_filename ?: "input",
+		    (unsigned long long) srcp->xps_offset);
 	}
     }
 
@@ -90,22 +94,39 @@ xi_source_create (int fd, xi_source_flags_t flags)
     srcp = calloc(1, sizeof(*srcp));
     if (srcp != NULL) {
 	srcp->xps_fd = fd;
-	srcp->xps_flags = flags & ~XPSF_MMAP_INPUT;
+	srcp->xps_flags = flags & ~(XPSF_MMAP_INPUT | XPSF_DECOMP_CHECK);
 	srcp->xps_lineno = 1;	/* Start on line 1 */
 
 	/*
-	 * The mmap flag asks us to try to mmap the file; if it fails,
-	 * we fall back to normal behavior.
+	 * The mmap flag asks us to try to mmap the whole file, so
+	 * there's nothing to read() or copy; if it fails (or the file
+	 * isn't a regular file), we fall back to normal behavior.  The
+	 * mapping is private and writable, since we NUL-terminate
+	 * tokens in place.
 	 */
-	if (flags & XPSF_MMAP_INPUT) {
+	if ((flags & XPSF_MMAP_INPUT) && !(flags & XPSF_NO_MMAP)) {
 	    struct stat st;
 
-	    if (fstat(fd, &st) >= 0 && st.st_size > 0) {
-		void *addr = mmap(NULL, st.st_size, PROT_READ, 0, fd, 0);
-		if (addr) {
-		    srcp->xps_flags |= XPSF_MMAP_INPUT | XPSF_NO_READ;
+	    if (fstat(fd, &st) >= 0 && S_ISREG(st.st_mode) && st.st_size > 0
+		&& (uintmax_t) st.st_size <= SIZE_MAX) {
+		void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+				  MAP_PRIVATE, fd, 0);
+
+		/* Compressed files are read (and decompressed) instead */
+		if (addr != MAP_FAILED && !(flags & XPSF_NO_DECOMP)
+		    && xi_decomp_check(addr, st.st_size) > XI_DECOMP_NONE) {
+		    munmap(addr, st.st_size);
+		    addr = MAP_FAILED;
+		}
+
+		if (addr != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+		    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+#endif /* MADV_SEQUENTIAL */
+		    srcp->xps_flags |= XPSF_MMAP_INPUT | XPSF_NO_READ
+			| XPSF_READ_ALL;
 		    srcp->xps_bufp = srcp->xps_curp = addr;
-		    srcp->xps_size = st.st_size;
+		    srcp->xps_size = srcp->xps_len = st.st_size;
 		}
 	    }
 	}
@@ -116,13 +137,21 @@ xi_source_create (int fd, xi_source_flags_t flags)
 	    if (srcp->xps_bufp != NULL)
 		srcp->xps_size = XI_BUFSIZ;
 	}
+
+	/* Anything we read() might be compressed */
+	if (!(srcp->xps_flags & (XPSF_NO_READ | XPSF_NO_DECOMP)))
+	    srcp->xps_flags |= XPSF_DECOMP_CHECK;
+
+	if (flags & XPSF_READ_AHEAD)
+	    xi_source_read_ahead(srcp, 0, 0);
     }
 
     return srcp;
 }
 
 /*
- * Open an xi_source_t for the given file.
+ * Open an xi_source_t for the given file.  Regular files are mmap'd
+ * unless XPSF_NO_MMAP is set.
  */
 xi_source_t *
 xi_source_open (const char *filename, xi_source_flags_t flags)
@@ -132,7 +161,7 @@ xi_source_open (const char *filename, xi_source_flags_t flags)
 	return NULL;
 
     xi_source_t *srcp;
-    srcp = xi_source_create(fd, flags | XPSF_CLOSE_FD);
+    srcp = xi_source_create(fd, flags | XPSF_CLOSE_FD | XPSF_MMAP_INPUT);
     if (srcp)
 	srcp->xps_filename = strdup(filename);
 
@@ -147,11 +176,28 @@ xi_source_open (const char *filename, xi_source_flags_t flags)
 void
 xi_source_destroy (xi_source_t *srcp)
 {
+    if (srcp->xps_reader != NULL)
+	xi_reader_stop(srcp->xps_reader);
+
+    /* After the reader, which may be using it */
+    if (srcp->xps_decomp != NULL)
+	xi_decomp_destroy(srcp->xps_decomp);
+
     if (srcp->xps_filename != NULL)
 	free(srcp->xps_filename);
 
-    if (srcp->xps_curp != NULL)
-	free(srcp->xps_curp);
+    if (srcp->xps_flags & XPSF_SEGMENT)
+	;			/* The buffer is our parent's */
+    else if (srcp->xps_flags & XPSF_MMAP_INPUT)
+	munmap(srcp->xps_bufp, srcp->xps_size);
+    else if (srcp->xps_bufp != NULL)
+	free(srcp->xps_bufp);
+
+    if (srcp->xps_scratch != NULL)
+	free(srcp->xps_scratch);
+
+    if (srcp->xps_hold != NULL)
+	free(srcp->xps_hold);
 
     if (srcp->xps_flags & XPSF_CLOSE_FD)
 	close(srcp->xps_fd);
@@ -159,79 +205,96 @@ xi_source_destroy (xi_source_t *srcp)
     free(srcp);
 }
 
+/* First byte is the unescaped form; the rest is the entity form */
+static const char *xi_entities[] = {
+    "&amp;", "<lt;", ">gt;", "'apos;", "\"quot;", NULL
+};
+
 /*
- * Unescape XML text data.  This is not done automatically since
- * if the caller is just copying data from input to output, there's
- * no reason to unescape data that will need escaping.
+ * Unescape "len" bytes at "start" into "out", returning the length of
+ * the result.  Unescaping never makes text longer, so "out" can be
+ * "start" itself.  Entities we can't decode are discarded, thru their
+ * semi-colon.
  */
-size_t
-xi_source_unescape (xi_source_t *srcp, char *start, unsigned len)
+static size_t
+xi_source_unescape_into (xi_source_t *srcp, char *out, const char *start,
+			 size_t len)
 {
-    /* First byte is the unescaped form; the rest is the entity form */
-    static const char *entities[] = {
-	"&amp;", "<lt;", ">gt;", "'&apos;", "\"quot;", NULL
-    };
-
-    size_t rc = len, elen = 0;
-    char *cur = start, *ins = NULL, *from = cur;
+    const char *cur = start, *end = start + len, *amp, *semi;
     const char **ep;
-
-    while (len > 0) {
-	cur = psu_memchr(cur, '&', len);
-	if (cur == NULL)
+    char *op = out;
+    size_t elen = 0;
+
+    while (cur < end) {
+	amp = xi_scan_find(cur, end - cur, XI_SCAN_AMP);
+	if (amp == NULL)
+	    amp = end;
+
+	if (op != cur)
+	    memmove(op, cur, amp - cur);
+	op += amp - cur;
+	if (amp == end)
 	    break;
 
-	len -= cur - from;
-	for (ep = entities; *ep; ep++) {
+	for (ep = xi_entities; *ep; ep++) {
 	    elen = strlen(*ep + 1);
-	    if (memcmp(*ep + 1, cur + 1, elen) == 0)
+	    if ((size_t) (end - amp - 1) >= elen
+		&& memcmp(*ep + 1, amp + 1, elen) == 0)
 		break;
 	}
 
-	if (*ep == NULL) {
-	    /* We didn't find the entity; bummer */
-	    xi_source_failure(srcp, 0, "could not decode entity");
-
-	    char *xp = psu_memchr(cur + 1, ';', len);
-	    if (xp != NULL) {
-		/*
-		 * Okay, the entity is trash, but at least we found a
-		 * semi-colon.  Move along, discarding the broken entity.
-		 */
-		ins = cur;
-		cur = from = xp;
-	    } else {
-		len -= 1;	/* Skip single character ('&') */
-		cur += 1;
-	    }
+	if (*ep != NULL) {
+	    *op++ = **ep;	/* Insert unencoded form */
+	    cur = amp + 1 + elen;
 	    continue;
-
 	}
 
-	if (ins == NULL) {
-	    *cur++ = **ep;	/* Replace '&' with unencoded form */
-	    ins = cur;		/* Point where we'll copy data (next time) */
+	/* We didn't find the entity; bummer */
+	xi_source_failure(srcp, 0, "could not decode entity");
 
+	semi = memchr(amp + 1, ';', end - amp - 1);
+	if (semi != NULL) {
+	    cur = semi + 1;	/* Discard the broken entity */
 	} else {
-	    size_t plen = cur - from; /* Length of uncopied data */
-	    memcpy(ins, from, plen);
-	    ins += plen;
-	    *ins++ = **ep;	/* Insert unencoded form */
-	    cur += 1;		/* Skip '&' */
+	    *op++ = '&';	/* Keep the lonely '&' */
+	    cur = amp + 1;
 	}
+    }
+
+    return op - out;
+}
+
+/*
+ * Unescape XML text data.  This is not done automatically since
+ * if the caller is just copying data from input to output, there's
+ * no reason to unescape data that will need escaping.
+ */
+size_t
+xi_source_unescape (xi_source_t *srcp, char *start, unsigned len)
+{
+    return xi_source_unescape_into(srcp, start, start, len);
+}
+
+char *
+xi_source_unescape_copy (xi_source_t *srcp, const char *start, size_t len,
+			 size_t *lenp)
+{
+    char *out;
 
-	/* Pointer maintenance */
-	cur += elen;		/* Skip over the rest of  */
-	from = cur;		/* Point where we'll copy from */
-	len -= elen + 1;
-	rc -= elen;
+    if (srcp->xps_scratch_size < len + 1) {
+	out = realloc(srcp->xps_scratch, len + 1);
+	if (out == NULL)
+	    return NULL;
+	srcp->xps_scratch = out;
+	srcp->xps_scratch_size = len + 1;
     }
 
-    /* If there's anything left over, copy it */
-    if (ins != NULL && len > 0)
-	memcpy(ins, from, len);
+    len = xi_source_unescape_into(srcp, srcp->xps_scratch, start, len);
+    srcp->xps_scratch[len] = '\0';
+    if (lenp)
+	*lenp = len;
 
-    return rc;
+    return srcp->xps_scratch;
 }
 
 static void
@@ -253,6 +316,64 @@ xi_source_move_curp (xi_source_t *srcp, char *newp)
     srcp->xps_curp = newp;
 }
 
+/*
+ * The first read looks for the magic number of a compressed format.
+ * If there's one, what we've read becomes the decompressor's first
+ * input; otherwise it's just data.  Either way, now we know what the
+ * read-ahead thread should read, so it's started here.
+ */
+static ssize_t
+xi_source_detect (xi_source_t *srcp, char *dst, size_t space)
+{
+    size_t len = 0;
+    ssize_t rc;
+    int format;
+
+    srcp->xps_flags &= ~XPSF_DECOMP_CHECK;
+
+    /* Read until we can tell (which is usually the first byte) */
+    while ((format = xi_decomp_check(dst, len)) < 0) {
+	rc = xi_reader_read(srcp->xps_fd, dst + len, space - len);
+	if (rc < 0)
+	    return -1;
+	if (rc == 0) {
+	    format = XI_DECOMP_NONE;
+	    break;
+	}
+	len += rc;
+    }
+
+    if (format != XI_DECOMP_NONE) {
+	srcp->xps_decomp = xi_decomp_create(format, srcp->xps_fd, dst, len);
+	if (srcp->xps_decomp == NULL) {
+	    xi_source_failure(srcp, 0, "cannot decompress %s input",
+			      xi_decomp_name(format));
+	    return 0;
+	}
+
+	len = 0;		/* It's the decompressor's now */
+	if (!(srcp->xps_flags & XPSF_NO_READ_AHEAD))
+	    srcp->xps_flags |= XPSF_READ_AHEAD;
+    }
+
+    if ((srcp->xps_flags & XPSF_READ_AHEAD)
+	&& (len > 0 || srcp->xps_decomp != NULL)) {
+	srcp->xps_reader = xi_reader_start(srcp->xps_fd, srcp->xps_decomp,
+					   srcp->xps_ahead_chunk,
+					   srcp->xps_ahead_slots);
+	if (srcp->xps_reader == NULL)
+	    srcp->xps_flags &= ~XPSF_READ_AHEAD;
+    }
+
+    if (len > 0 || srcp->xps_decomp == NULL)
+	return len;
+
+    if (srcp->xps_reader != NULL)
+	return xi_reader_get(srcp->xps_reader, dst, space);
+
+    return xi_decomp_read(srcp->xps_decomp, dst, space);
+}
+
 /*
  * Read some input data from the source.  If min is non-zero, it's the
  * minimum number of bytes we'd like to see.
@@ -263,8 +384,8 @@ xi_source_read (xi_source_t *srcp, int min)
     if (srcp->xps_flags & (XPSF_NO_READ | XPSF_EOF_SEEN))
 	return -1;
 
-    unsigned seen = srcp->xps_curp - srcp->xps_bufp;
-    unsigned left = srcp->xps_len - seen;
+    size_t seen = srcp->xps_curp - srcp->xps_bufp;
+    size_t left = srcp->xps_len - seen;
 
     if (left == 0) {
 	/* If we've consumed all data, reset it to initial state */
@@ -286,7 +407,7 @@ xi_source_read (xi_source_t *srcp, int min)
     /* If there's not enough room, expand the buffer */
     xi_offset_t space = srcp->xps_size - srcp->xps_len;
     if (space < XI_BUFSIZ_MIN) {
-	unsigned size = srcp->xps_size << 1; /* Double the buffer size */
+	size_t size = srcp->xps_size << 1; /* Double the buffer size */
 	char *cp = realloc(srcp->xps_bufp, size);
 	if (cp != NULL) {
 	    /* Record new buffer pointer values */
@@ -302,9 +423,21 @@ xi_source_read (xi_source_t *srcp, int min)
      * Read as much data as we can, remembering that we may have existing
      * data already in the buffer.  The first 'xps_len' bytes are precious.
      */
-    int rc = read(srcp->xps_fd, srcp->xps_bufp + srcp->xps_len,
-		  srcp->xps_size - srcp->xps_len);
+    char *dst = srcp->xps_bufp + srcp->xps_len;
+    ssize_t rc;
+
+    space = srcp->xps_size - srcp->xps_len;
+    if (srcp->xps_flags & XPSF_DECOMP_CHECK)
+	rc = xi_source_detect(srcp, dst, space);
+    else if (srcp->xps_reader != NULL)
+	rc = xi_reader_get(srcp->xps_reader, dst, space);
+    else if (srcp->xps_decomp != NULL)
+	rc = xi_decomp_read(srcp->xps_decomp, dst, space);
+    else
+	rc = read(srcp->xps_fd, dst, space);
     if (rc <= 0) {
+	if (rc < 0)
+	    xi_source_failure(srcp, errno, "read failed");
 	srcp->xps_flags |= XPSF_EOF_SEEN;
 	return -1;
     }
@@ -314,6 +447,37 @@ xi_source_read (xi_source_t *srcp, int min)
     return (rc >= min);
 }
 
+int
+xi_source_read_ahead (xi_source_t *srcp, size_t chunk, unsigned slots)
+{
+    if (srcp->xps_flags & (XPSF_NO_READ | XPSF_EOF_SEEN
+			   | XPSF_NO_READ_AHEAD)) {
+	srcp->xps_flags &= ~XPSF_READ_AHEAD;
+	return 0;		/* Nothing to read (or mmap'd) */
+    }
+
+    srcp->xps_ahead_chunk = chunk;
+    srcp->xps_ahead_slots = slots;
+
+    /* Until the first read, we don't know what the thread should read */
+    if (srcp->xps_flags & XPSF_DECOMP_CHECK) {
+	srcp->xps_flags |= XPSF_READ_AHEAD;
+	return 0;
+    }
+
+    if (srcp->xps_reader == NULL) {
+	srcp->xps_reader = xi_reader_start(srcp->xps_fd, srcp->xps_decomp,
+					   chunk, slots);
+	if (srcp->xps_reader == NULL) {
+	    srcp->xps_flags &= ~XPSF_READ_AHEAD;
+	    return -1;
+	}
+    }
+
+    srcp->xps_flags |= XPSF_READ_AHEAD;
+    return 0;
+}
+
 static inline xi_offset_t
 xi_source_offset (xi_source_t *srcp)
 {
@@ -330,12 +494,17 @@ xi_source_left (xi_source_t *srcp)
 static inline xi_offset_t
 xi_source_avail (xi_source_t *srcp, xi_offset_t min)
 {
-    xi_offset_t left = xi_source_left(srcp);
+    xi_offset_t left;
 
-    if (left >= min)
-	return left;
+    /* Short reads (pipes, read-ahead chunks) just mean we go again */
+    for (;;) {
+	left = xi_source_left(srcp);
+	if (left >= min)
+	    return left;
 
-    return xi_source_read(srcp, min);
+	if (xi_source_read(srcp, min - left) < 0)
+	    return -1;
+    }
 }
 
 static xi_offset_t
@@ -344,7 +513,7 @@ xi_source_find (xi_source_t *srcp, int ch, xi_offset_t offset)
     char *cur;
 
     for (;;) {
-	if (offset >= srcp->xps_len) {
+	if ((size_t) offset >= srcp->xps_len) {
 	    if (xi_source_read(srcp, 0) < 0)
 		return -1;
 	    offset = xi_source_offset(srcp); /* Recalculate our offset */
@@ -667,6 +836,38 @@ xi_source_token_pi (xi_source_t *srcp, char **datap,
     return XI_TYPE_PI;
 }
 
+/*
+ * Under XPSF_MMAP_INPUT, NUL-terminating a tag in place would make
+ * the kernel copy the page it's on, and tags are on most every page.
+ * So we copy the tag (from "*startp" thru "*lastp") into xps_hold
+ * and point the caller there instead; text tokens need no NULs, so
+ * they stay in the mapping.  Rarer constructs (comments, DTDs, and
+ * such) are still NUL-terminated in place.
+ */
+static void
+xi_source_hold (xi_source_t *srcp, char **startp, char **lastp)
+{
+    size_t len = *lastp - *startp + 1;
+    char *cp;
+
+    if (!(srcp->xps_flags & XPSF_MMAP_INPUT))
+	return;
+
+    if (srcp->xps_hold_size < len + 1) {
+	cp = realloc(srcp->xps_hold, len + 1);
+	if (cp == NULL)
+	    return;		/* Fine; we'll write in the mapping */
+	srcp->xps_hold = cp;
+	srcp->xps_hold_size = len + 1;
+    }
+
+    memcpy(srcp->xps_hold, *startp, len);
+    srcp->xps_hold[len] = '\0';
+
+    *startp = srcp->xps_hold;
+    *lastp = srcp->xps_hold + len - 1;
+}
+
 static xi_node_type_t
 xi_source_token_open (xi_source_t *srcp, char **datap, char **restp)
 {
@@ -681,21 +882,24 @@ xi_source_token_open (xi_source_t *srcp, char **datap, char **restp)
     char *dp = srcp->xps_curp + 1;
     char *cp = &srcp->xps_bufp[off];
 
+    xi_source_move_curp(srcp, cp + 1); /* Save as next starting point */
+    xi_source_hold(srcp, &dp, &cp);
+
     if (dp < cp && cp[-1] == '/') { /* Spec says no space between "/>" */
 	token = XI_TYPE_EMPTY;
 	cp[-1] = '\0';		/* Back up over '/' */
     }
 
     *cp++ = '\0';		/* Whack the '>' */
-    xi_source_move_curp(srcp, cp); /* Save as next starting point */
 
     /*
-     * Find the attributes, but don't bother parsing them.  Trim whitespace.
+     * Find the attributes, but don't bother parsing them.  Trim
+     * whitespace; any whitespace byte can end the element name.
      */
-    char *rp = psu_memchr(dp, ' ', cp - dp);
+    char *rp = xi_scan_find(dp, cp - dp, XI_SCAN_WS);
     if (rp != NULL) {
 	*rp++ = '\0';
-	rp = xi_skipws(rp, cp - rp, 1);
+	rp = xi_scan_skip(rp, cp - rp, XI_SCAN_WS);
 	if (rp != NULL && *rp == '\0')
 	    rp = NULL;
     }
@@ -717,8 +921,10 @@ xi_source_token_close (xi_source_t *srcp, char **datap)
 
     char *dp = srcp->xps_curp + 2; /* Skip "</" */
     char *cp = &srcp->xps_bufp[off];
-    *cp++ = '\0';		/* Whack the '>' */
-    xi_source_move_curp(srcp, cp); /* Save as next starting point */
+
+    xi_source_move_curp(srcp, cp + 1); /* Save as next starting point */
+    xi_source_hold(srcp, &dp, &cp);
+    *cp = '\0';		/* Whack the '>' */
 
     *datap = dp;
 
@@ -748,7 +954,7 @@ xi_source_token_text (xi_source_t *srcp, char **datap, char **restp)
     xi_source_move_curp(srcp, cp); /* Save as next starting point */
 
     if (srcp->xps_flags & XPSF_TRIM_WS) {
-	dp = xi_skipws(dp, cp - dp, 1); /* Trim leading ws */
+	dp = xi_scan_skip(dp, cp - dp, XI_SCAN_WS); /* Trim leading ws */
 	if (dp == NULL)			/* Nothing but ws */
 	    cp = NULL;
 	else {
@@ -771,12 +977,16 @@ xi_source_ignorews (xi_source_t *srcp)
     xi_offset_t off = xi_source_offset(srcp); /* Starting point */
     char *cp;
 
-    for (cp = &srcp->xps_bufp[off]; xi_isspace(*cp); cp++, off++) {
-	if (off >= srcp->xps_len) {
-	    if (xi_source_read(srcp, 0) < 0)
-		return;
-	    cp = &srcp->xps_bufp[off]; /* Refresh */
-	}
+    for (;;) {
+	cp = xi_scan_skip(&srcp->xps_bufp[off], srcp->xps_len - off,
+			  XI_SCAN_WS);
+	if (cp != NULL)
+	    break;
+
+	/* All whitespace so far; the read may move our data */
+	if (xi_source_read(srcp, 0) < 0)
+	    return;
+	off = xi_source_offset(srcp);
     }
 
     if (*cp != '<')
@@ -852,3 +1062,131 @@ xi_source_next_token (xi_source_t *srcp, char **datap, char **restp)
     srcp->xps_last = token;
     return token;
 }
+
+/*
+ * Find the '>' that ends the markup at "cp", the way the tokenizer
+ * does: the first one after the "skip" bytes of the opening, or, if
+ * "tail" is given, the first one right after those two bytes (for
+ * "-->" and "]]>").
+ */
+static const char *
+xi_source_split_gt (const char *cp, const char *ep, size_t skip,
+		    const char *tail)
+{
+    for (cp += skip; cp < ep; cp++) {
+	cp = xi_scan_find(cp, ep - cp, XI_SCAN_GT);
+	if (cp == NULL)
+	    return NULL;
+
+	if (tail == NULL || (cp[-2] == tail[0] && cp[-1] == tail[1]))
+	    return cp;
+    }
+
+    return NULL;
+}
+
+unsigned
+xi_source_split (xi_source_t *srcp, unsigned max, xi_offset_t *offsets)
+{
+    const char *base = srcp->xps_bufp, *ep = base + srcp->xps_len;
+    const char *cp = base, *gt;
+    size_t step = 0, next = 0;
+    unsigned count = 1, depth = 0;
+    int delta;
+
+    offsets[0] = 0;
+    if (max < 2 || !(srcp->xps_flags & XPSF_READ_ALL))
+	return count;
+
+    for (;;) {
+	cp = xi_scan_find(cp, ep - cp, XI_SCAN_LT);
+	if (cp == NULL || ep - cp < 4)
+	    break;
+
+	/* Between children of the root; time for the next piece? */
+	if (depth == 1 && (size_t) (cp - base) >= next
+	    && cp - base > offsets[count - 1]) {
+	    offsets[count++] = cp - base;
+	    if (count == max)
+		break;
+	    next += step;
+	}
+
+	delta = 0;
+	if (cp[1] == '!' && cp[2] == '-' && cp[3] == '-') {
+	    gt = xi_source_split_gt(cp, ep, 4, "--"); /* Comment */
+	} else if (cp[1] == '!' && cp[2] == '[') {
+	    gt = xi_source_split_gt(cp, ep, 3, "]]"); /* CDATA and such */
+	} else {
+	    gt = xi_source_split_gt(cp, ep, 1, NULL);
+	    if (cp[1] == '/')
+		delta = -1;	/* Close tag */
+	    else if (cp[1] != '!' && cp[1] != '?' && gt && gt[-1] != '/')
+		delta = 1;	/* Open tag (and not an empty one) */
+	}
+
+	if (gt == NULL)
+	    break;
+	cp = gt + 1;
+
+	if (delta < 0) {
+	    if (depth <= 1)
+		break;		/* The root is closed; we're done */
+	    depth -= 1;
+
+	} else if (delta > 0 && ++depth == 1) {
+	    /*
+	     * The first piece is everything thru the root's open tag;
+	     * the rest share out its contents
+	     */
+	    offsets[count++] = cp - base;
+	    if (count == max)
+		break;
+
+	    step = (ep - cp) / (max - 1);
+	    next = (cp - base) + step;
+	}
+    }
+
+    return count;
+}
+
+xi_source_t *
+xi_source_segment (xi_source_t *srcp, xi_offset_t start, xi_offset_t end)
+{
+    xi_source_t *segp;
+    char *cp, *ep;
+
+    if (start < 0 || start > end || (size_t) end > srcp->xps_len)
+	return NULL;
+
+    segp = calloc(1, sizeof(*segp));
+    if (segp == NULL)
+	return NULL;
+
+    segp->xps_fd = -1;
+    segp->xps_flags = (srcp->xps_flags & ~(XPSF_CLOSE_FD | XPSF_EOF_SEEN
+					   | XPSF_READ_AHEAD
+					   | XPSF_DECOMP_CHECK))
+	| XPSF_SEGMENT | XPSF_NO_READ | XPSF_READ_ALL;
+    segp->xps_bufp = segp->xps_curp = srcp->xps_bufp + start;
+    segp->xps_size = segp->xps_len = end - start;
+    segp->xps_offset = start;
+    segp->xps_lineno = 1;
+
+    if (srcp->xps_filename != NULL)
+	segp->xps_filename = strdup(srcp->xps_filename);
+
+    /* Line numbers cost a pass over what's ahead of us */
+    if (segp->xps_flags & XPSF_LINE_NO) {
+	ep = srcp->xps_bufp + start;
+	for (cp = srcp->xps_bufp; cp < ep; cp++) {
+	    cp = psu_memchr(cp, '\n', ep - cp);
+	    if (cp == NULL)
+		break;
+	    segp->xps_lineno += 1;
+	}
+    }
+
+    return segp;
+}
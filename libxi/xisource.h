@@ -26,23 +26,36 @@
 /*
  * Parser source object
  *
- * Note that we return pointers directly into our buffer.
+ * Note that we return pointers directly into our buffer.  Under
+ * XPSF_MMAP_INPUT, that buffer is a private mapping of the whole
+ * file, so text tokens point straight into it.  Tags are copied into
+ * xps_hold to be NUL-terminated, since writing into the mapping would
+ * copy the page; rarer constructs are NUL-terminated in place (the
+ * mapping is private, so that never reaches the file).
  */
 struct xi_source_s {
     int xps_fd;			/* File being read */
     char *xps_filename;		/* Filename */
     unsigned xps_lineno;	/* Line number of input */
-    unsigned xps_offset;	/* Offset in the file */
+    xi_offset_t xps_offset;	/* Offset in the file */
     xi_source_flags_t xps_flags; /* Flags for this source */
     char *xps_bufp;		/* Input buffer */
     char *xps_curp;		/* Current data point */
-    unsigned xps_len;		/* Number of bytes in the input buffer */
-    unsigned xps_size;		/* Size of the input buffer (max) */
+    size_t xps_len;		/* Number of bytes in the input buffer */
+    size_t xps_size;		/* Size of the input buffer (max) */
     xi_node_type_t xps_last;	/* Type of last token returned */
+    char *xps_scratch;		/* Scratch buffer (xi_source_unescape_copy) */
+    size_t xps_scratch_size;	/* Size of xps_scratch */
+    char *xps_hold;		/* Copy of the current tag (mmap'd input) */
+    size_t xps_hold_size;	/* Size of xps_hold */
+    xi_reader_t *xps_reader;	/* Read-ahead thread (XPSF_READ_AHEAD) */
+    size_t xps_ahead_chunk;	/* Chunk size for xps_reader */
+    unsigned xps_ahead_slots;	/* Number of chunks for xps_reader */
+    xi_decomp_t *xps_decomp;	/* Decompressor (compressed input) */
 }; /* xi_source_t */
 
 /* Flags for ps_flags: */
-#define XPSF_MMAP_INPUT	(1<<0)	/* File is mmap'd */
+#define XPSF_MMAP_INPUT	(1<<0)	/* File is (or should be) mmap'd */
 #define XPSF_IGNORE_WS	(1<<1)	/* Ignore whitespace-only mixed content */
 #define XPSF_NO_READ	(1<<2)	/* Don't read() on this fd */
 #define XPSF_EOF_SEEN	(1<<3)	/* EOF has been seen; read should fail */
@@ -53,6 +66,12 @@ struct xi_source_s {
 #define XPSF_LINE_NO	(1<<8)	/* Track line numbers for input */
 #define XPSF_IGNORE_COMMENTS (1<<9) /* Discard comments */
 #define XPSF_IGNORE_DTD (1<<10) /* Discard DTDs */
+#define XPSF_NO_MMAP	(1<<11) /* Never mmap the input (xi_source_open) */
+#define XPSF_READ_AHEAD	(1<<12) /* Read from a separate thread */
+#define XPSF_NO_DECOMP	(1<<13) /* Don't look for compressed input */
+#define XPSF_NO_READ_AHEAD (1<<14) /* Never read from a separate thread */
+#define XPSF_DECOMP_CHECK (1<<15) /* First read checks for compression */
+#define XPSF_SEGMENT	(1<<16) /* Piece of another source's buffer */
 
 xi_source_t *
 xi_source_create (int fd, xi_source_flags_t flags);
@@ -63,12 +82,62 @@ xi_source_open (const char *path, xi_source_flags_t flags);
 void
 xi_source_destroy (xi_source_t *srcp);
 
+/*
+ * Read ahead of the tokenizer, in a separate thread, with "slots"
+ * chunks of "chunk" bytes (zero for the defaults).  This is what
+ * XPSF_READ_AHEAD does with the defaults; it's a win for pipes and
+ * sockets, where read() would otherwise block the parse.  It's not
+ * used for mmap'd input.  Returns zero on success, or -1 if we've no
+ * threads (in which case we carry on reading in-line).
+ *
+ * Compressed (gzip or zstd) input is spotted by its magic number on
+ * the first read, unless XPSF_NO_DECOMP is set, and is decompressed
+ * as it's read.  That's done on the read-ahead thread, which is
+ * started for it, unless XPSF_NO_READ_AHEAD is set.
+ */
+int
+xi_source_read_ahead (xi_source_t *srcp, size_t chunk, unsigned slots);
+
+/*
+ * Find places to split an input that's all in memory (mmap'd) so the
+ * pieces can be tokenized separately (and in parallel): the first
+ * piece is everything thru the root element's open tag, and the
+ * rest split the root's contents into (roughly) equal runs of whole
+ * children, with the root's close tag at the end of the last.  The
+ * scan follows the tokenizer's rules, so it splits where it would.
+ * Fills in "offsets" with the start of each piece (the first is
+ * zero) and returns the number of pieces, at most "max".  A source
+ * that isn't all in memory, or has no root, gives one piece.
+ */
+unsigned
+xi_source_split (xi_source_t *srcp, unsigned max, xi_offset_t *offsets);
+
+/*
+ * Make a source for the bytes from "start" to "end" of the in-memory
+ * input of "srcp", typically a piece from xi_source_split().  It
+ * shares the parent's buffer, so the parent must outlive it, but
+ * pieces can be tokenized at the same time in different threads.
+ * Returns NULL if the range isn't in the buffer.
+ */
+xi_source_t *
+xi_source_segment (xi_source_t *srcp, xi_offset_t start, xi_offset_t end);
+
 xi_node_type_t
 xi_source_next_token (xi_source_t *srcp, char **datap, char **restp);
 
 size_t
 xi_source_unescape (xi_source_t *srcp, char *start, unsigned len);
 
+/*
+ * Unescape XML text data into the source's scratch buffer, leaving
+ * the input untouched.  Returns the (NUL-terminated) unescaped text,
+ * which is good until the next call, and its length in "*lenp"; or
+ * NULL if we can't allocate the room.
+ */
+char *
+xi_source_unescape_copy (xi_source_t *srcp, const char *start, size_t len,
+			 size_t *lenp);
+
 void
 xi_source_failure (xi_source_t *srcp, int errnum, const char *fmt, ...);
 
@@ -21,90 +21,412 @@
 #include <assert.h>
 
 #include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
 #include <parrotdb/palog2.h>
 #include <parrotdb/paarb.h>
+#include <parrotdb/pathread.h>
 #include <libpsu/psualloc.h>
 #include <libpsu/psulog.h>
 
+/*
+ * Find the size class for an allocation.  Classes are linear, by
+ * PA_ARB_ATOM_SIZE, up to PA_ARB_CLASS_LINEAR_SHIFT, and then each
+ * doubling is split into PA_ARB_CLASS_GROUP steps.
+ */
 static inline unsigned
 pa_arb_slot (size_t size)
 {
-    if (size < (1 << PA_ARB_ATOM_SHIFT))
-	return 0;
+    if (size <= (1 << PA_ARB_CLASS_LINEAR_SHIFT))
+	return size ? (size - 1) >> PA_ARB_ATOM_SHIFT : 0;
+
+    if (size > PA_ARB_MAX_SMALL)
+	return PA_ARB_SLOTS;
+
+    /* Find the doubling that holds us, and our step within it */
+    unsigned shift = pa_log2(size - 1) - 1;
+    unsigned step = (size - 1 - (1 << shift))
+	>> (shift - PA_ARB_CLASS_GROUP_SHIFT);
+
+    return PA_ARB_CLASS_LINEAR
+	+ ((shift - PA_ARB_CLASS_LINEAR_SHIFT) << PA_ARB_CLASS_GROUP_SHIFT)
+	+ step;
+}
+
+/*
+ * Convert from slot number to chunk size; this is the upper bound
+ * of the size class, where the first slot is an atom
+ * (PA_ARB_ATOM_SIZE).
+ */
+static inline size_t
+pa_arb_slot_to_size (pa_arb_t *prp UNUSED, unsigned slot)
+{
+    if (slot < PA_ARB_CLASS_LINEAR)
+	return (slot + 1) << PA_ARB_ATOM_SHIFT;
+
+    slot -= PA_ARB_CLASS_LINEAR;
 
-    return pa_log2(size - 1) - PA_ARB_ATOM_SHIFT;
+    size_t base = 1 << (PA_ARB_CLASS_LINEAR_SHIFT
+			+ (slot >> PA_ARB_CLASS_GROUP_SHIFT));
+    unsigned step = (slot & (PA_ARB_CLASS_GROUP - 1)) + 1;
+
+    return base + step * (base >> PA_ARB_CLASS_GROUP_SHIFT);
 }
 
 static inline uint32_t
-pa_arb_chunks_per_page (pa_arb_t *prp UNUSED, unsigned slot)
+pa_arb_chunks_per_page (size_t page_size, size_t size)
 {
-    uint32_t val = 1 << PA_ARB_OFFSET_SHIFT;
-    val >>= slot;
-    return val ?: 1;
+    uint32_t val = page_size / size;
+    return (val < PA_ARB_CHUNK_SIZE) ? val : PA_ARB_CHUNK_SIZE;
 }
 
 /*
- * Convert from slot number to size; this is power of two, where
- * the first slot is an atom (PA_ARB_ATOM_SIZE).
+ * Pick the page size for a slot, which is the smallest number of
+ * matoms that leaves less than an eighth of the page unused.
  */
 static inline size_t
-pa_arb_slot_to_size (pa_arb_t *prp UNUSED, unsigned slot)
+pa_arb_slot_page_size (pa_arb_t *prp, unsigned slot)
 {
-    size_t val = 1 << (slot + PA_ARB_ATOM_SHIFT);
+    size_t size = pa_arb_slot_to_size(prp, slot);
+    size_t page_size = pa_roundup32(size, PA_MMAP_ATOM_SIZE);
 
-    return (val < PA_MMAP_ATOM_SIZE) ? PA_MMAP_ATOM_SIZE : val;
+    while (pa_arb_chunks_per_page(page_size, size) * size
+	   < page_size - page_size / 8)
+	page_size += PA_MMAP_ATOM_SIZE;
+
+    return page_size;
 }
 
+/*
+ * Build the atom for a chunk.  Since chunks aren't powers of two,
+ * they can straddle matoms, so we find the matom that holds the
+ * start of the chunk and use our offset within it.
+ */
 static inline pa_arb_atom_t
-pa_arb_build_atom (pa_arb_t *prp UNUSED, pa_mmap_atom_t matom,
+pa_arb_build_atom (pa_arb_t *prp, pa_mmap_atom_t matom,
 		      pa_arb_slot_t slot, pa_arb_chunk_t chunk)
 {
     if (pa_mmap_is_null(matom))
 	return pa_arb_null_atom();
 
+    uint32_t off = chunk * pa_arb_slot_to_size(prp, slot);
+
     /* High bits are the mmap atom */
-    pa_atom_t raw = pa_mmap_atom_of(matom) << PA_ARB_OFFSET_SHIFT;
+    pa_atom_t raw = pa_mmap_atom_of(matom) + (off >> PA_MMAP_ATOM_SHIFT);
+    raw <<= PA_ARB_OFFSET_SHIFT;
 
     /* Low bits are the arb atom */
-    uint32_t off = (1 << slot) * chunk;
-    raw |= off;
+    raw |= (off & (PA_MMAP_ATOM_SIZE - 1)) >> PA_ARB_ATOM_SHIFT;
 
     return pa_arb_atom(raw);
 }
 
+/*
+ * Find the page that holds a chunk, working back from the chunk number
+ */
+static inline pa_mmap_atom_t
+pa_arb_chunk_page (pa_arb_t *prp, pa_arb_atom_t atom,
+		   pa_arb_slot_t slot, pa_arb_chunk_t chunk)
+{
+    uint32_t off = chunk * pa_arb_slot_to_size(prp, slot);
+    pa_atom_t matom = pa_arb_atom_of(atom) >> PA_ARB_OFFSET_SHIFT;
+
+    return pa_mmap_atom(matom - (off >> PA_MMAP_ATOM_SHIFT));
+}
+
+/*
+ * Return the page info for a page of chunks
+ */
+static inline pa_arb_page_info_t *
+pa_arb_page_info (pa_arb_t *prp, pa_mmap_atom_t page)
+{
+    return pa_fixed_element(prp->pr_page_info, pa_mmap_atom_of(page));
+}
+
+/*
+ * Put a page on the front of the list of pages with free chunks
+ */
+static void
+pa_arb_page_link (pa_arb_t *prp, pa_mmap_atom_t page,
+		  pa_arb_page_info_t *ppip)
+{
+    pa_mmap_atom_t *headp = &prp->pr_infop->pri_pages[ppip->ppi_slot];
+
+    ppip->ppi_prev = pa_mmap_null_atom();
+    ppip->ppi_next = *headp;
+
+    if (!pa_mmap_is_null(*headp))
+	pa_arb_page_info(prp, *headp)->ppi_prev = page;
+
+    *headp = page;
+}
+
+/*
+ * Take a page off the list of pages with free chunks
+ */
 static void
+pa_arb_page_unlink (pa_arb_t *prp, pa_arb_page_info_t *ppip)
+{
+    if (pa_mmap_is_null(ppip->ppi_prev))
+	prp->pr_infop->pri_pages[ppip->ppi_slot] = ppip->ppi_next;
+    else
+	pa_arb_page_info(prp, ppip->ppi_prev)->ppi_next = ppip->ppi_next;
+
+    if (!pa_mmap_is_null(ppip->ppi_next))
+	pa_arb_page_info(prp, ppip->ppi_next)->ppi_prev = ppip->ppi_prev;
+
+    ppip->ppi_next = ppip->ppi_prev = pa_mmap_null_atom();
+}
+
+/*
+ * Allocate a new page for a slot, marking all its chunks as free.
+ * We don't touch the page itself, so it won't be faulted in until
+ * a chunk is used.
+ */
+static pa_mmap_atom_t
 pa_arb_make_page (pa_arb_t *prp, unsigned slot)
 {
-    size_t real_size = pa_arb_slot_to_size(prp, slot);
-    pa_mmap_atom_t matom = pa_mmap_alloc(prp->pr_mmap, real_size);
-    if (pa_mmap_is_null(matom))
+    size_t real_size = pa_arb_slot_page_size(prp, slot);
+    pa_mmap_atom_t page = pa_mmap_alloc(prp->pr_mmap, real_size);
+    if (pa_mmap_is_null(page))
+	return page;
+
+    pa_arb_page_info_t *ppip = pa_arb_page_info(prp, page);
+    if (ppip == NULL) {
+	pa_mmap_free(prp->pr_mmap, page, real_size);
+	return pa_mmap_null_atom();
+    }
+
+    unsigned chunks_per_page
+	= pa_arb_chunks_per_page(real_size, pa_arb_slot_to_size(prp, slot));
+    unsigned i;
+
+    bzero(ppip, sizeof(*ppip));
+    ppip->ppi_magic = PPI_MAGIC;
+    ppip->ppi_slot = slot;
+    ppip->ppi_matoms = real_size >> PA_MMAP_ATOM_SHIFT;
+    ppip->ppi_chunks = chunks_per_page;
+
+    for (i = 0; i < chunks_per_page; i += PA_ARB_BITS_WIDTH) {
+	unsigned left = chunks_per_page - i;
+	ppip->ppi_free_bits[i / PA_ARB_BITS_WIDTH]
+	    = (left >= PA_ARB_BITS_WIDTH) ? (pa_arb_bits_t) -1
+	    : (((pa_arb_bits_t) 1) << left) - 1;
+    }
+
+    pa_arb_page_link(prp, page, ppip);
+    prp->pr_infop->pri_empty[slot] += 1;
+
+    return page;
+}
+
+/*
+ * In thread-safe mode, each slot's pages (and their free chunks) are
+ * guarded by the slot's own lock; otherwise, we have no locks.
+ */
+static inline pa_lock_t *
+pa_arb_slot_lock (pa_arb_t *prp, unsigned slot)
+{
+    return prp->pr_locks ? &prp->pr_locks[slot] : NULL;
+}
+
+/*
+ * Take a chunk off the first page with free chunks for a slot, making
+ * a new page of chunks if needed.  In thread-safe mode, the caller
+ * holds the slot's lock.
+ */
+static pa_arb_atom_t
+pa_arb_alloc_small_unlocked (pa_arb_t *prp, unsigned slot)
+{
+    pa_mmap_atom_t page = prp->pr_infop->pri_pages[slot];
+    if (pa_mmap_is_null(page)) {
+	/*
+	 * We're out of chunks at this size, so we go allocate some
+	 * memory, so we can try again to pull off a new chunk.
+	 */
+	page = pa_arb_make_page(prp, slot);
+	if (pa_mmap_is_null(page))
+	    return pa_arb_null_atom();
+    }
+
+    pa_arb_page_info_t *ppip = pa_arb_page_info(prp, page);
+    unsigned i, chunk;
+
+    for (i = 0; ppip->ppi_free_bits[i] == 0; i++)
+	continue;		/* Pages on our list must have a free chunk */
+
+    chunk = ffs(ppip->ppi_free_bits[i]) - 1;
+    ppip->ppi_free_bits[i] &= ~(((pa_arb_bits_t) 1) << chunk);
+    chunk += i * PA_ARB_BITS_WIDTH;
+
+    if (ppip->ppi_inuse++ == 0)
+	prp->pr_infop->pri_empty[slot] -= 1;
+
+    if (ppip->ppi_inuse == ppip->ppi_chunks)
+	pa_arb_page_unlink(prp, ppip);
+
+    pa_arb_atom_t atom = pa_arb_build_atom(prp, page, slot, chunk);
+    pa_arb_header_t *prhp = pa_arb_header(prp, atom);
+
+    prhp->prh_slot = slot;
+    prhp->prh_chunk = chunk;
+
+    return atom;
+}
+
+/*
+ * Put a chunk back on its page, and if the page is now empty and we
+ * are already holding enough empty pages for this slot, give the
+ * page back to pa_mmap.  In thread-safe mode, the caller holds
+ * the slot's lock.
+ */
+static void
+pa_arb_free_small_unlocked (pa_arb_t *prp, pa_arb_atom_t atom, unsigned slot)
+{
+    pa_arb_header_t *prhp = pa_arb_header(prp, atom);
+    unsigned chunk = prhp->prh_chunk;
+    pa_mmap_atom_t page = pa_arb_chunk_page(prp, atom, slot, chunk);
+
+    pa_arb_page_info_t *ppip = pa_arb_page_info(prp, page);
+    if (ppip == NULL || ppip->ppi_magic != PPI_MAGIC
+	    || ppip->ppi_slot != slot || chunk >= ppip->ppi_chunks) {
+	pa_warning(0, "pa_arb: free of atom %#" PA_ATOM_XFMT
+		   " on bad page %#" PA_ATOM_XFMT,
+		   pa_arb_atom_of(atom), pa_mmap_atom_of(page));
 	return;
+    }
 
-    pa_arb_header_t *prhp;
-    unsigned chunks_per_page = pa_arb_chunks_per_page(prp, slot);
-    unsigned i, imax = chunks_per_page;
+    pa_arb_bits_t bit = ((pa_arb_bits_t) 1) << (chunk % PA_ARB_BITS_WIDTH);
+    pa_arb_bits_t *bitsp = &ppip->ppi_free_bits[chunk / PA_ARB_BITS_WIDTH];
 
-    /*
-     * Whiffle thru the page, setting up the chunks
-     */
-    pa_arb_atom_t atom = pa_arb_build_atom(prp, matom, slot, 0);
-    pa_arb_atom_t saved_atom = atom;
+    if (*bitsp & bit) {
+	pa_warning(0, "attempt to double free atom %#" PA_ATOM_XFMT,
+		   pa_arb_atom_of(atom));
+	return;
+    }
 
-    for (i = 0; i < imax; i++) {
-	prhp = pa_arb_header(prp, atom);
-	prhp->prh_magic = PRH_MAGIC_SMALL_FREE;
-	prhp->prh_slot = slot;
-	prhp->prh_chunk = i;
+    *bitsp |= bit;
+
+    /* If the page was full, it's back on the list */
+    if (ppip->ppi_inuse-- == ppip->ppi_chunks)
+	pa_arb_page_link(prp, page, ppip);
+
+    if (ppip->ppi_inuse != 0)
+	return;
+
+    if (prp->pr_infop->pri_empty[slot] < prp->pr_keep_pages) {
+	prp->pr_infop->pri_empty[slot] += 1;
+	return;
+    }
+
+    pa_arb_page_unlink(prp, ppip);
+    ppip->ppi_magic = 0;
+    pa_mmap_free(prp->pr_mmap, page,
+		 ppip->ppi_matoms << PA_MMAP_ATOM_SHIFT);
+}
 
-	if (i == imax - 1)
-	    atom = pa_arb_null_atom(); /* End of the block */
-	else atom = pa_arb_build_atom(prp, matom, slot, i + 1);
+/*
+ * Thread-safe allocation: take a chunk from our magazine for this
+ * slot, filling it half way from the central free list when empty.
+ */
+static pa_arb_atom_t
+pa_arb_alloc_small_mt (pa_arb_t *prp, unsigned slot)
+{
+    pa_magazine_t *mags = prp->pr_depot ? pa_depot_magazines(prp->pr_depot)
+	: NULL;
+    pa_lock_t *lock = pa_arb_slot_lock(prp, slot);
+    pa_arb_atom_t atom;
+
+    if (mags == NULL) {
+	pa_lock(lock);
+	atom = pa_arb_alloc_small_unlocked(prp, slot);
+	pa_unlock(lock);
+	return atom;
+    }
+
+    pa_magazine_t *mag = &mags[slot];
+    if (mag->pmg_count == 0) {
+	pa_lock(lock);
+	while (mag->pmg_count < PA_MAGAZINE_SIZE / 2) {
+	    atom = pa_arb_alloc_small_unlocked(prp, slot);
+	    if (pa_arb_is_null(atom))
+		break;
+	    mag->pmg_atoms[mag->pmg_count++] = pa_arb_atom_of(atom);
+	}
+	pa_unlock(lock);
 
-	prhp->prh_next_free[0] = atom;
+	if (mag->pmg_count == 0)
+	    return pa_arb_null_atom();
     }
 
-    prp->pr_infop->pri_free[slot] = saved_atom;
+    return pa_arb_atom(mag->pmg_atoms[--mag->pmg_count]);
+}
+
+/*
+ * Return chunks from a slot's magazine to the central free list,
+ * until only 'keep' remain.  The caller holds the slot's lock.
+ */
+static void
+pa_arb_magazine_drain (pa_arb_t *prp, pa_magazine_t *mag, unsigned slot,
+		       uint32_t keep)
+{
+    while (mag->pmg_count > keep)
+	pa_arb_free_small_unlocked(prp,
+			pa_arb_atom(mag->pmg_atoms[--mag->pmg_count]), slot);
+}
+
+/*
+ * Thread-safe free: put the chunk in our magazine for its slot,
+ * emptying it half way to the central free list when it's full.
+ */
+static void
+pa_arb_free_small_mt (pa_arb_t *prp, pa_arb_atom_t atom, unsigned slot)
+{
+    pa_magazine_t *mags = prp->pr_depot ? pa_depot_magazines(prp->pr_depot)
+	: NULL;
+    pa_lock_t *lock = pa_arb_slot_lock(prp, slot);
+
+    if (mags == NULL) {
+	pa_lock(lock);
+	pa_arb_free_small_unlocked(prp, atom, slot);
+	pa_unlock(lock);
+	return;
+    }
+
+    pa_magazine_t *mag = &mags[slot];
+    if (mag->pmg_count >= PA_MAGAZINE_SIZE) {
+	pa_lock(lock);
+	pa_arb_magazine_drain(prp, mag, slot, PA_MAGAZINE_SIZE / 2);
+	pa_unlock(lock);
+    }
+
+    mag->pmg_atoms[mag->pmg_count++] = pa_arb_atom_of(atom);
+}
+
+/*
+ * Return the calling thread's cached chunks to the central free lists
+ */
+void
+pa_arb_flush (pa_arb_t *prp)
+{
+    if (prp->pr_depot == NULL)
+	return;
+
+    pa_magazine_t *mags = pa_depot_magazines(prp->pr_depot);
+    if (mags == NULL)
+	return;
+
+    unsigned slot;
+
+    for (slot = 0; slot < PA_ARB_SLOTS; slot++) {
+	if (mags[slot].pmg_count == 0)
+	    continue;
+
+	pa_lock(pa_arb_slot_lock(prp, slot));
+	pa_arb_magazine_drain(prp, &mags[slot], slot, 0);
+	pa_unlock(pa_arb_slot_lock(prp, slot));
+    }
 }
 
 /*
@@ -122,24 +444,17 @@ pa_arb_alloc (pa_arb_t *prp, size_t size)
 
     pa_arb_atom_t atom = pa_arb_null_atom();
 
-    if (slot <= PA_ARB_MAX_POW2) {
+    if (slot < PA_ARB_SLOTS) {
 	/* "Small"-style allocation */
-	atom = prp->pr_infop->pri_free[slot];
-	if (pa_arb_is_null(atom)) {
-	    /*
-	     * We're out of chunks at this size, so we go allocate some
-	     * memory, so we can try again to pull off a new chunk.
-	     */
-	    pa_arb_make_page(prp, slot);
-	    atom = prp->pr_infop->pri_free[slot];
-	    if (pa_arb_is_null(atom))
-		return pa_arb_null_atom();
-	}
+	if (prp->pr_locks)
+	    atom = pa_arb_alloc_small_mt(prp, slot);
+	else
+	    atom = pa_arb_alloc_small_unlocked(prp, slot);
 
-	prhp = pa_arb_header(prp, atom);
+	if (pa_arb_is_null(atom))
+	    return pa_arb_null_atom();
 
-	/* Pull out the next free atom and record in our slot */
-	prp->pr_infop->pri_free[slot] = prhp->prh_next_free[0];
+	prhp = pa_arb_header(prp, atom);
 
 	/* Mark the atom as in-use */
 	prhp->prh_magic = PRH_MAGIC_SMALL_INUSE;
@@ -173,6 +488,89 @@ pa_arb_alloc (pa_arb_t *prp, size_t size)
     return atom;
 }
 
+/*
+ * Take up to "count" chunks for a slot, emptying each page before
+ * looking up the next.  The caller holds the slot's lock (if any).
+ */
+static unsigned
+pa_arb_alloc_small_batch_unlocked (pa_arb_t *prp, unsigned slot,
+				   pa_arb_atom_t *atoms, unsigned count)
+{
+    pa_arb_page_info_t *ppip;
+    pa_arb_header_t *prhp;
+    pa_mmap_atom_t page;
+    pa_arb_atom_t atom;
+    unsigned n = 0, i, chunk;
+
+    while (n < count) {
+	page = prp->pr_infop->pri_pages[slot];
+	if (pa_mmap_is_null(page)) {
+	    page = pa_arb_make_page(prp, slot);
+	    if (pa_mmap_is_null(page))
+		break;
+	}
+
+	ppip = pa_arb_page_info(prp, page);
+	if (ppip->ppi_inuse == 0)
+	    prp->pr_infop->pri_empty[slot] -= 1;
+
+	for (i = 0; n < count && ppip->ppi_inuse < ppip->ppi_chunks; ) {
+	    while (ppip->ppi_free_bits[i] == 0)
+		i += 1;
+
+	    chunk = ffs(ppip->ppi_free_bits[i]) - 1;
+	    ppip->ppi_free_bits[i] &= ~(((pa_arb_bits_t) 1) << chunk);
+	    chunk += i * PA_ARB_BITS_WIDTH;
+	    ppip->ppi_inuse += 1;
+
+	    atom = pa_arb_build_atom(prp, page, slot, chunk);
+	    prhp = pa_arb_header(prp, atom);
+	    prhp->prh_slot = slot;
+	    prhp->prh_chunk = chunk;
+	    prhp->prh_magic = PRH_MAGIC_SMALL_INUSE;
+
+	    atoms[n++] = atom;
+	}
+
+	if (ppip->ppi_inuse == ppip->ppi_chunks)
+	    pa_arb_page_unlink(prp, ppip);
+    }
+
+    return n;
+}
+
+/*
+ * Allocate "count" chunks of the same size, filling in "atoms".
+ * Small chunks are taken under one lock, a page at a time, so they
+ * are usually adjacent.  (They bypass the per-thread magazines.)
+ * Returns the number allocated, which is short only on failure.
+ */
+unsigned
+pa_arb_alloc_atoms (pa_arb_t *prp, size_t size, pa_arb_atom_t *atoms,
+		    unsigned count)
+{
+    size_t full_size = size + sizeof(pa_arb_header_t);
+    unsigned slot = pa_arb_slot(full_size);
+    unsigned n;
+
+    if (slot >= PA_ARB_SLOTS) {
+	/* Large chunks come straight from pa_mmap, one at a time */
+	for (n = 0; n < count; n++) {
+	    atoms[n] = pa_arb_alloc(prp, size);
+	    if (pa_arb_is_null(atoms[n]))
+		break;
+	}
+
+	return n;
+    }
+
+    pa_lock(pa_arb_slot_lock(prp, slot));
+    n = pa_arb_alloc_small_batch_unlocked(prp, slot, atoms, count);
+    pa_unlock(pa_arb_slot_lock(prp, slot));
+
+    return n;
+}
+
 static void
 pa_arb_free_atom_addr (pa_arb_t *prp, pa_arb_atom_t atom, void *addr)
 {
@@ -186,14 +584,16 @@ pa_arb_free_atom_addr (pa_arb_t *prp, pa_arb_atom_t atom, void *addr)
     case PRH_MAGIC_SMALL_INUSE:
 	/* "Small"-style allocation */
 	slot = prhp->prh_slot;
-
-	prhp->prh_next_free[0] = prp->pr_infop->pri_free[slot];
-	prp->pr_infop->pri_free[slot] = atom;
 	prhp->prh_magic = PRH_MAGIC_SMALL_FREE;
+
+	if (prp->pr_locks)
+	    pa_arb_free_small_mt(prp, atom, slot);
+	else
+	    pa_arb_free_small_unlocked(prp, atom, slot);
 	break;
 
     case PRH_MAGIC_SMALL_FREE:
-	pa_warning(0, "attempt to double free atom %#x (%p)",
+	pa_warning(0, "attempt to double free atom %#" PA_ATOM_XFMT " (%p)",
 		   pa_arb_atom_of(atom), addr);
 	break;
 
@@ -205,12 +605,12 @@ pa_arb_free_atom_addr (pa_arb_t *prp, pa_arb_atom_t atom, void *addr)
 	break;
 
     case PRH_MAGIC_LARGE_FREE:
-	pa_warning(0, "attempt to double free atom %#x (%p)",
+	pa_warning(0, "attempt to double free atom %#" PA_ATOM_XFMT " (%p)",
 		   pa_arb_atom_of(atom), addr);
 	break;
 
     default:
-	pa_warning(0, "bad magic number atom %#x (%p): %#x",
+	pa_warning(0, "bad magic number atom %#" PA_ATOM_XFMT " (%p): %#x",
 		   pa_arb_atom_of(atom), addr, prhp->prh_magic);
     }
 }
@@ -228,24 +628,104 @@ pa_arb_free_atom (pa_arb_t *prp, pa_arb_atom_t atom)
     pa_arb_free_atom_addr(prp, atom, addr);
 }
 
+/*
+ * Return the number of usable bytes in an allocation, which may be
+ * more than was asked for, since we round up to the size class (or
+ * to a full page for "large" allocations).
+ */
+size_t
+pa_arb_atom_size (pa_arb_t *prp, pa_arb_atom_t atom)
+{
+    pa_arb_header_t *prhp = pa_arb_header(prp, atom);
+    if (pa_arb_is_null(atom) || prhp == NULL)
+	return 0;
+
+    switch (prhp->prh_magic) {
+    case PRH_MAGIC_SMALL_INUSE:
+	return pa_arb_slot_to_size(prp, prhp->prh_slot) - sizeof(*prhp);
+
+    case PRH_MAGIC_LARGE_INUSE:
+	return (prhp->prh_size << PA_MMAP_ATOM_SHIFT) - sizeof(*prhp);
+    }
+
+    return 0;
+}
+
+/*
+ * Resize an allocation.  If the new size fits in the chunk we
+ * already have (which it often will, thanks to rounding up to the
+ * size class), the atom is returned unchanged.  Otherwise we allocate
+ * a new chunk, copy the contents, and free the old one.  As with
+ * realloc(), if the allocation fails, the original atom is untouched
+ * and NULL is returned.
+ */
+pa_arb_atom_t
+pa_arb_realloc (pa_arb_t *prp, pa_arb_atom_t atom, size_t size)
+{
+    if (pa_arb_is_null(atom))
+	return pa_arb_alloc(prp, size);
+
+    size_t old_size = pa_arb_atom_size(prp, atom);
+    if (old_size == 0) {
+	pa_warning(0, "pa_arb: realloc of bad atom %#" PA_ATOM_XFMT,
+		   pa_arb_atom_of(atom));
+	return pa_arb_null_atom();
+    }
+
+    if (size <= old_size)
+	return atom;
+
+    pa_arb_atom_t new_atom = pa_arb_alloc(prp, size);
+    if (pa_arb_is_null(new_atom))
+	return pa_arb_null_atom();
+
+    memcpy(pa_arb_atom_addr(prp, new_atom), pa_arb_atom_addr(prp, atom),
+	   old_size);
+    pa_arb_free_atom(prp, atom);
+
+    return new_atom;
+}
+
 void
-pa_arb_init (pa_mmap_t *pmp, pa_arb_t *prp)
+pa_arb_init (pa_mmap_t *pmp, pa_arb_t *prp, const char *name)
 {
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+
     prp->pr_mmap = pmp;
+    prp->pr_keep_pages = pa_config_value32(name, "keep-pages",
+					   PA_ARB_KEEP_PAGES);
+
+    /* Our page info is a paged array, indexed by matom number */
+    if (prp->pr_page_info == NULL) {
+	pa_config_name(namebuf, sizeof(namebuf), name, "pages");
+	prp->pr_page_info = pa_fixed_setup(pmp, &prp->pr_infop->pri_page_info,
+				namebuf, PA_ARB_PAGE_INFO_SHIFT,
+				sizeof(pa_arb_page_info_t), PA_ARB_MAX_MATOMS);
+    }
+
+    if ((pmp->pm_flags & PMF_THREAD_SAFE) && prp->pr_locks == NULL) {
+	prp->pr_locks = pa_lock_create_stripes(PA_ARB_SLOTS);
+	prp->pr_depot = pa_depot_create(PA_ARB_SLOTS);
+    }
 }
 
 pa_arb_t *
-pa_arb_setup (pa_mmap_t *pmp, pa_arb_info_t *prip)
+pa_arb_setup (pa_mmap_t *pmp, pa_arb_info_t *prip, const char *name)
 {
     pa_arb_t *prp = psu_calloc(sizeof(*prp));
 
     if (prp) {
-	prp->pr_infop = prip;
-	pa_arb_init(pmp, prp);
+	prp->pr_infop = prip ?: &prp->pr_info;
+	pa_arb_init(pmp, prp, name);
+
+	if (prp->pr_page_info == NULL) {
+	    pa_arb_close(prp);
+	    prp = NULL;
+	}
     }
 
     return prp;
-}    
+}
 
 pa_arb_t *
 pa_arb_open (pa_mmap_t *pmp, const char *name)
@@ -260,13 +740,34 @@ pa_arb_open (pa_mmap_t *pmp, const char *name)
 	}
     }
 
-    return pa_arb_setup(pmp, prip);
+    return pa_arb_setup(pmp, prip, name);
 }
 
 
 void
 pa_arb_close (pa_arb_t *prp)
 {
+    /* Give back any chunks still sitting in magazines */
+    if (prp->pr_depot) {
+	int i;
+	unsigned slot;
+
+	for (i = 0; i < PA_THREAD_MAX; i++) {
+	    pa_magazine_t *mags = prp->pr_depot->pd_mags[i];
+	    if (mags == NULL)
+		continue;
+
+	    for (slot = 0; slot < PA_ARB_SLOTS; slot++)
+		pa_arb_magazine_drain(prp, &mags[slot], slot, 0);
+	}
+
+	pa_depot_destroy(prp->pr_depot);
+    }
+
+    if (prp->pr_page_info)
+	pa_fixed_close(prp->pr_page_info);
+
+    pa_lock_destroy_stripes(prp->pr_locks, PA_ARB_SLOTS);
     psu_free(prp);
 }
 
@@ -274,43 +775,41 @@ void
 pa_arb_dump (pa_arb_t *prp)
 {
     pa_arb_slot_t slot;
-    pa_arb_atom_t atom, saved_atom;
-    pa_arb_header_t *prhp;
-    unsigned count;
+    pa_mmap_atom_t page;
+    pa_arb_page_info_t *ppip;
+    unsigned count, free_chunks;
 
     psu_log("begin dumping pa_arb_t");
 
-    for (slot = 0; slot <= PA_ARB_MAX_POW2; slot++) {
-	saved_atom = atom = prp->pr_infop->pri_free[slot];
-	if (pa_arb_is_null(atom))
+    for (slot = 0; slot < PA_ARB_SLOTS; slot++) {
+	page = prp->pr_infop->pri_pages[slot];
+	if (pa_mmap_is_null(page))
 	    continue;
 
-	for (count = 0, prhp = pa_arb_header(prp, atom); prhp != NULL;
-	     prhp = pa_arb_header(prp, atom)) {
-	    if (prhp->prh_magic == PRH_MAGIC_SMALL_FREE) {
-		count += 1;
-		atom = prhp->prh_next_free[0];
-	    } else
+	for (count = free_chunks = 0; !pa_mmap_is_null(page);
+	     page = ppip->ppi_next) {
+	    ppip = pa_arb_page_info(prp, page);
+	    if (ppip == NULL || ppip->ppi_magic != PPI_MAGIC)
 		break;
+	    count += 1;
+	    free_chunks += ppip->ppi_chunks - ppip->ppi_inuse;
 	}
-	atom = saved_atom;
-
-	psu_log("  slot:%u %#x (%u)", slot, pa_arb_atom_of(atom), count);
-	for (prhp = pa_arb_header(prp, atom); prhp != NULL;
-	     prhp = pa_arb_header(prp, atom)) {
-	    if (prhp->prh_magic == PRH_MAGIC_SMALL_FREE) {
-		psu_log("    %#x:%p slot:%u chunk:%u next %#x",
-			pa_arb_atom_of(atom), prhp, prhp->prh_slot,
-			prhp->prh_chunk,
-			pa_arb_atom_of(prhp->prh_next_free[0]));
-
-		atom = prhp->prh_next_free[0];
-
-	    } else {
-		psu_log("    %#x:%p bad magic number (%#x)",
-			pa_arb_atom_of(atom), prhp, prhp->prh_magic);
+
+	psu_log("  slot:%u pages:%u (empty %u), free chunks:%u",
+		slot, count, prp->pr_infop->pri_empty[slot], free_chunks);
+
+	for (page = prp->pr_infop->pri_pages[slot]; !pa_mmap_is_null(page);
+	     page = ppip->ppi_next) {
+	    ppip = pa_arb_page_info(prp, page);
+	    if (ppip == NULL || ppip->ppi_magic != PPI_MAGIC) {
+		psu_log("    page %#" PA_ATOM_XFMT ": bad magic number (%#x)",
+			pa_mmap_atom_of(page), ppip ? ppip->ppi_magic : 0);
 		break;
 	    }
+
+	    psu_log("    page %#" PA_ATOM_XFMT ": slot:%u in-use:%u/%u",
+		    pa_mmap_atom_of(page), ppip->ppi_slot,
+		    ppip->ppi_inuse, ppip->ppi_chunks);
 	}
     }
     psu_log("end dumping pa_arb_t");
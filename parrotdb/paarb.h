@@ -34,16 +34,42 @@
  *
  * We use the low bits of the atom value to identify the chunk's
  * offset, and the minimal chunk size is 16 bytes (PA_ARB_ATOM_SIZE).
- * That gives us a max database size of 64GB when pa_arb is in use.
+ * That gives us a max database size of 64GB when pa_arb is in use,
+ * unless we're built with wide (64-bit) atoms, which lifts the limit
+ * to PA_ARB_MAX_MATOMS (1TB by default).
  *
  * Be aware that you will likely forget most numbers are in atoms,
  * not bytes, e.g. slot 9 is not 1<<9 (256), it's 1<<9<<4 (8192).
  * And yes, this comment is for "future me".
  *
+ * Update: slots are no longer powers of two, since rounding up to
+ * the next power wastes up to half of each chunk.  Slots are now
+ * size classes, spaced by PA_ARB_ATOM_SIZE up to 64 bytes, and then
+ * with PA_ARB_CLASS_GROUP classes per doubling (80, 96, 112, 128,
+ * 160, ...), so the waste is under 20%.  Pages are sized (in whole
+ * matoms) so that the space left over after the last chunk is
+ * small, which means a chunk can straddle matoms; the atom of a
+ * chunk is the matom holding its first byte, plus the offset in that
+ * matom.  Slot 9 is now 192 bytes, which future me will also forget.
+ *
  * For larger allocations, allocations (rounded up to page sizes) are
  * made directly from the underlaying allocator, with a header that
  * identifies them as such.  Freed blocks are free by the underlaying
  * allocator, at the cost of us recording their size.
+ *
+ * Each page of chunks has a pa_arb_page_info_t, kept in a paged
+ * array (pa_fixed) indexed by the page's matom number, with a bitmap
+ * of the chunks on the page that are free.  Rather than a free list
+ * of chunks, each slot has a (doubly linked) list of the pages that
+ * have free chunks.  To allocate, we take the first free chunk from
+ * the first page on the list, taking the page off the list when it
+ * fills up.  To free, we set the chunk's bit, and when the last
+ * chunk in a page is freed, the page is given back to pa_mmap.  To
+ * avoid thrashing when a single chunk is repeatedly allocated and
+ * freed, we hold on to a few ("keep-pages", default 1) empty pages
+ * per slot.  Chunks sitting in per-thread magazines (PMF_THREAD_SAFE)
+ * count as in use, so their pages can't be released until the
+ * magazines are flushed (pa_arb_flush).
  */
 
 typedef uint8_t pa_arb_chunk_t;
@@ -62,7 +88,6 @@ typedef struct pa_arb_header_s {
 	};
 	uint16_t prh_size;	/* Size, in 4k  */
     };
-    pa_arb_atom_t prh_next_free[0]; /* If free, next free atom in list */
 } pa_arb_header_t;
 
 #define PRH_MAGIC_SMALL_INUSE	0x5ea1 /* "Small"-style allocation; in use */
@@ -72,7 +97,7 @@ typedef struct pa_arb_header_s {
 
 /** Constants for "small" allocations */
 #define PA_ARB_ATOM_SHIFT	4 /* 1<<4 == 16, size of atom */
-#define PA_ARB_ATOM_SIZE	(1 << PA_ARB_ATOM_SIZE)
+#define PA_ARB_ATOM_SIZE	(1 << PA_ARB_ATOM_SHIFT)
 #define PA_ARB_PAGE_SHIFT	12 /* 1<<12 == 4k atoms per page */
 #define PA_ARB_PAGE_SIZE	(1 << PA_ARB_PAGE_SHIFT)
 
@@ -83,37 +108,77 @@ typedef struct pa_arb_header_s {
 
 /* This is the largest power of two that can be handled by "small" */
 #define PA_ARB_MAX_POW2 	PA_ARB_PAGE_SHIFT
+#define PA_ARB_MAX_SMALL	(1 << (PA_ARB_MAX_POW2 + PA_ARB_ATOM_SHIFT))
+
+/* Size classes ("slots") for "small" allocations */
+#define PA_ARB_CLASS_GROUP_SHIFT 2 /* log2 of classes per doubling */
+#define PA_ARB_CLASS_GROUP	(1 << PA_ARB_CLASS_GROUP_SHIFT)
+#define PA_ARB_CLASS_LINEAR_SHIFT 6 /* Classes are linear up to 64 bytes */
+#define PA_ARB_CLASS_LINEAR	(1 << (PA_ARB_CLASS_LINEAR_SHIFT \
+				       - PA_ARB_ATOM_SHIFT))
+#define PA_ARB_SLOTS	(PA_ARB_CLASS_LINEAR + PA_ARB_CLASS_GROUP \
+			 * (PA_ARB_MAX_POW2 + PA_ARB_ATOM_SHIFT \
+			    - PA_ARB_CLASS_LINEAR_SHIFT))
 #define PA_ARB_MAX_LARGE	(1 << (PA_MMAP_ATOM_SHIFT + PA_NBBY * 2))
 
-#if 0
+/* Default number of empty pages to hold per slot */
+#define PA_ARB_KEEP_PAGES	1
+
+/* Shift for our page info array; 4096 entries cover 16MB */
+#define PA_ARB_PAGE_INFO_SHIFT	12
+
+/*
+ * Number of matoms that an arb atom can address.  Wide atoms could
+ * address far more, but the page info table is sized by this, so we
+ * pick something sane (1TB); "<name>.pages.max-atoms" can raise it.
+ */
+#ifdef PA_WIDE_ATOMS
+#define PA_ARB_MAX_MATOMS	(1U << 28)
+#else /* PA_WIDE_ATOMS */
+#define PA_ARB_MAX_MATOMS	(1U << (32 - PA_ARB_OFFSET_SHIFT))
+#endif /* PA_WIDE_ATOMS */
+
+typedef uint32_t pa_arb_bits_t;
+#define PA_ARB_BITS_WIDTH	(sizeof(pa_arb_bits_t) * PA_NBBY)
+#define PA_ARB_BITS_COUNT	(PA_ARB_CHUNK_SIZE / PA_ARB_BITS_WIDTH)
+
 /*
  * Each page is divided into chunks, which are continquous atoms,
  * with a single atom being the smallest chunk we can allocate.
- * Each page has a set of bits in the malloc info that tell us which
+ * Each page has a set of bits in the page info that tell us which
  * chunks of a page are free.
- * (not implemented yet)
  */
-typedef uint16_t pa_alloc_bits_t;
-pa_alloc_bits_t ppi_free_bits; /* Which chunks are free */
-
-typedef struct pa_page_info_s {
+typedef struct pa_arb_page_info_s {
     uint16_t ppi_magic;		/* Magic number */
-    uint16_t ppi_pow2;		/* What pow of 2 is this chunk */
-} pa_page_info_t;
-#endif /* 0 */
+    pa_arb_slot_t ppi_slot;	/* What size class is this chunk */
+    uint8_t ppi_matoms;		/* Size of this page, in matoms */
+    uint16_t ppi_inuse;		/* Number of chunks in use */
+    uint16_t ppi_chunks;	/* Number of chunks on this page */
+    pa_mmap_atom_t ppi_next;	/* Next page with free chunks (same slot) */
+    pa_mmap_atom_t ppi_prev;	/* Previous page with free chunks */
+    pa_arb_bits_t ppi_free_bits[PA_ARB_BITS_COUNT]; /* Which chunks are free */
+} pa_arb_page_info_t;
+
+#define PPI_MAGIC		0x9a6e /* Page belongs to pa_arb */
 
 /*
  * pa_arb_info_t is the persistent information on the malloc store, in
  * contrast with pa_arb_t which is transient.
  */
 typedef struct pa_arb_info_s {
-    pa_arb_atom_t pri_free[PA_ARB_MAX_POW2 + 1]; /* The free list */
+    pa_mmap_atom_t pri_pages[PA_ARB_SLOTS]; /* Pages with free chunks */
+    uint16_t pri_empty[PA_ARB_SLOTS]; /* Number of empty pages held */
+    pa_fixed_info_t pri_page_info; /* Page info (pa_arb_page_info_t) */
 } pa_arb_info_t;
 
 typedef struct pa_arb_s {
     pa_mmap_t *pr_mmap;		/* Underlaying memory file */
     pa_arb_info_t pr_info;	/* Our info structure, if needed */
     pa_arb_info_t *pr_infop;	/* A pointer to our info structure */
+    struct pa_lock_s *pr_locks;	/* Lock per slot (for PMF_THREAD_SAFE) */
+    struct pa_depot_s *pr_depot; /* Per-thread magazines, per slot (ditto) */
+    pa_fixed_t *pr_page_info;	/* Page info, indexed by matom */
+    uint32_t pr_keep_pages;	/* Number of empty pages to hold per slot */
 } pa_arb_t;
 
 static inline void *
@@ -158,6 +223,10 @@ pa_arb_atom_addr (pa_arb_t *prp, pa_arb_atom_t atom)
 pa_arb_atom_t
 pa_arb_alloc (pa_arb_t *prp, size_t size);
 
+unsigned
+pa_arb_alloc_atoms (pa_arb_t *prp, size_t size, pa_arb_atom_t *atoms,
+		    unsigned count);
+
 /*
  * Shorthand for strdup()-like functionality
  */
@@ -180,11 +249,20 @@ pa_arb_alloc_string (pa_arb_t *prp, const char *value)
 void
 pa_arb_free_atom (pa_arb_t *prp, pa_arb_atom_t atom);
 
+size_t
+pa_arb_atom_size (pa_arb_t *prp, pa_arb_atom_t atom);
+
+pa_arb_atom_t
+pa_arb_realloc (pa_arb_t *prp, pa_arb_atom_t atom, size_t size);
+
+void
+pa_arb_flush (pa_arb_t *prp);
+
 void
-pa_arb_init (pa_mmap_t *pmp, pa_arb_t *prp);
+pa_arb_init (pa_mmap_t *pmp, pa_arb_t *prp, const char *name);
 
 pa_arb_t *
-pa_arb_setup (pa_mmap_t *pmp, pa_arb_info_t *prip);
+pa_arb_setup (pa_mmap_t *pmp, pa_arb_info_t *prip, const char *name);
 
 pa_arb_t *
 pa_arb_open (pa_mmap_t *pmp, const char *name);
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Whole-bitmap operations.  Each works a chunk at a time, using the
+ * widest kernel the CPU supports: AVX2, SSE2, or plain 64-bit words.
+ * The kernel set is picked at first use, via psu_cpu_features().
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <strings.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <libpsu/psucpu.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/pabitmap.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PA_BITMAP_X86 1
+#include <immintrin.h>
+#endif /* __GNUC__ && x86 */
+
+/*
+ * The kernels each handle one chunk.  The binary operations update
+ * "dst" in place and return non-zero if any bit is left set in it.
+ */
+typedef int (*pa_bitmap_op_func_t)(pa_bitunit_t *dst,
+				   const pa_bitunit_t *src, unsigned units);
+typedef uint32_t (*pa_bitmap_count_func_t)(const pa_bitunit_t *data,
+					   unsigned units);
+typedef unsigned (*pa_bitmap_find_func_t)(const pa_bitunit_t *data,
+					  unsigned unit, unsigned units);
+
+typedef struct pa_bitmap_ops_s {
+    const char *pbo_name;	/* Name of this kernel set */
+    uint32_t pbo_needs;		/* PSU_CPU_* features we need */
+    pa_bitmap_op_func_t pbo_and; /* dst &= src */
+    pa_bitmap_op_func_t pbo_or;	/* dst |= src */
+    pa_bitmap_op_func_t pbo_andnot; /* dst &= ~src */
+    pa_bitmap_op_func_t pbo_xor; /* dst ^= src */
+    pa_bitmap_count_func_t pbo_count; /* Count the bits that are set */
+    pa_bitmap_find_func_t pbo_find; /* Find the first non-zero unit */
+} pa_bitmap_ops_t;
+
+/*
+ * Scalar kernels, using 64-bit words.  We go thru memcpy since units
+ * are only guaranteed 32-bit alignment; compilers turn it into plain
+ * loads and stores.
+ */
+static inline uint64_t
+pa_bitmap_load64 (const pa_bitunit_t *data)
+{
+    uint64_t val;
+
+    memcpy(&val, data, sizeof(val));
+    return val;
+}
+
+static inline void
+pa_bitmap_store64 (pa_bitunit_t *data, uint64_t val)
+{
+    memcpy(data, &val, sizeof(val));
+}
+
+#define PA_BITMAP_SCALAR_OP(_name, _expr)				\
+static int								\
+pa_bitmap_ ## _name ## _scalar (pa_bitunit_t *dst,			\
+				const pa_bitunit_t *src, unsigned units) \
+{									\
+    uint64_t any = 0, d, s;						\
+    unsigned i;								\
+									\
+    for (i = 0; i < units; i += 2) {					\
+	d = pa_bitmap_load64(dst + i);					\
+	s = pa_bitmap_load64(src + i);					\
+	d = (_expr);							\
+	pa_bitmap_store64(dst + i, d);					\
+	any |= d;							\
+    }									\
+									\
+    return any != 0;							\
+}
+
+PA_BITMAP_SCALAR_OP(and, d & s)
+PA_BITMAP_SCALAR_OP(or, d | s)
+PA_BITMAP_SCALAR_OP(andnot, d & ~s)
+PA_BITMAP_SCALAR_OP(xor, d ^ s)
+
+static inline unsigned
+pa_bitmap_popcount64 (uint64_t val)
+{
+    val = val - ((val >> 1) & 0x5555555555555555ULL);
+    val = (val & 0x3333333333333333ULL) + ((val >> 2) & 0x3333333333333333ULL);
+    val = (val + (val >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (val * 0x0101010101010101ULL) >> 56;
+}
+
+static uint32_t
+pa_bitmap_count_scalar (const pa_bitunit_t *data, unsigned units)
+{
+    uint32_t count = 0;
+    unsigned i;
+
+    for (i = 0; i < units; i += 2)
+	count += pa_bitmap_popcount64(pa_bitmap_load64(data + i));
+
+    return count;
+}
+
+static unsigned
+pa_bitmap_find_scalar (const pa_bitunit_t *data, unsigned unit,
+		       unsigned units)
+{
+    /* Single units until we're on a word boundary */
+    for ( ; unit < units && (unit & 1); unit++)
+	if (data[unit])
+	    return unit;
+
+    for ( ; unit < units; unit += 2)
+	if (pa_bitmap_load64(data + unit))
+	    return data[unit] ? unit : unit + 1;
+
+    return units;
+}
+
+static const pa_bitmap_ops_t pa_bitmap_ops_scalar = {
+    "scalar", 0,
+    pa_bitmap_and_scalar, pa_bitmap_or_scalar,
+    pa_bitmap_andnot_scalar, pa_bitmap_xor_scalar,
+    pa_bitmap_count_scalar, pa_bitmap_find_scalar,
+};
+
+#ifdef PA_BITMAP_X86
+
+/*
+ * Count using the POPCNT instruction, for CPUs that have it
+ */
+__attribute__((target("popcnt")))
+static uint32_t
+pa_bitmap_count_popcnt (const pa_bitunit_t *data, unsigned units)
+{
+    uint32_t count = 0;
+    unsigned i;
+
+    for (i = 0; i < units; i += 2)
+	count += __builtin_popcountll(pa_bitmap_load64(data + i));
+
+    return count;
+}
+
+/*
+ * SSE2 kernels, four units at a time
+ */
+#define PA_BITMAP_SSE2_OP(_name, _expr)					\
+__attribute__((target("sse2")))						\
+static int								\
+pa_bitmap_ ## _name ## _sse2 (pa_bitunit_t *dst,			\
+			      const pa_bitunit_t *src, unsigned units)	\
+{									\
+    __m128i any = _mm_setzero_si128(), d, s;				\
+    unsigned i;								\
+									\
+    for (i = 0; i < units; i += 4) {					\
+	d = _mm_loadu_si128((const __m128i *) (dst + i));		\
+	s = _mm_loadu_si128((const __m128i *) (src + i));		\
+	d = (_expr);							\
+	_mm_storeu_si128((__m128i *) (dst + i), d);			\
+	any = _mm_or_si128(any, d);					\
+    }									\
+									\
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) \
+	!= 0xffff;							\
+}
+
+PA_BITMAP_SSE2_OP(and, _mm_and_si128(d, s))
+PA_BITMAP_SSE2_OP(or, _mm_or_si128(d, s))
+PA_BITMAP_SSE2_OP(andnot, _mm_andnot_si128(s, d))
+PA_BITMAP_SSE2_OP(xor, _mm_xor_si128(d, s))
+
+__attribute__((target("sse2")))
+static unsigned
+pa_bitmap_find_sse2 (const pa_bitunit_t *data, unsigned unit,
+		     unsigned units)
+{
+    __m128i zero = _mm_setzero_si128(), v;
+    int mask;
+
+    for ( ; unit < units && (unit & 3); unit++)
+	if (data[unit])
+	    return unit;
+
+    for ( ; unit < units; unit += 4) {
+	v = _mm_loadu_si128((const __m128i *) (data + unit));
+	mask = _mm_movemask_epi8(_mm_cmpeq_epi32(v, zero));
+	if (mask != 0xffff)
+	    return unit + __builtin_ctz(~mask & 0xffff) / 4;
+    }
+
+    return units;
+}
+
+static const pa_bitmap_ops_t pa_bitmap_ops_sse2 = {
+    "sse2", PSU_CPU_SSE2,
+    pa_bitmap_and_sse2, pa_bitmap_or_sse2,
+    pa_bitmap_andnot_sse2, pa_bitmap_xor_sse2,
+    NULL, pa_bitmap_find_sse2,	/* Count depends on POPCNT */
+};
+
+/*
+ * AVX2 kernels, eight units at a time
+ */
+#define PA_BITMAP_AVX2_OP(_name, _expr)					\
+__attribute__((target("avx2")))						\
+static int								\
+pa_bitmap_ ## _name ## _avx2 (pa_bitunit_t *dst,			\
+			      const pa_bitunit_t *src, unsigned units)	\
+{									\
+    __m256i any = _mm256_setzero_si256(), d, s;				\
+    unsigned i;								\
+									\
+    for (i = 0; i < units; i += 8) {					\
+	d = _mm256_loadu_si256((const __m256i *) (dst + i));		\
+	s = _mm256_loadu_si256((const __m256i *) (src + i));		\
+	d = (_expr);							\
+	_mm256_storeu_si256((__m256i *) (dst + i), d);			\
+	any = _mm256_or_si256(any, d);					\
+    }									\
+									\
+    return !_mm256_testz_si256(any, any);				\
+}
+
+PA_BITMAP_AVX2_OP(and, _mm256_and_si256(d, s))
+PA_BITMAP_AVX2_OP(or, _mm256_or_si256(d, s))
+PA_BITMAP_AVX2_OP(andnot, _mm256_andnot_si256(s, d))
+PA_BITMAP_AVX2_OP(xor, _mm256_xor_si256(d, s))
+
+/*
+ * Count bits a nibble at a time, using a shuffle as a sixteen entry
+ * lookup table, and sum the byte counts with SAD.
+ */
+__attribute__((target("avx2")))
+static uint32_t
+pa_bitmap_count_avx2 (const pa_bitunit_t *data, unsigned units)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+					    1, 2, 2, 3, 2, 3, 3, 4,
+					    0, 1, 1, 2, 1, 2, 2, 3,
+					    1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256(), v, lo, hi, cnt;
+    uint64_t lanes[4];
+    unsigned i;
+
+    for (i = 0; i < units; i += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (data + i));
+	lo = _mm256_and_si256(v, low);
+	hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+	cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+			      _mm256_shuffle_epi8(lookup, hi));
+	acc = _mm256_add_epi64(acc,
+			       _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+
+    _mm256_storeu_si256((__m256i *) lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+__attribute__((target("avx2")))
+static unsigned
+pa_bitmap_find_avx2 (const pa_bitunit_t *data, unsigned unit,
+		     unsigned units)
+{
+    __m256i zero = _mm256_setzero_si256(), v;
+    unsigned mask;
+
+    for ( ; unit < units && (unit & 7); unit++)
+	if (data[unit])
+	    return unit;
+
+    for ( ; unit < units; unit += 8) {
+	v = _mm256_loadu_si256((const __m256i *) (data + unit));
+	mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(v, zero));
+	if (mask != 0xffffffffU)
+	    return unit + __builtin_ctz(~mask) / 4;
+    }
+
+    return units;
+}
+
+static const pa_bitmap_ops_t pa_bitmap_ops_avx2 = {
+    "avx2", PSU_CPU_AVX2,
+    pa_bitmap_and_avx2, pa_bitmap_or_avx2,
+    pa_bitmap_andnot_avx2, pa_bitmap_xor_avx2,
+    pa_bitmap_count_avx2, pa_bitmap_find_avx2,
+};
+
+#endif /* PA_BITMAP_X86 */
+
+/* Kernel sets, best first */
+static const pa_bitmap_ops_t *pa_bitmap_ops_list[] = {
+#ifdef PA_BITMAP_X86
+    &pa_bitmap_ops_avx2,
+    &pa_bitmap_ops_sse2,
+#endif /* PA_BITMAP_X86 */
+    &pa_bitmap_ops_scalar,
+    NULL
+};
+
+static pa_bitmap_ops_t pa_bitmap_ops;	/* Kernel set in use */
+
+psu_boolean_t
+pa_bitmap_impl_select (const char *name)
+{
+    const pa_bitmap_ops_t **opsp, *ops = NULL;
+    uint32_t features = psu_cpu_features();
+
+    for (opsp = pa_bitmap_ops_list; *opsp; opsp++) {
+	if (((*opsp)->pbo_needs & features) != (*opsp)->pbo_needs)
+	    continue;
+
+	if (name == NULL || strcmp(name, (*opsp)->pbo_name) == 0) {
+	    ops = *opsp;
+	    break;
+	}
+    }
+
+    if (ops == NULL)
+	return FALSE;
+
+    pa_bitmap_ops = *ops;
+    if (pa_bitmap_ops.pbo_count == NULL) {
+#ifdef PA_BITMAP_X86
+	if (features & PSU_CPU_POPCNT)
+	    pa_bitmap_ops.pbo_count = pa_bitmap_count_popcnt;
+	else
+#endif /* PA_BITMAP_X86 */
+	    pa_bitmap_ops.pbo_count = pa_bitmap_count_scalar;
+    }
+
+    return TRUE;
+}
+
+static inline const pa_bitmap_ops_t *
+pa_bitmap_ops_get (void)
+{
+    if (pa_bitmap_ops.pbo_name == NULL)
+	pa_bitmap_impl_select(NULL);
+
+    return &pa_bitmap_ops;
+}
+
+const char *
+pa_bitmap_impl_name (void)
+{
+    return pa_bitmap_ops_get()->pbo_name;
+}
+
+unsigned
+pa_bitmap_find_unit (const pa_bitunit_t *data, unsigned unit)
+{
+    return pa_bitmap_ops_get()->pbo_find(data, unit,
+					 PA_BITMAP_UNITS_PER_CHUNK);
+}
+
+int
+pa_bitmap_units_and (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		     unsigned units)
+{
+    return pa_bitmap_ops_get()->pbo_and(dst, src, units);
+}
+
+int
+pa_bitmap_units_or (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		    unsigned units)
+{
+    return pa_bitmap_ops_get()->pbo_or(dst, src, units);
+}
+
+int
+pa_bitmap_units_andnot (pa_bitunit_t *dst, const pa_bitunit_t *src,
+			unsigned units)
+{
+    return pa_bitmap_ops_get()->pbo_andnot(dst, src, units);
+}
+
+int
+pa_bitmap_units_xor (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		     unsigned units)
+{
+    return pa_bitmap_ops_get()->pbo_xor(dst, src, units);
+}
+
+uint32_t
+pa_bitmap_units_count (const pa_bitunit_t *data, unsigned units)
+{
+    return pa_bitmap_ops_get()->pbo_count(data, units);
+}
+
+static void
+pa_bitmap_chunk_free (pa_bitmap_t *pbp, pa_fixed_atom_t *chunkp,
+		      unsigned chunknum)
+{
+    pa_fixed_free_atom(pbp->pb_data, chunkp[chunknum]);
+    chunkp[chunknum] = pa_fixed_null_atom();
+}
+
+/*
+ * Apply a kernel to each pair of chunks.  A chunk that's missing is
+ * all zeros, which lets us skip most of the work on sparse bitmaps:
+ * "and" frees the chunks that have no partner, "or" and "xor" copy
+ * them, and "andnot" leaves them alone.  Chunks that end up empty
+ * are freed.
+ */
+static psu_boolean_t
+pa_bitmap_combine (pa_bitmap_t *pbp, pa_bitmap_id_t dst_id,
+		   pa_bitmap_id_t src_id, pa_bitmap_op_func_t func,
+		   psu_boolean_t copy_missing, psu_boolean_t clear_missing)
+{
+    pa_fixed_atom_t *dst_chunkp = pa_bitmap_chunk_addr(pbp, dst_id);
+    pa_fixed_atom_t *src_chunkp = pa_bitmap_chunk_addr(pbp, src_id);
+    pa_bitunit_t *dst, *src;
+    pa_fixed_atom_t atom;
+    unsigned chunknum;
+
+    if (dst_chunkp == NULL || src_chunkp == NULL)
+	return FALSE;
+
+    for (chunknum = 0; chunknum < PA_BITMAP_CHUNK_SIZE; chunknum++) {
+	if (pa_fixed_is_null(src_chunkp[chunknum])) {
+	    if (clear_missing && !pa_fixed_is_null(dst_chunkp[chunknum]))
+		pa_bitmap_chunk_free(pbp, dst_chunkp, chunknum);
+	    continue;
+	}
+
+	src = pa_fixed_atom_addr(pbp->pb_data, src_chunkp[chunknum]);
+	if (src == NULL)
+	    return FALSE;	/* Should not occur */
+
+	if (pa_fixed_is_null(dst_chunkp[chunknum])) {
+	    if (!copy_missing)
+		continue;
+
+	    atom = pa_fixed_alloc_atom(pbp->pb_data);
+	    dst = pa_fixed_atom_addr(pbp->pb_data, atom);
+	    if (pa_fixed_is_null(atom) || dst == NULL)
+		return FALSE;
+
+	    memcpy(dst, src, PA_BITMAP_BLOCK_SIZE);
+	    dst_chunkp[chunknum] = atom;
+	    continue;
+	}
+
+	dst = pa_fixed_atom_addr(pbp->pb_data, dst_chunkp[chunknum]);
+	if (dst == NULL)
+	    return FALSE;	/* Should not occur */
+
+	if (!func(dst, src, PA_BITMAP_UNITS_PER_CHUNK))
+	    pa_bitmap_chunk_free(pbp, dst_chunkp, chunknum);
+    }
+
+    return TRUE;
+}
+
+psu_boolean_t
+pa_bitmap_and (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src)
+{
+    return pa_bitmap_combine(pbp, dst, src, pa_bitmap_ops_get()->pbo_and,
+			     FALSE, TRUE);
+}
+
+psu_boolean_t
+pa_bitmap_or (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src)
+{
+    return pa_bitmap_combine(pbp, dst, src, pa_bitmap_ops_get()->pbo_or,
+			     TRUE, FALSE);
+}
+
+psu_boolean_t
+pa_bitmap_andnot (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src)
+{
+    return pa_bitmap_combine(pbp, dst, src, pa_bitmap_ops_get()->pbo_andnot,
+			     FALSE, FALSE);
+}
+
+psu_boolean_t
+pa_bitmap_xor (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src)
+{
+    return pa_bitmap_combine(pbp, dst, src, pa_bitmap_ops_get()->pbo_xor,
+			     TRUE, FALSE);
+}
+
+uint32_t
+pa_bitmap_count (pa_bitmap_t *pbp, pa_bitmap_id_t bitmap_id)
+{
+    pa_fixed_atom_t *chunkp = pa_bitmap_chunk_addr(pbp, bitmap_id);
+    pa_bitmap_count_func_t func = pa_bitmap_ops_get()->pbo_count;
+    pa_bitunit_t *data;
+    unsigned chunknum;
+    uint32_t count = 0;
+
+    if (chunkp == NULL)
+	return 0;
+
+    for (chunknum = 0; chunknum < PA_BITMAP_CHUNK_SIZE; chunknum++) {
+	if (pa_fixed_is_null(chunkp[chunknum]))
+	    continue;
+
+	data = pa_fixed_atom_addr(pbp->pb_data, chunkp[chunknum]);
+	if (data)
+	    count += func(data, PA_BITMAP_UNITS_PER_CHUNK);
+    }
+
+    return count;
+}
+
+void
+pa_bitmap_free (pa_bitmap_t *pbp, pa_bitmap_id_t bitmap_id)
+{
+    pa_fixed_atom_t *chunkp;
+    unsigned chunknum;
+
+    if (pa_bitmap_is_null(bitmap_id))
+	return;
+
+    chunkp = pa_bitmap_chunk_addr(pbp, bitmap_id);
+    if (chunkp == NULL)
+	return;
+
+    for (chunknum = 0; chunknum < PA_BITMAP_CHUNK_SIZE; chunknum++)
+	if (!pa_fixed_is_null(chunkp[chunknum]))
+	    pa_bitmap_chunk_free(pbp, chunkp, chunknum);
+
+    pa_fixed_free_atom(pbp->pb_data, pa_bitmap_to_fixed(bitmap_id));
+}
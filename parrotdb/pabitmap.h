@@ -21,7 +21,8 @@
  * The formula for max bits for any PA_BITMAP_BLOCK_SHIFT is:
  *    (((1 << shift) * PA_NBBY) * ((1 << shift) / sizeof(pa_atom_t)))
  * Counter that against needing 2 1<<shift chunks minimum per bitmap.
- * "10" is our current best guess, yielding 2 million bits for 2k.
+ * "10" is our current best guess, yielding 2 million bits for 2k
+ * (1 million with wide atoms, whose index tables hold half as many).
  * Setting it to "12" yields 33.5 million bits for 8k.  For now, we
  * hardcode this at 10.
  */
@@ -201,6 +202,13 @@ pa_bitmap_clear (pa_bitmap_t *pfp, pa_bitmap_id_t bitmap_id, pa_bitnumber_t num)
     data[unitnum] &= ~(1 << bitnum);
 }
 
+/*
+ * Return the first unit in a chunk at or after the given one that has
+ * any bit set, or PA_BITMAP_UNITS_PER_CHUNK if there's none
+ */
+unsigned
+pa_bitmap_find_unit (const pa_bitunit_t *data, unsigned unit);
+
 static inline pa_bitnumber_t
 pa_bitmap_find_next (pa_bitmap_t *pfp, pa_bitmap_id_t bitmap_id,
 		     pa_bitnumber_t num)
@@ -261,15 +269,17 @@ pa_bitmap_find_next (pa_bitmap_t *pfp, pa_bitmap_id_t bitmap_id,
     bitmask = 0;		/* Don't repeat it next time thru */
 
     if (value == 0) {	/* All zeros */
-	while (++unitnum < PA_BITMAP_UNITS_PER_CHUNK) {
-	    if (data[unitnum] != 0) {
-		num = (chunknum * PA_BITMAP_BITS_PER_CHUNK)
-		    + (unitnum * PA_BITMAP_BITS_PER_UNIT);
-		goto restart;
-	    }
+	unitnum = pa_bitmap_find_unit(data, unitnum + 1);
+	if (unitnum < PA_BITMAP_UNITS_PER_CHUNK) {
+	    num = (chunknum * PA_BITMAP_BITS_PER_CHUNK)
+		+ (unitnum * PA_BITMAP_BITS_PER_UNIT);
+	    goto restart;
 	}
 
-	/* Move to next chunk */
+	/* Move to next chunk, if there is one */
+	if (chunknum + 1 >= PA_BITMAP_CHUNK_SIZE)
+	    return PA_BITMAP_FIND_DONE;
+
 	num = (chunknum + 1) * PA_BITMAP_BITS_PER_CHUNK;
 	goto restart;
     }
@@ -285,6 +295,71 @@ pa_bitmap_find_next (pa_bitmap_t *pfp, pa_bitmap_id_t bitmap_id,
 	+ (unitnum * PA_BITMAP_BITS_PER_UNIT) + found;
 }
 
+/*
+ * Whole-bitmap operations.  Each updates "dst" in place, a chunk at a
+ * time, and returns FALSE if we ran out of memory part way thru.
+ */
+psu_boolean_t
+pa_bitmap_and (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src);
+
+psu_boolean_t
+pa_bitmap_or (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src);
+
+psu_boolean_t
+pa_bitmap_andnot (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src);
+
+psu_boolean_t
+pa_bitmap_xor (pa_bitmap_t *pbp, pa_bitmap_id_t dst, pa_bitmap_id_t src);
+
+/*
+ * Return the number of bits set in a bitmap
+ */
+uint32_t
+pa_bitmap_count (pa_bitmap_t *pbp, pa_bitmap_id_t bitmap_id);
+
+/*
+ * Free a bitmap and all its chunks
+ */
+void
+pa_bitmap_free (pa_bitmap_t *pbp, pa_bitmap_id_t bitmap_id);
+
+/*
+ * The kernels behind these operations, for other bit arrays (like
+ * pa_roar's bitmap containers) to share.  Each works on "units"
+ * words; the binary ones update "dst" in place and return non-zero if
+ * any bit is left set in it.
+ */
+int
+pa_bitmap_units_and (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		     unsigned units);
+
+int
+pa_bitmap_units_or (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		    unsigned units);
+
+int
+pa_bitmap_units_andnot (pa_bitunit_t *dst, const pa_bitunit_t *src,
+			unsigned units);
+
+int
+pa_bitmap_units_xor (pa_bitunit_t *dst, const pa_bitunit_t *src,
+		     unsigned units);
+
+uint32_t
+pa_bitmap_units_count (const pa_bitunit_t *data, unsigned units);
+
+/*
+ * The bitmap operations use the best kernels the CPU supports ("avx2",
+ * "sse2", or "scalar").  pa_bitmap_impl_select() forces a particular
+ * set, which is handy for testing and benchmarking; NULL returns to
+ * the best one.  It returns FALSE if the CPU can't run that set.
+ */
+psu_boolean_t
+pa_bitmap_impl_select (const char *name);
+
+const char *
+pa_bitmap_impl_name (void);
+
 static inline pa_bitmap_t *
 pa_bitmap_open (pa_mmap_t *pmp, const char *name)
 {
@@ -0,0 +1,862 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#include <sys/types.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/pabtree.h>
+
+#if defined(__GNUC__)
+#define PA_BTREE_PREFETCH(_p) __builtin_prefetch(_p)
+#else
+#define PA_BTREE_PREFETCH(_p) do { } while (0)
+#endif
+
+#define PA_BTREE_REC_HDR	offsetof(pa_btree_rec_t, pbr_key)
+
+/*
+ * A stack of the nodes we passed through on the way down to a leaf,
+ * with the child we took from each
+ */
+typedef struct pa_btree_path_s {
+    pa_btree_atom_t pbpa_atom;	/* Node we passed through */
+    int pbpa_slot;		/* Record we followed (-1 for pbn_first) */
+} pa_btree_path_t;
+
+/*
+ * Return the number of bytes a record with the given key takes up,
+ * not counting its slot
+ */
+static inline unsigned
+pa_btree_rec_size (unsigned len)
+{
+    return pa_roundup32(PA_BTREE_REC_HDR + len, sizeof(pa_atom_t));
+}
+
+static inline int
+pa_btree_compare (const psu_byte_t *k1, unsigned len1,
+		  const psu_byte_t *k2, unsigned len2)
+{
+    int rc = memcmp(k1, k2, (len1 < len2) ? len1 : len2);
+
+    return rc ? rc : (int) len1 - (int) len2;
+}
+
+/*
+ * Return the number of contiguous free bytes between the slot array
+ * and the records
+ */
+static inline unsigned
+pa_btree_node_gap (pa_btree_node_t *node)
+{
+    return node->pbn_top
+	- (sizeof(*node) + node->pbn_count * sizeof(node->pbn_slot[0]));
+}
+
+/*
+ * Return the first slot whose key is greater than or equal to the
+ * given key, setting *exactp if it's equal.
+ */
+static unsigned
+pa_btree_search (pa_btree_node_t *node, const psu_byte_t *key, unsigned len,
+		 psu_boolean_t *exactp)
+{
+    unsigned lo = 0, hi = node->pbn_count, mid;
+    pa_btree_rec_t *rec;
+    int rc;
+
+    *exactp = FALSE;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	rec = pa_btree_node_rec(node, mid);
+	rc = pa_btree_compare(rec->pbr_key, rec->pbr_len, key, len);
+	if (rc < 0) {
+	    lo = mid + 1;
+	} else {
+	    if (rc == 0)
+		*exactp = TRUE;
+	    hi = mid;
+	}
+    }
+
+    return lo;
+}
+
+static inline pa_btree_atom_t
+pa_btree_node_child (pa_btree_node_t *node, int slot)
+{
+    if (slot < 0)
+	return node->pbn_first;
+
+    return pa_btree_atom(pa_btree_node_rec(node, slot)->pbr_value);
+}
+
+static void
+pa_btree_node_init (pa_btree_node_t *node, unsigned size, unsigned level)
+{
+    bzero(node, sizeof(*node));
+    node->pbn_level = level;
+    node->pbn_top = size;
+}
+
+static pa_btree_atom_t
+pa_btree_node_alloc (pa_btree_t *pbp)
+{
+    pa_fixed_atom_t fatom = pa_fixed_alloc_atom(pbp->pb_nodes);
+    pa_btree_atom_t atom = pa_btree_atom(pa_fixed_atom_of(fatom));
+
+    if (!pa_btree_is_null(atom))
+	pbp->pb_infop->pbi_nodes += 1;
+
+    return atom;
+}
+
+static void
+pa_btree_node_free (pa_btree_t *pbp, pa_btree_atom_t atom)
+{
+    pa_fixed_free_atom(pbp->pb_nodes, pa_fixed_atom(pa_btree_atom_of(atom)));
+    pbp->pb_infop->pbi_nodes -= 1;
+}
+
+/*
+ * Add a record at the given slot.  The caller has made sure the
+ * record fits in the gap.
+ */
+static void
+pa_btree_node_insert (pa_btree_node_t *node, unsigned slot,
+		      const psu_byte_t *key, unsigned len, pa_atom_t value)
+{
+    pa_btree_rec_t *rec;
+
+    node->pbn_top -= pa_btree_rec_size(len);
+    rec = (pa_btree_rec_t *) ((psu_byte_t *) node + node->pbn_top);
+    rec->pbr_value = value;
+    rec->pbr_len = len;
+    memcpy(rec->pbr_key, key, len);
+
+    memmove(&node->pbn_slot[slot + 1], &node->pbn_slot[slot],
+	    (node->pbn_count - slot) * sizeof(node->pbn_slot[0]));
+    node->pbn_slot[slot] = node->pbn_top;
+    node->pbn_count += 1;
+}
+
+/*
+ * Remove the records in slots [from, to).  Their space isn't reused
+ * until the node is compacted.
+ */
+static void
+pa_btree_node_remove (pa_btree_t *pbp, pa_btree_node_t *node,
+		      unsigned from, unsigned to)
+{
+    unsigned slot;
+
+    for (slot = from; slot < to; slot++)
+	node->pbn_dead
+	    += pa_btree_rec_size(pa_btree_node_rec(node, slot)->pbr_len);
+
+    memmove(&node->pbn_slot[from], &node->pbn_slot[to],
+	    (node->pbn_count - to) * sizeof(node->pbn_slot[0]));
+    node->pbn_count -= to - from;
+
+    if (node->pbn_count == 0) {
+	node->pbn_top = pbp->pb_node_size;
+	node->pbn_dead = 0;
+    }
+}
+
+/*
+ * Append the records in slots [from, to) of one node to another.  The
+ * records are laid out in key order, so scans read them front to back.
+ */
+static void
+pa_btree_node_fill (pa_btree_node_t *dst, pa_btree_node_t *src,
+		    unsigned from, unsigned to)
+{
+    unsigned slot, total = 0, off;
+    pa_btree_rec_t *rec;
+
+    for (slot = from; slot < to; slot++)
+	total += pa_btree_rec_size(pa_btree_node_rec(src, slot)->pbr_len);
+
+    dst->pbn_top -= total;
+    off = dst->pbn_top;
+
+    for (slot = from; slot < to; slot++) {
+	rec = pa_btree_node_rec(src, slot);
+	memcpy((psu_byte_t *) dst + off, rec, PA_BTREE_REC_HDR + rec->pbr_len);
+	dst->pbn_slot[dst->pbn_count++] = off;
+	off += pa_btree_rec_size(rec->pbr_len);
+    }
+}
+
+/*
+ * Squeeze out the space left by deleted records
+ */
+static void
+pa_btree_node_compact (pa_btree_t *pbp, pa_btree_node_t *node)
+{
+    pa_btree_node_t *copy = (pa_btree_node_t *) pbp->pb_scratch;
+
+    memcpy(copy, node, pbp->pb_node_size);
+
+    node->pbn_count = 0;
+    node->pbn_dead = 0;
+    node->pbn_top = pbp->pb_node_size;
+    pa_btree_node_fill(node, copy, 0, copy->pbn_count);
+}
+
+/*
+ * Walk from the root to the leaf that would hold the given key,
+ * recording our path.  Returns the depth of the path.
+ */
+static unsigned
+pa_btree_descend (pa_btree_t *pbp, const psu_byte_t *key, unsigned len,
+		  pa_btree_path_t *path)
+{
+    pa_btree_atom_t atom = pbp->pb_infop->pbi_root;
+    pa_btree_node_t *node;
+    unsigned depth = 0, slot;
+    psu_boolean_t exact;
+
+    for (;;) {
+	node = pa_btree_node(pbp, atom);
+	if (node == NULL)
+	    return 0;
+
+	path[depth].pbpa_atom = atom;
+	path[depth].pbpa_slot = 0;
+	if (node->pbn_level == 0 || depth + 1 >= PA_BTREE_MAXDEPTH)
+	    return depth + 1;
+
+	/* Follow the last record whose key is <= ours */
+	slot = pa_btree_search(node, key, len, &exact);
+	path[depth].pbpa_slot = exact ? (int) slot : (int) slot - 1;
+	atom = pa_btree_node_child(node, path[depth].pbpa_slot);
+	depth += 1;
+    }
+}
+
+pa_btree_data_atom_t
+pa_btree_get (pa_btree_t *pbp, uint16_t key_bytes, const void *v_key)
+{
+    pa_btree_path_t path[PA_BTREE_MAXDEPTH];
+    pa_btree_node_t *leaf;
+    psu_boolean_t exact;
+    unsigned depth, slot;
+
+    if (pa_btree_is_null(pbp->pb_infop->pbi_root))
+	return pa_btree_data_null_atom();
+
+    depth = pa_btree_descend(pbp, v_key, key_bytes, path);
+    if (depth == 0)
+	return pa_btree_data_null_atom();
+
+    leaf = pa_btree_node(pbp, path[depth - 1].pbpa_atom);
+    slot = pa_btree_search(leaf, v_key, key_bytes, &exact);
+    if (!exact)
+	return pa_btree_data_null_atom();
+
+    return pa_btree_data_atom(pa_btree_node_rec(leaf, slot)->pbr_value);
+}
+
+/*
+ * Put a record into a node, splitting the node if there's no room.
+ * On a split, the upper half of the records move to "spare", which
+ * we return, and the key that separates the two halves is copied
+ * into "sep".
+ */
+static pa_btree_atom_t
+pa_btree_node_put (pa_btree_t *pbp, pa_btree_atom_t atom, unsigned slot,
+		   const psu_byte_t *key, unsigned len, pa_atom_t value,
+		   pa_btree_atom_t spare, psu_byte_t *sep, uint16_t *sep_lenp)
+{
+    pa_btree_node_t *node = pa_btree_node(pbp, atom);
+    unsigned need = pa_btree_rec_size(len) + sizeof(node->pbn_slot[0]);
+    unsigned gap = pa_btree_node_gap(node);
+
+    if (gap < need && gap + node->pbn_dead >= need) {
+	pa_btree_node_compact(pbp, node);
+	gap = pa_btree_node_gap(node);
+    }
+
+    if (gap >= need) {
+	pa_btree_node_insert(node, slot, key, len, value);
+	return pa_btree_null_atom();
+    }
+
+    /* pa_btree_add made sure we have a spare for every split */
+    if (pa_btree_is_null(spare))
+	return pa_btree_null_atom();
+
+    pa_btree_node_t *right = pa_btree_node(pbp, spare);
+
+    /* Build the over-full node in our scratch space, which is twice our size */
+    pa_btree_node_t *big = (pa_btree_node_t *) pbp->pb_scratch;
+    unsigned count = node->pbn_count + 1;
+    unsigned split, total = 0, sum = 0;
+    pa_btree_rec_t *rec;
+
+    pa_btree_node_init(big, pbp->pb_node_size * 2, node->pbn_level);
+    pa_btree_node_fill(big, node, 0, slot);
+    pa_btree_node_insert(big, slot, key, len, value);
+    pa_btree_node_fill(big, node, slot, node->pbn_count);
+
+    /* Split where the bytes in use are about even */
+    for (split = 0; split < count; split++)
+	total += pa_btree_rec_size(pa_btree_node_rec(big, split)->pbr_len)
+	    + sizeof(big->pbn_slot[0]);
+
+    for (split = 0; split < count - 1; split++) {
+	sum += pa_btree_rec_size(pa_btree_node_rec(big, split)->pbr_len)
+	    + sizeof(big->pbn_slot[0]);
+	if (sum * 2 >= total)
+	    break;
+    }
+
+    pa_btree_node_init(right, pbp->pb_node_size, node->pbn_level);
+    node->pbn_count = 0;
+    node->pbn_dead = 0;
+    node->pbn_top = pbp->pb_node_size;
+    pa_btree_node_fill(node, big, 0, split + 1);
+
+    if (node->pbn_level == 0) {
+	/*
+	 * The separator is the shortest prefix of the right's first
+	 * key that's larger than the left's last key.
+	 */
+	pa_btree_rec_t *last = pa_btree_node_rec(big, split);
+	unsigned i, max;
+
+	rec = pa_btree_node_rec(big, split + 1);
+	max = (last->pbr_len < rec->pbr_len) ? last->pbr_len : rec->pbr_len;
+	for (i = 0; i < max; i++)
+	    if (last->pbr_key[i] != rec->pbr_key[i])
+		break;
+
+	*sep_lenp = i + 1;
+	memcpy(sep, rec->pbr_key, i + 1);
+	pa_btree_node_fill(right, big, split + 1, count);
+
+	/* Link the new leaf into the chain */
+	right->pbn_prev = atom;
+	right->pbn_next = node->pbn_next;
+	if (!pa_btree_is_null(node->pbn_next)) {
+	    pa_btree_node_t *next = pa_btree_node(pbp, node->pbn_next);
+	    if (next)
+		next->pbn_prev = spare;
+	}
+	node->pbn_next = spare;
+
+    } else {
+	/*
+	 * The middle record moves up to our parent, and its child
+	 * becomes the right node's first child.
+	 */
+	rec = pa_btree_node_rec(big, split + 1);
+	*sep_lenp = rec->pbr_len;
+	memcpy(sep, rec->pbr_key, rec->pbr_len);
+	right->pbn_first = pa_btree_atom(rec->pbr_value);
+	pa_btree_node_fill(right, big, split + 2, count);
+    }
+
+    return spare;
+}
+
+psu_boolean_t
+pa_btree_add (pa_btree_t *pbp, uint16_t key_bytes, const void *v_key,
+	      pa_btree_data_atom_t datom)
+{
+    const psu_byte_t *key = v_key;
+    pa_btree_info_t *pbip = pbp->pb_infop;
+    pa_btree_path_t path[PA_BTREE_MAXDEPTH];
+    pa_btree_atom_t spare[PA_BTREE_MAXDEPTH + 1], atom;
+    psu_byte_t sepbuf[2][PA_BTREE_MAXKEY];
+    pa_btree_node_t *node;
+    unsigned depth, slot, need, nspare = 0, used = 0, cur = 0;
+    int level;
+    psu_boolean_t exact;
+
+    if (key_bytes > pbp->pb_max_key || pa_btree_data_is_null(datom))
+	return FALSE;
+
+    if (pa_btree_is_null(pbip->pbi_root)) {
+	atom = pa_btree_node_alloc(pbp);
+	if (pa_btree_is_null(atom))
+	    return FALSE;
+
+	node = pa_btree_node(pbp, atom);
+
+	pa_btree_node_init(node, pbp->pb_node_size, 0);
+	pbip->pbi_root = atom;
+	pbip->pbi_depth = 1;
+    }
+
+    depth = pa_btree_descend(pbp, key, key_bytes, path);
+    if (depth == 0)
+	return FALSE;
+
+    node = pa_btree_node(pbp, path[depth - 1].pbpa_atom);
+    slot = pa_btree_search(node, key, key_bytes, &exact);
+    if (exact)
+	return FALSE;		/* Duplicate */
+
+    /*
+     * Count the nodes that might split, and allocate their new
+     * siblings before we touch anything, so running out of memory
+     * leaves the tree as it was.  Above the leaf, we don't know the
+     * separator yet, so we assume the worst.
+     */
+    need = pa_btree_rec_size(key_bytes) + sizeof(node->pbn_slot[0]);
+    for (level = depth - 1; level >= 0; level--) {
+	node = pa_btree_node(pbp, path[level].pbpa_atom);
+	if (pa_btree_node_gap(node) + node->pbn_dead >= need)
+	    break;
+
+	nspare += (level == 0) ? 2 : 1; /* The root needs a new root too */
+	need = pa_btree_rec_size(pbp->pb_max_key) + sizeof(node->pbn_slot[0]);
+    }
+
+    for (used = 0; used < nspare; used++) {
+	spare[used] = pa_btree_node_alloc(pbp);
+	if (pa_btree_is_null(spare[used])) {
+	    while (used-- > 0)
+		pa_btree_node_free(pbp, spare[used]);
+	    return FALSE;
+	}
+    }
+
+    used = 0;
+    for (level = depth - 1; ; level--) {
+	atom = pa_btree_node_put(pbp, path[level].pbpa_atom, slot,
+				 key, key_bytes, pa_btree_data_atom_of(datom),
+				 (used < nspare) ? spare[used]
+				 : pa_btree_null_atom(),
+				 sepbuf[cur], &key_bytes);
+	if (pa_btree_is_null(atom))
+	    break;
+
+	/* The node split, so its parent gets the new node */
+	used += 1;
+	key = sepbuf[cur];
+	cur ^= 1;
+	datom = pa_btree_data_atom(pa_btree_atom_of(atom));
+
+	if (level == 0) {
+	    /* The root split, so we grow a new root above it */
+	    pa_btree_atom_t root = spare[used++];
+	    pa_btree_node_t *old = pa_btree_node(pbp, path[0].pbpa_atom);
+
+	    node = pa_btree_node(pbp, root);
+	    pa_btree_node_init(node, pbp->pb_node_size, old->pbn_level + 1);
+	    node->pbn_first = path[0].pbpa_atom;
+	    pa_btree_node_insert(node, 0, key, key_bytes,
+				 pa_btree_atom_of(atom));
+	    pbip->pbi_root = root;
+	    pbip->pbi_depth += 1;
+	    break;
+	}
+
+	slot = path[level - 1].pbpa_slot + 1;
+    }
+
+    while (used < nspare)
+	pa_btree_node_free(pbp, spare[used++]);
+
+    pbip->pbi_count += 1;
+    return TRUE;
+}
+
+/*
+ * The last node on the path has no records left, so remove it from
+ * its parent, and so on up the tree as parents empty out.
+ */
+static void
+pa_btree_prune (pa_btree_t *pbp, pa_btree_path_t *path, unsigned depth)
+{
+    pa_btree_info_t *pbip = pbp->pb_infop;
+    pa_btree_node_t *node, *parent, *sib;
+    int level = depth - 1, slot;
+
+    node = pa_btree_node(pbp, path[level].pbpa_atom);
+
+    if (node->pbn_level == 0) {
+	/* Take the leaf out of the chain */
+	if (!pa_btree_is_null(node->pbn_prev)) {
+	    sib = pa_btree_node(pbp, node->pbn_prev);
+	    if (sib)
+		sib->pbn_next = node->pbn_next;
+	}
+	if (!pa_btree_is_null(node->pbn_next)) {
+	    sib = pa_btree_node(pbp, node->pbn_next);
+	    if (sib)
+		sib->pbn_prev = node->pbn_prev;
+	}
+    }
+
+    for (;;) {
+	pa_btree_node_free(pbp, path[level].pbpa_atom);
+
+	if (level == 0) {
+	    /* That was the root, so the tree is empty */
+	    pbip->pbi_root = pa_btree_null_atom();
+	    pbip->pbi_depth = 0;
+	    return;
+	}
+
+	level -= 1;
+	parent = pa_btree_node(pbp, path[level].pbpa_atom);
+	slot = path[level].pbpa_slot;
+
+	if (slot >= 0) {
+	    pa_btree_node_remove(pbp, parent, slot, slot + 1);
+	    break;
+	}
+
+	/* We were the first child; the next one takes our place */
+	if (parent->pbn_count > 0) {
+	    parent->pbn_first = pa_btree_node_child(parent, 0);
+	    pa_btree_node_remove(pbp, parent, 0, 1);
+	    break;
+	}
+
+	/* The parent has no children left, so it goes too */
+    }
+
+    /* Drop roots that are down to a single child */
+    for (;;) {
+	node = pa_btree_node(pbp, pbip->pbi_root);
+	if (node == NULL || node->pbn_level == 0 || node->pbn_count > 0)
+	    break;
+
+	pa_btree_atom_t child = node->pbn_first;
+	pa_btree_node_free(pbp, pbip->pbi_root);
+	pbip->pbi_root = child;
+	pbip->pbi_depth -= 1;
+    }
+}
+
+pa_btree_data_atom_t
+pa_btree_delete (pa_btree_t *pbp, uint16_t key_bytes, const void *v_key)
+{
+    pa_btree_path_t path[PA_BTREE_MAXDEPTH];
+    pa_btree_data_atom_t datom;
+    pa_btree_node_t *leaf;
+    psu_boolean_t exact;
+    unsigned depth, slot;
+
+    if (pa_btree_is_null(pbp->pb_infop->pbi_root))
+	return pa_btree_data_null_atom();
+
+    depth = pa_btree_descend(pbp, v_key, key_bytes, path);
+    if (depth == 0)
+	return pa_btree_data_null_atom();
+
+    leaf = pa_btree_node(pbp, path[depth - 1].pbpa_atom);
+    slot = pa_btree_search(leaf, v_key, key_bytes, &exact);
+    if (!exact)
+	return pa_btree_data_null_atom();
+
+    datom = pa_btree_data_atom(pa_btree_node_rec(leaf, slot)->pbr_value);
+    pa_btree_node_remove(pbp, leaf, slot, slot + 1);
+    pbp->pb_infop->pbi_count -= 1;
+
+    if (leaf->pbn_count == 0)
+	pa_btree_prune(pbp, path, depth);
+
+    return datom;
+}
+
+uint32_t
+pa_btree_delete_range (pa_btree_t *pbp, uint16_t lo_bytes, const void *v_lo,
+		       uint16_t hi_bytes, const void *v_hi)
+{
+    pa_btree_path_t path[PA_BTREE_MAXDEPTH];
+    psu_byte_t lobuf[PA_BTREE_MAXKEY];
+    const psu_byte_t *lo = v_lo ? v_lo : (const psu_byte_t *) "";
+    pa_btree_node_t *leaf, *next;
+    pa_btree_rec_t *rec;
+    unsigned depth, from, to;
+    uint32_t removed = 0;
+    psu_boolean_t exact, last;
+
+    if (v_lo == NULL)
+	lo_bytes = 0;
+
+    /*
+     * Each pass clears the part of one leaf that's in range.  If the
+     * range runs on past the leaf, we pick up again at the first key
+     * of the next one.
+     */
+    while (!pa_btree_is_null(pbp->pb_infop->pbi_root)) {
+	depth = pa_btree_descend(pbp, lo, lo_bytes, path);
+	if (depth == 0)
+	    break;
+
+	leaf = pa_btree_node(pbp, path[depth - 1].pbpa_atom);
+	from = pa_btree_search(leaf, lo, lo_bytes, &exact);
+	to = v_hi ? pa_btree_search(leaf, v_hi, hi_bytes, &exact)
+	    : leaf->pbn_count;
+	if (to < from)
+	    to = from;
+
+	last = (to < leaf->pbn_count || pa_btree_is_null(leaf->pbn_next));
+	if (!last) {
+	    next = pa_btree_node(pbp, leaf->pbn_next);
+	    if (next == NULL || next->pbn_count == 0) {
+		last = TRUE;
+	    } else {
+		rec = pa_btree_node_rec(next, 0);
+		memcpy(lobuf, rec->pbr_key, rec->pbr_len);
+		lo = lobuf;
+		lo_bytes = rec->pbr_len;
+	    }
+	}
+
+	if (to > from) {
+	    pa_btree_node_remove(pbp, leaf, from, to);
+	    pbp->pb_infop->pbi_count -= to - from;
+	    removed += to - from;
+
+	    if (leaf->pbn_count == 0)
+		pa_btree_prune(pbp, path, depth);
+	}
+
+	if (last)
+	    break;
+    }
+
+    return removed;
+}
+
+void
+pa_btree_cursor_seek (pa_btree_t *pbp, pa_btree_cursor_t *pbcp,
+		      uint16_t key_bytes, const void *v_key)
+{
+    pa_btree_path_t path[PA_BTREE_MAXDEPTH];
+    pa_btree_atom_t atom = pbp->pb_infop->pbi_root;
+    pa_btree_node_t *node;
+    psu_boolean_t exact;
+    unsigned depth;
+
+    pbcp->pbc_leaf = pa_btree_null_atom();
+    pbcp->pbc_slot = 0;
+
+    if (pa_btree_is_null(atom))
+	return;
+
+    if (v_key == NULL) {
+	/* Follow the first children down to the first leaf */
+	for (;;) {
+	    node = pa_btree_node(pbp, atom);
+	    if (node == NULL)
+		return;
+	    if (node->pbn_level == 0)
+		break;
+	    atom = node->pbn_first;
+	}
+
+    } else {
+	depth = pa_btree_descend(pbp, v_key, key_bytes, path);
+	if (depth == 0)
+	    return;
+
+	atom = path[depth - 1].pbpa_atom;
+	node = pa_btree_node(pbp, atom);
+	pbcp->pbc_slot = pa_btree_search(node, v_key, key_bytes, &exact);
+    }
+
+    pbcp->pbc_leaf = atom;
+    if (!pa_btree_is_null(node->pbn_next))
+	PA_BTREE_PREFETCH(pa_btree_node(pbp, node->pbn_next));
+}
+
+pa_btree_node_t *
+pa_btree_cursor_next_leaf (pa_btree_t *pbp, pa_btree_cursor_t *pbcp)
+{
+    pa_btree_node_t *leaf = pa_btree_node(pbp, pbcp->pbc_leaf);
+
+    while (leaf) {
+	pbcp->pbc_leaf = leaf->pbn_next;
+	pbcp->pbc_slot = 0;
+	if (pa_btree_is_null(pbcp->pbc_leaf))
+	    return NULL;
+
+	leaf = pa_btree_node(pbp, pbcp->pbc_leaf);
+	if (leaf && leaf->pbn_count > 0) {
+	    /* Start pulling in the leaf after this one */
+	    if (!pa_btree_is_null(leaf->pbn_next))
+		PA_BTREE_PREFETCH(pa_btree_node(pbp, leaf->pbn_next));
+	    return leaf;
+	}
+    }
+
+    return NULL;
+}
+
+pa_btree_t *
+pa_btree_open (pa_mmap_t *pmp, const char *name, uint16_t node_size,
+	       pa_shift_t shift, pa_atom_t max_atoms)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    pa_btree_info_t *pbip;
+    pa_fixed_t *pfp;
+    pa_btree_t *pbp;
+    unsigned quarter;
+
+    if (node_size == 0)
+	node_size = PA_BTREE_NODE_SIZE;
+    else if (node_size < PA_BTREE_MIN_NODE)
+	node_size = PA_BTREE_MIN_NODE;
+    else if (node_size > PA_BTREE_MAX_NODE)
+	node_size = PA_BTREE_MAX_NODE;
+
+    pfp = pa_fixed_open(pmp, name, shift, node_size, max_atoms);
+    if (pfp == NULL)
+	return NULL;
+
+    /* An existing tree keeps the node size it was built with */
+    node_size = pfp->pf_atom_size;
+    if (node_size < PA_BTREE_MIN_NODE || node_size > PA_BTREE_MAX_NODE) {
+	pa_warning(0, "pa_btree node size out of range: %s (%u)",
+		   name, node_size);
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "root");
+    pbip = pa_mmap_header(pmp, namebuf, PA_TYPE_BTREE, 0, sizeof(*pbip));
+    if (pbip == NULL) {
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    pbp = psu_calloc(sizeof(*pbp));
+    if (pbp == NULL) {
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    pbp->pb_scratch = psu_malloc(node_size * 2);
+    if (pbp->pb_scratch == NULL) {
+	psu_free(pbp);
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    pbp->pb_infop = pbip;
+    pbp->pb_mmap = pmp;
+    pbp->pb_nodes = pfp;
+    pbp->pb_node_size = node_size;
+
+    /*
+     * A record and its slot can take up at most a quarter of a node,
+     * so that a split always leaves room in both halves.
+     */
+    quarter = (node_size - sizeof(pa_btree_node_t)) / 4
+	- sizeof(((pa_btree_node_t *) NULL)->pbn_slot[0]);
+    pbp->pb_max_key = (quarter & ~(sizeof(pa_atom_t) - 1)) - PA_BTREE_REC_HDR;
+    if (pbp->pb_max_key > PA_BTREE_MAXKEY)
+	pbp->pb_max_key = PA_BTREE_MAXKEY;
+
+    return pbp;
+}
+
+void
+pa_btree_close (pa_btree_t *pbp)
+{
+    if (pbp == NULL)
+	return;
+
+    pa_fixed_close(pbp->pb_nodes);
+    psu_free(pbp->pb_scratch);
+    psu_free(pbp);
+}
+
+/*
+ * Walk a subtree, counting the nodes and records at each level and
+ * checking that keys are in order.  Returns the number of problems.
+ */
+static unsigned
+pa_btree_check (pa_btree_t *pbp, pa_btree_atom_t atom, unsigned level,
+		unsigned *nodes, unsigned *bytes)
+{
+    pa_btree_node_t *node = pa_btree_node(pbp, atom);
+    pa_btree_rec_t *rec, *prev = NULL;
+    unsigned slot, bad = 0;
+
+    if (node == NULL || node->pbn_level != level)
+	return 1;
+
+    nodes[level] += 1;
+    bytes[level] += pbp->pb_node_size - pa_btree_node_gap(node)
+	- node->pbn_dead;
+
+    for (slot = 0; slot < node->pbn_count; slot++) {
+	rec = pa_btree_node_rec(node, slot);
+	if (prev && pa_btree_compare(prev->pbr_key, prev->pbr_len,
+				     rec->pbr_key, rec->pbr_len) >= 0)
+	    bad += 1;
+	prev = rec;
+    }
+
+    if (level > 0) {
+	bad += pa_btree_check(pbp, node->pbn_first, level - 1, nodes, bytes);
+	for (slot = 0; slot < node->pbn_count; slot++)
+	    bad += pa_btree_check(pbp, pa_btree_node_child(node, slot),
+				  level - 1, nodes, bytes);
+    }
+
+    return bad;
+}
+
+void
+pa_btree_dump (pa_btree_t *pbp, psu_boolean_t full)
+{
+    pa_btree_info_t *pbip = pbp->pb_infop;
+
+    psu_log("begin pa_btree dump of %p", pbip);
+
+    psu_log("root %#" PA_ATOM_XFMT
+	    ", keys %u, nodes %u (%u bytes each), depth %u, "
+	    "max key %u", pa_btree_atom_of(pbip->pbi_root), pbip->pbi_count,
+	    pbip->pbi_nodes, pbp->pb_node_size, pbip->pbi_depth,
+	    pbp->pb_max_key);
+
+    if (full && pbip->pbi_depth > 0 && pbip->pbi_depth <= PA_BTREE_MAXDEPTH) {
+	unsigned nodes[PA_BTREE_MAXDEPTH], bytes[PA_BTREE_MAXDEPTH];
+	unsigned level, bad;
+
+	bzero(nodes, sizeof(nodes));
+	bzero(bytes, sizeof(bytes));
+
+	bad = pa_btree_check(pbp, pbip->pbi_root, pbip->pbi_depth - 1,
+			     nodes, bytes);
+
+	for (level = pbip->pbi_depth; level-- > 0; )
+	    psu_log("level %u: %u nodes, %u%% full", level, nodes[level],
+		    nodes[level] ? bytes[level] * 100
+		    / (nodes[level] * pbp->pb_node_size) : 0);
+
+	if (bad)
+	    psu_log("%u problems found", bad);
+    }
+
+    psu_log("end pa_btree dump of %p", pbip);
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PABTREE_H
+#define PARROTDB_PABTREE_H
+
+/**
+ * @file pabtree.h
+ * @brief B+tree APIs
+ *
+ * A pa_btree is an ordered index whose nodes are page-sized elements
+ * of a pa_fixed array.  Unlike pa_pat and pa_trie, keys are copied
+ * into the nodes, so a lookup or a scan never calls back into the
+ * caller's data store, and keys may be prefixes of other keys.  Each
+ * key maps to a data atom.
+ *
+ * A node is a slotted page: an array of 16-bit offsets, sorted by key,
+ * grows up from the header and the records it points to grow down
+ * from the end of the node.  Leaves are linked in key order, so a
+ * cursor walks the keys leaf by leaf, reading each leaf front to
+ * back, and prefetches the next leaf while it works on this one.
+ * Separators in interior nodes are cut down to the shortest prefix
+ * that still splits their children, which keeps the fanout high for
+ * long keys with common prefixes.
+ *
+ * Deletes don't rebalance.  A node is freed when its last key goes,
+ * which keeps range deletes cheap, but a tree that shrinks by random
+ * deletes can be left with sparse leaves.  Like pa_pat, a pa_btree
+ * does no locking of its own.
+ */
+
+/* Wrapper for our "btree node" atom */
+PA_ATOM_TYPE(pa_btree_atom_t, pa_btree_atom_s, pba_atom,
+	     pa_btree_is_null, pa_btree_atom, pa_btree_atom_of,
+	     pa_btree_null_atom);
+
+/* Wrapper for our "data node" atom */
+PA_ATOM_TYPE(pa_btree_data_atom_t, pa_btree_data_atom_s, pbda_atom,
+	     pa_btree_data_is_null, pa_btree_data_atom, pa_btree_data_atom_of,
+	     pa_btree_data_null_atom);
+
+#define PA_BTREE_NODE_SIZE	4096 /* Default node size */
+#define PA_BTREE_MIN_NODE	256  /* Smallest node size we allow */
+#define PA_BTREE_MAX_NODE	16384 /* Largest node size we allow */
+#define PA_BTREE_MAXKEY		512  /* Maximum key length, in bytes */
+#define PA_BTREE_MAXDEPTH	16   /* Maximum number of levels */
+
+/*
+ * A record: the key and the atom it maps to.  In a leaf, the atom is
+ * a data atom; in an interior node, it's the child that holds keys
+ * greater than or equal to this key.
+ */
+typedef struct pa_btree_rec_s {
+    pa_atom_t pbr_value;	/* Data atom or child node atom */
+    uint16_t pbr_len;		/* Length of the key */
+    psu_byte_t pbr_key[0];	/* The key itself */
+} pa_btree_rec_t;
+
+typedef struct pa_btree_node_s {
+    uint16_t pbn_count;		/* Number of records */
+    uint16_t pbn_level;		/* Height above the leaves (0 = leaf) */
+    uint16_t pbn_top;		/* Offset of the lowest record */
+    uint16_t pbn_dead;		/* Bytes of records lost to deletes */
+    pa_btree_atom_t pbn_first;	/* Interior: child for keys before ours */
+    pa_btree_atom_t pbn_next;	/* Leaf: next leaf, in key order */
+    pa_btree_atom_t pbn_prev;	/* Leaf: previous leaf */
+    uint16_t pbn_slot[0];	/* Offsets of our records, in key order */
+} pa_btree_node_t;
+
+typedef struct pa_btree_info_s {
+    pa_btree_atom_t pbi_root;	/* Root node */
+    uint32_t pbi_count;		/* Number of keys in the tree */
+    uint32_t pbi_nodes;		/* Number of nodes in the tree */
+    uint32_t pbi_depth;		/* Number of levels (0 when empty) */
+} pa_btree_info_t;
+
+typedef struct pa_btree_s {
+    pa_btree_info_t *pb_infop;	/* Pointer to root info */
+    pa_mmap_t *pb_mmap;		/* Underlaying mmap */
+    pa_fixed_t *pb_nodes;	/* Fixed paged array of nodes */
+    uint16_t pb_node_size;	/* Size of each node */
+    uint16_t pb_max_key;	/* Longest key that fits our nodes */
+    psu_byte_t *pb_scratch;	/* Work space for splits (2 nodes) */
+} pa_btree_t;
+
+/*
+ * A cursor for walking keys in order
+ */
+typedef struct pa_btree_cursor_s {
+    pa_btree_atom_t pbc_leaf;	/* Current leaf */
+    uint16_t pbc_slot;		/* Next slot in that leaf */
+} pa_btree_cursor_t;
+
+static inline pa_btree_node_t *
+pa_btree_node (pa_btree_t *pbp, pa_btree_atom_t atom)
+{
+    return pa_fixed_atom_addr(pbp->pb_nodes,
+			      pa_fixed_atom(pa_btree_atom_of(atom)));
+}
+
+static inline pa_btree_rec_t *
+pa_btree_node_rec (pa_btree_node_t *node, unsigned slot)
+{
+    return (pa_btree_rec_t *) ((psu_byte_t *) node + node->pbn_slot[slot]);
+}
+
+/**
+ * @brief
+ * Looks up the data atom with the given key
+ *
+ * @return
+ *     The data atom for the key, or a null atom if there's none
+ */
+pa_btree_data_atom_t
+pa_btree_get (pa_btree_t *pbp, uint16_t key_bytes, const void *key);
+
+/**
+ * @brief
+ * Adds a key to the tree, mapping it to the given data atom
+ *
+ * @return
+ *     @c TRUE if the key was added;
+ *     @c FALSE if it's already in the tree, it's too long, or we're
+ *     out of memory.
+ */
+psu_boolean_t
+pa_btree_add (pa_btree_t *pbp, uint16_t key_bytes, const void *key,
+	      pa_btree_data_atom_t datom);
+
+/**
+ * @brief
+ * Removes a key from the tree
+ *
+ * @return
+ *     The data atom the key mapped to, or a null atom if the key
+ *     wasn't in the tree.
+ */
+pa_btree_data_atom_t
+pa_btree_delete (pa_btree_t *pbp, uint16_t key_bytes, const void *key);
+
+/**
+ * @brief
+ * Removes every key that's at least "lo" and less than "hi".  A NULL
+ * "hi" means there's no upper limit.  Whole leaves are dropped at a
+ * time, without visiting their keys one by one.
+ *
+ * @return
+ *     The number of keys removed
+ */
+uint32_t
+pa_btree_delete_range (pa_btree_t *pbp, uint16_t lo_bytes, const void *lo,
+		       uint16_t hi_bytes, const void *hi);
+
+/**
+ * @brief
+ * Positions a cursor at the first key that's greater than or equal
+ * to the given key.  A NULL key starts at the beginning of the tree.
+ */
+void
+pa_btree_cursor_seek (pa_btree_t *pbp, pa_btree_cursor_t *pbcp,
+		      uint16_t key_bytes, const void *key);
+
+/*
+ * Move a cursor onto the next leaf; internal to pa_btree_cursor_next
+ */
+pa_btree_node_t *
+pa_btree_cursor_next_leaf (pa_btree_t *pbp, pa_btree_cursor_t *pbcp);
+
+/**
+ * @brief
+ * Returns the data atom for the cursor's key and moves the cursor to
+ * the next key.  If key_bytesp and keyp aren't NULL, the key is
+ * returned thru them; it points into the tree, so it is only good
+ * until the tree is changed.  Changing the tree invalidates all
+ * cursors; re-seek to carry on.
+ *
+ * @return
+ *     The data atom, or a null atom at the end of the tree
+ */
+static inline pa_btree_data_atom_t
+pa_btree_cursor_next (pa_btree_t *pbp, pa_btree_cursor_t *pbcp,
+		      uint16_t *key_bytesp, const psu_byte_t **keyp)
+{
+    pa_btree_node_t *leaf;
+    pa_btree_rec_t *rec;
+
+    if (pa_btree_is_null(pbcp->pbc_leaf))
+	return pa_btree_data_null_atom();
+
+    leaf = pa_btree_node(pbp, pbcp->pbc_leaf);
+    if (leaf == NULL)
+	return pa_btree_data_null_atom();
+
+    if (pbcp->pbc_slot >= leaf->pbn_count) {
+	leaf = pa_btree_cursor_next_leaf(pbp, pbcp);
+	if (leaf == NULL)
+	    return pa_btree_data_null_atom();
+    }
+
+    rec = pa_btree_node_rec(leaf, pbcp->pbc_slot++);
+    if (key_bytesp && keyp) {
+	*key_bytesp = rec->pbr_len;
+	*keyp = rec->pbr_key;
+    }
+
+    return pa_btree_data_atom(rec->pbr_value);
+}
+
+pa_btree_t *
+pa_btree_open (pa_mmap_t *pmp, const char *name, uint16_t node_size,
+	       pa_shift_t shift, pa_atom_t max_atoms);
+
+void
+pa_btree_close (pa_btree_t *pbp);
+
+void
+pa_btree_dump (pa_btree_t *pbp, psu_boolean_t full);
+
+#endif /* PARROTDB_PABTREE_H */
@@ -34,6 +34,7 @@
  */
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <assert.h>
 #include <stddef.h>
 
@@ -42,9 +43,27 @@
 /*
  * NOTE WELL: There's no way to keep PA_ATOM_SHIFT up-to-date
  * automatically, but it must be log2(sizeof(pa_atom_t).
+ *
+ * Atoms are 32 bits, which keeps our tables (and caches) dense, but
+ * limits each allocator to 4G atoms.  Building with
+ * --enable-wide-atoms (PA_WIDE_ATOMS) makes them 64 bits, at the cost
+ * of bigger nodes, headers, and page tables.  The two layouts are
+ * incompatible; pa_mmap_open refuses a file made with the other one.
+ * Use PA_ATOM_FMT to print atoms, e.g. "atom %" PA_ATOM_FMT.
  */
+#ifdef PA_WIDE_ATOMS
+#define PA_ATOM_SHIFT	3	/* log2(sizeof(pa_atom_t) */
+typedef uint64_t pa_atom_t;	/* Type for atom numbers */
+#define PA_ATOM_FMT	PRIu64	/* printf format for pa_atom_t */
+#define PA_ATOM_XFMT	PRIx64	/* Same, in hex */
+#else /* PA_WIDE_ATOMS */
 #define PA_ATOM_SHIFT	2	/* log2(sizeof(pa_atom_t) */
 typedef uint32_t pa_atom_t;	/* Type for atom numbers */
+#define PA_ATOM_FMT	"u"	/* printf format for pa_atom_t */
+#define PA_ATOM_XFMT	"x"	/* Same, in hex */
+#endif /* PA_WIDE_ATOMS */
+
+#define PA_ATOM_BITS	(sizeof(pa_atom_t) * PA_NBBY) /* Bits in an atom */
 
 #define PA_NULL_ATOM	((pa_atom_t) 0)
 
@@ -100,8 +119,12 @@ typedef uint8_t pa_boolean_t;	/* Simple boolean */
 #define PA_TYPE_OPAQUE		6 /* Opaque header (can't decode) */
 #define PA_TYPE_TREE		7 /* Tree (xi_tree_t) */
 #define PA_TYPE_BITMAP		8 /* Bitmap (pa_bitmap_t) */
+#define PA_TYPE_TRIE		9 /* Multi-bit trie (pa_trie_t) */
+#define PA_TYPE_HASH		10 /* Hash table (pa_hash_t) */
+#define PA_TYPE_BTREE		11 /* B+tree (pa_btree_t) */
+#define PA_TYPE_ROAR		12 /* Compressed bitmap (pa_roar_t) */
 
-#define PA_TYPE_MAX		9
+#define PA_TYPE_MAX		13
 
 /*
  * A page number is the number of the page containing an atom,
@@ -122,6 +145,24 @@ pa_roundup_shift32 (uint32_t val, pa_shift_t shift)
     return (val + (1 << shift) - 1) & ~((1 << shift) - 1);
 }
 
+static inline pa_atom_t
+pa_roundup_shift_atom (pa_atom_t val, pa_shift_t shift)
+{
+    pa_atom_t mask = ((pa_atom_t) 1 << shift) - 1;
+
+    return (val + mask) & ~mask;
+}
+
+/*
+ * Round up an atom count to a multiple of "rnd" (a power of two),
+ * without narrowing wide atoms to 32 bits
+ */
+static inline pa_atom_t
+pa_roundup_atom (pa_atom_t val, pa_atom_t rnd)
+{
+    return (val + rnd - 1) & ~(rnd - 1);
+}
+
 static inline uint32_t
 pa_roundup32 (uint32_t val, uint32_t rnd)
 {
@@ -193,4 +234,25 @@ pa_is_short_string (const char *string)
 	    && string < &pa_short_strings[PA_SHORT_STRINGS_MAX * 2]);
 }
 
+/*
+ * Hash a string, for our hash-based indices.  This is FNV-1a, which
+ * is simple and good enough for the short strings we see.
+ */
+#define PA_HASH_INIT	0x811c9dc5U /* FNV-1a offset basis */
+#define PA_HASH_PRIME	0x01000193U /* FNV-1a prime */
+
+static inline uint32_t
+pa_hash_nstring (const char *string, size_t len)
+{
+    const uint8_t *cp = (const uint8_t *) string;
+    uint32_t hash = PA_HASH_INIT;
+
+    for ( ; len > 0; len--, cp++) {
+	hash ^= *cp;
+	hash *= PA_HASH_PRIME;
+    }
+
+    return hash;
+}
+
 #endif /* PARROTDB_PACOMMON_H */
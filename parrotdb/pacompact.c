@@ -0,0 +1,753 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Offline compaction: copy the live contents of a parrotdb file into
+ * a new one, renumbering atoms as we go.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/pacompact.h>
+
+#define PA_COMPACT_BASE		"compact" /* Config base for the new file */
+#define PA_COMPACT_HASH_SIZE	1024 /* Initial size of each atom map */
+#define PA_COMPACT_GROW_PERCENT	10 /* Growth for the new file */
+
+/* Bits in pctt_live */
+#define PA_COMPACT_TEST(_live, _atom) ((_live)[(_atom) >> 3] & (1 << ((_atom) & 7)))
+#define PA_COMPACT_SET(_live, _atom) ((_live)[(_atom) >> 3] |= (1 << ((_atom) & 7)))
+#define PA_COMPACT_CLEAR(_live, _atom) ((_live)[(_atom) >> 3] &= ~(1 << ((_atom) & 7)))
+
+/*
+ * Each table maps old atoms to new ones with an open-addressed hash,
+ * since arb atoms are sparse
+ */
+static inline uint32_t
+pa_compact_hash (pa_atom_t atom, uint32_t mask)
+{
+    return (atom * 2654435761U) & mask;
+}
+
+static pa_atom_t
+pa_compact_lookup (pa_compact_table_t *ptp, pa_atom_t atom)
+{
+    uint32_t mask = ptp->pctt_size - 1;
+    uint32_t slot;
+
+    if (ptp->pctt_keys == NULL)
+	return PA_NULL_ATOM;
+
+    for (slot = pa_compact_hash(atom, mask); ptp->pctt_keys[slot];
+	 slot = (slot + 1) & mask)
+	if (ptp->pctt_keys[slot] == atom)
+	    return ptp->pctt_values[slot];
+
+    return PA_NULL_ATOM;
+}
+
+static int
+pa_compact_resize (pa_compact_table_t *ptp, uint32_t new_size)
+{
+    pa_atom_t *keys = psu_calloc(new_size * sizeof(*keys));
+    pa_atom_t *values = psu_calloc(new_size * sizeof(*values));
+    uint32_t mask = new_size - 1;
+    uint32_t i, slot;
+
+    if (keys == NULL || values == NULL) {
+	pa_warning(errno, "could not allocate atom map (%u)", new_size);
+	psu_free(keys);
+	psu_free(values);
+	return -1;
+    }
+
+    for (i = 0; i < ptp->pctt_size; i++) {
+	if (ptp->pctt_keys[i] == PA_NULL_ATOM)
+	    continue;
+
+	for (slot = pa_compact_hash(ptp->pctt_keys[i], mask); keys[slot];
+	     slot = (slot + 1) & mask)
+	    continue;
+
+	keys[slot] = ptp->pctt_keys[i];
+	values[slot] = ptp->pctt_values[i];
+    }
+
+    psu_free(ptp->pctt_keys);
+    psu_free(ptp->pctt_values);
+    ptp->pctt_keys = keys;
+    ptp->pctt_values = values;
+    ptp->pctt_size = new_size;
+
+    return 0;
+}
+
+static int
+pa_compact_record (pa_compact_table_t *ptp, pa_atom_t atom, pa_atom_t new_atom)
+{
+    uint32_t mask, slot;
+
+    /* Keep the hash under half full */
+    if ((ptp->pctt_count + 1) * 2 > ptp->pctt_size
+	    && pa_compact_resize(ptp, ptp->pctt_size
+				 ? ptp->pctt_size * 2 : PA_COMPACT_HASH_SIZE))
+	return -1;
+
+    mask = ptp->pctt_size - 1;
+    for (slot = pa_compact_hash(atom, mask); ptp->pctt_keys[slot];
+	 slot = (slot + 1) & mask)
+	continue;
+
+    ptp->pctt_keys[slot] = atom;
+    ptp->pctt_values[slot] = new_atom;
+    ptp->pctt_count += 1;
+
+    ptp->pctt_stats.pcs_live += 1;
+    if (atom != new_atom)
+	ptp->pctt_stats.pcs_renumbered += 1;
+
+    return 0;
+}
+
+/*
+ * Remember an arb atom that needs fixing up
+ */
+static int
+pa_compact_enqueue (pa_compact_t *pcp, unsigned table, pa_atom_t atom)
+{
+    if (pcp->pc_queue_len >= pcp->pc_queue_size) {
+	uint32_t size = pcp->pc_queue_size ? pcp->pc_queue_size * 2 : 1024;
+	pa_atom_t *queue = psu_realloc(pcp->pc_queue,
+				       size * 2 * sizeof(*queue));
+	if (queue == NULL)
+	    return -1;
+
+	pcp->pc_queue = queue;
+	pcp->pc_queue_size = size;
+    }
+
+    pcp->pc_queue[pcp->pc_queue_len * 2] = table;
+    pcp->pc_queue[pcp->pc_queue_len * 2 + 1] = atom;
+    pcp->pc_queue_len += 1;
+
+    return 0;
+}
+
+/*
+ * Copy an arb atom into the new file
+ */
+static pa_atom_t
+pa_compact_copy_arb (pa_compact_t *pcp, unsigned table, pa_atom_t atom)
+{
+    pa_compact_table_t *ptp = &pcp->pc_tables[table];
+    pa_arb_atom_t old_atom = pa_arb_atom(atom), new_atom;
+    size_t size;
+
+    size = pa_arb_atom_size(ptp->pctt_from, old_atom);
+    if (size == 0)
+	return PA_NULL_ATOM;
+
+    new_atom = pa_arb_alloc(ptp->pctt_to, size);
+    if (pa_arb_is_null(new_atom))
+	return PA_NULL_ATOM;
+
+    memcpy(pa_arb_atom_addr(ptp->pctt_to, new_atom),
+	   pa_arb_atom_addr(ptp->pctt_from, old_atom), size);
+
+    if (pa_compact_record(ptp, atom, pa_arb_atom_of(new_atom))
+	    || pa_compact_enqueue(pcp, table, pa_arb_atom_of(new_atom)))
+	return PA_NULL_ATOM;
+
+    return pa_arb_atom_of(new_atom);
+}
+
+pa_atom_t
+pa_compact_map (pa_compact_t *pcp, unsigned table, pa_atom_t atom)
+{
+    pa_compact_table_t *ptp;
+    pa_atom_t new_atom;
+
+    if (atom == PA_NULL_ATOM || table >= pcp->pc_count)
+	return PA_NULL_ATOM;
+
+    ptp = &pcp->pc_tables[table];
+
+    /* Short strings aren't stored, so they never change */
+    if (ptp->pctt_type->pct_type == PA_TYPE_ISTR
+	    && atom < PA_SHORT_STRINGS_MAX)
+	return atom;
+
+    new_atom = pa_compact_lookup(ptp, atom);
+    if (new_atom != PA_NULL_ATOM)
+	return new_atom;
+
+    if (ptp->pctt_type->pct_type == PA_TYPE_ARB && ptp->pctt_from)
+	new_atom = pa_compact_copy_arb(pcp, table, atom);
+
+    if (new_atom == PA_NULL_ATOM)
+	pcp->pc_dangling += 1;
+
+    return new_atom;
+}
+
+/*
+ * Rewrite the references in one (newly copied) atom
+ */
+static void
+pa_compact_fixup (pa_compact_t *pcp, unsigned table, void *data, size_t size)
+{
+    const pa_compact_type_t *pctp = pcp->pc_tables[table].pctt_type;
+    const pa_compact_field_t *pcfp;
+    pa_atom_t *ap;
+    unsigned i;
+
+    if (data == NULL)
+	return;
+
+    for (i = 0; i < pctp->pct_nfields; i++) {
+	pcfp = &pctp->pct_fields[i];
+	if (pcfp->pcf_offset + sizeof(*ap) > size)
+	    continue;
+
+	ap = (void *) ((psu_byte_t *) data + pcfp->pcf_offset);
+	*ap = pa_compact_map(pcp, pcfp->pcf_table, *ap);
+    }
+
+    if (pctp->pct_fixup)
+	pctp->pct_fixup(pcp, table, data, size);
+}
+
+/*
+ * Fix up the arb atoms we've copied; fixing them can copy more
+ */
+static void
+pa_compact_drain (pa_compact_t *pcp)
+{
+    pa_compact_table_t *ptp;
+    pa_arb_atom_t atom;
+    unsigned table;
+
+    while (pcp->pc_queue_len > 0) {
+	pcp->pc_queue_len -= 1;
+	table = pcp->pc_queue[pcp->pc_queue_len * 2];
+	atom = pa_arb_atom(pcp->pc_queue[pcp->pc_queue_len * 2 + 1]);
+	ptp = &pcp->pc_tables[table];
+
+	pa_compact_fixup(pcp, table, pa_arb_atom_addr(ptp->pctt_to, atom),
+			 pa_arb_atom_size(ptp->pctt_to, atom));
+    }
+}
+
+/*
+ * Clear the atoms on a free chain from our live bitmap.  The chain
+ * ends (or runs into pages we've never allocated); we stop at a loop,
+ * in case the file is damaged.
+ */
+static void
+pa_compact_free_chain (pa_compact_table_t *ptp, pa_fixed_atom_t free_atom)
+{
+    pa_fixed_t *from = ptp->pctt_from;
+    pa_atom_t atom, steps;
+    void *addr;
+
+    for (steps = 0; !pa_fixed_is_null(free_atom)
+	     && steps < ptp->pctt_limit; steps++) {
+	atom = pa_fixed_atom_of(free_atom);
+	if (atom >= ptp->pctt_limit || !PA_COMPACT_TEST(ptp->pctt_live, atom))
+	    break;
+
+	addr = pa_fixed_atom_addr(from, free_atom);
+	if (addr == NULL)
+	    break;
+
+	PA_COMPACT_CLEAR(ptp->pctt_live, atom);
+	ptp->pctt_stats.pcs_dropped += 1;
+	free_atom = *(pa_fixed_atom_t *) addr;
+    }
+}
+
+/*
+ * Find the atoms in use in a pa_fixed: those on allocated pages that
+ * aren't on the free chain (or, for PFF_RECLAIM, their page's chain).
+ * Then copy them, in order.
+ */
+static int
+pa_compact_copy_fixed (pa_compact_table_t *ptp)
+{
+    pa_fixed_t *from = ptp->pctt_from, *to = ptp->pctt_to;
+    pa_page_t page, max_page = from->pf_max_atoms >> from->pf_shift;
+    pa_atom_t atom, limit;
+    pa_fixed_atom_t new_atom;
+    void *addr;
+
+    for (page = max_page; page > 0; page--)
+	if (pa_fixed_page_get(from, page - 1) != NULL)
+	    break;
+
+    limit = page << from->pf_shift;
+    if (limit == 0)
+	return 0;
+
+    ptp->pctt_live = psu_calloc((limit + 7) / 8);
+    if (ptp->pctt_live == NULL)
+	return -1;
+    ptp->pctt_limit = limit;
+
+    for (atom = 1; atom < limit; atom++)
+	if (pa_fixed_page_get(from, atom >> from->pf_shift) != NULL)
+	    PA_COMPACT_SET(ptp->pctt_live, atom);
+
+    if (from->pf_reclaim) {
+	for (page = 0; page < (limit >> from->pf_shift); page++)
+	    pa_compact_free_chain(ptp,
+			from->pf_reclaim->pfr_info[page].pfpi_free);
+    } else {
+	pa_compact_free_chain(ptp, from->pf_free);
+    }
+
+    for (atom = 1; atom < limit; atom++) {
+	if (!PA_COMPACT_TEST(ptp->pctt_live, atom))
+	    continue;
+
+	new_atom = pa_fixed_alloc_atom(to);
+	addr = pa_fixed_atom_addr(to, new_atom);
+	if (addr == NULL)
+	    return -1;
+
+	memcpy(addr, pa_fixed_atom_addr(from, pa_fixed_atom(atom)),
+	       from->pf_atom_size);
+
+	if (pa_compact_record(ptp, atom, pa_fixed_atom_of(new_atom)))
+	    return -1;
+    }
+
+    return 0;
+}
+
+static void
+pa_compact_fixup_fixed (pa_compact_t *pcp, unsigned table)
+{
+    pa_compact_table_t *ptp = &pcp->pc_tables[table];
+    pa_fixed_t *to = ptp->pctt_to;
+    pa_atom_t atom;
+
+    if (ptp->pctt_live == NULL)
+	return;
+
+    for (atom = 1; atom < ptp->pctt_limit; atom++) {
+	if (!PA_COMPACT_TEST(ptp->pctt_live, atom))
+	    continue;
+
+	pa_compact_fixup(pcp, table,
+		pa_fixed_atom_addr(to,
+			pa_fixed_atom(pa_compact_lookup(ptp, atom))),
+		to->pf_atom_size);
+    }
+}
+
+/*
+ * Strings are never freed, so the index is handed out in order; we
+ * copy them in that order, so they should keep their numbers
+ */
+static int
+pa_compact_copy_istr (pa_compact_table_t *ptp)
+{
+    pa_istr_t *from = ptp->pctt_from, *to = ptp->pctt_to;
+    pa_fixed_t *index = from->pi_index;
+    psu_boolean_t interned;
+    pa_istr_atom_t old_atom, new_atom;
+    pa_atom_t atom, count;
+    const char *string;
+    size_t len;
+
+    interned = !pa_mmap_is_null(from->pi_infop->pii_hash.pih_table);
+
+    count = pa_fixed_is_null(index->pf_free) ? index->pf_max_atoms
+	: pa_fixed_atom_of(index->pf_free);
+
+    for (atom = 1; atom < count; atom++) {
+	old_atom = pa_istr_atom(atom + PA_SHORT_STRINGS_MAX);
+	string = pa_istr_atom_string(from, old_atom);
+	if (string == NULL)
+	    break;
+
+	len = strlen(string);
+	if (interned && pa_istr_atom_of(pa_istr_nstring_find(from, string, len))
+		== pa_istr_atom_of(old_atom))
+	    new_atom = pa_istr_nstring_intern(to, string, len);
+	else
+	    new_atom = pa_istr_nstring(to, string, len);
+
+	if (pa_istr_is_null(new_atom)
+		|| pa_compact_record(ptp, pa_istr_atom_of(old_atom),
+				     pa_istr_atom_of(new_atom)))
+	    return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Rebuild a patricia tree from its (renumbered) data atoms
+ */
+static int
+pa_compact_copy_pat (pa_compact_t *pcp, pa_compact_table_t *ptp)
+{
+    pa_pat_t *from = ptp->pctt_from, *to = ptp->pctt_to;
+    unsigned data = ptp->pctt_type->pct_data;
+    pa_pat_node_t *node;
+    pa_atom_t atom;
+
+    for (node = pa_pat_find_next(from, NULL); node;
+	 node = pa_pat_find_next(from, node)) {
+	atom = pa_compact_map(pcp, data, pa_pat_data_atom_of(node->ppn_data));
+	if (atom == PA_NULL_ATOM) {
+	    ptp->pctt_stats.pcs_dropped += 1;
+	    continue;
+	}
+
+	/* Keys of arb data must be fixed up before we look at them */
+	pa_compact_drain(pcp);
+
+	if (!pa_pat_add(to, pa_pat_data_atom(atom), (node->ppn_length >> 8) + 1))
+	    ptp->pctt_stats.pcs_dropped += 1;
+	else
+	    ptp->pctt_stats.pcs_live += 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Open one table in both files.  An empty table is opened only in
+ * the new one, since opening it in the old one would need to write.
+ */
+static int
+pa_compact_open_table (pa_compact_t *pcp, unsigned table)
+{
+    pa_compact_table_t *ptp = &pcp->pc_tables[table];
+    const pa_compact_type_t *pctp = ptp->pctt_type;
+    const char *name = pctp->pct_name;
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    pa_fixed_info_t *pfip;
+    pa_arb_info_t *prip;
+    pa_istr_info_t *piip;
+    pa_pat_info_t *ppip;
+    pa_compact_table_t *dtp;
+    pa_pat_t *ppp;
+    void *header;
+    uint32_t size;
+
+    header = pa_mmap_header(pcp->pc_from, name, 0, 0, 0);
+    if (header == NULL) {
+	pa_warning(0, "pa_compact: header not found: %s", name);
+	return 0;
+    }
+
+    switch (pctp->pct_type) {
+    case PA_TYPE_FIXED:
+	pfip = header;
+	if (!pa_mmap_is_null(pfip->pfi_base))
+	    ptp->pctt_from = pa_fixed_open(pcp->pc_from, name, pfip->pfi_shift,
+				pfip->pfi_atom_size, pfip->pfi_max_atoms);
+	ptp->pctt_to = pa_fixed_open(pcp->pc_to, name, pfip->pfi_shift,
+				pfip->pfi_atom_size, pfip->pfi_max_atoms);
+	if (ptp->pctt_to) {
+	    pa_fixed_set_flags(ptp->pctt_to, pfip->pfi_flags & ~PFF_RECLAIM);
+	    if ((pfip->pfi_flags & PFF_RECLAIM)
+		    && pa_fixed_reclaim_enable(ptp->pctt_to))
+		return -1;
+	}
+	break;
+
+    case PA_TYPE_ARB:
+	prip = header;
+	if (!pa_mmap_is_null(prip->pri_page_info.pfi_base))
+	    ptp->pctt_from = pa_arb_open(pcp->pc_from, name);
+	ptp->pctt_to = pa_arb_open(pcp->pc_to, name);
+	break;
+
+    case PA_TYPE_ISTR:
+	piip = header;
+	if (!pa_mmap_is_null(piip->pii_data.pid_base)
+		&& !pa_mmap_is_null(piip->pii_index.pfi_base))
+	    ptp->pctt_from = pa_istr_open(pcp->pc_from, name,
+				piip->pii_data.pid_shift,
+				piip->pii_data.pid_atom_shift,
+				piip->pii_data.pid_max_atoms);
+	ptp->pctt_to = pa_istr_open(pcp->pc_to, name,
+				piip->pii_data.pid_shift,
+				piip->pii_data.pid_atom_shift,
+				piip->pii_data.pid_max_atoms);
+	break;
+
+    case PA_TYPE_PAT:
+	/* A pa_pat is a pa_fixed of nodes, with a "<name>.root" header */
+	if (pctp->pct_data >= pcp->pc_count || pctp->pct_key_func == NULL) {
+	    pa_warning(0, "pa_compact: no data table for %s", name);
+	    return -1;
+	}
+
+	pfip = header;
+	pa_config_name(namebuf, sizeof(namebuf), name, "root");
+	ppip = pa_mmap_header(pcp->pc_from, namebuf, 0, 0, 0);
+	dtp = &pcp->pc_tables[pctp->pct_data];
+
+	if (ppip && !pa_mmap_is_null(pfip->pfi_base) && dtp->pctt_from)
+	    ptp->pctt_from = pa_pat_open(pcp->pc_from, name, dtp->pctt_from,
+				pctp->pct_key_func, ppip->ppi_key_bytes,
+				pfip->pfi_shift, pfip->pfi_max_atoms);
+	ptp->pctt_to = pa_pat_open(pcp->pc_to, name, dtp->pctt_to,
+				pctp->pct_key_func,
+				ppip ? ppip->ppi_key_bytes : PA_PAT_MAXKEY,
+				pfip->pfi_shift, pfip->pfi_max_atoms);
+
+	/* If the old tree is empty, don't bother */
+	ppp = ptp->pctt_from;
+	if (ppp && pa_pat_is_null(ppp->pp_root)) {
+	    pa_pat_close(ppp);
+	    ptp->pctt_from = NULL;
+	}
+	break;
+
+    case PA_TYPE_OPAQUE:
+	pa_mmap_header_info(header, NULL, &size);
+	ptp->pctt_from = header;
+	ptp->pctt_to = pa_mmap_header(pcp->pc_to, name, PA_TYPE_OPAQUE, 0, size);
+	if (ptp->pctt_to) {
+	    memcpy(ptp->pctt_to, header, size);
+	    ptp->pctt_stats.pcs_live = 1;
+	}
+	break;
+
+    default:
+	pa_warning(0, "pa_compact: can't compact %s (type %u)",
+		   name, pctp->pct_type);
+	return -1;
+    }
+
+    if (ptp->pctt_to == NULL) {
+	pa_warning(0, "pa_compact: could not open %s", name);
+	return -1;
+    }
+
+    return 0;
+}
+
+static void
+pa_compact_close_table (pa_compact_table_t *ptp)
+{
+    void *handles[2] = { ptp->pctt_from, ptp->pctt_to };
+    unsigned i;
+
+    for (i = 0; i < 2; i++) {
+	if (handles[i] == NULL)
+	    continue;
+
+	switch (ptp->pctt_type->pct_type) {
+	case PA_TYPE_FIXED:
+	    pa_fixed_close(handles[i]);
+	    break;
+
+	case PA_TYPE_ARB:
+	    pa_arb_close(handles[i]);
+	    break;
+
+	case PA_TYPE_ISTR:
+	    pa_istr_close(handles[i]);
+	    break;
+
+	case PA_TYPE_PAT:
+	    pa_fixed_close(((pa_pat_t *) handles[i])->pp_nodes);
+	    pa_pat_close(handles[i]);
+	    break;
+	}
+    }
+
+    ptp->pctt_from = ptp->pctt_to = NULL;
+}
+
+/*
+ * Warn about headers in the old file that the map doesn't cover
+ */
+static void
+pa_compact_check_headers (pa_compact_t *pcp)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    const pa_compact_type_t *pctp;
+    const char *name;
+    void *header;
+    unsigned i;
+
+    for (header = pa_mmap_next_header(pcp->pc_from, NULL); header;
+	 header = pa_mmap_next_header(pcp->pc_from, header)) {
+	name = pa_mmap_header_info(header, NULL, NULL);
+
+	for (i = 0; i < pcp->pc_count; i++) {
+	    pctp = pcp->pc_tables[i].pctt_type;
+	    if (strcmp(name, pctp->pct_name) == 0)
+		break;
+
+	    if (pctp->pct_type == PA_TYPE_PAT) {
+		pa_config_name(namebuf, sizeof(namebuf),
+			       pctp->pct_name, "root");
+		if (strcmp(name, namebuf) == 0)
+		    break;
+	    }
+	}
+
+	if (i >= pcp->pc_count) {
+	    pa_warning(0, "pa_compact: %s is not in the map; dropped", name);
+	    pcp->pc_dropped_headers += 1;
+	}
+    }
+}
+
+pa_compact_t *
+pa_compact (const char *from, const char *to, const pa_compact_type_t *map)
+{
+    pa_compact_table_t *ptp;
+    pa_compact_t *pcp;
+    unsigned i, count;
+    int rc = 0;
+
+    for (count = 0; map[count].pct_name; count++)
+	continue;
+
+    pcp = psu_calloc(sizeof(*pcp));
+    if (pcp == NULL)
+	return NULL;
+
+    pcp->pc_count = count;
+    pcp->pc_tables = psu_calloc(count * sizeof(*pcp->pc_tables));
+    if (pcp->pc_tables == NULL)
+	goto fail;
+
+    for (i = 0; i < count; i++)
+	pcp->pc_tables[i].pctt_type = &map[i];
+
+    pcp->pc_from = pa_mmap_open(from, PA_COMPACT_BASE, PMF_READ_ONLY, 0);
+    if (pcp->pc_from == NULL)
+	goto fail;
+
+    unlink(to);
+    pcp->pc_to = pa_mmap_open(to, PA_COMPACT_BASE, 0, 0644);
+    if (pcp->pc_to == NULL)
+	goto fail;
+
+    /* Grow in small steps, so there's little slack at the end */
+    pcp->pc_to->pm_grow_percent = pa_config_value32(PA_COMPACT_BASE,
+				"grow-percent", PA_COMPACT_GROW_PERCENT);
+
+    pa_compact_check_headers(pcp);
+
+    for (i = 0; i < count && rc == 0; i++)
+	rc = pa_compact_open_table(pcp, i);
+
+    /* Copy the tables we copy wholesale, then fix them up */
+    for (i = 0; i < count && rc == 0; i++) {
+	ptp = &pcp->pc_tables[i];
+	if (ptp->pctt_from == NULL)
+	    continue;
+
+	if (map[i].pct_type == PA_TYPE_ISTR)
+	    rc = pa_compact_copy_istr(ptp);
+	else if (map[i].pct_type == PA_TYPE_FIXED)
+	    rc = pa_compact_copy_fixed(ptp);
+    }
+
+    for (i = 0; i < count && rc == 0; i++) {
+	ptp = &pcp->pc_tables[i];
+	if (ptp->pctt_from == NULL)
+	    continue;
+
+	if (map[i].pct_type == PA_TYPE_FIXED) {
+	    pa_compact_fixup_fixed(pcp, i);
+	} else if (map[i].pct_type == PA_TYPE_OPAQUE) {
+	    uint32_t size;
+	    pa_mmap_header_info(ptp->pctt_from, NULL, &size);
+	    pa_compact_fixup(pcp, i, ptp->pctt_to, size);
+	}
+
+	/* Keep arb data in the order it's referenced */
+	pa_compact_drain(pcp);
+    }
+
+    for (i = 0; i < count && rc == 0; i++) {
+	ptp = &pcp->pc_tables[i];
+	if (ptp->pctt_from && map[i].pct_type == PA_TYPE_PAT)
+	    rc = pa_compact_copy_pat(pcp, ptp);
+    }
+
+    pa_compact_drain(pcp);
+
+    if (rc == 0)
+	rc = pa_mmap_commit(pcp->pc_to);
+
+    pcp->pc_old_size = pcp->pc_from->pm_len;
+    pcp->pc_new_size = pcp->pc_to->pm_len;
+
+    /* The map is the caller's; we don't hold onto it */
+    for (i = 0; i < count; i++) {
+	pa_compact_close_table(&pcp->pc_tables[i]);
+	pcp->pc_tables[i].pctt_type = NULL;
+    }
+
+    if (rc == 0)
+	return pcp;
+
+ fail:
+    pa_warning(0, "pa_compact: could not compact '%s' into '%s'", from, to);
+    pa_compact_close(pcp);
+    return NULL;
+}
+
+void
+pa_compact_close (pa_compact_t *pcp)
+{
+    pa_compact_table_t *ptp;
+    unsigned i;
+
+    if (pcp == NULL)
+	return;
+
+    if (pcp->pc_tables) {
+	for (i = 0; i < pcp->pc_count; i++) {
+	    ptp = &pcp->pc_tables[i];
+	    pa_compact_close_table(ptp);
+	    psu_free(ptp->pctt_keys);
+	    psu_free(ptp->pctt_values);
+	    psu_free(ptp->pctt_live);
+	}
+
+	psu_free(pcp->pc_tables);
+    }
+
+    if (pcp->pc_to)
+	pa_mmap_close(pcp->pc_to);
+    if (pcp->pc_from)
+	pa_mmap_close(pcp->pc_from);
+
+    psu_free(pcp->pc_queue);
+    psu_free(pcp);
+}
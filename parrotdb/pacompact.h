@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PACOMPACT_H
+#define PARROTDB_PACOMPACT_H
+
+/**
+ * @file pacompact.h
+ * @brief Offline compaction of parrotdb files
+ *
+ * A long-lived file collects free space: free chunks in pa_mmap,
+ * half-empty pages in pa_arb, and free chains thru pa_fixed arrays.
+ * Since everything is addressed by atom number, we can copy the live
+ * data into a new file, densely and in order, and renumber the atoms
+ * as we go.  Scans of the new file touch fewer pages, so cold starts
+ * are quicker.
+ *
+ * The caller describes the file with a "type map", an array of
+ * pa_compact_type_t (ending with a NULL pct_name), one per allocator
+ * header.  Each entry names the header, gives its type, and lists
+ * the fields inside each atom that hold atoms of other tables, so
+ * they can be rewritten.  Fields are pa_atom_t values at fixed
+ * offsets; anything fancier (bit fields, references that depend on
+ * the atom's contents) is handled by a pct_fixup function, which
+ * calls pa_compact_map() to renumber each reference.
+ *
+ * How each type is copied:
+ *
+ *   - PA_TYPE_FIXED: every allocated atom (those not on the free
+ *     chain) is copied, in atom order.
+ *   - PA_TYPE_ARB: atoms are copied when a reference to them is
+ *     mapped, so unreferenced data is dropped.  (pa_arb can't tell
+ *     us where its large allocations are.)  Atoms are laid out in
+ *     the order they're referenced, which is usually the order
+ *     they'll be read.
+ *   - PA_TYPE_ISTR: every string is copied, in order, so atoms
+ *     usually keep their numbers.  Interned strings are interned
+ *     again.
+ *   - PA_TYPE_PAT: rebuilt by adding each data atom (as mapped thru
+ *     pct_data's table) to a new tree.  pct_key_func is the tree's
+ *     key function.
+ *   - PA_TYPE_OPAQUE: copied as is, then fixed up like an atom.
+ *
+ * Headers that aren't in the map are dropped, with a warning.
+ */
+
+#define PA_COMPACT_FIELDS_MAX	8 /* Most fields per type */
+#define PA_COMPACT_NO_TABLE	0xffff /* No table (for pct_data) */
+
+struct pa_compact_s;
+typedef struct pa_compact_s pa_compact_t;
+
+/*
+ * A field in an atom that holds an atom of another table (or the
+ * same one)
+ */
+typedef struct pa_compact_field_s {
+    uint16_t pcf_offset;	/* Offset of the pa_atom_t (in bytes) */
+    uint16_t pcf_table;		/* Table it refers to (index in map) */
+} pa_compact_field_t;
+
+/*
+ * Fix up any references in one (newly copied) atom that fields can't
+ * describe.  "table" is the atom's table (index in the map), and
+ * "size" is the number of bytes at "data".
+ */
+typedef void (*pa_compact_fixup_t)(pa_compact_t *pcp, unsigned table,
+				   void *data, size_t size);
+
+typedef struct pa_compact_type_s {
+    const char *pct_name;	/* Name of the header */
+    uint16_t pct_type;		/* Type (PA_TYPE_*) */
+    uint16_t pct_data;		/* Data table (for PA_TYPE_PAT) */
+    pa_pat_key_func_t pct_key_func; /* Key function (for PA_TYPE_PAT) */
+    unsigned pct_nfields;	/* Number of fields in pct_fields */
+    pa_compact_field_t pct_fields[PA_COMPACT_FIELDS_MAX]; /* References */
+    pa_compact_fixup_t pct_fixup; /* Fixup function (or NULL) */
+} pa_compact_type_t;
+
+/*
+ * What became of one table
+ */
+typedef struct pa_compact_stats_s {
+    uint64_t pcs_live;		/* Atoms copied */
+    uint64_t pcs_dropped;	/* Atoms left behind (free or unreferenced) */
+    uint64_t pcs_renumbered;	/* Atoms that changed number */
+} pa_compact_stats_t;
+
+/*
+ * Per-table state
+ */
+typedef struct pa_compact_table_s {
+    const pa_compact_type_t *pctt_type; /* Our entry in the type map */
+    void *pctt_from;		/* Allocator in the old file */
+    void *pctt_to;		/* Allocator in the new file */
+    pa_atom_t *pctt_keys;	/* Old atoms (hash of old -> new) */
+    pa_atom_t *pctt_values;	/* New atoms */
+    uint32_t pctt_size;		/* Size of the hash (a power of two) */
+    uint32_t pctt_count;	/* Entries in use */
+    uint8_t *pctt_live;		/* Bitmap of live atoms (PA_TYPE_FIXED) */
+    pa_atom_t pctt_limit;	/* Atoms covered by pctt_live */
+    pa_compact_stats_t pctt_stats; /* What happened */
+} pa_compact_table_t;
+
+struct pa_compact_s {
+    pa_mmap_t *pc_from;		/* The old file (read-only) */
+    pa_mmap_t *pc_to;		/* The new file */
+    unsigned pc_count;		/* Number of tables */
+    pa_compact_table_t *pc_tables; /* One per type map entry */
+    pa_atom_t *pc_queue;	/* ARB atoms awaiting fixup (table, atom) */
+    uint32_t pc_queue_len;	/* Entries (pairs) in pc_queue */
+    uint32_t pc_queue_size;	/* Room in pc_queue */
+    uint64_t pc_dangling;	/* References to atoms we don't have */
+    unsigned pc_dropped_headers; /* Headers not in the map */
+    size_t pc_old_size;		/* Size of the old file */
+    size_t pc_new_size;		/* Size of the new file */
+};
+
+/**
+ * @brief
+ * Compacts the file "from" into a new file "to", which is replaced if
+ * it exists.  The old file isn't changed, so the caller can rename
+ * the new one over it when we're done.  The map is only used during
+ * the call; tables in the results are in map order.
+ *
+ * @return
+ *     The results, for pa_compact_stats() and friends, or NULL on
+ *     failure.  Free them with pa_compact_close().
+ */
+pa_compact_t *
+pa_compact (const char *from, const char *to, const pa_compact_type_t *map);
+
+/**
+ * @brief
+ * Maps an atom of a table in the old file to its number in the new
+ * one, copying it if needed (for PA_TYPE_ARB).  For use by fixup
+ * functions.
+ *
+ * @return
+ *     The new atom, or PA_NULL_ATOM if we don't know the old one
+ */
+pa_atom_t
+pa_compact_map (pa_compact_t *pcp, unsigned table, pa_atom_t atom);
+
+static inline pa_compact_stats_t *
+pa_compact_stats (pa_compact_t *pcp, unsigned table)
+{
+    return (table < pcp->pc_count) ? &pcp->pc_tables[table].pctt_stats : NULL;
+}
+
+void
+pa_compact_close (pa_compact_t *pcp);
+
+#endif /* PARROTDB_PACOMPACT_H */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * pacompact -- compact a parrotdb file into a new one
+ *
+ * Each "-t" option adds a table to the type map:
+ *
+ *     -t name:fixed[:offset=table,...]
+ *     -t name:arb[:offset=table,...]
+ *     -t name:istr
+ *     -t name:opaque[:offset=table,...]
+ *     -t name:pat:data=table[:istr]
+ *
+ * where "table" is the index of another "-t" option (from zero) and
+ * "offset" is the byte offset of a pa_atom_t that refers to it.  A pat
+ * table's keys are either strings in an istr table ("istr") or the
+ * raw bytes of the atoms in a fixed table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <stddef.h>
+#include <getopt.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/pacompact.h>
+
+#define MAX_TABLES	64	/* Most "-t" options */
+
+static pa_compact_type_t map[MAX_TABLES + 1];
+static unsigned map_count;
+
+static const char *type_names[PA_TYPE_MAX] = {
+    [PA_TYPE_FIXED] = "fixed",
+    [PA_TYPE_ARB] = "arb",
+    [PA_TYPE_ISTR] = "istr",
+    [PA_TYPE_PAT] = "pat",
+    [PA_TYPE_OPAQUE] = "opaque",
+};
+
+/*
+ * Keys for a pat table whose data is a pa_fixed: the atom's bytes
+ */
+static const uint8_t *
+fixed_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom)
+{
+    return pa_fixed_atom_addr(pp->pp_data,
+			      pa_fixed_atom(pa_pat_data_atom_of(datom)));
+}
+
+static void
+print_usage (void)
+{
+    fprintf(stderr,
+	    "Usage: pacompact [-v] -t name:type[:options] ... from to\n"
+	    "    types: fixed, arb, istr, opaque, pat\n"
+	    "    options: offset=table (fixed, arb, opaque);\n"
+	    "             data=table and istr (pat)\n");
+}
+
+static int
+parse_table (char *spec)
+{
+    pa_compact_type_t *pctp;
+    unsigned type, offset, table;
+    char *cp, *opt;
+
+    if (map_count >= MAX_TABLES) {
+	fprintf(stderr, "pacompact: too many tables\n");
+	return -1;
+    }
+
+    pctp = &map[map_count];
+    pctp->pct_data = PA_COMPACT_NO_TABLE;
+
+    cp = strchr(spec, ':');
+    if (cp == NULL) {
+	fprintf(stderr, "pacompact: missing type: %s\n", spec);
+	return -1;
+    }
+
+    *cp++ = '\0';
+    pctp->pct_name = spec;
+
+    opt = strchr(cp, ':');
+    if (opt)
+	*opt++ = '\0';
+
+    for (type = 0; type < PA_TYPE_MAX; type++)
+	if (type_names[type] && strcmp(cp, type_names[type]) == 0)
+	    break;
+
+    if (type >= PA_TYPE_MAX) {
+	fprintf(stderr, "pacompact: unknown type: %s\n", cp);
+	return -1;
+    }
+
+    pctp->pct_type = type;
+    if (type == PA_TYPE_PAT)
+	pctp->pct_key_func = fixed_key_func;
+
+    for (cp = opt; cp && *cp; cp = opt) {
+	opt = strchr(cp, ',');
+	if (opt)
+	    *opt++ = '\0';
+
+	if (type == PA_TYPE_PAT && strcmp(cp, "istr") == 0) {
+	    pctp->pct_key_func = pa_pat_istr_key_func;
+
+	} else if (type == PA_TYPE_PAT && sscanf(cp, "data=%u", &table) == 1) {
+	    pctp->pct_data = table;
+
+	} else if (type != PA_TYPE_PAT && type != PA_TYPE_ISTR
+		   && sscanf(cp, "%u=%u", &offset, &table) == 2
+		   && pctp->pct_nfields < PA_COMPACT_FIELDS_MAX) {
+	    pctp->pct_fields[pctp->pct_nfields].pcf_offset = offset;
+	    pctp->pct_fields[pctp->pct_nfields].pcf_table = table;
+	    pctp->pct_nfields += 1;
+
+	} else {
+	    fprintf(stderr, "pacompact: bad option for %s: %s\n",
+		    pctp->pct_name, cp);
+	    return -1;
+	}
+    }
+
+    if (type == PA_TYPE_PAT && pctp->pct_data == PA_COMPACT_NO_TABLE) {
+	fprintf(stderr, "pacompact: %s needs data=table\n", pctp->pct_name);
+	return -1;
+    }
+
+    map_count += 1;
+    return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    pa_compact_stats_t *pcsp;
+    pa_compact_t *pcp;
+    int opt_verbose = 0;
+    unsigned i;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "t:v")) != -1) {
+	switch (ch) {
+	case 't':
+	    if (parse_table(optarg))
+		return 1;
+	    break;
+
+	case 'v':
+	    opt_verbose = 1;
+	    break;
+
+	default:
+	    print_usage();
+	    return 1;
+	}
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 2 || map_count == 0) {
+	print_usage();
+	return 1;
+    }
+
+    pcp = pa_compact(argv[0], argv[1], map);
+    if (pcp == NULL)
+	return 1;
+
+    if (opt_verbose) {
+	for (i = 0; i < map_count; i++) {
+	    pcsp = pa_compact_stats(pcp, i);
+	    printf("%s (%s): live %llu, dropped %llu, renumbered %llu\n",
+		   map[i].pct_name, type_names[map[i].pct_type],
+		   (unsigned long long) pcsp->pcs_live,
+		   (unsigned long long) pcsp->pcs_dropped,
+		   (unsigned long long) pcsp->pcs_renumbered);
+	}
+
+	if (pcp->pc_dangling)
+	    printf("dangling references: %llu\n",
+		   (unsigned long long) pcp->pc_dangling);
+    }
+
+    printf("%s: %zu bytes -> %zu bytes (%zd reclaimed)\n", argv[0],
+	   pcp->pc_old_size, pcp->pc_new_size,
+	   (ssize_t) (pcp->pc_old_size - pcp->pc_new_size));
+
+    pa_compact_close(pcp);
+    return 0;
+}
@@ -134,7 +134,7 @@ pa_config_read (const char *filename)
  */
 static const char *
 pa_config_value_internal (const char *base, const char *name,
-			  int show_def, uint32_t def)
+			  int show_def, uint64_t def)
 {
     size_t blen = strlen(base), nlen = strlen(name);
     char namebuf[blen + nlen + 2];
@@ -146,7 +146,8 @@ pa_config_value_internal (const char *base, const char *name,
     memcpy(namebuf + blen + 1, name, nlen + 1);
 
     if (show_def)
-	psu_log("config: looking for '%s' (default %u)", namebuf, def);
+	psu_log("config: looking for '%s' (default %" PRIu64 ")",
+		namebuf, def);
     else psu_log("config: looking for '%s'", namebuf);
 
     for (xcvp = pa_config_vars; xcvp; xcvp = xcvp->xcv_next) {
@@ -191,3 +192,28 @@ pa_config_value32 (const char *base, const char *name, uint32_t def)
     ival = strtoul(value, NULL, 0);
     return (ival == ULONG_MAX) ? def : ival;
 }
+
+/*
+ * Return a 64-bit integer value from the config file, or the default.
+ */
+uint64_t
+pa_config_value64 (const char *base, const char *name, uint64_t def)
+{
+    unsigned long long ival;
+    const char *value = pa_config_value_internal(base, name, 1, def);
+    if (value == NULL)
+	return def;
+
+    if (strncmp(value, "1<<", 3) == 0) {
+	ival = strtoull(value + 3, NULL, 0);
+	return (ival == ULLONG_MAX || ival > 63) ? def : (1ULL << ival);
+    }
+
+    if (strncmp(value, "1 <<", 4) == 0) {
+	ival = strtoull(value + 4, NULL, 0);
+	return (ival == ULLONG_MAX || ival > 63) ? def : (1ULL << ival);
+    }
+
+    ival = strtoull(value, NULL, 0);
+    return (ival == ULLONG_MAX) ? def : ival;
+}
@@ -53,6 +53,32 @@ pa_config_value (const char *base, const char *name);
 uint32_t
 pa_config_value32 (const char *base, const char *name, uint32_t def);
 
+/**
+ * Return a 64-bit value from config, or the default if nothing is
+ * configured.
+ *
+ * @param[in] base basename/prefix of the config name
+ * @param[in] name name of this table
+ * @param[in] def default value
+ * @return value to be used
+ */
+uint64_t
+pa_config_value64 (const char *base, const char *name, uint64_t def);
+
+/**
+ * Return an atom-sized value (such as "max-atoms") from config, or
+ * the default.  Wide atoms allow values past 32 bits.
+ */
+static inline pa_atom_t
+pa_config_value_atom (const char *base, const char *name, pa_atom_t def)
+{
+#ifdef PA_WIDE_ATOMS
+    return pa_config_value64(base, name, def);
+#else /* PA_WIDE_ATOMS */
+    return pa_config_value32(base, name, def);
+#endif /* PA_WIDE_ATOMS */
+}
+
 /**
  * Return a value from config, but only if the default is zero or
  * if the config value is greater than the default.  In any case
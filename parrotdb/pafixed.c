@@ -21,6 +21,7 @@
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
 #include <parrotdb/pafixed.h>
+#include <parrotdb/pathread.h>
 #include <libpsu/psualloc.h>
 
 /*
@@ -74,17 +75,451 @@ pa_fixed_element_setup_page (pa_fixed_t *pfp, pa_fixed_atom_t atom)
     pa_atom_t count = 1 << pfp->pf_shift;
     size_t size = count * pfp->pf_atom_size;
 
+    pa_lock(pfp->pf_lock);
+
+    /* Another thread may have beaten us to it */
+    if (pa_fixed_page_get(pfp, page) != NULL)
+	goto done;
+
     pa_mmap_atom_t matom = pa_mmap_alloc(pfp->pf_mmap, size);
     pa_fixed_atom_t *addr = pa_mmap_addr(pfp->pf_mmap, matom);
     if (addr == NULL)
-	return;
-
-    /* Set the page in the page array */
-    pa_fixed_page_set(pfp, page, matom, addr);
+	goto done;
 
     /* If needed, initialize the new memory to zero */
     if (pfp->pf_flags & PFF_INIT_ZERO)
 	bzero(addr, size);
+
+    /* Set the page in the page array */
+    pa_fixed_page_set(pfp, page, matom, addr);
+
+ done:
+    pa_unlock(pfp->pf_lock);
+}
+
+/*
+ * Which bin a partly used page belongs in
+ */
+static inline unsigned
+pa_fixed_reclaim_bin (pa_fixed_t *pfp, uint32_t live)
+{
+    return ((uint64_t) live * PA_FIXED_RECLAIM_BINS) >> pfp->pf_shift;
+}
+
+static void
+pa_fixed_reclaim_unlink (pa_fixed_t *pfp, pa_page_t page, unsigned bin)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    pa_fixed_page_info_t *pip = &pfrp->pfr_info[page];
+
+    if (pip->pfpi_prev == PA_FIXED_NO_PAGE)
+	pfrp->pfr_bins[bin] = pip->pfpi_next;
+    else
+	pfrp->pfr_info[pip->pfpi_prev].pfpi_next = pip->pfpi_next;
+
+    if (pip->pfpi_next != PA_FIXED_NO_PAGE)
+	pfrp->pfr_info[pip->pfpi_next].pfpi_prev = pip->pfpi_prev;
+}
+
+static void
+pa_fixed_reclaim_link (pa_fixed_t *pfp, pa_page_t page, unsigned bin)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    pa_fixed_page_info_t *pip = &pfrp->pfr_info[page];
+
+    pip->pfpi_prev = PA_FIXED_NO_PAGE;
+    pip->pfpi_next = pfrp->pfr_bins[bin];
+    if (pip->pfpi_next != PA_FIXED_NO_PAGE)
+	pfrp->pfr_info[pip->pfpi_next].pfpi_prev = page;
+    pfrp->pfr_bins[bin] = page;
+}
+
+/*
+ * A page's live count went from "old" to its current value; move it
+ * to the right bin.  Full pages live on no bin.
+ */
+static void
+pa_fixed_reclaim_rebin (pa_fixed_t *pfp, pa_page_t page, uint32_t old)
+{
+    uint32_t live = pfp->pf_reclaim->pfr_info[page].pfpi_live;
+    uint32_t full = 1U << pfp->pf_shift;
+    unsigned old_bin = pa_fixed_reclaim_bin(pfp, old);
+    unsigned new_bin = pa_fixed_reclaim_bin(pfp, live);
+
+    psu_boolean_t was_binned = (old != 0 && old < full);
+    psu_boolean_t is_binned = (live != 0 && live < full);
+
+    if (was_binned && (!is_binned || new_bin != old_bin))
+	pa_fixed_reclaim_unlink(pfp, page, old_bin);
+
+    if (is_binned && (!was_binned || new_bin != old_bin))
+	pa_fixed_reclaim_link(pfp, page, new_bin);
+}
+
+/*
+ * Give an empty page back to pa_mmap
+ */
+static void
+pa_fixed_reclaim_release (pa_fixed_t *pfp, pa_page_t page)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    size_t size = (size_t) pfp->pf_atom_size << pfp->pf_shift;
+
+    pa_mmap_free(pfp->pf_mmap, pfp->pf_base[page], size);
+    pa_fixed_page_set(pfp, page, pa_mmap_null_atom(), NULL);
+
+    pfrp->pfr_info[page].pfpi_free = pa_fixed_null_atom();
+    pfrp->pfr_pages -= 1;
+    pfrp->pfr_released += 1;
+    if (page < pfrp->pfr_hint)
+	pfrp->pfr_hint = page;
+}
+
+/*
+ * Allocate the lowest unallocated page, with its own free chain
+ */
+static pa_page_t
+pa_fixed_reclaim_new_page (pa_fixed_t *pfp)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    pa_page_t page, max_page = pfp->pf_max_atoms >> pfp->pf_shift;
+    pa_atom_t i, count = 1U << pfp->pf_shift;
+    size_t size = count * pfp->pf_atom_size;
+
+    for (page = pfrp->pfr_hint; page < max_page; page++)
+	if (pa_mmap_is_null(pfp->pf_base[page]))
+	    break;
+
+    pfrp->pfr_hint = page;
+    if (page >= max_page)
+	return PA_FIXED_NO_PAGE;
+
+    pa_mmap_atom_t matom = pa_mmap_alloc(pfp->pf_mmap, size);
+    pa_fixed_atom_t *addr = pa_mmap_addr(pfp->pf_mmap, matom);
+    if (addr == NULL) {
+	pa_alloc_failed(__FUNCTION__);
+	return PA_FIXED_NO_PAGE;
+    }
+
+    unsigned mult = pfp->pf_atom_size / sizeof(addr[0]);
+    pa_atom_t first = (pa_atom_t) page << pfp->pf_shift;
+    for (i = 0; i < count - 1; i++)
+	addr[i * mult].pfa_atom = first + i + 1;
+    addr[(count - 1) * mult] = pa_fixed_null_atom();
+
+    pa_fixed_page_set(pfp, page, matom, addr);
+
+    /* Atom zero is PA_NULL_ATOM, which is never handed out */
+    pa_fixed_page_info_t *pip = &pfrp->pfr_info[page];
+    pip->pfpi_live = (page == 0) ? 1 : 0;
+    pip->pfpi_free = pa_fixed_atom((page == 0) ? 1 : first);
+    if (pip->pfpi_live)
+	pa_fixed_reclaim_link(pfp, page, pa_fixed_reclaim_bin(pfp, 1));
+
+    pfrp->pfr_pages += 1;
+    pfrp->pfr_hint = page + 1;
+
+    return page;
+}
+
+/*
+ * Allocate an atom from the fullest partly used page, so atoms
+ * cluster.  In thread-safe mode, the caller must hold pf_lock.
+ */
+pa_fixed_atom_t
+pa_fixed_reclaim_alloc (pa_fixed_t *pfp)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    pa_page_t page = PA_FIXED_NO_PAGE;
+    int bin;
+
+    for (bin = PA_FIXED_RECLAIM_BINS - 1; bin >= 0; bin--) {
+	page = pfrp->pfr_bins[bin];
+	if (page != PA_FIXED_NO_PAGE)
+	    break;
+    }
+
+    /* No partly used pages; start a new one (or we're full) */
+    if (page == PA_FIXED_NO_PAGE) {
+	page = pa_fixed_reclaim_new_page(pfp);
+	if (page == PA_FIXED_NO_PAGE)
+	    return pa_fixed_null_atom();
+    }
+
+    pa_fixed_page_info_t *pip = &pfrp->pfr_info[page];
+    pa_fixed_atom_t atom = pip->pfpi_free;
+    pa_fixed_atom_t *addr = pa_fixed_atom_addr(pfp, atom);
+    if (addr == NULL) {
+	pa_alloc_failed(__FUNCTION__);
+	return pa_fixed_null_atom();
+    }
+
+    pip->pfpi_free = *addr;
+    pip->pfpi_live += 1;
+    pa_fixed_reclaim_rebin(pfp, page, pip->pfpi_live - 1);
+
+    return atom;
+}
+
+/*
+ * Put an atom on its page's free chain, giving back the page when
+ * it's empty.  In thread-safe mode, the caller must hold pf_lock.
+ */
+void
+pa_fixed_reclaim_free (pa_fixed_t *pfp, pa_fixed_atom_t atom)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    pa_page_t page = pa_fixed_atom_of(atom) >> pfp->pf_shift;
+    pa_fixed_atom_t *addr = pa_fixed_atom_addr(pfp, atom);
+    if (addr == NULL)
+	return;
+
+    pa_fixed_page_info_t *pip = &pfrp->pfr_info[page];
+    *addr = pip->pfpi_free;
+    pip->pfpi_free = atom;
+    pip->pfpi_live -= 1;
+    pa_fixed_reclaim_rebin(pfp, page, pip->pfpi_live + 1);
+
+    if (pip->pfpi_live == 0)
+	pa_fixed_reclaim_release(pfp, page);
+}
+
+/*
+ * Take up to "count" atoms off the free chain, keeping the address of
+ * the current page rather than looking it up for each atom.  The
+ * caller holds pf_lock (if any).
+ */
+static unsigned
+pa_fixed_alloc_batch_unlocked (pa_fixed_t *pfp, pa_fixed_atom_t *atoms,
+			       unsigned count)
+{
+    pa_fixed_atom_t atom = pfp->pf_free;
+    pa_page_t page, cur_page = PA_FIXED_NO_PAGE;
+    pa_atom_t mask = (1U << pfp->pf_shift) - 1;
+    uint8_t *base = NULL;
+    unsigned n;
+
+    if (pfp->pf_reclaim) {
+	for (n = 0; n < count; n++) {
+	    atoms[n] = pa_fixed_reclaim_alloc(pfp);
+	    if (pa_fixed_is_null(atoms[n]))
+		break;
+	}
+
+	return n;
+    }
+
+    for (n = 0; n < count; n++) {
+	if (pa_fixed_is_null(atom) || atom.pfa_atom >= pfp->pf_max_atoms)
+	    break;
+
+	page = atom.pfa_atom >> pfp->pf_shift;
+	if (page != cur_page) {
+	    base = pa_fixed_page_get(pfp, page);
+	    if (base == NULL) {
+		/* A fresh page (see pa_fixed_alloc_atom_unlocked) */
+		pa_fixed_alloc_setup_page(pfp, atom);
+		base = pa_fixed_page_get(pfp, page);
+		if (base == NULL) {
+		    pa_alloc_failed(__FUNCTION__);
+		    break;
+		}
+	    }
+	    cur_page = page;
+	}
+
+	atoms[n] = atom;
+	atom = *(pa_fixed_atom_t *) &base[(atom.pfa_atom & mask)
+					  * pfp->pf_atom_size];
+    }
+
+    pfp->pf_free = atom;
+    return n;
+}
+
+/*
+ * Allocate "count" atoms, filling in "atoms", under one lock.  Atoms
+ * come off the free chain in order, so on fresh pages they are
+ * adjacent.  (They bypass the per-thread magazines.)  Returns the
+ * number allocated, which is short only when we run out.
+ */
+unsigned
+pa_fixed_alloc_atoms (pa_fixed_t *pfp, pa_fixed_atom_t *atoms, unsigned count)
+{
+    unsigned i, n;
+
+    if (pfp->pf_base == NULL)
+	return 0;
+
+    pa_lock(pfp->pf_lock);
+    n = pa_fixed_alloc_batch_unlocked(pfp, atoms, count);
+    pa_unlock(pfp->pf_lock);
+
+    if (pfp->pf_flags & PFF_INIT_ZERO) {
+	for (i = 0; i < n; i++)
+	    bzero(pa_fixed_atom_addr(pfp, atoms[i]), pfp->pf_atom_size);
+    }
+
+    return n;
+}
+
+/*
+ * Reserve "count" adjacent atoms (on one page), returning the first.
+ * This works when the free chain starts with such a run, as it does
+ * for fresh pages; otherwise we return PA_NULL_ATOM and the caller
+ * should fall back to pa_fixed_alloc_atoms().
+ */
+pa_fixed_atom_t
+pa_fixed_alloc_run (pa_fixed_t *pfp, unsigned count)
+{
+    pa_fixed_atom_t first = pa_fixed_null_atom(), atom, *addr;
+    pa_atom_t mask = (1U << pfp->pf_shift) - 1;
+    unsigned i;
+
+    if (pfp->pf_base == NULL || pfp->pf_reclaim || count == 0)
+	return first;
+
+    pa_lock(pfp->pf_lock);
+
+    atom = pfp->pf_free;
+    if (pa_fixed_is_null(atom)
+	    || (atom.pfa_atom & mask) + count - 1 > mask)
+	goto done;
+
+    /* Fault in a fresh page, like any allocation would */
+    if (pa_fixed_atom_addr(pfp, atom) == NULL)
+	pa_fixed_alloc_setup_page(pfp, atom);
+
+    for (i = 0; i < count; i++) {
+	addr = pa_fixed_atom_addr(pfp, pa_fixed_atom(atom.pfa_atom + i));
+	if (addr == NULL)
+	    goto done;
+
+	/* Each atom must be the next one's predecessor on the chain */
+	if (i + 1 < count && addr->pfa_atom != atom.pfa_atom + i + 1)
+	    goto done;
+    }
+
+    first = atom;
+    pfp->pf_free = *addr;
+
+ done:
+    pa_unlock(pfp->pf_lock);
+
+    if (!pa_fixed_is_null(first) && (pfp->pf_flags & PFF_INIT_ZERO))
+	bzero(pa_fixed_atom_addr(pfp, first),
+	      (size_t) count * pfp->pf_atom_size);
+
+    return first;
+}
+
+/*
+ * Free a set of atoms under one lock
+ */
+void
+pa_fixed_free_atoms (pa_fixed_t *pfp, const pa_fixed_atom_t *atoms,
+		     unsigned count)
+{
+    unsigned i;
+
+    pa_lock(pfp->pf_lock);
+    for (i = 0; i < count; i++)
+	pa_fixed_free_atom_unlocked(pfp, atoms[i]);
+    pa_unlock(pfp->pf_lock);
+}
+
+/*
+ * Thread-safe allocation: take an atom from our magazine, filling
+ * it half way from the central free list when it's empty.
+ */
+pa_fixed_atom_t
+pa_fixed_alloc_atom_mt (pa_fixed_t *pfp)
+{
+    pa_magazine_t *mag = pfp->pf_depot ? pa_depot_magazines(pfp->pf_depot)
+	: NULL;
+    pa_fixed_atom_t atom;
+
+    if (mag == NULL) {
+	pa_lock(pfp->pf_lock);
+	atom = pa_fixed_alloc_atom_unlocked(pfp);
+	pa_unlock(pfp->pf_lock);
+	return atom;
+    }
+
+    if (mag->pmg_count == 0) {
+	pa_lock(pfp->pf_lock);
+	while (mag->pmg_count < PA_MAGAZINE_SIZE / 2) {
+	    atom = pa_fixed_alloc_atom_unlocked(pfp);
+	    if (pa_fixed_is_null(atom))
+		break;
+	    mag->pmg_atoms[mag->pmg_count++] = pa_fixed_atom_of(atom);
+	}
+	pa_unlock(pfp->pf_lock);
+
+	if (mag->pmg_count == 0)
+	    return pa_fixed_null_atom();
+    }
+
+    return pa_fixed_atom(mag->pmg_atoms[--mag->pmg_count]);
+}
+
+/*
+ * Return atoms from a magazine to the central free list, until
+ * only 'keep' remain.  The caller must hold pf_lock.
+ */
+static void
+pa_fixed_magazine_drain (pa_fixed_t *pfp, pa_magazine_t *mag, uint32_t keep)
+{
+    while (mag->pmg_count > keep)
+	pa_fixed_free_atom_unlocked(pfp,
+			pa_fixed_atom(mag->pmg_atoms[--mag->pmg_count]));
+}
+
+/*
+ * Thread-safe free: put the atom in our magazine, emptying it
+ * half way to the central free list when it's full.
+ */
+void
+pa_fixed_free_atom_mt (pa_fixed_t *pfp, pa_fixed_atom_t atom)
+{
+    pa_magazine_t *mag = pfp->pf_depot ? pa_depot_magazines(pfp->pf_depot)
+	: NULL;
+
+    if (pa_fixed_is_null(atom))
+	return;
+
+    if (mag == NULL) {
+	pa_lock(pfp->pf_lock);
+	pa_fixed_free_atom_unlocked(pfp, atom);
+	pa_unlock(pfp->pf_lock);
+	return;
+    }
+
+    if (mag->pmg_count >= PA_MAGAZINE_SIZE) {
+	pa_lock(pfp->pf_lock);
+	pa_fixed_magazine_drain(pfp, mag, PA_MAGAZINE_SIZE / 2);
+	pa_unlock(pfp->pf_lock);
+    }
+
+    mag->pmg_atoms[mag->pmg_count++] = pa_fixed_atom_of(atom);
+}
+
+/*
+ * Return the calling thread's cached atoms to the central free list
+ */
+void
+pa_fixed_flush (pa_fixed_t *pfp)
+{
+    if (pfp->pf_depot == NULL)
+	return;
+
+    pa_magazine_t *mag = pa_depot_magazines(pfp->pf_depot);
+    if (mag == NULL || mag->pmg_count == 0)
+	return;
+
+    pa_lock(pfp->pf_lock);
+    pa_fixed_magazine_drain(pfp, mag, 0);
+    pa_unlock(pfp->pf_lock);
 }
 
 /*
@@ -101,12 +536,12 @@ pa_fixed_init_from_block (pa_fixed_t *pfp, void *base,
 
 void
 pa_fixed_init (pa_mmap_t *pmp, pa_fixed_t *pfp, const char *name,
-	       pa_shift_t shift, uint16_t atom_size, uint32_t max_atoms)
+	       pa_shift_t shift, uint16_t atom_size, pa_atom_t max_atoms)
 {
     /* Overload the value with config values */
     shift = pa_config_value32(name, "shift", shift);
     atom_size = pa_config_value32_min(name, "atom-size", atom_size);
-    max_atoms = pa_config_value32(name, "max-atoms", max_atoms);
+    max_atoms = pa_config_value_atom(name, "max-atoms", max_atoms);
 
     /* The atom must be able to hold a free node id */
     if (atom_size < sizeof(pa_atom_t))
@@ -116,7 +551,11 @@ pa_fixed_init (pa_mmap_t *pmp, pa_fixed_t *pfp, const char *name,
     atom_size = pa_roundup32(atom_size, sizeof(pa_atom_t));
 
     /* Round max_atoms up to the next page size */
-    max_atoms = pa_roundup_shift32(max_atoms, shift);
+    max_atoms = pa_roundup_shift_atom(max_atoms, shift);
+
+    /* If the map already has our page table, use it */
+    if (pfp->pf_base == NULL && !pa_mmap_is_null(pfp->pf_infop->pfi_base))
+	pfp->pf_base = pa_mmap_addr(pmp, pfp->pf_infop->pfi_base);
 
     /* No base is NULL, allocate it, zero it and init the free list */
     if (pfp->pf_base == NULL) {
@@ -135,18 +574,31 @@ pa_fixed_init (pa_mmap_t *pmp, pa_fixed_t *pfp, const char *name,
 
 	/* Mark number 1 as our first free atom */
 	pfp->pf_free = pa_fixed_atom(1);
+
+	/*
+	 * Fill in the rest of fhe fields from the argument list.  An
+	 * existing array keeps the values it was built with (and may
+	 * be read-only).
+	 */
+	pfp->pf_shift = shift;
+	pfp->pf_atom_size = atom_size;
+	pfp->pf_max_atoms = max_atoms;
     }
 
-    /* Fill in the rest of fhe fields from the argument list */
-    pfp->pf_shift = shift;
-    pfp->pf_atom_size = atom_size;
-    pfp->pf_max_atoms = max_atoms;
     pfp->pf_mmap = pmp;
+
+    if ((pfp->pf_flags & PFF_RECLAIM) && pfp->pf_reclaim == NULL)
+	pfp->pf_reclaim = pa_mmap_addr(pmp, pfp->pf_infop->pfi_reclaim);
+
+    if ((pmp->pm_flags & PMF_THREAD_SAFE) && pfp->pf_lock == NULL) {
+	pfp->pf_lock = pa_lock_create();
+	pfp->pf_depot = pa_depot_create(1);
+    }
 }
 
 pa_fixed_t *
 pa_fixed_setup (pa_mmap_t *pmp, pa_fixed_info_t *pfip, const char *name,
-		pa_shift_t shift, uint16_t atom_size, uint32_t max_atoms)
+		pa_shift_t shift, uint16_t atom_size, pa_atom_t max_atoms)
 {
     pa_fixed_t *pfp = psu_calloc(sizeof(*pfp));
 
@@ -160,7 +612,7 @@ pa_fixed_setup (pa_mmap_t *pmp, pa_fixed_info_t *pfip, const char *name,
 
 pa_fixed_t *
 pa_fixed_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
-		 uint16_t atom_size, uint32_t max_atoms)
+		 uint16_t atom_size, pa_atom_t max_atoms)
 {
     pa_fixed_info_t *pfip = NULL;
 
@@ -175,8 +627,116 @@ pa_fixed_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
     return pa_fixed_setup(pmp, pfip, name, shift, atom_size, max_atoms);
 }
 
+int
+pa_fixed_reclaim_enable (pa_fixed_t *pfp)
+{
+    pa_fixed_reclaim_t *pfrp;
+    pa_fixed_atom_t free_atom, *addr;
+    pa_page_t page, max_page;
+    pa_atom_t atom, steps;
+    unsigned bin;
+    size_t size;
+    int i;
+
+    if (pfp->pf_reclaim)
+	return 0;
+
+    if (pfp->pf_base == NULL)
+	return -1;
+
+    max_page = pfp->pf_max_atoms >> pfp->pf_shift;
+    size = sizeof(*pfrp) + max_page * sizeof(pfrp->pfr_info[0]);
+
+    pa_mmap_atom_t matom = pa_mmap_alloc(pfp->pf_mmap, size);
+    pfrp = pa_mmap_addr(pfp->pf_mmap, matom);
+    if (pfrp == NULL) {
+	pa_warning(0, "pa_fixed: could not allocate page accounting");
+	return -1;
+    }
+
+    pa_lock(pfp->pf_lock);
+
+    /* Atoms in magazines go back on the chain, so we can sort them */
+    if (pfp->pf_depot) {
+	for (i = 0; i < PA_THREAD_MAX; i++)
+	    if (pfp->pf_depot->pd_mags[i])
+		pa_fixed_magazine_drain(pfp, pfp->pf_depot->pd_mags[i], 0);
+    }
+
+    bzero(pfrp, size);
+    for (bin = 0; bin < PA_FIXED_RECLAIM_BINS; bin++)
+	pfrp->pfr_bins[bin] = PA_FIXED_NO_PAGE;
+    pfrp->pfr_hint = max_page;
+
+    /* Every atom on an allocated page is live until we learn otherwise */
+    for (page = 0; page < max_page; page++) {
+	if (pa_mmap_is_null(pfp->pf_base[page])) {
+	    if (page < pfrp->pfr_hint)
+		pfrp->pfr_hint = page;
+	    continue;
+	}
+
+	pfrp->pfr_info[page].pfpi_live = 1U << pfp->pf_shift;
+	pfrp->pfr_pages += 1;
+    }
+
+    /*
+     * Move each atom on the chain to its page's chain.  The chain
+     * ends (or runs into pages we've never allocated); we stop at a
+     * loop, in case the table is damaged.
+     */
+    free_atom = pfp->pf_free;
+    for (steps = 0; !pa_fixed_is_null(free_atom)
+	     && steps < pfp->pf_max_atoms; steps++) {
+	atom = pa_fixed_atom_of(free_atom);
+	addr = pa_fixed_atom_addr(pfp, free_atom);
+	if (addr == NULL)
+	    break;
+
+	page = atom >> pfp->pf_shift;
+	if (pfrp->pfr_info[page].pfpi_live == 0)
+	    break;
+
+	pa_fixed_atom_t next = *addr;
+	*addr = pfrp->pfr_info[page].pfpi_free;
+	pfrp->pfr_info[page].pfpi_free = free_atom;
+	pfrp->pfr_info[page].pfpi_live -= 1;
+	free_atom = next;
+    }
+
+    /* From here on, the union holds our accounting, not the chain */
+    pfp->pf_infop->pfi_reclaim = matom;
+    pfp->pf_flags |= PFF_RECLAIM;
+    pfp->pf_reclaim = pfrp;
+
+    for (page = 0; page < max_page; page++) {
+	if (pa_mmap_is_null(pfp->pf_base[page]))
+	    continue;
+
+	uint32_t live = pfrp->pfr_info[page].pfpi_live;
+	if (live == 0)
+	    pa_fixed_reclaim_release(pfp, page);
+	else if (live < (1U << pfp->pf_shift))
+	    pa_fixed_reclaim_link(pfp, page, pa_fixed_reclaim_bin(pfp, live));
+    }
+
+    pa_unlock(pfp->pf_lock);
+    return 0;
+}
+
 void
 pa_fixed_close (pa_fixed_t *pfp)
 {
+    /* Give back any atoms still sitting in magazines */
+    if (pfp->pf_depot) {
+	int i;
+	for (i = 0; i < PA_THREAD_MAX; i++)
+	    if (pfp->pf_depot->pd_mags[i])
+		pa_fixed_magazine_drain(pfp, pfp->pf_depot->pd_mags[i], 0);
+
+	pa_depot_destroy(pfp->pf_depot);
+    }
+
+    pa_lock_destroy(pfp->pf_lock);
     psu_free(pfp);
 }
@@ -40,6 +40,16 @@
  * "atoms", we need to keep our thinking clear in terms of whose atoms
  * are whose.  Our "pages" are their "atoms".  We then divide each
  * page into our fixed-sized atoms.
+ *
+ * Normally free atoms sit on a single chain, so pages are never given
+ * back: after a peak, the pages stay allocated (and resident) forever.
+ * pa_fixed_reclaim_enable() switches a table to per-page accounting
+ * (PFF_RECLAIM): each page keeps its own free chain and a count of
+ * live atoms, and a page whose atoms are all freed goes back to
+ * pa_mmap.  Partly used pages are binned by how full they are, and we
+ * allocate from the fullest, so live atoms cluster and sparse pages
+ * drain.  This doesn't mix with pa_fixed_element(), whose pages
+ * aren't allocated atom by atom.
  */
 
 /* Declare our wrapper type */
@@ -54,17 +64,50 @@ typedef struct pa_fixed_info_s {
     pa_fixed_flags_t pfi_flags;	/* Flags (in the padding) */
     uint16_t pfi_atom_size;	/* Size of each atom */
     pa_atom_t pfi_max_atoms;	/* Max number of atoms */
-    pa_fixed_atom_t pfi_free;	/* First atom that is free */
+    union {
+	pa_fixed_atom_t pfiu_free; /* First atom that is free */
+	pa_mmap_atom_t pfiu_reclaim; /* Page accounting (PFF_RECLAIM) */
+    } pfi_u;
     pa_mmap_atom_t pfi_base; 	/* Offset of page table base (in mmap atoms) */
 } pa_fixed_info_t;
 
+#define pfi_free	pfi_u.pfiu_free
+#define pfi_reclaim	pfi_u.pfiu_reclaim
+
 /* Flags for pfi_flags: */
 #define PFF_INIT_ZERO	(1<<0)	/* Initialize memory to zeroes */
+#define PFF_RECLAIM	(1<<1)	/* Per-page free chains; give back empty pages */
+
+/*
+ * Per-page accounting for PFF_RECLAIM.  Partly used pages are kept
+ * on doubly-linked lists ("bins"), by how full they are; full pages
+ * are on no list, and empty ones are given back.
+ */
+#define PA_FIXED_RECLAIM_BINS	8 /* Number of bins (by eighths) */
+#define PA_FIXED_NO_PAGE	((pa_page_t) -1) /* End of a bin's list */
+
+typedef struct pa_fixed_page_info_s {
+    uint32_t pfpi_live;		/* Number of atoms in use */
+    pa_page_t pfpi_next;	/* Next page in our bin */
+    pa_page_t pfpi_prev;	/* Previous page in our bin */
+    pa_fixed_atom_t pfpi_free;	/* First free atom on this page */
+} pa_fixed_page_info_t;
+
+typedef struct pa_fixed_reclaim_s {
+    pa_page_t pfr_bins[PA_FIXED_RECLAIM_BINS]; /* Partly used pages */
+    pa_page_t pfr_hint;		/* No unallocated page below this one */
+    uint32_t pfr_pages;		/* Number of pages allocated */
+    uint32_t pfr_released;	/* Number of pages given back (ever) */
+    pa_fixed_page_info_t pfr_info[]; /* One per page */
+} pa_fixed_reclaim_t;
 
 typedef struct pa_fixed_s {
     pa_mmap_t *pf_mmap;		   /* Mmap overhead declarations */
     pa_fixed_info_t *pf_infop;	   /* Pointer to real block */
     pa_mmap_atom_t *pf_base;	   /* Pointer to base of page table */
+    struct pa_lock_s *pf_lock;	   /* Lock (for PMF_THREAD_SAFE) */
+    struct pa_depot_s *pf_depot;   /* Per-thread magazines (ditto) */
+    pa_fixed_reclaim_t *pf_reclaim; /* Page accounting (PFF_RECLAIM) */
 } pa_fixed_t;
 
 /* Simplification macros, so we don't need to think about pf_infop */
@@ -108,7 +151,7 @@ pa_fixed_page_set (pa_fixed_t *pfp, pa_page_t page,
  */
 static inline void *
 pa_fixed_atom_addr_direct (pa_fixed_t *pfp, uint8_t shift, uint16_t atom_size,
-			   uint32_t max_atoms, pa_fixed_atom_t atom)
+			   pa_atom_t max_atoms, pa_fixed_atom_t atom)
 {
     uint8_t *addr;
     if (pa_fixed_is_null(atom) || atom.pfa_atom >= max_atoms)
@@ -145,15 +188,25 @@ pa_fixed_alloc_setup_page (pa_fixed_t *pfp, pa_fixed_atom_t atom);
 void
 pa_fixed_element_setup_page (pa_fixed_t *pfp, pa_fixed_atom_t atom);
 
+pa_fixed_atom_t
+pa_fixed_reclaim_alloc (pa_fixed_t *pfp);
+
+void
+pa_fixed_reclaim_free (pa_fixed_t *pfp, pa_fixed_atom_t atom);
+
 /*
- * Allocate a new atom, returning the atom number
+ * Allocate a new atom from the free list, returning the atom number.
+ * In thread-safe mode, the caller must hold pf_lock.
  */
 static inline pa_fixed_atom_t
-pa_fixed_alloc_atom (pa_fixed_t *pfp)
+pa_fixed_alloc_atom_unlocked (pa_fixed_t *pfp)
 {
     if (pfp->pf_base == NULL)
 	return pa_fixed_null_atom();
 
+    if (pfp->pf_reclaim)
+	return pa_fixed_reclaim_alloc(pfp);
+
     /* free == PA_NULL_ATOM -> nothing available */
     pa_fixed_atom_t atom = pfp->pf_free;
     if (pa_fixed_is_null(atom))
@@ -185,9 +238,43 @@ pa_fixed_alloc_atom (pa_fixed_t *pfp)
     /* Fetch the next free atom, which is stored at the start of this atom */
     pfp->pf_free = *(pa_fixed_atom_t *) addr;
 
+    return atom;
+}
+
+pa_fixed_atom_t
+pa_fixed_alloc_atom_mt (pa_fixed_t *pfp);
+
+/*
+ * Batch allocation, for hot producers: pa_fixed_alloc_atoms() fills
+ * an array of atoms, and pa_fixed_alloc_run() reserves a run of
+ * adjacent atoms (if the free chain starts with one).  Both take the
+ * lock once, and zero what they return under PFF_INIT_ZERO.
+ */
+unsigned
+pa_fixed_alloc_atoms (pa_fixed_t *pfp, pa_fixed_atom_t *atoms, unsigned count);
+
+pa_fixed_atom_t
+pa_fixed_alloc_run (pa_fixed_t *pfp, unsigned count);
+
+/*
+ * Allocate a new atom, returning the atom number
+ */
+static inline pa_fixed_atom_t
+pa_fixed_alloc_atom (pa_fixed_t *pfp)
+{
+    pa_fixed_atom_t atom;
+
+    if (pfp->pf_lock)
+	atom = pa_fixed_alloc_atom_mt(pfp);
+    else
+	atom = pa_fixed_alloc_atom_unlocked(pfp);
+
     /* If needed, initialize the new memory to zero */
-    if (pfp->pf_flags & PFF_INIT_ZERO)
-	bzero(addr, pfp->pf_atom_size);
+    if ((pfp->pf_flags & PFF_INIT_ZERO) && !pa_fixed_is_null(atom)) {
+	void *addr = pa_fixed_atom_addr(pfp, atom);
+	if (addr)
+	    bzero(addr, pfp->pf_atom_size);
+    }
 
     return atom;
 }
@@ -232,14 +319,20 @@ pa_fixed_element_if_exists (pa_fixed_t *pfp, uint32_t num)
 }
 
 /*
- * Put a fixed atom on our free list
+ * Put a fixed atom on our free list.  In thread-safe mode, the
+ * caller must hold pf_lock.
  */
 static inline void
-pa_fixed_free_atom (pa_fixed_t *pfp, pa_fixed_atom_t atom)
+pa_fixed_free_atom_unlocked (pa_fixed_t *pfp, pa_fixed_atom_t atom)
 {
     if (pa_fixed_is_null(atom))
 	return;
 
+    if (pfp->pf_reclaim) {
+	pa_fixed_reclaim_free(pfp, atom);
+	return;
+    }
+
     /* The free list is a single-linked list of atoms */
     pa_fixed_atom_t *addr = pa_fixed_atom_addr(pfp, atom);
     if (addr == NULL)
@@ -250,25 +343,69 @@ pa_fixed_free_atom (pa_fixed_t *pfp, pa_fixed_atom_t atom)
     pfp->pf_free = atom;
 }
 
+void
+pa_fixed_free_atom_mt (pa_fixed_t *pfp, pa_fixed_atom_t atom);
+
+void
+pa_fixed_free_atoms (pa_fixed_t *pfp, const pa_fixed_atom_t *atoms,
+		     unsigned count);
+
+/*
+ * Put a fixed atom on our free list
+ */
+static inline void
+pa_fixed_free_atom (pa_fixed_t *pfp, pa_fixed_atom_t atom)
+{
+    if (pfp->pf_lock)
+	pa_fixed_free_atom_mt(pfp, atom);
+    else
+	pa_fixed_free_atom_unlocked(pfp, atom);
+}
+
+void
+pa_fixed_flush (pa_fixed_t *pfp);
+
 void
 pa_fixed_init_from_block (pa_fixed_t *pfp, void *base,
 			  pa_fixed_info_t *infop);
 
 void
 pa_fixed_init (pa_mmap_t *pmp, pa_fixed_t *pfp, const char *name,
-	       pa_shift_t shift, uint16_t atom_size, uint32_t max_atoms);
+	       pa_shift_t shift, uint16_t atom_size, pa_atom_t max_atoms);
 
 pa_fixed_t *
 pa_fixed_setup (pa_mmap_t *pmp, pa_fixed_info_t *pfip, const char *name,
-		pa_shift_t shift, uint16_t atom_size, uint32_t max_atoms);
+		pa_shift_t shift, uint16_t atom_size, pa_atom_t max_atoms);
 
 pa_fixed_t *
 pa_fixed_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
-	       uint16_t atom_size, uint32_t max_atoms);
+	       uint16_t atom_size, pa_atom_t max_atoms);
 
 void
 pa_fixed_close (pa_fixed_t *pfp);
 
+/**
+ * @brief
+ * Switches a table to per-page accounting (PFF_RECLAIM), so pages
+ * whose atoms are all freed are given back to pa_mmap.  An existing
+ * table is converted: its free chain is sorted out by page, and any
+ * empty pages are given back now.  There's no way back.
+ *
+ * @return
+ *     0 on success, or -1 if we can't allocate the accounting
+ */
+int
+pa_fixed_reclaim_enable (pa_fixed_t *pfp);
+
+/*
+ * Number of pages in use, which only PFF_RECLAIM tables know
+ */
+static inline uint32_t
+pa_fixed_pages_in_use (pa_fixed_t *pfp)
+{
+    return pfp->pf_reclaim ? pfp->pf_reclaim->pfr_pages : 0;
+}
+
 static inline void
 pa_fixed_set_flags (pa_fixed_t *pfp, pa_fixed_flags_t flags)
 {
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#include <sys/types.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/palog2.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/pahash.h>
+
+/*
+ * Split the next bucket in line.  The entries that have the next bit
+ * of their hash set move to a new bucket, 'size' buckets later.
+ */
+static void
+pa_hash_split (pa_hash_t *php)
+{
+    uint32_t size = 1U << (php->ph_shift + php->ph_level);
+    uint32_t old = php->ph_split, new = old + size;
+    pa_hash_entry_atom_t *oldp, *newp, atom, keep, move;
+    pa_hash_entry_t *entry;
+
+    /* Make sure we have room for the new bucket before we start */
+    if (new + 1 >= pa_fixed_max_atoms(php->ph_buckets))
+	return;
+
+    newp = pa_fixed_element(php->ph_buckets, new + 1);
+    oldp = pa_fixed_element(php->ph_buckets, old + 1);
+    if (newp == NULL || oldp == NULL)
+	return;
+
+    keep = move = pa_hash_entry_null_atom();
+
+    for (atom = *oldp; !pa_hash_entry_is_null(atom); ) {
+	entry = pa_hash_entry(php, atom);
+	if (entry == NULL)
+	    break;
+
+	pa_hash_entry_atom_t next = entry->phe_next;
+
+	if (entry->phe_hash & size) {
+	    entry->phe_next = move;
+	    move = atom;
+	} else {
+	    entry->phe_next = keep;
+	    keep = atom;
+	}
+
+	atom = next;
+    }
+
+    *oldp = keep;
+    *newp = move;
+
+    if (++php->ph_split == size) {
+	php->ph_level += 1;
+	php->ph_split = 0;
+    }
+}
+
+psu_boolean_t
+pa_hash_add (pa_hash_t *php, pa_hash_data_atom_t datom)
+{
+    const psu_byte_t *key;
+    size_t key_bytes = 0;
+
+    if (pa_hash_data_is_null(datom))
+	return FALSE;
+
+    key = php->ph_key_func(php, datom, &key_bytes);
+    if (key == NULL)
+	return FALSE;
+
+    if (!pa_hash_data_is_null(pa_hash_get(php, key_bytes, key)))
+	return FALSE;		/* Duplicate */
+
+    pa_fixed_atom_t fatom = pa_fixed_alloc_atom(php->ph_entries);
+    pa_hash_entry_atom_t atom = pa_hash_entry_atom(pa_fixed_atom_of(fatom));
+    pa_hash_entry_t *entry = pa_hash_entry(php, atom);
+    if (entry == NULL)
+	return FALSE;
+
+    uint32_t hash = pa_hash_key_hash(key, key_bytes);
+    uint32_t bucket = pa_hash_bucket(php, hash);
+    pa_hash_entry_atom_t *headp = pa_fixed_element(php->ph_buckets,
+						   bucket + 1);
+    if (headp == NULL) {
+	pa_fixed_free_atom(php->ph_entries, fatom);
+	return FALSE;
+    }
+
+    entry->phe_hash = hash;
+    entry->phe_data = datom;
+    entry->phe_next = *headp;
+    *headp = atom;
+
+    /* Grow by one bucket if we're over our load */
+    php->ph_count += 1;
+    if ((uint64_t) php->ph_count * 100
+	> (uint64_t) pa_hash_buckets(php) * php->ph_load)
+	pa_hash_split(php);
+
+    return TRUE;
+}
+
+pa_hash_data_atom_t
+pa_hash_delete (pa_hash_t *php, size_t key_bytes, const void *key)
+{
+    uint32_t hash = pa_hash_key_hash(key, key_bytes);
+    uint32_t bucket = pa_hash_bucket(php, hash);
+    pa_hash_entry_atom_t *prevp, atom;
+    pa_hash_entry_t *entry;
+    const psu_byte_t *dkey;
+    size_t len;
+
+    prevp = pa_fixed_element_if_exists(php->ph_buckets, bucket + 1);
+    if (prevp == NULL)
+	return pa_hash_data_null_atom();
+
+    for (atom = *prevp; !pa_hash_entry_is_null(atom); atom = *prevp) {
+	entry = pa_hash_entry(php, atom);
+	if (entry == NULL)
+	    break;
+
+	if (entry->phe_hash == hash) {
+	    len = 0;
+	    dkey = php->ph_key_func(php, entry->phe_data, &len);
+	    if (dkey && len == key_bytes && memcmp(dkey, key, len) == 0) {
+		pa_hash_data_atom_t datom = entry->phe_data;
+
+		*prevp = entry->phe_next;
+		pa_fixed_free_atom(php->ph_entries,
+			   pa_fixed_atom(pa_hash_entry_atom_of(atom)));
+		php->ph_count -= 1;
+		return datom;
+	    }
+	}
+
+	prevp = &entry->phe_next;
+    }
+
+    return pa_hash_data_null_atom();
+}
+
+pa_hash_data_atom_t
+pa_hash_cursor_next (pa_hash_t *php, pa_hash_cursor_t *phcp)
+{
+    uint32_t buckets = pa_hash_buckets(php);
+    pa_hash_entry_t *entry;
+
+    while (pa_hash_entry_is_null(phcp->phc_entry)) {
+	if (++phcp->phc_bucket >= buckets)
+	    return pa_hash_data_null_atom();
+
+	phcp->phc_entry = pa_hash_bucket_head(php, phcp->phc_bucket);
+    }
+
+    entry = pa_hash_entry(php, phcp->phc_entry);
+    if (entry == NULL)
+	return pa_hash_data_null_atom();
+
+    phcp->phc_entry = entry->phe_next;
+    return entry->phe_data;
+}
+
+const psu_byte_t *
+pa_hash_istr_key_func (pa_hash_t *php, pa_hash_data_atom_t datom,
+		       size_t *key_bytesp)
+{
+    /* Need to "convert" the data atom to an istr data */
+    pa_istr_atom_t atom = pa_istr_atom(pa_hash_data_atom_of(datom));
+    const char *key = pa_istr_atom_string(php->ph_data, atom);
+
+    *key_bytesp = key ? strlen(key) : 0;
+    return (const psu_byte_t *) key;
+}
+
+void
+pa_hash_init (pa_mmap_t *pmp, pa_hash_t *php, const char *name)
+{
+    php->ph_mmap = pmp;
+
+    /* An existing table keeps the values it was built with */
+    if (php->ph_shift != 0)
+	return;
+
+    uint32_t buckets = pa_config_value32(name, "buckets", PA_HASH_BUCKETS);
+    uint32_t load = pa_config_value32(name, "load", PA_HASH_LOAD);
+
+    php->ph_shift = (buckets > 1) ? pa_log2(buckets - 1) : 1;
+    php->ph_load = (load > 0 && load <= UINT16_MAX) ? load : PA_HASH_LOAD;
+    php->ph_level = 0;
+    php->ph_split = 0;
+    php->ph_count = 0;
+}
+
+pa_hash_t *
+pa_hash_setup (pa_mmap_t *pmp, pa_hash_info_t *phip, const char *name,
+	       void *data_store, pa_hash_key_func_t key_func,
+	       pa_shift_t shift, pa_atom_t max_atoms)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    pa_hash_t *php = psu_calloc(sizeof(*php));
+
+    if (php == NULL)
+	return NULL;
+
+    php->ph_infop = phip;
+    php->ph_data = data_store;
+    php->ph_key_func = key_func;
+
+    pa_hash_init(pmp, php, name);
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "buckets");
+    php->ph_buckets = pa_fixed_setup(pmp, &phip->phi_buckets, namebuf, shift,
+				     sizeof(pa_hash_entry_atom_t), max_atoms);
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "entries");
+    php->ph_entries = pa_fixed_setup(pmp, &phip->phi_entries, namebuf, shift,
+				     sizeof(pa_hash_entry_t), max_atoms);
+
+    if (php->ph_buckets == NULL || php->ph_entries == NULL) {
+	pa_hash_close(php);
+	return NULL;
+    }
+
+    /* New bucket pages must start out empty */
+    if (!pa_fixed_test_flags(php->ph_buckets, PFF_INIT_ZERO))
+	pa_fixed_set_flags(php->ph_buckets, PFF_INIT_ZERO);
+
+    return php;
+}
+
+pa_hash_t *
+pa_hash_open (pa_mmap_t *pmp, const char *name, void *data_store,
+	      pa_hash_key_func_t key_func, pa_shift_t shift,
+	      pa_atom_t max_atoms)
+{
+    pa_hash_info_t *phip = NULL;
+
+    phip = pa_mmap_header(pmp, name, PA_TYPE_HASH, 0, sizeof(*phip));
+    if (phip == NULL) {
+	pa_warning(0, "pa_hash header not found: %s", name);
+	return NULL;
+    }
+
+    return pa_hash_setup(pmp, phip, name, data_store, key_func,
+			 shift, max_atoms);
+}
+
+void
+pa_hash_close (pa_hash_t *php)
+{
+    if (php->ph_buckets)
+	pa_fixed_close(php->ph_buckets);
+    if (php->ph_entries)
+	pa_fixed_close(php->ph_entries);
+
+    psu_free(php);
+}
+
+void
+pa_hash_dump (pa_hash_t *php, psu_boolean_t full)
+{
+    pa_hash_info_t *phip = php->ph_infop;
+    uint32_t buckets = pa_hash_buckets(php);
+
+    psu_log("begin pa_hash dump of %p", phip);
+
+    psu_log("count %u, buckets %u (shift %u, level %u, split %u), load %u%%",
+	    phip->phi_count, buckets, phip->phi_shift, phip->phi_level,
+	    phip->phi_split, phip->phi_load);
+
+    if (full) {
+	uint32_t bucket, used = 0, longest = 0, len;
+	pa_hash_entry_atom_t atom;
+	pa_hash_entry_t *entry;
+
+	for (bucket = 0; bucket < buckets; bucket++) {
+	    len = 0;
+	    atom = pa_hash_bucket_head(php, bucket);
+	    for ( ; !pa_hash_entry_is_null(atom); atom = entry->phe_next) {
+		entry = pa_hash_entry(php, atom);
+		if (entry == NULL)
+		    break;
+		len += 1;
+	    }
+
+	    if (len)
+		used += 1;
+	    if (len > longest)
+		longest = len;
+	}
+
+	psu_log("buckets in use %u, longest chain %u", used, longest);
+    }
+
+    psu_log("end pa_hash dump of %p", phip);
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PAHASH_H
+#define PARROTDB_PAHASH_H
+
+/**
+ * @file pahash.h
+ * @brief Hash table APIs
+ *
+ * A pa_hash is an exact-match index over atoms in some other data
+ * store, in the style of pa_pat: the caller hands us data atoms and a
+ * key function that turns a data atom into its key.  Lookups cost one
+ * hash, one bucket and (usually) one key compare, instead of a walk
+ * down a tree.
+ *
+ * The table grows by linear hashing.  Rather than doubling the table
+ * and rehashing everything at once, each insert that pushes the load
+ * past "<name>.load" percent splits a single bucket, the next one in
+ * line, moving about half of its entries to a new bucket at the end
+ * of the table.  The work of growing is spread evenly over the
+ * inserts, so no caller ever waits for a full rehash.  Entries cache
+ * their hash, so a split never calls the key function.
+ *
+ * Buckets and entries live in pa_fixed arrays, so the whole table
+ * lives in the mmap segment.  Deleting doesn't shrink the table.
+ * Like pa_pat, a pa_hash does no locking of its own.
+ */
+
+/* Wrapper for our "hash entry" atom */
+PA_ATOM_TYPE(pa_hash_entry_atom_t, pa_hash_entry_atom_s, phea_atom,
+	     pa_hash_entry_is_null, pa_hash_entry_atom, pa_hash_entry_atom_of,
+	     pa_hash_entry_null_atom);
+
+/* Wrapper for our "data node" atom */
+PA_ATOM_TYPE(pa_hash_data_atom_t, pa_hash_data_atom_s, phda_atom,
+	     pa_hash_data_is_null, pa_hash_data_atom, pa_hash_data_atom_of,
+	     pa_hash_data_null_atom);
+
+typedef struct pa_hash_entry_s {
+    pa_hash_entry_atom_t phe_next; /* Next entry in this bucket */
+    uint32_t phe_hash;		/* Hash of our key */
+    pa_hash_data_atom_t phe_data; /* Atom in the data store */
+} pa_hash_entry_t;
+
+#define PA_HASH_BUCKETS		256 /* Default initial number of buckets */
+#define PA_HASH_LOAD		100 /* Default max load (entries per 100 buckets) */
+
+typedef struct pa_hash_info_s {
+    uint32_t phi_count;		/* Number of entries */
+    uint32_t phi_split;		/* Next bucket to split */
+    uint8_t phi_level;		/* Number of times the table has doubled */
+    uint8_t phi_shift;		/* Log2 of the initial number of buckets */
+    uint16_t phi_load;		/* Max load (entries per 100 buckets) */
+    pa_fixed_info_t phi_buckets; /* Bucket heads */
+    pa_fixed_info_t phi_entries; /* Entries */
+} pa_hash_info_t;
+
+struct pa_hash_s;		/* Forward declaration */
+typedef const psu_byte_t *(*pa_hash_key_func_t)(struct pa_hash_s *,
+						pa_hash_data_atom_t,
+						size_t *key_bytesp);
+
+typedef struct pa_hash_s {
+    pa_hash_info_t *ph_infop;	/* Pointer to info block */
+    pa_mmap_t *ph_mmap;		/* Underlaying mmap */
+    pa_fixed_t *ph_buckets;	/* Bucket heads, indexed by bucket + 1 */
+    pa_fixed_t *ph_entries;	/* Entries */
+    void *ph_data;		/* Opaque data store */
+    pa_hash_key_func_t ph_key_func; /* Find the key for a data atom */
+} pa_hash_t;
+
+/* Shorthand for fields */
+#define ph_count	ph_infop->phi_count
+#define ph_split	ph_infop->phi_split
+#define ph_level	ph_infop->phi_level
+#define ph_shift	ph_infop->phi_shift
+#define ph_load		ph_infop->phi_load
+
+/*
+ * A cursor for walking all the entries in a table
+ */
+typedef struct pa_hash_cursor_s {
+    uint32_t phc_bucket;	/* Current bucket */
+    pa_hash_entry_atom_t phc_entry; /* Next entry in that bucket */
+} pa_hash_cursor_t;
+
+static inline pa_hash_entry_t *
+pa_hash_entry (pa_hash_t *php, pa_hash_entry_atom_t atom)
+{
+    return pa_fixed_atom_addr(php->ph_entries,
+			      pa_fixed_atom(pa_hash_entry_atom_of(atom)));
+}
+
+/*
+ * Return the number of buckets in use
+ */
+static inline uint32_t
+pa_hash_buckets (pa_hash_t *php)
+{
+    return (1U << (php->ph_shift + php->ph_level)) + php->ph_split;
+}
+
+/*
+ * Turn a hash value into a bucket number.  Buckets before ph_split
+ * have already been split this round, so they use one more bit.
+ */
+static inline uint32_t
+pa_hash_bucket (pa_hash_t *php, uint32_t hash)
+{
+    uint32_t size = 1U << (php->ph_shift + php->ph_level);
+    uint32_t bucket = hash & (size - 1);
+
+    if (bucket < php->ph_split)
+	bucket = hash & ((size << 1) - 1);
+
+    return bucket;
+}
+
+/*
+ * Return the head of a bucket's chain.  A bucket whose page was
+ * never allocated is empty.
+ */
+static inline pa_hash_entry_atom_t
+pa_hash_bucket_head (pa_hash_t *php, uint32_t bucket)
+{
+    pa_hash_entry_atom_t *headp;
+
+    headp = pa_fixed_element_if_exists(php->ph_buckets, bucket + 1);
+    return headp ? *headp : pa_hash_entry_null_atom();
+}
+
+/*
+ * Return the hash of a key
+ */
+static inline uint32_t
+pa_hash_key_hash (const void *key, size_t key_bytes)
+{
+    return pa_hash_nstring(key, key_bytes);
+}
+
+/**
+ * @brief
+ * Looks up the data atom with the given key
+ *
+ * @param[in] php
+ *     Pointer to the hash table
+ * @param[in] key_bytes
+ *     Number of bytes in key
+ * @param[in] key
+ *     Pointer to key value
+ *
+ * @return
+ *     The data atom with the key, or a null atom if there's none
+ */
+static inline pa_hash_data_atom_t
+pa_hash_get (pa_hash_t *php, size_t key_bytes, const void *key)
+{
+    uint32_t hash = pa_hash_key_hash(key, key_bytes);
+    pa_hash_entry_atom_t atom;
+    pa_hash_entry_t *entry;
+    const psu_byte_t *dkey;
+    size_t len;
+
+    atom = pa_hash_bucket_head(php, pa_hash_bucket(php, hash));
+    for ( ; !pa_hash_entry_is_null(atom); atom = entry->phe_next) {
+	entry = pa_hash_entry(php, atom);
+	if (entry == NULL)
+	    break;
+
+	if (entry->phe_hash != hash)
+	    continue;
+
+	len = 0;
+	dkey = php->ph_key_func(php, entry->phe_data, &len);
+	if (dkey && len == key_bytes && memcmp(dkey, key, len) == 0)
+	    return entry->phe_data;
+    }
+
+    return pa_hash_data_null_atom();
+}
+
+/**
+ * @brief
+ * Adds a data atom to the table, under the key returned by the
+ * key function.
+ *
+ * @return
+ *     @c TRUE if the atom was added;
+ *     @c FALSE if its key is already in the table, or we're out of
+ *     memory.
+ */
+psu_boolean_t
+pa_hash_add (pa_hash_t *php, pa_hash_data_atom_t datom);
+
+/**
+ * @brief
+ * Removes the given key from the table
+ *
+ * @return
+ *     The data atom that was removed, or a null atom if the key
+ *     wasn't in the table.
+ */
+pa_hash_data_atom_t
+pa_hash_delete (pa_hash_t *php, size_t key_bytes, const void *key);
+
+static inline void
+pa_hash_cursor_init (pa_hash_t *php, pa_hash_cursor_t *phcp)
+{
+    phcp->phc_bucket = 0;
+    phcp->phc_entry = pa_hash_bucket_head(php, 0);
+}
+
+/**
+ * @brief
+ * Return the next data atom in the table, or a null atom when we've
+ * seen them all.  Entries come out in no particular order, and
+ * changing the table while walking it may skip or repeat entries.
+ */
+pa_hash_data_atom_t
+pa_hash_cursor_next (pa_hash_t *php, pa_hash_cursor_t *phcp);
+
+/*
+ * A key function for tables whose data store is a pa_istr_t
+ */
+const psu_byte_t *
+pa_hash_istr_key_func (pa_hash_t *php, pa_hash_data_atom_t datom,
+		       size_t *key_bytesp);
+
+void
+pa_hash_init (pa_mmap_t *pmp, pa_hash_t *php, const char *name);
+
+pa_hash_t *
+pa_hash_setup (pa_mmap_t *pmp, pa_hash_info_t *phip, const char *name,
+	       void *data_store, pa_hash_key_func_t key_func,
+	       pa_shift_t shift, pa_atom_t max_atoms);
+
+pa_hash_t *
+pa_hash_open (pa_mmap_t *pmp, const char *name, void *data_store,
+	      pa_hash_key_func_t key_func, pa_shift_t shift,
+	      pa_atom_t max_atoms);
+
+void
+pa_hash_close (pa_hash_t *php);
+
+void
+pa_hash_dump (pa_hash_t *php, psu_boolean_t full);
+
+#endif /* PARROTDB_PAHASH_H */
@@ -25,6 +25,7 @@
 #include <parrotdb/pammap.h>
 #include <parrotdb/pafixed.h>
 #include <parrotdb/paistr.h>
+#include <parrotdb/pathread.h>
 
 /*
  * We need to allocate "len" bytes of space, and return an atom
@@ -87,6 +88,193 @@ pa_istr_nstring_alloc (pa_istr_t *pip, const char *string, size_t len)
     return pa_istr_atom_to_index(pip, atom);
 }
 
+/*
+ * Thread-safe version of pa_istr_nstring: our data pages are
+ * append-only, so a single lock covers both the fast path and
+ * pa_istr_nstring_alloc.
+ */
+pa_istr_atom_t
+pa_istr_nstring_mt (pa_istr_t *pip, const char *string, size_t len)
+{
+    pa_istr_atom_t atom;
+
+    pa_lock(pip->pi_lock);
+    atom = pa_istr_nstring_unlocked(pip, string, len);
+    pa_unlock(pip->pi_lock);
+
+    return atom;
+}
+
+/*
+ * Return the hash index table, or NULL if we don't have one yet
+ */
+static inline pa_istr_hash_entry_t *
+pa_istr_hash_table (pa_istr_t *pip)
+{
+    pa_istr_hash_info_t *pihp = &pip->pi_infop->pii_hash;
+
+    if (pa_mmap_is_null(pihp->pih_table))
+	return NULL;
+
+    return pa_mmap_addr(pip->pi_mmap, pihp->pih_table);
+}
+
+/*
+ * Look for a string in the hash index, returning either the entry
+ * that holds it or the (empty) entry where it should go.  We don't
+ * write anything, so this is safe on read-only maps.
+ */
+static pa_istr_hash_entry_t *
+pa_istr_hash_lookup (pa_istr_t *pip, pa_istr_hash_entry_t *table,
+		     uint32_t hash, const char *string, size_t len)
+{
+    uint32_t mask = pip->pi_infop->pii_hash.pih_size - 1;
+    uint32_t slot;
+    pa_istr_hash_entry_t *php;
+
+    for (slot = hash & mask; ; slot = (slot + 1) & mask) {
+	php = &table[slot];
+	if (pa_istr_is_null(php->pihe_atom))
+	    return php;
+
+	if (php->pihe_hash != hash)
+	    continue;
+
+	const char *str = pa_istr_atom_string(pip, php->pihe_atom);
+	if (str && memcmp(str, string, len) == 0 && str[len] == '\0')
+	    return php;
+    }
+}
+
+/*
+ * Allocate a new (empty) table of the given size, copy the entries
+ * from the old one (if any), and free the old one.  Returns the new
+ * table, or NULL.
+ */
+static pa_istr_hash_entry_t *
+pa_istr_hash_resize (pa_istr_t *pip, uint32_t new_size)
+{
+    pa_istr_hash_info_t *pihp = &pip->pi_infop->pii_hash;
+    size_t bytes = new_size * sizeof(pa_istr_hash_entry_t);
+
+    pa_mmap_atom_t matom = pa_mmap_alloc(pip->pi_mmap, bytes);
+    pa_istr_hash_entry_t *table = pa_mmap_addr(pip->pi_mmap, matom);
+    if (table == NULL)
+	return NULL;
+
+    bzero(table, bytes);
+
+    pa_istr_hash_entry_t *old_table = pa_istr_hash_table(pip);
+    uint32_t old_size = pihp->pih_size;
+    uint32_t mask = new_size - 1;
+    uint32_t i, slot;
+
+    /* Rehash using the saved hash values; no need to look at strings */
+    if (old_table) {
+	for (i = 0; i < old_size; i++) {
+	    if (pa_istr_is_null(old_table[i].pihe_atom))
+		continue;
+
+	    for (slot = old_table[i].pihe_hash & mask;
+		 !pa_istr_is_null(table[slot].pihe_atom);
+		 slot = (slot + 1) & mask)
+		continue;
+
+	    table[slot] = old_table[i];
+	}
+
+	pa_mmap_free(pip->pi_mmap, pihp->pih_table,
+		     old_size * sizeof(pa_istr_hash_entry_t));
+    }
+
+    pihp->pih_table = matom;
+    pihp->pih_size = new_size;
+
+    return table;
+}
+
+/*
+ * Find a string in the hash index, without allocating anything.
+ * Returns the null atom if the string hasn't been interned.
+ */
+pa_istr_atom_t
+pa_istr_nstring_find (pa_istr_t *pip, const char *string, size_t len)
+{
+    if (string == NULL)
+	return pa_istr_null_atom();
+
+    if (len <= 1)
+	return pa_istr_atom(pa_short_string_atom(string));
+
+    pa_istr_atom_t atom = pa_istr_null_atom();
+    uint32_t hash = pa_hash_nstring(string, len);
+
+    pa_lock(pip->pi_lock);
+
+    pa_istr_hash_entry_t *table = pa_istr_hash_table(pip);
+    if (table)
+	atom = pa_istr_hash_lookup(pip, table, hash, string, len)->pihe_atom;
+
+    pa_unlock(pip->pi_lock);
+
+    return atom;
+}
+
+/*
+ * Find a string in the hash index, adding it if it's not there.
+ * The index is created on first use.
+ */
+pa_istr_atom_t
+pa_istr_nstring_intern (pa_istr_t *pip, const char *string, size_t len)
+{
+    if (string == NULL)
+	return pa_istr_null_atom();
+
+    if (len <= 1)
+	return pa_istr_atom(pa_short_string_atom(string));
+
+    pa_istr_hash_info_t *pihp = &pip->pi_infop->pii_hash;
+    pa_istr_atom_t atom = pa_istr_null_atom();
+    uint32_t hash = pa_hash_nstring(string, len);
+    pa_istr_hash_entry_t *table, *php;
+
+    pa_lock(pip->pi_lock);
+
+    table = pa_istr_hash_table(pip);
+    if (table == NULL) {
+	table = pa_istr_hash_resize(pip, pip->pi_hash_size);
+	if (table == NULL)
+	    goto done;
+    }
+
+    php = pa_istr_hash_lookup(pip, table, hash, string, len);
+    if (!pa_istr_is_null(php->pihe_atom)) {
+	atom = php->pihe_atom;
+	goto done;
+    }
+
+    /* Grow before we add, so there's always an empty entry */
+    if ((pihp->pih_count + 1) * 100 > pihp->pih_size * PA_ISTR_HASH_LOAD) {
+	table = pa_istr_hash_resize(pip, pihp->pih_size * 2);
+	if (table == NULL)
+	    goto done;
+
+	php = pa_istr_hash_lookup(pip, table, hash, string, len);
+    }
+
+    atom = pa_istr_nstring_unlocked(pip, string, len);
+    if (pa_istr_is_null(atom))
+	goto done;
+
+    php->pihe_hash = hash;
+    php->pihe_atom = atom;
+    pihp->pih_count += 1;
+
+ done:
+    pa_unlock(pip->pi_lock);
+    return atom;
+}
+
 /*
  * The most brutal of the initializers: the caller has an existing
  * base and info block for our use.  We just take them.
@@ -101,14 +289,18 @@ pa_istr_init_from_block (pa_istr_t *pip, void *base,
 
 void
 pa_istr_init (pa_mmap_t *pmp, pa_istr_t *pip, const char *name,
-	      pa_shift_t shift, uint16_t atom_shift, uint32_t max_atoms)
+	      pa_shift_t shift, uint16_t atom_shift, pa_atom_t max_atoms)
 {
     shift = pa_config_value32(name, "shift", shift);
     atom_shift = pa_config_value32(name, "atom-shift", atom_shift);
-    max_atoms = pa_config_value32(name, "max-atoms", max_atoms);
+    max_atoms = pa_config_value_atom(name, "max-atoms", max_atoms);
 
     /* Round max_atoms up to the next page size */
-    max_atoms = pa_roundup_shift32(max_atoms, shift);
+    max_atoms = pa_roundup_shift_atom(max_atoms, shift);
+
+    /* If the map already has our page table, use it */
+    if (pip->pi_base == NULL && !pa_mmap_is_null(pip->pi_datap->pid_base))
+	pip->pi_base = pa_mmap_addr(pmp, pip->pi_datap->pid_base);
 
     /* No base is NULL, allocate it, zero it and init the free list */
     if (pip->pi_base == NULL) {
@@ -124,18 +316,26 @@ pa_istr_init (pa_mmap_t *pmp, pa_istr_t *pip, const char *name,
 
 	/* Mark us empty */
 	pip->pi_free = pa_istr_data_null_atom();
+
+	/*
+	 * Fill in the rest of fhe fields from the argument list.  An
+	 * existing table keeps the values it was built with (and may
+	 * be read-only).
+	 */
+	pip->pi_shift = shift;
+	pip->pi_atom_shift = atom_shift;
+	pip->pi_max_atoms = max_atoms;
     }
 
-    /* Fill in the rest of fhe fields from the argument list */
-    pip->pi_shift = shift;
-    pip->pi_atom_shift = atom_shift;
-    pip->pi_max_atoms = max_atoms;
     pip->pi_mmap = pmp;
+
+    if ((pmp->pm_flags & PMF_THREAD_SAFE) && pip->pi_lock == NULL)
+	pip->pi_lock = pa_lock_create();
 }
 
 pa_istr_t *
 pa_istr_setup (pa_mmap_t *pmp, pa_istr_info_t *piip, const char *name,
-	       pa_shift_t shift, uint16_t atom_shift, uint32_t max_atoms)
+	       pa_shift_t shift, uint16_t atom_shift, pa_atom_t max_atoms)
 {
     char namebuf[PA_MMAP_HEADER_NAME_LEN];
     pa_istr_t *pip = psu_calloc(sizeof(*pip));
@@ -147,6 +347,13 @@ pa_istr_setup (pa_mmap_t *pmp, pa_istr_info_t *piip, const char *name,
 	pa_config_name(namebuf, sizeof(namebuf), name, "data");
 	pa_istr_init(pmp, pip, namebuf, shift, atom_shift, max_atoms);
 
+	/* The hash index must be a power of two */
+	pa_config_name(namebuf, sizeof(namebuf), name, "hash");
+	uint32_t hash_size = pa_config_value32(namebuf, "size",
+					       PA_ISTR_HASH_SIZE);
+	for (pip->pi_hash_size = 2; pip->pi_hash_size < hash_size; )
+	    pip->pi_hash_size <<= 1;
+
 	/*
 	 * Now we build the index, used to turn our externally visible
 	 * index numbers into atoms in our underlaying data store.
@@ -165,7 +372,7 @@ pa_istr_setup (pa_mmap_t *pmp, pa_istr_info_t *piip, const char *name,
 
 pa_istr_t *
 pa_istr_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
-		 uint16_t atom_shift, uint32_t max_atoms)
+		 uint16_t atom_shift, pa_atom_t max_atoms)
 {
     pa_istr_info_t *piip = NULL;
 
@@ -183,6 +390,10 @@ pa_istr_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
 void
 pa_istr_close (pa_istr_t *pip)
 {
+    if (pip->pi_index)
+	pa_fixed_close(pip->pi_index);
+
+    pa_lock_destroy(pip->pi_lock);
     psu_free(pip);
 }
 
@@ -196,12 +407,20 @@ pa_istr_dump (pa_istr_t *pip, psu_boolean_t full UNUSED)
 
     psu_log("begin pa_istr dump of %p", pidp);
 
-    psu_log("shift %u, atom-shift %u, max-atom %u, "
-	    "free %#x, left %d, base-atom %#x",
+    psu_log("shift %u, atom-shift %u, max-atom %" PA_ATOM_FMT ", "
+	    "free %#" PA_ATOM_XFMT ", left %" PA_ATOM_FMT
+	    ", base-atom %#" PA_ATOM_XFMT,
 	    pidp->pid_shift, pidp->pid_atom_shift, pidp->pid_max_atoms,
 	    pa_istr_data_atom_of(pidp->pid_free), pidp->pid_left,
 	    pa_mmap_atom_of(pidp->pid_base));
 
+    pa_istr_hash_info_t *pihp = &pip->pi_infop->pii_hash;
+    if (!pa_mmap_is_null(pihp->pih_table))
+	psu_log("hash index: table %#" PA_ATOM_XFMT
+		", size %u, count %u (%u%% full)",
+		pa_mmap_atom_of(pihp->pih_table), pihp->pih_size,
+		pihp->pih_count, pihp->pih_count * 100 / pihp->pih_size);
+
     psu_log("end pa_istr dump of %p", pidp);
 }
 
@@ -26,6 +26,15 @@
  * We use an index to give us a compact contiguous number space.  We
  * have also support short strings, where small numbers represent
  * strings of length zero or one.  
+ *
+ * Strings are normally just appended, so allocating the same string
+ * twice gives two atoms.  For "there can be only one" semantics,
+ * pa_istr_intern() looks for an existing copy of the string in a
+ * hash index, and only allocates a new one if needed, so equal
+ * strings get equal atoms.  pa_istr_find() looks without allocating
+ * (or writing anything), so it works on read-only maps.  The index
+ * is created the first time a string is interned, and only holds
+ * interned strings.
  */
 
 /* Declare our wrapper type: istr is the external-facing type */
@@ -65,11 +74,34 @@ typedef struct pa_istr_data_info_s {
 } pa_istr_data_info_t;
 
 /*
- * Our info contains both the info for our strings and the index
+ * The hash index is open-addressed, with linear probing.  Each entry
+ * holds the string's hash along with its atom, so we rarely need to
+ * compare strings that don't match, and we can rehash without
+ * touching the strings.  The table is a single pa_mmap allocation,
+ * which we double when it gets more than 70% full.
+ */
+typedef struct pa_istr_hash_entry_s {
+    uint32_t pihe_hash;		/* Hash of the string */
+    pa_istr_atom_t pihe_atom;	/* String atom (or null if unused) */
+} pa_istr_hash_entry_t;
+
+typedef struct pa_istr_hash_info_s {
+    pa_mmap_atom_t pih_table;	/* Table of entries */
+    uint32_t pih_size;		/* Number of entries (a power of two) */
+    uint32_t pih_count;		/* Number of entries in use */
+} pa_istr_hash_info_t;
+
+#define PA_ISTR_HASH_SIZE	1024 /* Default initial number of entries */
+#define PA_ISTR_HASH_LOAD	70   /* Max percentage in use */
+
+/*
+ * Our info contains the info for our strings, the index, and the
+ * hash index
  */
 typedef struct pa_istr_info_s {
     pa_fixed_info_t pii_index;	/* Packed array of string atoms */
     pa_istr_data_info_t pii_data; /* String data */
+    pa_istr_hash_info_t pii_hash; /* Hash index (for pa_istr_intern) */
 } pa_istr_info_t;
 
 typedef struct pa_istr_s {
@@ -78,6 +110,8 @@ typedef struct pa_istr_s {
     pa_istr_data_info_t *pi_datap; /* Data header (for pii_data) */
     pa_fixed_t *pi_index;	   /* Index of strings (for pii_index) */
     pa_mmap_atom_t *pi_base;	   /* Base of page table (in mmap atoms) */
+    struct pa_lock_s *pi_lock;	   /* Lock (for PMF_THREAD_SAFE) */
+    uint32_t pi_hash_size;	   /* Initial hash index size (entries) */
 } pa_istr_t;
 
 /* Simplification macros, so we don't need to think about pi_datap */
@@ -129,7 +163,7 @@ pa_istr_page_set (pa_istr_t *pip, pa_page_t page, pa_mmap_atom_t matom)
  */
 static inline void *
 pa_istr_data_atom_addr_direct (pa_istr_t *pip, uint8_t shift,
-			       uint16_t atom_shift, uint32_t max_atoms,
+			       uint16_t atom_shift, pa_atom_t max_atoms,
 			       pa_istr_data_atom_t atom)
 {
     pa_atom_t raw = pa_istr_data_atom_of(atom);
@@ -214,18 +248,13 @@ pa_istr_atom_string (pa_istr_t *pip, pa_istr_atom_t iatom)
 pa_istr_atom_t
 pa_istr_nstring_alloc (pa_istr_t *pip, const char *string, size_t len);
 
+/*
+ * Copy a string into our data pages.  In thread-safe mode, the caller
+ * must hold pi_lock.
+ */
 static inline pa_istr_atom_t
-pa_istr_nstring (pa_istr_t *pip, const char *string, size_t len)
+pa_istr_nstring_unlocked (pa_istr_t *pip, const char *string, size_t len)
 {
-    if (string == NULL)
-	return pa_istr_null_atom();
-
-    /*
-     * Strings that are length 1 are handled specifically
-     */
-    if (len <= 1)
-	return pa_istr_atom(pa_short_string_atom(string));
-
     unsigned num_atoms = pa_items_shift32(len + 1, pip->pi_atom_shift);
     if (num_atoms <= pip->pi_left) {
 	/* Easy case */
@@ -248,12 +277,58 @@ pa_istr_nstring (pa_istr_t *pip, const char *string, size_t len)
     return pa_istr_nstring_alloc(pip, string, len);
 }
 
+pa_istr_atom_t
+pa_istr_nstring_mt (pa_istr_t *pip, const char *string, size_t len);
+
+static inline pa_istr_atom_t
+pa_istr_nstring (pa_istr_t *pip, const char *string, size_t len)
+{
+    if (string == NULL)
+	return pa_istr_null_atom();
+
+    /*
+     * Strings that are length 1 are handled specifically
+     */
+    if (len <= 1)
+	return pa_istr_atom(pa_short_string_atom(string));
+
+    if (pip->pi_lock)
+	return pa_istr_nstring_mt(pip, string, len);
+
+    return pa_istr_nstring_unlocked(pip, string, len);
+}
+
 static inline pa_istr_atom_t
 pa_istr_string (pa_istr_t *pip, const char *string)
 {
     return pa_istr_nstring(pip, string, string ? strlen(string) : 0);
 }
 
+pa_istr_atom_t
+pa_istr_nstring_intern (pa_istr_t *pip, const char *string, size_t len);
+
+pa_istr_atom_t
+pa_istr_nstring_find (pa_istr_t *pip, const char *string, size_t len);
+
+/*
+ * Return the atom for a string, allocating it only if an equal string
+ * hasn't already been interned.
+ */
+static inline pa_istr_atom_t
+pa_istr_intern (pa_istr_t *pip, const char *string)
+{
+    return pa_istr_nstring_intern(pip, string, string ? strlen(string) : 0);
+}
+
+/*
+ * Return the atom for a previously interned string, or the null atom
+ */
+static inline pa_istr_atom_t
+pa_istr_find (pa_istr_t *pip, const char *string)
+{
+    return pa_istr_nstring_find(pip, string, string ? strlen(string) : 0);
+}
+
 /*
  * Shortcut to return both atom and addr
  */
@@ -274,15 +349,15 @@ pa_istr_init_from_block (pa_istr_t *pip, void *base, pa_istr_info_t *infop);
 
 void
 pa_istr_init (pa_mmap_t *pmp, pa_istr_t *pip, const char *name,
-	      pa_shift_t shift, uint16_t atom_shift, uint32_t max_atoms);
+	      pa_shift_t shift, uint16_t atom_shift, pa_atom_t max_atoms);
 
 pa_istr_t *
 pa_istr_setup (pa_mmap_t *pmp, pa_istr_info_t *pidp, const char *name,
-	       pa_shift_t shift, uint16_t atom_shift, uint32_t max_atoms);
+	       pa_shift_t shift, uint16_t atom_shift, pa_atom_t max_atoms);
 
 pa_istr_t *
 pa_istr_open (pa_mmap_t *pmp, const char *name, pa_shift_t shift,
-	       uint16_t atom_shift, uint32_t max_atoms);
+	       uint16_t atom_shift, pa_atom_t max_atoms);
 
 void
 pa_istr_close (pa_istr_t *pip);
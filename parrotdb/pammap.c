@@ -14,13 +14,27 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/file.h>
 #include <errno.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#ifdef HAVE_SCHED_YIELD
+#include <sched.h>
+#endif /* HAVE_SCHED_YIELD */
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#define PA_MMAP_FUTEX		1 /* Sleep on the lock word */
+#endif /* HAVE_LINUX_FUTEX_H && HAVE_SYS_SYSCALL_H */
 
 #include <libpsu/psulog.h>
 #include <libpsu/psualloc.h>
@@ -29,13 +43,26 @@
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
+#include <parrotdb/palog2.h>
+#include <parrotdb/pathread.h>
 #include <libpsu/psualloc.h>
 
-#define PA_VERS_MAJOR		1 /* Major numbers are mutually incompatible */
+#define PA_VERS_MAJOR		4 /* Major numbers are mutually incompatible */
 #define PA_VERS_MINOR		0 /* Minor numbers are compatible */
 
 #define PA_MMAP_FREE_MAGIC	0xCABB1E16 /* Denoted free atoms */
 
+/*
+ * Free chunks are kept on segregated lists ("bins") indexed by size.
+ * Chunks of 1 to PA_MMAP_EXACT_BINS atoms each have a bin of their
+ * own, so any chunk on those lists is an exact fit.  Above that, each
+ * bin holds a power-of-two range of sizes ([16,32), [32,64), ...) with
+ * the last bin taking everything that's larger.  A bitmap of non-empty
+ * bins lets us find the next usable bin without walking empty ones.
+ */
+#define PA_MMAP_NUM_BINS	32 /* Number of free list bins */
+#define PA_MMAP_EXACT_BINS	15 /* Bins holding a single size */
+
 /*
  * The magic number allow us to "know" that the file is our's as well
  * as knowing that it's in the correct endian-ness.  Allows us to report
@@ -48,6 +75,13 @@
 #define PA_DEFAULT_COUNT	32
 #define PA_DEFAULT_SIZE		(PA_DEFAULT_COUNT << PA_MMAP_ATOM_SHIFT)
 
+/* Default growth policy: add half our size, but never less than this */
+#define PA_DEFAULT_GROW_PERCENT	50
+#define PA_DEFAULT_GROW_MIN	PA_DEFAULT_COUNT
+
+/* Default hugetlb page size, used to round PMF_HUGETLB segments */
+#define PA_HUGE_PAGE_SIZE	(1U << 21)
+
 /*
  * This structure defines the header of the mmap'd memory segment.
  */
@@ -55,18 +89,37 @@ struct pa_mmap_info_s {
     uint16_t pmi_magic;		/* Magic number */
     uint8_t pmi_vers_major;	/* Major version number */
     uint8_t pmi_vers_minor;	/* Minor version number */
-    uint32_t pmi_max_size;	/* Maximum size (or 0) */
     uint32_t pmi_num_headers;	/* Number of named headers following ours */
+    uint64_t pmi_max_size;	/* Maximum size (or 0) */
+    uint8_t pmi_atom_shift;	/* PA_ATOM_SHIFT of our writer (or 0 for 2) */
+    uint8_t pmi_pad[7];		/* Padding (must be zero) */
     size_t pmi_len;		/* Current size */
-    pa_mmap_atom_t pmi_free;	/* First free memory segment */
+    uint32_t pmi_bin_map;	/* Bitmap of non-empty bins */
+    pa_mmap_atom_t pmi_bins[PA_MMAP_NUM_BINS]; /* Free lists, by size */
+    uint32_t pmi_lock;		/* Reader/writer lock word */
+    uint32_t pmi_lock_waiters;	/* Number of sleepers on pmi_lock */
+    uint32_t pmi_lock_seq;	/* Write sequence (odd while writing) */
 }; /* pa_mmap_info_t */
 
+/*
+ * Each free chunk starts with a pa_mmap_free_t and ends with a
+ * pa_mmap_free_tail_t, occupying the last bytes of its last atom.
+ * The tail (a "boundary tag") lets pa_mmap_free find the start
+ * of the chunk that precedes a freed one, so neighbours can be
+ * merged in either direction.
+ */
 typedef struct pa_mmap_free_s {
     uint32_t pmf_magic;		/* Magic number */
     pa_atom_t pmf_size;		/* Number of atoms free here */
-    pa_mmap_atom_t pmf_next;	/* Free list */
+    pa_mmap_atom_t pmf_next;	/* Next chunk in this bin */
+    pa_mmap_atom_t pmf_prev;	/* Previous chunk in this bin */
 } pa_mmap_free_t;
 
+typedef struct pa_mmap_free_tail_s {
+    uint32_t pmft_magic;	/* Magic number (PA_MMAP_FREE_MAGIC) */
+    pa_atom_t pmft_size;	/* Number of atoms in this free chunk */
+} pa_mmap_free_tail_t;
+
 typedef struct pa_mmap_header_s {
     char pmh_name[PA_MMAP_HEADER_NAME_LEN]; /* Simple text name */
     uint16_t pmh_type;		/* Type of data (PA_TYPE_*) */
@@ -88,179 +141,1248 @@ typedef struct pa_mmap_header_s {
 static uint8_t *pa_mmap_next_address = (void *) PA_ADDR_DEFAULT;
 static ptrdiff_t pa_mmap_incr_address = PA_ADDR_DEFAULT_INCR;
 
-/*
- * Add an item from a free list.
- */
-static void
-pa_mmap_list_add (pa_mmap_t *pmp, pa_mmap_atom_t atom, unsigned size)
+/*
+ * Return the bin number for a chunk of the given number of atoms
+ */
+static inline unsigned
+pa_mmap_bin (pa_atom_t count)
+{
+    if (count <= PA_MMAP_EXACT_BINS)
+	return count - 1;
+
+    /* pa_log2(16) is 5, which should map to our first range bin */
+    unsigned bin = PA_MMAP_EXACT_BINS + pa_log2(count) - 5;
+
+    return (bin < PA_MMAP_NUM_BINS) ? bin : PA_MMAP_NUM_BINS - 1;
+}
+
+static inline pa_mmap_free_tail_t *
+pa_mmap_free_tail (pa_mmap_t *pmp, pa_atom_t atom, pa_atom_t count)
+{
+    psu_byte_t *cp = pa_pointer(pmp->pm_addr, atom + count,
+				PA_MMAP_ATOM_SHIFT);
+    return (pa_mmap_free_tail_t *) (cp - sizeof(pa_mmap_free_tail_t));
+}
+
+/*
+ * Is the given atom the start of a chunk that's sitting on one of
+ * our free lists?  The magic number alone isn't proof, since the
+ * atom might be allocated and the caller's data might happen to
+ * match, so we make sure the chunk is really linked into its bin.
+ */
+static psu_boolean_t
+pa_mmap_is_free (pa_mmap_t *pmp, pa_atom_t atom)
+{
+    pa_atom_t max_atom = pmp->pm_len >> PA_MMAP_ATOM_SHIFT;
+
+    if (atom == 0 || atom >= max_atom)
+	return FALSE;
+
+    pa_mmap_free_t *pmfp = pa_pointer(pmp->pm_addr, atom, PA_MMAP_ATOM_SHIFT);
+    if (pmfp->pmf_magic != PA_MMAP_FREE_MAGIC || pmfp->pmf_size == 0
+	    || pmfp->pmf_size > max_atom - atom)
+	return FALSE;
+
+    pa_atom_t prev = pa_mmap_atom_of(pmfp->pmf_prev);
+    if (prev == 0) {
+	unsigned bin = pa_mmap_bin(pmfp->pmf_size);
+	return (pa_mmap_atom_of(pmp->pm_infop->pmi_bins[bin]) == atom);
+    }
+
+    if (prev >= max_atom)
+	return FALSE;
+
+    pa_mmap_free_t *prevp = pa_pointer(pmp->pm_addr, prev, PA_MMAP_ATOM_SHIFT);
+    return (prevp->pmf_magic == PA_MMAP_FREE_MAGIC
+	    && pa_mmap_atom_of(prevp->pmf_next) == atom);
+}
+
+/*
+ * Add a chunk to the head of the bin for its size, writing both
+ * its header and its boundary tag.
+ */
+static void
+pa_mmap_list_add (pa_mmap_t *pmp, pa_mmap_atom_t atom, pa_atom_t count)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    unsigned bin = pa_mmap_bin(count);
+    pa_mmap_free_t *pmfp = pa_mmap_addr(pmp, atom);
+    pa_mmap_free_tail_t *pmftp;
+
+    pmfp->pmf_magic = PA_MMAP_FREE_MAGIC;
+    pmfp->pmf_size = count;
+    pmfp->pmf_prev = pa_mmap_null_atom();
+    pmfp->pmf_next = pmip->pmi_bins[bin];
+
+    if (!pa_mmap_is_null(pmfp->pmf_next)) {
+	pa_mmap_free_t *nextp = pa_mmap_addr(pmp, pmfp->pmf_next);
+	nextp->pmf_prev = atom;
+    }
+
+    pmip->pmi_bins[bin] = atom;
+    pmip->pmi_bin_map |= 1U << bin;
+
+    pmftp = pa_mmap_free_tail(pmp, pa_mmap_atom_of(atom), count);
+    pmftp->pmft_magic = PA_MMAP_FREE_MAGIC;
+    pmftp->pmft_size = count;
+}
+
+/*
+ * Unlink a chunk from its bin.  The header and tail are left alone;
+ * the caller is either reusing the chunk or rewriting them.
+ */
+static void
+pa_mmap_list_remove (pa_mmap_t *pmp, pa_mmap_atom_t atom)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    pa_mmap_free_t *pmfp = pa_mmap_addr(pmp, atom);
+    unsigned bin = pa_mmap_bin(pmfp->pmf_size);
+
+    if (pa_mmap_is_null(pmfp->pmf_prev)) {
+	pmip->pmi_bins[bin] = pmfp->pmf_next;
+	if (pa_mmap_is_null(pmfp->pmf_next))
+	    pmip->pmi_bin_map &= ~(1U << bin);
+    } else {
+	pa_mmap_free_t *prevp = pa_mmap_addr(pmp, pmfp->pmf_prev);
+	prevp->pmf_next = pmfp->pmf_next;
+    }
+
+    if (!pa_mmap_is_null(pmfp->pmf_next)) {
+	pa_mmap_free_t *nextp = pa_mmap_addr(pmp, pmfp->pmf_next);
+	nextp->pmf_prev = pmfp->pmf_prev;
+    }
+
+    pmfp->pmf_next = pmfp->pmf_prev = pa_mmap_null_atom();
+}
+
+/*
+ * Release a chunk, merging it with any free chunk that sits
+ * directly before or after it in the address space.
+ */
+static void
+pa_mmap_release (pa_mmap_t *pmp, pa_atom_t atom, pa_atom_t count)
+{
+    pa_mmap_free_t *pmfp;
+
+    /* Merge with the following chunk, if it's free */
+    if (pa_mmap_is_free(pmp, atom + count)) {
+	pmfp = pa_pointer(pmp->pm_addr, atom + count, PA_MMAP_ATOM_SHIFT);
+	pa_mmap_list_remove(pmp, pa_mmap_atom(atom + count));
+	pmfp->pmf_magic = 0;
+	count += pmfp->pmf_size;
+    }
+
+    /*
+     * Merge with the preceding chunk; its boundary tag tells us where
+     * it starts.  Atom zero is our header, so it's never a candidate.
+     */
+    if (atom > 1) {
+	pa_mmap_free_tail_t *pmftp = pa_mmap_free_tail(pmp, atom - 1, 1);
+
+	if (pmftp->pmft_magic == PA_MMAP_FREE_MAGIC
+		&& pmftp->pmft_size != 0 && pmftp->pmft_size < atom
+		&& pa_mmap_is_free(pmp, atom - pmftp->pmft_size)) {
+	    pmfp = pa_pointer(pmp->pm_addr, atom - pmftp->pmft_size,
+			      PA_MMAP_ATOM_SHIFT);
+	    if (pmfp->pmf_size == pmftp->pmft_size) {
+		atom -= pmfp->pmf_size;
+		count += pmfp->pmf_size;
+		pa_mmap_list_remove(pmp, pa_mmap_atom(atom));
+		pmftp->pmft_magic = 0;
+	    }
+	}
+    }
+
+    pa_mmap_list_add(pmp, pa_mmap_atom(atom), count);
+}
+
+/*
+ * Find a free chunk of at least 'count' atoms and carve our
+ * allocation from it.
+ */
+static pa_mmap_atom_t
+pa_mmap_alloc_from_bins (pa_mmap_t *pmp, pa_atom_t count)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    unsigned bin = pa_mmap_bin(count);
+    pa_mmap_atom_t fa = pa_mmap_null_atom();
+    pa_mmap_free_t *pmfp;
+
+    /*
+     * Exact bins give an exact fit from the head of the list.  Range
+     * bins need a walk, since chunks in them may be too small.
+     */
+    if (pmip->pmi_bin_map & (1U << bin)) {
+	for (fa = pmip->pmi_bins[bin]; !pa_mmap_is_null(fa);
+	     fa = pmfp->pmf_next) {
+	    pmfp = pa_mmap_addr(pmp, fa);
+	    if (pmfp->pmf_size >= count)
+		break;
+	}
+    }
+
+    /* Anything in a larger bin is big enough, so we take the head */
+    if (pa_mmap_is_null(fa)) {
+	uint32_t map = (bin + 1 < PA_MMAP_NUM_BINS)
+	    ? pmip->pmi_bin_map & ~((2U << bin) - 1) : 0;
+	if (map == 0)
+	    return pa_mmap_null_atom();
+
+	fa = pmip->pmi_bins[ffs(map) - 1];
+	pmfp = pa_mmap_addr(pmp, fa);
+    }
+
+    pa_mmap_list_remove(pmp, fa);
+
+    pa_atom_t size = pmfp->pmf_size;
+    pa_mmap_free_tail_t *pmftp = pa_mmap_free_tail(pmp, pa_mmap_atom_of(fa),
+						   size);
+    pmftp->pmft_magic = 0;
+
+    if (count < size) {
+	/*
+	 * We allocate from the end of the chunk, so the remainder
+	 * keeps its header where it is.
+	 */
+	pa_mmap_list_add(pmp, fa, size - count);
+	fa.pma_atom += size - count; /* Reference end of the chunk */
+    } else {
+	pmfp->pmf_magic = 0;
+    }
+
+    return fa;
+}
+
+/*
+ * Fault in a range of our segment, so later references don't stall.
+ * We'd rather have the kernel do this in one call, but if it can't,
+ * we touch each atom ourselves.
+ */
+static void
+pa_mmap_prefault (pa_mmap_t *pmp, psu_byte_t *addr, size_t len)
+{
+#if defined(HAVE_MADVISE) && defined(MADV_POPULATE_WRITE)
+    /* Writing would copy every page of a PMF_COMMIT segment */
+    int advice = (pmp->pm_flags & (PMF_READ_ONLY | PMF_COMMIT))
+	? MADV_POPULATE_READ : MADV_POPULATE_WRITE;
+    if (madvise(addr, len, advice) == 0)
+	return;
+#endif /* HAVE_MADVISE && MADV_POPULATE_WRITE */
+
+#ifdef HAVE_MADVISE
+    madvise(addr, len, MADV_WILLNEED);
+#endif /* HAVE_MADVISE */
+
+    volatile psu_byte_t *cp = addr, *endp = addr + len;
+    for ( ; cp < endp; cp += PA_MMAP_ATOM_SIZE)
+	(void) *cp;
+}
+
+/*
+ * Apply our paging flags to a freshly mapped range.  All of these
+ * are hints, so failures are reported but not fatal.
+ */
+static void
+pa_mmap_advise (pa_mmap_t *pmp, psu_byte_t *addr, size_t len)
+{
+#if defined(HAVE_MADVISE) && defined(MADV_HUGEPAGE)
+    if ((pmp->pm_flags & PMF_HUGE_PAGES)
+	    && madvise(addr, len, MADV_HUGEPAGE) < 0)
+	pa_warning(errno, "madvise(MADV_HUGEPAGE) failed");
+#endif /* HAVE_MADVISE && MADV_HUGEPAGE */
+
+#ifdef MAP_POPULATE
+    if (pmp->pm_mmap_flags & MAP_POPULATE)
+	return;			/* mmap has already done the work */
+#endif /* MAP_POPULATE */
+
+    if (pmp->pm_flags & PMF_PREFAULT)
+	pa_mmap_prefault(pmp, addr, len);
+}
+
+/*
+ * Reserve a range of address space without committing any memory to
+ * it, so our segment can later grow in place.  Returns zero on
+ * success, one if the address is in use, and -1 on failure.
+ */
+static int
+pa_mmap_reserve (psu_byte_t *addr, size_t len)
+{
+    int flags = MAP_PRIVATE | MAP_ANON;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif /* MAP_NORESERVE */
+
+    /* No MAP_FIXED here; we don't want to clobber someone's mapping */
+    void *res = mmap(addr, len, PROT_NONE, flags, -1, 0);
+    if (res == NULL || res == MAP_FAILED)
+	return -1;
+
+    if (res != addr) {
+	munmap(res, len);
+	return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Extend the file under our segment.  On Linux, fallocate gives us
+ * real blocks, so running out of disk is reported here rather than
+ * as a SIGBUS when the page is touched.
+ */
+static int
+pa_mmap_extend_file (pa_mmap_t *pmp, size_t old_len, size_t new_len)
+{
+#ifdef HAVE_FALLOCATE
+    if (fallocate(pmp->pm_fd, 0, old_len, new_len - old_len) == 0)
+	return 0;
+
+    if (errno != EOPNOTSUPP && errno != ENOSYS) {
+	pa_warning(errno, "cannot allocate memory file to %zu", new_len);
+	return -1;
+    }
+#endif /* HAVE_FALLOCATE */
+
+    if (ftruncate(pmp->pm_fd, new_len) < 0) {
+	pa_warning(errno, "cannot extend memory file to %zu (from %zu)",
+		   new_len, old_len);
+	return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Decide how many atoms to add when we need room for 'count' more.
+ * We grow by a percentage of our current size, so the number of
+ * growth events is logarithmic in the size of the database.
+ */
+static pa_atom_t
+pa_mmap_grow_count (pa_mmap_t *pmp, pa_atom_t count)
+{
+    pa_atom_t cur = pmp->pm_len >> PA_MMAP_ATOM_SHIFT;
+    uint64_t grow = ((uint64_t) cur * pmp->pm_grow_percent) / 100;
+
+    if (grow < pmp->pm_grow_min)
+	grow = pmp->pm_grow_min;
+    if (pmp->pm_grow_max != 0 && grow > pmp->pm_grow_max)
+	grow = pmp->pm_grow_max;
+    if (grow < count)
+	grow = count;
+
+    grow = (grow + PA_DEFAULT_COUNT - 1) & ~(uint64_t) (PA_DEFAULT_COUNT - 1);
+
+    /* Don't let our appetite push us past max-size */
+    uint64_t max_size = pmp->pm_infop->pmi_max_size;
+    if (max_size != 0) {
+	uint64_t max_atoms = max_size >> PA_MMAP_ATOM_SHIFT;
+	uint64_t room = (max_atoms > cur) ? max_atoms - cur : 0;
+
+	if (grow > room && count <= room)
+	    grow = room;
+    }
+
+    return grow;
+}
+
+/*
+ * Extend our segment by 'count' atoms, putting the new space onto
+ * the free list.
+ */
+static int
+pa_mmap_grow (pa_mmap_t *pmp, pa_atom_t count)
+{
+    /* Hugetlb segments must grow in whole huge pages */
+    count = pa_roundup_atom(count, pmp->pm_align >> PA_MMAP_ATOM_SHIFT);
+
+    size_t new_len = pmp->pm_len + ((size_t) count << PA_MMAP_ATOM_SHIFT);
+    size_t old_len = pmp->pm_len;
+    psu_byte_t *target = pmp->pm_addr + old_len;
+
+    if (pmp->pm_infop->pmi_max_size != 0
+	&& new_len > pmp->pm_infop->pmi_max_size) {
+	pa_warning(0, "max size reached");
+	return -1;
+    }
+
+    /*
+     * If we've outgrown our reserved address range, try to extend
+     * it; if someone else is living there, we're stuck.
+     */
+    if (pmp->pm_reserve != 0 && new_len > pmp->pm_reserve) {
+	size_t extra = new_len - pmp->pm_reserve;
+	if (extra < pmp->pm_reserve)
+	    extra = pmp->pm_reserve;
+
+	if (pa_mmap_reserve(pmp->pm_addr + pmp->pm_reserve, extra) != 0) {
+	    pa_warning(0, "no address space to grow segment (%zu)", new_len);
+	    return -1;
+	}
+
+	pmp->pm_reserve += extra;
+    }
+
+    /* If we've got a file attached, we need to extend the file */
+    if (pmp->pm_fd > 0 && pa_mmap_extend_file(pmp, old_len, new_len) < 0)
+	return -1;
+
+    /*
+     * We map just the new space, directly after our current
+     * segment.  If we've reserved the address range, this simply
+     * replaces part of the reservation.
+     */
+    void *addr = mmap(target, new_len - old_len, pmp->pm_mmap_prot,
+		      pmp->pm_mmap_flags | MAP_FIXED,
+		      pmp->pm_fd, (pmp->pm_fd > 0) ? (off_t) old_len : 0);
+    if (addr == NULL || addr == MAP_FAILED) {
+	pa_warning(errno, "mmap failed");
+	return -1;
+    }
+
+    if (addr != target) {
+	pa_warning(0, "mmap was moved (%p:%p:%p)",
+		   pmp->pm_addr, target, addr);
+	return -1;
+    }
+
+    /*
+     * An anonymous segment with no reservation is a stack of
+     * separate mappings, so we record each one to unmap it during
+     * close.
+     */
+    if (pmp->pm_fd < 0 && pmp->pm_reserve == 0) {
+	pa_mmap_record_t *pmrp = psu_calloc(sizeof(*pmrp));
+	if (pmrp) {
+	    pmrp->pmr_addr = target;
+	    pmrp->pmr_len = new_len - old_len;
+	    pmrp->pmr_next = pmp->pm_record;
+	    pmp->pm_record = pmrp;
+	}
+    }
+
+    pa_mmap_advise(pmp, addr, new_len - old_len);
+
+    pmp->pm_len = new_len;	/* Record our new length */
+    pmp->pm_infop->pmi_len = new_len;
+
+    /* The new space may merge with a free chunk at our old end */
+    pa_mmap_release(pmp, old_len >> PA_MMAP_ATOM_SHIFT, count);
+
+    return 0;
+}
+
+/*
+ * Allocate a chunk of memory and return its offset.
+ */
+pa_mmap_atom_t
+pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
+{
+    if (size == 0) {
+	pa_warning(0, "pa_mmap_alloc called with zero size");
+	return pa_mmap_null_atom();
+    }
+
+    pa_mmap_atom_t fa;		/* Free atom number */
+    pa_atom_t count = (size + PA_MMAP_ATOM_SIZE - 1) >> PA_MMAP_ATOM_SHIFT;
+    pa_atom_t new_count;
+
+    pa_lock(pmp->pm_lock);
+
+    fa = pa_mmap_alloc_from_bins(pmp, count);
+    if (pa_mmap_is_null(fa)) {
+	/*
+	 * Okay, so there's nothing big enough to fit this.  So we grow
+	 * our database, toss the new space onto the free list, and
+	 * try again.
+	 */
+	new_count = pa_mmap_grow_count(pmp, count);
+
+	if (pa_mmap_grow(pmp, new_count) == 0)
+	    fa = pa_mmap_alloc_from_bins(pmp, count);
+    }
+
+    pa_unlock(pmp->pm_lock);
+
+    return fa;
+}
+
+void
+pa_mmap_free (pa_mmap_t *pmp, pa_mmap_atom_t atom, unsigned size)
+{
+    if (pa_mmap_is_null(atom)) {
+	pa_warning(0, "pa_mmap_free called with NULL");
+	return;
+    }
+
+    unsigned count = pa_items_shift32(size, PA_MMAP_ATOM_SHIFT);
+    if (count == 0) {
+	pa_warning(0, "pa_mmap_free called with count 0");
+	return;
+    }
+
+    pa_lock(pmp->pm_lock);
+    pa_mmap_release(pmp, pa_mmap_atom_of(atom), count);
+    pa_unlock(pmp->pm_lock);
+}
+
+/*
+ * The lock fields in our header only mean something to the threads
+ * (or processes) that have the segment mapped right now, so they
+ * must not reach the file: whoever maps it next would find it
+ * locked, with a write in progress.  We clear them in everything we
+ * write to the file (or recover into it), leaving pmi_lock_seq even.
+ */
+static void
+pa_mmap_info_scrub (pa_mmap_info_t *pmip)
+{
+    pmip->pmi_lock = 0;
+    pmip->pmi_lock_waiters = 0;
+    pmip->pmi_lock_seq = (pmip->pmi_lock_seq + 1) & ~1U;
+}
+
+/*
+ * The redo log for PMF_COMMIT segments starts with this header,
+ * followed by the file offset of each page, followed by the pages
+ * themselves.  The header is written last, so a log with the right
+ * magic number and checksum is complete.
+ */
+typedef struct pa_mmap_log_s {
+    uint32_t pml_magic;		/* PA_MMAP_LOG_MAGIC, once complete */
+    uint32_t pml_page_size;	/* Size of each page */
+    uint64_t pml_count;		/* Number of pages */
+    uint64_t pml_len;		/* Length of the file, once committed */
+    uint64_t pml_sum;		/* Checksum of the offsets and pages */
+} pa_mmap_log_t;
+
+#define PA_MMAP_LOG_MAGIC	0x10CC0317 /* Denotes a complete log */
+#define PA_MMAP_LOG_SUFFIX	".log"	/* Appended to our filename */
+#define PA_MMAP_LOG_BATCH	512	/* Pages per pagemap read */
+
+/* FNV-1a, which is plenty for spotting a torn log */
+#define PA_MMAP_SUM_INIT	0xcbf29ce484222325ULL
+#define PA_MMAP_SUM_PRIME	0x100000001b3ULL
+
+/* Bits in a /proc/self/pagemap entry */
+#define PA_PAGEMAP_PRESENT	(1ULL << 63) /* Page is in memory */
+#define PA_PAGEMAP_SWAPPED	(1ULL << 62) /* Page is in swap */
+#define PA_PAGEMAP_FILE		(1ULL << 61) /* Page is the file's own */
+
+static uint64_t
+pa_mmap_sum (uint64_t sum, const void *buf, size_t len)
+{
+    const psu_byte_t *cp = buf, *ep = cp + len;
+
+    for ( ; cp < ep; cp++) {
+	sum ^= *cp;
+	sum *= PA_MMAP_SUM_PRIME;
+    }
+
+    return sum;
+}
+
+static int
+pa_mmap_pwrite (int fd, const void *buf, size_t len, off_t off)
+{
+    const psu_byte_t *cp = buf;
+    ssize_t rc;
+
+    while (len > 0) {
+	rc = pwrite(fd, cp, len, off);
+	if (rc < 0 && errno == EINTR)
+	    continue;
+	if (rc <= 0)
+	    return -1;
+	cp += rc;
+	off += rc;
+	len -= rc;
+    }
+
+    return 0;
+}
+
+static int
+pa_mmap_pread (int fd, void *buf, size_t len, off_t off)
+{
+    psu_byte_t *cp = buf;
+    ssize_t rc;
+
+    while (len > 0) {
+	rc = pread(fd, cp, len, off);
+	if (rc < 0 && errno == EINTR)
+	    continue;
+	if (rc <= 0)
+	    return -1;
+	cp += rc;
+	off += rc;
+	len -= rc;
+    }
+
+    return 0;
+}
+
+/*
+ * The checksum covers the header fields recovery relies on, as well
+ * as the offsets and pages
+ */
+static uint64_t
+pa_mmap_log_sum (uint64_t sum, const pa_mmap_log_t *logp)
+{
+    sum = pa_mmap_sum(sum, &logp->pml_page_size,
+		      sizeof(logp->pml_page_size));
+    sum = pa_mmap_sum(sum, &logp->pml_count, sizeof(logp->pml_count));
+    sum = pa_mmap_sum(sum, &logp->pml_len, sizeof(logp->pml_len));
+
+    return sum;
+}
+
+/*
+ * Sync the directory holding "filename", so the creation or removal
+ * of the file itself survives a crash
+ */
+static int
+pa_mmap_sync_dir (const char *filename)
+{
+    const char *cp = strrchr(filename, '/');
+    size_t len = cp ? (size_t) (cp - filename) : 0;
+    char *dir = psu_malloc(len + 2);
+    int fd, rc;
+
+    if (dir == NULL)
+	return -1;
+
+    if (cp == NULL)
+	strcpy(dir, ".");
+    else if (len == 0)
+	strcpy(dir, "/");
+    else {
+	memcpy(dir, filename, len);
+	dir[len] = '\0';
+    }
+
+    fd = open(dir, O_RDONLY);
+    psu_free(dir);
+    if (fd < 0)
+	return -1;
+
+    rc = fsync(fd);
+    close(fd);
+    return rc;
+}
+
+static char *
+pa_mmap_log_name (const char *filename)
+{
+    size_t len = strlen(filename) + sizeof(PA_MMAP_LOG_SUFFIX);
+    char *name = psu_malloc(len);
+
+    if (name == NULL) {
+	pa_warning(errno, "could not allocate log name");
+	return NULL;
+    }
+
+    snprintf(name, len, "%s%s", filename, PA_MMAP_LOG_SUFFIX);
+    return name;
+}
+
+/*
+ * Recover a PMF_COMMIT file before we map it.  A complete redo log
+ * is copied into the file; an incomplete one is thrown away.  Then
+ * anything past the committed length is trimmed.
+ */
+static int
+pa_mmap_recover (int fd, const char *filename, pa_mmap_flags_t flags)
+{
+    psu_boolean_t read_only = (flags & PMF_READ_ONLY) ? TRUE : FALSE;
+    char *log_name = pa_mmap_log_name(filename);
+    uint64_t *offsets = NULL, sum, i;
+    psu_byte_t *page = NULL;
+    pa_mmap_log_t log;
+    pa_mmap_info_t info;
+    struct stat st;
+    int lfd, rc = 0;
+
+    if (log_name == NULL)
+	return -1;
+
+    lfd = open(log_name, O_RDONLY);
+    if (lfd >= 0) {
+	bzero(&log, sizeof(log));
+	if (pa_mmap_pread(lfd, &log, sizeof(log), 0) < 0
+		|| log.pml_magic != PA_MMAP_LOG_MAGIC
+		|| log.pml_page_size < PA_MMAP_ATOM_SIZE
+		|| log.pml_count > (SIZE_MAX / log.pml_page_size))
+	    goto discard;
+
+	offsets = psu_malloc(log.pml_count * sizeof(*offsets) + 1);
+	page = psu_malloc(log.pml_page_size);
+	if (offsets == NULL || page == NULL) {
+	    pa_warning(errno, "could not allocate memory for recovery");
+	    rc = -1;
+	    goto done;
+	}
+
+	/* Check the whole log before we touch the file */
+	if (pa_mmap_pread(lfd, offsets, log.pml_count * sizeof(*offsets),
+			  sizeof(log)) < 0)
+	    goto discard;
+
+	sum = pa_mmap_log_sum(PA_MMAP_SUM_INIT, &log);
+	sum = pa_mmap_sum(sum, offsets, log.pml_count * sizeof(*offsets));
+	off_t base = sizeof(log) + log.pml_count * sizeof(*offsets);
+
+	for (i = 0; i < log.pml_count; i++) {
+	    if (pa_mmap_pread(lfd, page, log.pml_page_size,
+			      base + i * log.pml_page_size) < 0)
+		goto discard;
+	    sum = pa_mmap_sum(sum, page, log.pml_page_size);
+	}
+
+	if (sum != log.pml_sum)
+	    goto discard;
+
+	if (read_only) {
+	    pa_warning(0, "'%s' has a commit to recover; "
+		       "open read-write to apply it", filename);
+	    goto done;
+	}
+
+	for (i = 0; i < log.pml_count; i++) {
+	    size_t len = log.pml_page_size;
+	    if (offsets[i] >= log.pml_len)
+		continue;
+	    if (offsets[i] + len > log.pml_len)
+		len = log.pml_len - offsets[i];
+
+	    rc = pa_mmap_pread(lfd, page, len, base + i * log.pml_page_size);
+	    if (rc == 0) {
+		/* Logs written by older versions may hold lock state */
+		if (offsets[i] == 0 && len >= sizeof(info))
+		    pa_mmap_info_scrub((pa_mmap_info_t *) page);
+
+		rc = pa_mmap_pwrite(fd, page, len, offsets[i]);
+	    }
+
+	    if (rc < 0) {
+		pa_warning(errno, "could not recover commit to '%s'",
+			   filename);
+		goto done;
+	    }
+	}
+
+	if (ftruncate(fd, log.pml_len) < 0 || fsync(fd) < 0) {
+	    pa_warning(errno, "could not recover commit to '%s'", filename);
+	    rc = -1;
+	    goto done;
+	}
+
+	unlink(log_name);
+	pa_mmap_sync_dir(log_name);
+	goto done;
+
+    discard:
+	/* The commit never finished, so the file is as it was */
+	if (!read_only)
+	    unlink(log_name);
+	goto done;
+
+    done:
+	close(lfd);
+	psu_free(offsets);
+	psu_free(page);
+	if (rc < 0) {
+	    psu_free(log_name);
+	    return rc;
+	}
+    }
+
+    psu_free(log_name);
+
+    if (read_only || fstat(fd, &st) < 0
+	    || pa_mmap_pread(fd, &info, sizeof(info), 0) < 0
+	    || info.pmi_magic != PA_MAGIC_NUMBER)
+	return 0;
+
+    /* Space we grew into after the last commit isn't ours anymore */
+    if (info.pmi_len != 0 && (size_t) st.st_size > info.pmi_len) {
+	if (ftruncate(fd, info.pmi_len) < 0) {
+	    pa_warning(errno, "could not trim '%s'", filename);
+	    return -1;
+	}
+    }
+
+    /* Nobody can hold a lock in a file we have to ourselves */
+    if (info.pmi_lock || info.pmi_lock_waiters || (info.pmi_lock_seq & 1)) {
+	pa_mmap_info_scrub(&info);
+	if (pa_mmap_pwrite(fd, &info, sizeof(info), 0) < 0 || fsync(fd) < 0) {
+	    pa_warning(errno, "could not clear lock in '%s'", filename);
+	    return -1;
+	}
+    }
+
+    return 0;
+}
+
+static int
+pa_mmap_dirty_add (pa_mmap_t *pmp, uint64_t off)
+{
+    if (pmp->pm_dirty_count >= pmp->pm_dirty_size) {
+	size_t size = pmp->pm_dirty_size ? pmp->pm_dirty_size * 2 : 64;
+	uint64_t *dirty = psu_realloc(pmp->pm_dirty, size * sizeof(*dirty));
+	if (dirty == NULL)
+	    return -1;
+
+	pmp->pm_dirty = dirty;
+	pmp->pm_dirty_size = size;
+    }
+
+    pmp->pm_dirty[pmp->pm_dirty_count++] = off;
+    return 0;
+}
+
+/*
+ * Find the pages we've changed since the last commit.  Our mapping
+ * is private, so a changed page is one the kernel has copied for us.
+ * Linux will tell us which those are; elsewhere (or if it won't) we
+ * compare each page with the file.
+ */
+static int
+pa_mmap_dirty_scan (pa_mmap_t *pmp)
+{
+    size_t page_size = pmp->pm_page_size;
+    size_t npages = (pmp->pm_len + page_size - 1) / page_size;
+    size_t i, j, n, len;
+    psu_byte_t *buf;
+
+    pmp->pm_dirty_count = 0;
+
+#ifdef __linux__
+    int pfd = open("/proc/self/pagemap", O_RDONLY);
+    if (pfd >= 0) {
+	uint64_t ents[PA_MMAP_LOG_BATCH];
+	off_t base = ((uintptr_t) pmp->pm_addr / page_size) * sizeof(ents[0]);
+
+	for (i = 0; i < npages; i += n) {
+	    n = npages - i;
+	    if (n > PA_MMAP_LOG_BATCH)
+		n = PA_MMAP_LOG_BATCH;
+
+	    if (pa_mmap_pread(pfd, ents, n * sizeof(ents[0]),
+			      base + i * sizeof(ents[0])) < 0)
+		break;
+
+	    for (j = 0; j < n; j++) {
+		if (((ents[j] & PA_PAGEMAP_PRESENT)
+		     && !(ents[j] & PA_PAGEMAP_FILE))
+			|| (ents[j] & PA_PAGEMAP_SWAPPED)) {
+		    if (pa_mmap_dirty_add(pmp, (i + j) * page_size) < 0) {
+			close(pfd);
+			return -1;
+		    }
+		}
+	    }
+	}
+
+	close(pfd);
+	if (i >= npages)
+	    return 0;
+
+	pmp->pm_dirty_count = 0; /* Fall back to comparing */
+    }
+#endif /* __linux__ */
+
+    buf = psu_malloc(page_size);
+    if (buf == NULL)
+	return -1;
+
+    for (i = 0; i < npages; i++) {
+	len = page_size;
+	if (i * page_size + len > pmp->pm_len)
+	    len = pmp->pm_len - i * page_size;
+
+	if (pa_mmap_pread(pmp->pm_fd, buf, len, i * page_size) < 0
+		|| memcmp(buf, pmp->pm_addr + i * page_size, len) != 0) {
+	    if (pa_mmap_dirty_add(pmp, i * page_size) < 0) {
+		psu_free(buf);
+		return -1;
+	    }
+	}
+    }
+
+    psu_free(buf);
+    return 0;
+}
+
+/*
+ * Write our changed pages to the redo log, and sync it
+ */
+static int
+pa_mmap_log_write (pa_mmap_t *pmp)
+{
+    size_t page_size = pmp->pm_page_size;
+    pa_mmap_log_t log;
+    psu_byte_t *buf;
+    uint64_t sum;
+    size_t i, len;
+    off_t base;
+    int lfd;
+
+    if (pa_mmap_dirty_scan(pmp) < 0) {
+	pa_warning(errno, "could not find changed pages");
+	return -1;
+    }
+
+    lfd = open(pmp->pm_log_name, O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if (lfd < 0) {
+	pa_warning(errno, "could not create log: '%s'", pmp->pm_log_name);
+	return -1;
+    }
+
+    buf = psu_calloc(page_size);
+    if (buf == NULL)
+	goto fail;
+
+    bzero(&log, sizeof(log));
+    log.pml_page_size = page_size;
+    log.pml_count = pmp->pm_dirty_count;
+    log.pml_len = pmp->pm_len;
+
+    len = pmp->pm_dirty_count * sizeof(pmp->pm_dirty[0]);
+    if (pa_mmap_pwrite(lfd, pmp->pm_dirty, len, sizeof(log)) < 0)
+	goto fail;
+
+    sum = pa_mmap_log_sum(PA_MMAP_SUM_INIT, &log);
+    sum = pa_mmap_sum(sum, pmp->pm_dirty, len);
+    base = sizeof(log) + len;
+
+    for (i = 0; i < pmp->pm_dirty_count; i++) {
+	/* The last page may run past our end; pad it */
+	len = page_size;
+	if (pmp->pm_dirty[i] + len > pmp->pm_len)
+	    len = pmp->pm_len - pmp->pm_dirty[i];
+
+	bzero(buf + len, page_size - len);
+	memcpy(buf, pmp->pm_addr + pmp->pm_dirty[i], len);
+	if (pmp->pm_dirty[i] == 0)
+	    pa_mmap_info_scrub((pa_mmap_info_t *) buf);
+
+	if (pa_mmap_pwrite(lfd, buf, page_size, base + i * page_size) < 0)
+	    goto fail;
+	sum = pa_mmap_sum(sum, buf, page_size);
+    }
+
+    /* The header goes last, once everything else is safe */
+    if (fsync(lfd) < 0)
+	goto fail;
+
+    log.pml_magic = PA_MMAP_LOG_MAGIC;
+    log.pml_sum = sum;
+    if (pa_mmap_pwrite(lfd, &log, sizeof(log), 0) < 0 || fsync(lfd) < 0)
+	goto fail;
+
+    /* We made a new file, so the log isn't safe until its directory is */
+    if (pa_mmap_sync_dir(pmp->pm_log_name) < 0)
+	goto fail;
+
+    psu_free(buf);
+    close(lfd);
+    return 0;
+
+ fail:
+    pa_warning(errno, "could not write log: '%s'", pmp->pm_log_name);
+    psu_free(buf);
+    close(lfd);
+    unlink(pmp->pm_log_name);
+    return -1;
+}
+
+/*
+ * Our snapshots map the file privately, so their untouched pages are
+ * the file's own.  Before a commit overwrites those pages, we write
+ * to them (with the same bytes), making the kernel give each
+ * snapshot a private copy of the old contents.
+ */
+static void
+pa_mmap_snapshot_preserve (pa_mmap_t *pmp)
+{
+    volatile psu_byte_t *cp;
+    pa_mmap_t *snap;
+    size_t i;
+
+    for (snap = pmp->pm_snapshots; snap; snap = snap->pm_snap_next) {
+	if (mprotect(snap->pm_addr, snap->pm_len,
+		     PROT_READ | PROT_WRITE) < 0) {
+	    pa_warning(errno, "could not preserve snapshot");
+	    continue;
+	}
+
+	for (i = 0; i < pmp->pm_dirty_count; i++) {
+	    if (pmp->pm_dirty[i] >= snap->pm_len)
+		continue;
+
+	    cp = snap->pm_addr + pmp->pm_dirty[i];
+	    *cp = *cp;
+	}
+
+	mprotect(snap->pm_addr, snap->pm_len, PROT_READ);
+    }
+}
+
+/*
+ * Copy our changed pages into the file, then drop our private copies
+ * of them by mapping the file's (now identical) pages in their place
+ */
+static int
+pa_mmap_log_apply (pa_mmap_t *pmp)
+{
+    size_t page_size = pmp->pm_page_size;
+    pa_mmap_info_t info;
+    size_t i, j, len;
+    uint64_t off;
+    void *addr;
+
+    pa_mmap_snapshot_preserve(pmp);
+
+    for (i = 0; i < pmp->pm_dirty_count; i++) {
+	len = page_size;
+	if (pmp->pm_dirty[i] + len > pmp->pm_len)
+	    len = pmp->pm_len - pmp->pm_dirty[i];
+
+	if (pa_mmap_pwrite(pmp->pm_fd, pmp->pm_addr + pmp->pm_dirty[i],
+			   len, pmp->pm_dirty[i]) < 0)
+	    goto fail;
+
+	if (pmp->pm_dirty[i] == 0) {
+	    info = *pmp->pm_infop;
+	    pa_mmap_info_scrub(&info);
+	    if (pa_mmap_pwrite(pmp->pm_fd, &info, sizeof(info), 0) < 0)
+		goto fail;
+	}
+    }
+
+    if (fsync(pmp->pm_fd) < 0)
+	goto fail;
+
+    /*
+     * If we crash before the unlink reaches the disk, the log is
+     * replayed when the file is next opened.  That's harmless: it
+     * holds exactly the pages we just wrote, and no later commit can
+     * start until a new log has replaced this one.
+     */
+    unlink(pmp->pm_log_name);
+    pa_mmap_sync_dir(pmp->pm_log_name);
+
+    for (i = 0; i < pmp->pm_dirty_count; i = j) {
+	off = pmp->pm_dirty[i];
+	for (j = i + 1; j < pmp->pm_dirty_count; j++)
+	    if (pmp->pm_dirty[j] != off + (j - i) * page_size)
+		break;
+
+	len = (j - i) * page_size;
+
+	/* Our copy of the header page holds our lock; the file's doesn't */
+	if (off == 0) {
+	    off += page_size;
+	    len -= page_size;
+	}
+	if (len == 0 || off >= pmp->pm_len)
+	    continue;
+	if (off + len > pmp->pm_len)
+	    len = pmp->pm_len - off;
+
+	addr = mmap(pmp->pm_addr + off, len, pmp->pm_mmap_prot,
+		    pmp->pm_mmap_flags | MAP_FIXED, pmp->pm_fd, off);
+	if (addr != pmp->pm_addr + off)
+	    pa_warning(errno, "could not remap committed pages; ignored");
+    }
+
+    pmp->pm_dirty_count = 0;
+    return 0;
+
+ fail:
+    /* The log is complete, so the next open will finish this */
+    pa_warning(errno, "could not commit to file");
+    return -1;
+}
+
+int
+pa_mmap_commit_prepare (pa_mmap_t *pmp)
 {
-    pa_mmap_atom_t fa;		/* Free atom number */
-    pa_mmap_free_t *pmfp;
-    pa_mmap_atom_t *lastp = &pmp->pm_infop->pmi_free;
+    int rc = 0;
 
-    for (fa = *lastp; !pa_mmap_is_null(fa); fa = *lastp) {
-	pmfp = pa_mmap_addr(pmp, fa);
+    if (!(pmp->pm_flags & PMF_COMMIT))
+	return 0;
 
-	if (size <= pmfp->pmf_size)
-	    break;
+    pa_lock(pmp->pm_lock);
 
-	lastp = &pmfp->pmf_next; /* Move to next item on free list */
+    if (!pmp->pm_prepared) {
+	rc = pa_mmap_log_write(pmp);
+	if (rc == 0)
+	    pmp->pm_prepared = TRUE;
     }
 
-    /* Insert atom into the chain */
-    pmfp = pa_mmap_addr(pmp, atom);
-    pmfp->pmf_magic = PA_MMAP_FREE_MAGIC;
-    pmfp->pmf_size = size;
-    pmfp->pmf_next = *lastp;
-    *lastp = atom;
+    pa_unlock(pmp->pm_lock);
+    return rc;
 }
 
-/*
- * Allocate a chunk of memory and return its offset.
- */
-pa_mmap_atom_t
-pa_mmap_alloc (pa_mmap_t *pmp, size_t size)
+int
+pa_mmap_commit (pa_mmap_t *pmp)
 {
-    if (size == 0) {
-	pa_warning(0, "pa_mmap_alloc called with zero size");
-	return pa_mmap_null_atom();
-    }
-
-    pa_mmap_atom_t fa;		/* Free atom number */
-    unsigned count = (size + PA_MMAP_ATOM_SIZE - 1) >> PA_MMAP_ATOM_SHIFT;
-    unsigned new_count;
-    pa_mmap_free_t *pmfp;
-    pa_mmap_atom_t *lastp = &pmp->pm_infop->pmi_free;
+    int rc = 0;
 
-    for (fa = *lastp; !pa_mmap_is_null(fa); fa = *lastp) {
-	pmfp = pa_mmap_addr(pmp, fa);
+    if (!(pmp->pm_flags & PMF_COMMIT)) {
+	if (pmp->pm_fd > 0 && msync(pmp->pm_addr, pmp->pm_len, MS_SYNC) < 0) {
+	    pa_warning(errno, "could not sync segment");
+	    return -1;
+	}
+	return 0;
+    }
 
-	if (pmfp->pmf_size >= count) {
-	    /*
-	     * We "cheat", allocating from the end so we don't need to
-	     * touch the current by_addr list.  We'll still have to mung
-	     * the by_size list.
-	     */
-	    if (count < pmfp->pmf_size) {
-		pmfp->pmf_size -= count;
-		fa.pma_atom += pmfp->pmf_size; /* Reference end of the chunk */
-	    } else
-		*lastp = pmfp->pmf_next; /* Unlink this chunk */
+    pa_lock(pmp->pm_lock);
 
-	    return fa;		/* Return offset */
-	}
+    if (!pmp->pm_prepared)
+	rc = pa_mmap_log_write(pmp);
 
-	lastp = &pmfp->pmf_next;
+    if (rc == 0) {
+	rc = pa_mmap_log_apply(pmp);
+	pmp->pm_prepared = FALSE;
     }
 
-    /*
-     * Okay, so there's nothing but enough to fit this, but we do
-     * know that *lastp is the end of the free list.  So we grow our
-     * database, and toss the excess onto the free list.
-     */
-    if (count < PA_DEFAULT_COUNT)
-	new_count = PA_DEFAULT_COUNT;
-    else
-	new_count = pa_roundup32(count, PA_DEFAULT_COUNT);
+    pa_unlock(pmp->pm_lock);
+    return rc;
+}
 
-    size_t new_len = pmp->pm_len + (new_count << PA_MMAP_ATOM_SHIFT);
-    size_t old_len = pmp->pm_len;
+/*
+ * A PMF_COMMIT segment is mapped privately, so the lock in its header
+ * only works between our own threads, and other processes couldn't
+ * see our changes anyway.  A file lock keeps a second writer (in this
+ * process or another) from opening it at the same time.
+ */
+static int
+pa_mmap_commit_claim (int fd, const char *filename, pa_mmap_flags_t flags)
+{
+    if (!(flags & PMF_COMMIT) || (flags & PMF_READ_ONLY))
+	return 0;
 
-    if (pmp->pm_infop->pmi_max_size != 0
-	&& new_len > pmp->pm_infop->pmi_max_size) {
-	pa_warning(0, "max size reached");
-	return pa_mmap_null_atom();
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+	pa_warning(errno, "'%s' is already open for commits", filename);
+	return -1;
     }
 
-    /* If we've got a file attached, we need to extend the file */
-    if (pmp->pm_fd > 0) {
-	if (ftruncate(pmp->pm_fd, new_len) < 0) {
-	    pa_warning(errno, "cannot extend memory file to %d", new_len);
-	    return pa_mmap_null_atom();
-	}
+    return 0;
+}
 
-	/* Re-mmap the segment */
-	void *addr = mmap(pmp->pm_addr, new_len, pmp->pm_mmap_prot,
-			  pmp->pm_mmap_flags | MAP_FIXED | MAP_SHARED,
-			  pmp->pm_fd, 0);
-	if (addr == NULL || addr == MAP_FAILED) {
-	    pa_warning(errno, "mmap failed");
-	    return pa_mmap_null_atom();
-	}
+pa_mmap_t *
+pa_mmap_snapshot (pa_mmap_t *pmp)
+{
+    size_t page_size = pmp->pm_page_size;
+    pa_mmap_t *snap;
+    psu_byte_t *addr;
+    size_t i, len;
+    uint32_t seq;
+
+    snap = psu_calloc(sizeof(*snap));
+    if (snap == NULL) {
+	pa_warning(errno, "could not allocate memory for snapshot");
+	return NULL;
+    }
 
-	if (addr != pmp->pm_addr) {
-	    pa_warning(0, "mmap was moved (%p:%p)", pmp->pm_addr, addr);
-	    return pa_mmap_null_atom();
+    /* Keep writers out until we've got a consistent copy */
+    pa_mmap_read_lock(pmp);
+    pa_lock(pmp->pm_lock);
+
+    if (pmp->pm_flags & PMF_COMMIT) {
+	/* A prepared commit has already found our changed pages */
+	if (!pmp->pm_prepared && pa_mmap_dirty_scan(pmp) < 0) {
+	    pa_warning(errno, "could not find changed pages");
+	    goto fail;
 	}
 
-    } else {
-	/*
-	 * With mmap and no file, we can't extend our mapping, so
-	 * we map a new segment at the end of our current one and
-	 * record that fact so we can unmap it during close.
-	 */
+	addr = mmap(NULL, pmp->pm_len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_FILE, pmp->pm_fd, 0);
+	if (addr == MAP_FAILED)
+	    goto fail_mmap;
 
-	uint8_t *target = pmp->pm_addr;
-	target += old_len;
+	for (i = 0; i < pmp->pm_dirty_count; i++) {
+	    len = page_size;
+	    if (pmp->pm_dirty[i] + len > pmp->pm_len)
+		len = pmp->pm_len - pmp->pm_dirty[i];
 
-	void *addr = mmap(target, new_len - old_len, pmp->pm_mmap_prot,
-			  pmp->pm_mmap_flags | MAP_FIXED | MAP_SHARED,
-			  pmp->pm_fd, 0);
-	if (addr == NULL || addr == MAP_FAILED) {
-	    pa_warning(errno, "mmap failed");
-	    return pa_mmap_null_atom();
+	    memcpy(addr + pmp->pm_dirty[i], pmp->pm_addr + pmp->pm_dirty[i],
+		   len);
 	}
 
-	if (addr != target) {
-	    pa_warning(0, "mmap was moved (%p:%p:%p)",
-		       pmp->pm_addr, target, addr);
-	    return pa_mmap_null_atom();
-	}
+	snap->pm_parent = pmp;
+	snap->pm_snap_next = pmp->pm_snapshots;
+	pmp->pm_snapshots = snap;
 
-	pa_mmap_record_t *pmrp = psu_calloc(sizeof(*pmrp));
-	if (pmrp) {
-	    pmrp->pmr_addr = target;
-	    pmrp->pmr_len = new_len - old_len;
-	    pmrp->pmr_next = pmp->pm_record;
-	    pmp->pm_record = pmrp;
-	}
+    } else {
+	addr = mmap(NULL, pmp->pm_len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (addr == MAP_FAILED)
+	    goto fail_mmap;
+
+	/*
+	 * Our read lock does nothing for a PMF_READ_ONLY segment, so
+	 * we copy again if a writer got in while we were copying
+	 */
+	do {
+	    seq = pa_mmap_read_begin(pmp);
+	    memcpy(addr, pmp->pm_addr, pmp->pm_len);
+	} while (pa_mmap_read_retry(pmp, seq));
     }
 
-    pmp->pm_len = new_len;	/* Record our new length */
-    /* We'll use the first chunk for this allocation */
-    fa = pa_mmap_atom(old_len >> PA_MMAP_ATOM_SHIFT);
+    /* Our readers' lock was copied too */
+    pa_mmap_info_scrub((pa_mmap_info_t *) addr);
 
-    if (new_count > count) {
-	/* Put the rest on the free list */
-	pa_mmap_atom_t na = { fa.pma_atom + count };
+    if (mprotect(addr, pmp->pm_len, PROT_READ) < 0)
+	pa_warning(errno, "could not protect snapshot; ignored");
 
-	pmfp = pa_mmap_addr(pmp, na);
-	pmfp->pmf_magic = PA_MMAP_FREE_MAGIC;
-	pmfp->pmf_size = new_count - count;
-	pmfp->pmf_next = pa_mmap_null_atom();
+    snap->pm_fd = -1;
+    snap->pm_flags = PMF_READ_ONLY;
+    snap->pm_mmap_prot = PROT_READ;
+    snap->pm_addr = addr;
+    snap->pm_len = pmp->pm_len;
+    snap->pm_align = pmp->pm_align;
+    snap->pm_infop = (void *) addr;
 
-	*lastp = na;		/* Add 'na' to the free list */
-    }
+    pa_unlock(pmp->pm_lock);
+    pa_mmap_read_unlock(pmp);
+    return snap;
 
-    return fa;
+ fail_mmap:
+    pa_warning(errno, "could not map snapshot");
+ fail:
+    pa_unlock(pmp->pm_lock);
+    pa_mmap_read_unlock(pmp);
+    psu_free(snap);
+    return NULL;
 }
 
-void
-pa_mmap_free (pa_mmap_t *pmp, pa_mmap_atom_t atom, unsigned size)
+#ifdef MAP_HUGETLB
+/*
+ * Return the alignment for PMF_HUGETLB segments, from "huge-page-size".
+ * We use it as a mask, so it must be a power of two, and it can't be
+ * smaller than a normal page; we round up anything else.
+ */
+static size_t
+pa_mmap_huge_align (const char *base)
 {
-    if (pa_mmap_is_null(atom)) {
-	pa_warning(0, "pa_mmap_free called with NULL");
-	return;
-    }
+    size_t want = pa_config_value32(base, "huge-page-size",
+				    PA_HUGE_PAGE_SIZE);
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t align = (page_size > 0) ? (size_t) page_size : PA_MMAP_ATOM_SIZE;
 
-    unsigned count = pa_items_shift32(size, PA_MMAP_ATOM_SHIFT);
-    if (count == 0) {
-	pa_warning(0, "pa_mmap_free called with count 0");
-	return;
-    }
+    while (align < want)
+	align <<= 1;
+
+    if (align != want)
+	pa_warning(0, "huge-page-size %zu is not a power of two of at "
+		   "least the page size; using %zu", want, align);
 
-    pa_mmap_list_add(pmp, atom, count);
+    return align;
 }
+#endif /* MAP_HUGETLB */
 
 pa_mmap_t *
 pa_mmap_open (const char *filename, const char *base,
@@ -274,8 +1396,11 @@ pa_mmap_open (const char *filename, const char *base,
     pa_mmap_info_t *pmip = NULL;
     pa_mmap_t *pmp = NULL;
     int created = 0;
-    unsigned len = 0;
+    size_t len = 0;
+    size_t align = PA_MMAP_ATOM_SIZE;
+    size_t reserve;
     psu_byte_t *addr = NULL;
+    int rc;
 
     if (flags & PMF_READ_ONLY) {
 	prot = PROT_READ;
@@ -302,15 +1427,24 @@ pa_mmap_open (const char *filename, const char *base,
 		goto fail;
 	    }
 
-	    len = pa_config_value32(base, "size", PA_DEFAULT_SIZE);
-	    if (ftruncate(fd, len) < 0) {
-		pa_warning(errno, "could not extend file length (%d)", len);
+	    if (pa_mmap_commit_claim(fd, filename, flags) < 0)
+		goto fail;
+
+	    len = pa_config_value64(base, "size", PA_DEFAULT_SIZE);
+	    if (ftruncate(fd, (off_t) len) < 0) {
+		pa_warning(errno, "could not extend file length (%zu)", len);
 		goto fail;
 	    }
 
 	    created = 1;
 
 	} else {
+	    if (pa_mmap_commit_claim(fd, filename, flags) < 0)
+		goto fail;
+
+	    if ((flags & PMF_COMMIT) && pa_mmap_recover(fd, filename, flags))
+		goto fail;
+
 	    if (fstat(fd, &st)) {
 		pa_warning(errno, "could not stat file: '%s'", filename);
 		goto fail;
@@ -321,24 +1455,99 @@ pa_mmap_open (const char *filename, const char *base,
 
 	mmap_flags |= MAP_FILE;
 
+	/* Our changes stay private until they're committed */
+	if ((flags & PMF_COMMIT) && !(flags & PMF_READ_ONLY))
+	    mmap_flags = (mmap_flags & ~MAP_SHARED) | MAP_PRIVATE;
+
+	if (flags & PMF_HUGETLB)
+	    pa_warning(0, "hugetlb pages need an anonymous segment; ignored");
+
     } else {
 	/* Without a filename, we build an anonymos mmap segment */
 	fd = -1;
+	flags &= ~PMF_COMMIT;
 	mmap_flags |= MAP_ANON;
 	len = PA_DEFAULT_SIZE;
 	created = 1;
+
+#ifdef MAP_HUGETLB
+	if (flags & PMF_HUGETLB) {
+	    align = pa_mmap_huge_align(base);
+	    len = (len + align - 1) & ~(align - 1);
+	    mmap_flags |= MAP_HUGETLB;
+	}
+#else /* MAP_HUGETLB */
+	if (flags & PMF_HUGETLB)
+	    pa_warning(0, "hugetlb pages are not supported; ignored");
+#endif /* MAP_HUGETLB */
     }
 
+#ifdef MAP_POPULATE
+    /*
+     * If we can let mmap fault in our pages, we do, but huge page
+     * advice has to be given before pages are faulted in, so that
+     * case is left to pa_mmap_advise.
+     */
+    if ((flags & PMF_PREFAULT) && !(flags & (PMF_HUGE_PAGES | PMF_COMMIT)))
+	mmap_flags |= MAP_POPULATE;
+#endif /* MAP_POPULATE */
+
+    /*
+     * We reserve the address range our segment can grow into, up to
+     * the distance to the next segment's address.  Growth then maps
+     * the new space in place, without stacking separate segments.
+     */
+    reserve = (size_t) pa_config_value64(base, "reserve-atoms",
+			PA_ADDR_DEFAULT_INCR >> PA_MMAP_ATOM_SHIFT);
+    if (reserve > ((size_t) pa_mmap_incr_address >> PA_MMAP_ATOM_SHIFT))
+	reserve = (size_t) pa_mmap_incr_address >> PA_MMAP_ATOM_SHIFT;
+    reserve <<= PA_MMAP_ATOM_SHIFT;
+    if (reserve <= len)
+	reserve = 0;
+
     for (;;) {
 	if (pa_mmap_next_address > (psu_byte_t *) PA_ADDR_MAX)
 	    goto fail;
 
-	addr = mmap(pa_mmap_next_address, len, prot, mmap_flags | MAP_SHARED,
-		    fd, 0);
+	if (reserve != 0) {
+	    rc = pa_mmap_reserve(pa_mmap_next_address, reserve);
+	    if (rc > 0) {
+		/* Something's already mapped there; try the next one */
+		pa_mmap_next_address += pa_mmap_incr_address;
+		continue;
+	    }
+
+	    if (rc < 0) {
+		pa_warning(errno, "could not reserve address space (%zu); "
+			   "ignored", reserve);
+		reserve = 0;
+	    }
+	}
+
+	addr = mmap(pa_mmap_next_address, len, prot, mmap_flags, fd, 0);
 	if (addr == pa_mmap_next_address) /* Success */
 	    break;
 
+	if (reserve != 0) {
+	    int save_errno = errno;
+	    munmap(pa_mmap_next_address, reserve);
+	    errno = save_errno;
+	}
+
 	if (addr == NULL || addr == MAP_FAILED) {
+	    addr = NULL;
+
+#ifdef MAP_HUGETLB
+	    if (mmap_flags & MAP_HUGETLB) {
+		/* Huge pages might not be reserved; use normal ones */
+		pa_warning(errno, "hugetlb mmap failed; using normal pages");
+		mmap_flags &= ~MAP_HUGETLB;
+		align = PA_MMAP_ATOM_SIZE;
+		len = PA_DEFAULT_SIZE;
+		continue;
+	    }
+#endif /* MAP_HUGETLB */
+
 	    pa_warning(errno, "mmap failed (%p.vs.%p)",
 		       addr, pa_mmap_next_address);
 	    if (errno != EINVAL)
@@ -349,6 +1558,7 @@ pa_mmap_open (const char *filename, const char *base,
 	} else if (addr != pa_mmap_next_address) {
 	    pa_warning(errno, "mmap returns wrong address (%p.vs.%p)",
 		       addr, pa_mmap_next_address);
+	    reserve = 0;
 	    goto fail;
 	}
     }
@@ -360,18 +1570,9 @@ pa_mmap_open (const char *filename, const char *base,
 	pmip->pmi_magic = PA_MAGIC_NUMBER;
 	pmip->pmi_vers_major = PA_VERS_MAJOR;
 	pmip->pmi_vers_minor = PA_VERS_MINOR;
+	pmip->pmi_atom_shift = PA_ATOM_SHIFT;
 	pmip->pmi_len = len;
-	pmip->pmi_max_size = pa_config_value32(base, "max-size", 0);
-
-	/* We waste the rest of the first atom, but we're atom aligned */
-	pmip->pmi_free = pa_mmap_atom(1);
-
-	/* Make the first entry in the free list */
-	pa_mmap_free_t *pmfp;
-	pmfp = pa_pointer(addr, 1, PA_MMAP_ATOM_SHIFT);
-	pmfp->pmf_magic = PA_MMAP_FREE_MAGIC;
-	pmfp->pmf_size = (len >> PA_MMAP_ATOM_SHIFT) - 1;
-
+	pmip->pmi_max_size = pa_config_value64(base, "max-size", 0);
 
     } else {
 	/* Check header fields */
@@ -389,16 +1590,26 @@ pa_mmap_open (const char *filename, const char *base,
 		       pmip->pmi_vers_major, PA_VERS_MAJOR);
 	    goto fail;
 
+	} else if ((pmip->pmi_atom_shift ?: 2) != PA_ATOM_SHIFT) {
+	    /* Files from before pmi_atom_shift have zero (32-bit atoms) */
+	    pa_warning(0, "atom size mismatch (%d:%d); see --enable-wide-atoms",
+		       1 << (pmip->pmi_atom_shift ?: 2), 1 << PA_ATOM_SHIFT);
+	    goto fail;
+
 	} else if (pmip->pmi_vers_minor != PA_VERS_MINOR) {
 	    pa_warning(0, "minor version number mismatch (%d:%d); "
 		       "ignored", pmip->pmi_vers_minor, PA_VERS_MINOR);
 
 	} else if (pmip->pmi_len != len) {
-	    pa_warning(0, "memory size mismatch (%d:%d); "
+	    pa_warning(0, "memory size mismatch (%zu:%zu); "
 		       "ignored", pmip->pmi_len, len);
 	} else {
 	    /* Success!! */
 	}
+
+	/* Our private copy starts unlocked, whatever the file says */
+	if ((flags & PMF_COMMIT) && !(flags & PMF_READ_ONLY))
+	    pa_mmap_info_scrub(pmip);
     }
 
     /*
@@ -418,8 +1629,59 @@ pa_mmap_open (const char *filename, const char *base,
     pmp->pm_infop = pmip;
     pmp->pm_mmap_flags = mmap_flags;
     pmp->pm_mmap_prot = prot;
+    pmp->pm_align = align;
+    pmp->pm_reserve = reserve;
+    pmp->pm_grow_percent = pa_config_value32(base, "grow-percent",
+					     PA_DEFAULT_GROW_PERCENT);
+    pmp->pm_grow_min = pa_config_value32(base, "grow-min",
+					 PA_DEFAULT_GROW_MIN);
+    pmp->pm_grow_max = pa_config_value32(base, "grow-max", 0);
+
+    if (flags & PMF_THREAD_SAFE) {
+	pmp->pm_lock = pa_lock_create();
+	if (pmp->pm_lock == NULL) {
+	    pa_warning(0, "thread-safe mode is not available; ignored");
+	    pmp->pm_flags &= ~PMF_THREAD_SAFE;
+	}
+    }
+
+    pa_mmap_advise(pmp, addr, len);
+
+    /*
+     * Warm start pages in an existing database now, so the first
+     * lookups don't each stall on a page fault.  PMF_PREFAULT has
+     * already done this.
+     */
+    if ((flags & PMF_WARM_START) && !(flags & PMF_PREFAULT))
+	pa_mmap_prefault(pmp, addr, len);
+
+    if (flags & PMF_COMMIT) {
+	pmp->pm_page_size = sysconf(_SC_PAGESIZE);
+	if (pmp->pm_page_size < PA_MMAP_ATOM_SIZE)
+	    pmp->pm_page_size = PA_MMAP_ATOM_SIZE;
+
+	pmp->pm_log_name = pa_mmap_log_name(filename);
+	if (pmp->pm_log_name == NULL) {
+	    pa_mmap_close(pmp);
+	    return NULL;
+	}
+    }
+
+    if (created) {
+	/*
+	 * We waste the rest of the first atom, but we're atom aligned.
+	 * Everything after that makes the first entry in the free list.
+	 */
+	pa_mmap_list_add(pmp, pa_mmap_atom(1), (len >> PA_MMAP_ATOM_SHIFT) - 1);
+
+	/* A new file needs a header before anyone can open it */
+	if ((flags & PMF_COMMIT) && pa_mmap_commit(pmp) < 0) {
+	    pa_mmap_close(pmp);
+	    return NULL;
+	}
+    }
 
-    if (fd < 0) {
+    if (fd < 0 && reserve == 0) {
 	pa_mmap_record_t *pmrp = psu_calloc(sizeof(*pmrp));
 	if (pmrp) {
 	    pmrp->pmr_addr = addr;
@@ -432,7 +1694,7 @@ pa_mmap_open (const char *filename, const char *base,
 
  fail:
     if (addr != NULL)
-	munmap(addr, len);
+	munmap(addr, reserve ? reserve : len);
     if (fd > 0)
 	close(fd);
 
@@ -445,6 +1707,24 @@ pa_mmap_open (const char *filename, const char *base,
 void
 pa_mmap_close (pa_mmap_t *pmp)
 {
+    pa_mmap_t **snapp, *snap;
+
+    /* A snapshot leaves its parent's list; a parent lets go of its own */
+    if (pmp->pm_parent) {
+	pa_lock(pmp->pm_parent->pm_lock);
+	for (snapp = &pmp->pm_parent->pm_snapshots; *snapp;
+	     snapp = &(*snapp)->pm_snap_next) {
+	    if (*snapp == pmp) {
+		*snapp = pmp->pm_snap_next;
+		break;
+	    }
+	}
+	pa_unlock(pmp->pm_parent->pm_lock);
+    }
+
+    for (snap = pmp->pm_snapshots; snap; snap = snap->pm_snap_next)
+	snap->pm_parent = NULL;
+
     if (pmp->pm_record) {
 	pa_mmap_record_t *pmrp = pmp->pm_record, *nextp;
 	for (; pmrp; pmrp = nextp) {
@@ -453,23 +1733,210 @@ pa_mmap_close (pa_mmap_t *pmp)
 	    psu_free(pmrp);
 	}
     } else {
+	/* A reservation covers our whole segment and then some */
 	if (pmp->pm_addr != NULL)
-	    munmap(pmp->pm_addr, pmp->pm_len);
+	    munmap(pmp->pm_addr,
+		   pmp->pm_reserve ? pmp->pm_reserve : pmp->pm_len);
     }
 
     if (pmp->pm_fd > 0)
 	close(pmp->pm_fd);
 
+    pa_lock_destroy(pmp->pm_lock);
+    psu_free(pmp->pm_log_name);
+    psu_free(pmp->pm_dirty);
     psu_free(pmp);
 }
 
+/*
+ * The segment's reader/writer lock lives in the segment header, so
+ * every process that maps the segment shares it.  The lock word holds
+ * the number of readers, plus PA_MMAP_LOCK_WRITER when a writer holds
+ * the lock or is waiting for the readers to drain.  Taking or
+ * dropping an uncontended lock is a single atomic operation, with no
+ * system calls.  Waiters spin a while, then sleep on the lock word
+ * (using a futex, where we have them) or yield the CPU.
+ *
+ * Writers win: once a writer sets its bit, new readers wait.  Writers
+ * also bump pmi_lock_seq, making it odd while they hold the lock, so
+ * readers that can't write to the segment (PMF_READ_ONLY) can read
+ * optimistically and retry (see pa_mmap_read_begin()).
+ *
+ * The lock isn't robust: a process that dies holding it leaves it
+ * held.
+ */
+#define PA_MMAP_LOCK_WRITER	(1U << 31) /* A writer has (or wants) it */
+#define PA_MMAP_LOCK_SPINS	100 /* Spins before we sleep */
+
+static inline void
+pa_mmap_lock_relax (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif /* __x86_64__ || __i386__ */
+}
+
+/*
+ * Wait for the lock word to change from "seen"
+ */
+static void
+pa_mmap_lock_wait (pa_mmap_info_t *pmip, uint32_t seen, unsigned *spinsp)
+{
+    if (*spinsp < PA_MMAP_LOCK_SPINS) {
+	*spinsp += 1;
+	pa_mmap_lock_relax();
+	return;
+    }
+
+#ifdef PA_MMAP_FUTEX
+    /*
+     * The waiter count must be visible before we check the lock
+     * word, and the futex call checks it for us, so an unlock
+     * between the two either sees us or changes the word.
+     */
+    __atomic_add_fetch(&pmip->pmi_lock_waiters, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &pmip->pmi_lock, FUTEX_WAIT, seen, NULL, NULL, 0);
+    __atomic_sub_fetch(&pmip->pmi_lock_waiters, 1, __ATOMIC_SEQ_CST);
+#elif defined(HAVE_SCHED_YIELD)
+    (void) pmip;
+    (void) seen;
+    sched_yield();
+#else /* HAVE_SCHED_YIELD */
+    (void) pmip;
+    (void) seen;
+    pa_mmap_lock_relax();
+#endif /* PA_MMAP_FUTEX */
+}
+
+static inline void
+pa_mmap_lock_wake (pa_mmap_info_t *pmip UNUSED)
+{
+#ifdef PA_MMAP_FUTEX
+    if (__atomic_load_n(&pmip->pmi_lock_waiters, __ATOMIC_SEQ_CST))
+	syscall(SYS_futex, &pmip->pmi_lock, FUTEX_WAKE, INT_MAX,
+		NULL, NULL, 0);
+#endif /* PA_MMAP_FUTEX */
+}
+
+void
+pa_mmap_read_lock (pa_mmap_t *pmp)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    uint32_t val;
+    unsigned spins = 0;
+
+    if (pmp->pm_flags & PMF_READ_ONLY)
+	return;
+
+    val = __atomic_load_n(&pmip->pmi_lock, __ATOMIC_RELAXED);
+    for (;;) {
+	if (!(val & PA_MMAP_LOCK_WRITER)) {
+	    /* On failure, "val" is reloaded for us */
+	    if (__atomic_compare_exchange_n(&pmip->pmi_lock, &val, val + 1,
+			FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+	    continue;
+	}
+
+	pa_mmap_lock_wait(pmip, val, &spins);
+	val = __atomic_load_n(&pmip->pmi_lock, __ATOMIC_RELAXED);
+    }
+}
+
+void
+pa_mmap_read_unlock (pa_mmap_t *pmp)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+
+    if (pmp->pm_flags & PMF_READ_ONLY)
+	return;
+
+    /* The last reader out lets a waiting writer in */
+    if (__atomic_sub_fetch(&pmip->pmi_lock, 1, __ATOMIC_SEQ_CST)
+	    == PA_MMAP_LOCK_WRITER)
+	pa_mmap_lock_wake(pmip);
+}
+
+void
+pa_mmap_write_lock (pa_mmap_t *pmp)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    uint32_t val;
+    unsigned spins = 0;
+
+    if (pmp->pm_flags & PMF_READ_ONLY)
+	return;
+
+    /* First, claim the writer bit, which keeps out new readers */
+    val = __atomic_load_n(&pmip->pmi_lock, __ATOMIC_RELAXED);
+    for (;;) {
+	if (!(val & PA_MMAP_LOCK_WRITER)) {
+	    if (__atomic_compare_exchange_n(&pmip->pmi_lock, &val,
+			val | PA_MMAP_LOCK_WRITER, FALSE,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		break;
+	    continue;
+	}
+
+	pa_mmap_lock_wait(pmip, val, &spins);
+	val = __atomic_load_n(&pmip->pmi_lock, __ATOMIC_RELAXED);
+    }
+
+    /* Then wait for the readers we let in to leave */
+    spins = 0;
+    for (;;) {
+	val = __atomic_load_n(&pmip->pmi_lock, __ATOMIC_ACQUIRE);
+	if (val == PA_MMAP_LOCK_WRITER)
+	    break;
+	pa_mmap_lock_wait(pmip, val, &spins);
+    }
+
+    /* Our changes can't be seen before the odd sequence number */
+    __atomic_add_fetch(&pmip->pmi_lock_seq, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void
+pa_mmap_write_unlock (pa_mmap_t *pmp)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+
+    if (pmp->pm_flags & PMF_READ_ONLY)
+	return;
+
+    __atomic_add_fetch(&pmip->pmi_lock_seq, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&pmip->pmi_lock, 0, __ATOMIC_SEQ_CST);
+    pa_mmap_lock_wake(pmip);
+}
+
+uint32_t
+pa_mmap_read_begin (pa_mmap_t *pmp)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    uint32_t seq;
+
+    while ((seq = __atomic_load_n(&pmip->pmi_lock_seq, __ATOMIC_ACQUIRE)) & 1)
+	pa_mmap_lock_relax();
+
+    return seq;
+}
+
+psu_boolean_t
+pa_mmap_read_retry (pa_mmap_t *pmp, uint32_t seq)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&pmip->pmi_lock_seq, __ATOMIC_RELAXED) != seq;
+}
+
 /*
  * Find or add a header in the first page (page 0) of the mmap file.
  * If 'size' == 0, we don't add it; the caller's just checking.
  */
-void *
-pa_mmap_header (pa_mmap_t *pmp, const char *name,
-		uint16_t type, uint16_t flags, size_t size)
+static void *
+pa_mmap_header_locked (pa_mmap_t *pmp, const char *name,
+		       uint16_t type, uint16_t flags, size_t size)
 {
     pa_mmap_header_t *pmhp;
     uint8_t *base = pmp->pm_addr;
@@ -521,6 +1988,19 @@ pa_mmap_header (pa_mmap_t *pmp, const char *name,
     return &pmhp->pmh_content[0];
 }
 
+void *
+pa_mmap_header (pa_mmap_t *pmp, const char *name,
+		uint16_t type, uint16_t flags, size_t size)
+{
+    void *header;
+
+    pa_lock(pmp->pm_lock);
+    header = pa_mmap_header_locked(pmp, name, type, flags, size);
+    pa_unlock(pmp->pm_lock);
+
+    return header;
+}
+
 void *
 pa_mmap_next_header (pa_mmap_t *pmp, void *header)
 {
@@ -528,22 +2008,85 @@ pa_mmap_next_header (pa_mmap_t *pmp, void *header)
     uint8_t *base = pmp->pm_addr;
     uint32_t i;
 
-    base -= sizeof(*pmhp);
     base += sizeof(*pmp->pm_infop); /* Named headers start after ours */
 
     for (i = 0; i < pmp->pm_infop->pmi_num_headers; i++) {
 	pmhp = (void *) base;
-	base += sizeof(*pmhp) + pmhp->pmh_size;
-	if ((header == NULL || header == &pmhp->pmh_content[0])
-	    && i < pmp->pm_infop->pmi_num_headers - 1) {
-	    pmhp = (void *) base;
+	if (header == NULL)
 	    return &pmhp->pmh_content[0];
-	}
+
+	base += sizeof(*pmhp) + pmhp->pmh_size;
+	if (header == &pmhp->pmh_content[0])
+	    header = NULL;	/* The next one is the one we want */
     }
 
     return NULL;
 }
 
+const char *
+pa_mmap_header_info (void *header, uint16_t *typep, uint32_t *sizep)
+{
+    pa_mmap_header_t *pmhp = (void *) ((psu_byte_t *) header
+				       - offsetof(pa_mmap_header_t,
+						  pmh_content));
+
+    if (typep)
+	*typep = pmhp->pmh_type;
+    if (sizep)
+	*sizep = pmhp->pmh_size;
+
+    return pmhp->pmh_name;
+}
+
+/*
+ * Report on the state of our free lists.  Fragmentation is the
+ * share of free space that lies outside the largest free chunk,
+ * so a single free chunk reports zero, no matter its size.
+ */
+static void
+pa_mmap_dump_free (pa_mmap_t *pmp, psu_boolean_t full)
+{
+    pa_mmap_info_t *pmip = pmp->pm_infop;
+    pa_mmap_free_t *pmfp;
+    pa_mmap_atom_t fa;
+    unsigned bin;
+    uint32_t chunks = 0, bin_chunks;
+    uint64_t total = 0, bin_total;
+    pa_atom_t largest = 0;
+
+    for (bin = 0; bin < PA_MMAP_NUM_BINS; bin++) {
+	bin_chunks = 0;
+	bin_total = 0;
+
+	for (fa = pmip->pmi_bins[bin]; !pa_mmap_is_null(fa);
+	     fa = pmfp->pmf_next) {
+	    pmfp = pa_mmap_addr(pmp, fa);
+	    bin_chunks += 1;
+	    bin_total += pmfp->pmf_size;
+	    if (largest < pmfp->pmf_size)
+		largest = pmfp->pmf_size;
+	}
+
+	if (full && bin_chunks != 0)
+	    psu_log("  bin %u (%u%s atoms): %u chunks, %llu atoms",
+		    bin, (bin < PA_MMAP_EXACT_BINS) ? bin + 1
+		    : 1U << (bin - PA_MMAP_EXACT_BINS + 4),
+		    (bin < PA_MMAP_EXACT_BINS) ? "" : "+",
+		    bin_chunks, (unsigned long long) bin_total);
+
+	chunks += bin_chunks;
+	total += bin_total;
+    }
+
+    unsigned frag = total ? (unsigned) (100 - (largest * 100) / total) : 0;
+
+    psu_log("free: %u chunks, %llu atoms (of %zu), largest %" PA_ATOM_FMT ", "
+	    "fragmentation %u%%, bins %#x",
+	    chunks, (unsigned long long) total,
+	    pmp->pm_len >> PA_MMAP_ATOM_SHIFT, largest, frag,
+	    pmip->pmi_bin_map);
+}
+
 /**
  * Dump the internal state of a pa_mmap table
  */
@@ -553,10 +2096,11 @@ pa_mmap_dump (pa_mmap_t *pmp, psu_boolean_t full)
     pa_mmap_info_t *pmip = pmp->pm_infop;
 
     psu_log("begin pa_mmap dump of %p", pmip);
-    psu_log("magic %#x, version %d.%03d, max-size %u, len %zu, free %#x",
+    psu_log("magic %#x, version %d.%03d, max-size %llu, len %zu",
 	    pmip->pmi_magic, pmip->pmi_vers_major, pmip->pmi_vers_minor,
-	    pmip->pmi_max_size, pmip->pmi_len,
-	    pa_mmap_atom_of(pmip->pmi_free));
+	    (unsigned long long) pmip->pmi_max_size, pmip->pmi_len);
+
+    pa_mmap_dump_free(pmp, full);
 
     psu_log("dumping headers: (%d)", pmip->pmi_num_headers);
 
@@ -583,4 +2127,3 @@ pa_mmap_dump (pa_mmap_t *pmp, psu_boolean_t full)
 
     psu_log("end pa_mmap dump of %p", pmip);
 }
-
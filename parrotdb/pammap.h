@@ -14,10 +14,10 @@
 
 /*
  * Support for memory allocation over mmap()'d sections of memory.
- * Since paged arrays use only offset, this is mostly trivial.  In
- * particular, we don't provide a means of freeing memory.  We just
- * grow the memory segment and gives pages out of that delta between
- * the top of the memory segment and the top of allocated memory.
+ * Since paged arrays use only offset, this is mostly trivial.  We
+ * grow the memory segment as needed and give out runs of pages from
+ * free lists binned by size.  Freed runs are merged with their free
+ * neighbours, so the segment doesn't fragment into unusable slivers.
  *
  * On top of this facility, there are a number of distinct memory
  * allocators, each with different parameters and behaviors, and
@@ -39,6 +39,12 @@ typedef struct pa_mmap_info_s pa_mmap_info_t; /* Opaque type */
 typedef uint32_t pa_mmap_flags_t; /* Flag values */
 /* Flags for pa_mmap_flags_t */
 #define PMF_READ_ONLY	(1<<0)	/* Open read-only */
+#define PMF_HUGE_PAGES	(1<<1)	/* Ask for transparent huge pages */
+#define PMF_HUGETLB	(1<<2)	/* Use hugetlb pages (anonymous only) */
+#define PMF_PREFAULT	(1<<3)	/* Fault in pages as they are mapped */
+#define PMF_WARM_START	(1<<4)	/* Page in existing contents at open */
+#define PMF_THREAD_SAFE	(1<<5)	/* Allow use from multiple threads */
+#define PMF_COMMIT	(1<<6)	/* Changes reach the file at pa_mmap_commit */
 
 /* Record of mmap'd segments */
 typedef struct pa_mmap_record_s {
@@ -58,8 +64,23 @@ typedef struct pa_mmap_s {
     int pm_mmap_prot;		/* mmap prot parameter */
     psu_byte_t *pm_addr;	/* Base memory address */
     size_t pm_len;		/* Current mapped len */
+    size_t pm_align;		/* Growth granularity (bytes) */
+    size_t pm_reserve;		/* Reserved address space (bytes) */
+    uint32_t pm_grow_percent;	/* Growth, as a percentage of pm_len */
+    uint32_t pm_grow_min;	/* Minimum growth (atoms) */
+    uint32_t pm_grow_max;	/* Maximum growth (atoms, or 0) */
     pa_mmap_info_t *pm_infop;	/* Mmap segment header */
     pa_mmap_record_t *pm_record; /* Record of mmap'd segments */
+    struct pa_lock_s *pm_lock;	/* Lock (for PMF_THREAD_SAFE) */
+    char *pm_log_name;		/* Redo log file (for PMF_COMMIT) */
+    size_t pm_page_size;	/* Unit of change tracking (PMF_COMMIT) */
+    uint64_t *pm_dirty;		/* Offsets of changed pages (PMF_COMMIT) */
+    size_t pm_dirty_count;	/* Number of entries in pm_dirty */
+    size_t pm_dirty_size;	/* Room in pm_dirty */
+    psu_boolean_t pm_prepared;	/* Redo log is written, not applied */
+    struct pa_mmap_s *pm_parent; /* Segment we're a snapshot of */
+    struct pa_mmap_s *pm_snapshots; /* Our live snapshots */
+    struct pa_mmap_s *pm_snap_next; /* Next snapshot of our parent */
 } pa_mmap_t;
 
 static inline void *
@@ -85,14 +106,111 @@ pa_mmap_close (pa_mmap_t *pmp);
 void *
 pa_mmap_addr (pa_mmap_t *pmp, pa_mmap_atom_t atom);
 
+/*
+ * Commits for file-backed segments.  A segment opened with PMF_COMMIT
+ * is mapped privately, so changes stay in our memory until
+ * pa_mmap_commit() writes them to the file.  The changed pages are
+ * first written (and synced) to a redo log next to the file
+ * ("<filename>.log"), and then copied into the file.  If we die part
+ * way thru, the next open replays a complete log or discards an
+ * incomplete one, so the file always holds the last committed state.
+ * Space added since the last commit is trimmed off as well.
+ *
+ * pa_mmap_commit_prepare() does just the first half: once it
+ * returns, the changes will survive a crash.  pa_mmap_commit()
+ * finishes the job (preparing first, if needed).  Nothing should
+ * change the segment between the two.  Callers must keep other
+ * threads from changing the segment during a commit.
+ *
+ * A PMF_COMMIT segment is private to its process until committed,
+ * so only one process may have it open for writing; a second open
+ * (without PMF_READ_ONLY) fails.  Its lock (pa_mmap_read_lock(), etc)
+ * is private too, so it only works between threads.  It's fine to
+ * commit while holding the write lock: the lock fields never reach
+ * the file.  Without PMF_COMMIT, pa_mmap_commit() just flushes the
+ * segment to its file.
+ *
+ * Both return zero on success, and -1 on failure.
+ */
+int
+pa_mmap_commit_prepare (pa_mmap_t *pmp);
+
+int
+pa_mmap_commit (pa_mmap_t *pmp);
+
+/*
+ * Snapshots give readers a stable, read-only view of a segment while
+ * a writer keeps changing it.  The snapshot is a pa_mmap_t opened
+ * PMF_READ_ONLY, so allocators can be opened over it as usual, and
+ * readers need no locks.  Close it with pa_mmap_close().
+ *
+ * For a PMF_COMMIT segment, the snapshot maps the file privately and
+ * copies in the pages changed since the last commit, so it costs one
+ * mmap plus a page copy per uncommitted page.  Later stores by the
+ * writer cost nothing extra; each commit copies the pages it's about
+ * to overwrite into each live snapshot first.  Other segments get
+ * no copy-on-write: the whole segment is copied with memcpy(), which
+ * costs O(size) time and memory for every snapshot.
+ *
+ * The snapshot is taken under pa_mmap_read_lock(), so writers that
+ * use the segment lock can't tear it; don't take one while holding
+ * the write lock.  For PMF_READ_ONLY segments, where that lock does
+ * nothing, the copy is retried until pa_mmap_read_retry() is happy.
+ * Snapshots should be closed before their segment is; one that
+ * outlives it may see later commits made by others.
+ */
+pa_mmap_t *
+pa_mmap_snapshot (pa_mmap_t *pmp);
+
 void *
 pa_mmap_header (pa_mmap_t *pmp, const char *name,
 		uint16_t type, uint16_t flags, size_t size);
 
+/*
+ * Iterate thru our headers, starting with header == NULL
+ */
 void *
 pa_mmap_next_header (pa_mmap_t *pmp, void *header);
 
+/*
+ * Return the name of a header (as returned by pa_mmap_header or
+ * pa_mmap_next_header), along with its type and size
+ */
+const char *
+pa_mmap_header_info (void *header, uint16_t *typep, uint32_t *sizep);
+
 void
 pa_mmap_dump (pa_mmap_t *pmp, psu_boolean_t full);
 
+/*
+ * A reader/writer lock for the whole segment, kept in the segment
+ * header and shared by every process (and thread) using it (but see
+ * PMF_COMMIT, above).  Readers take no system calls unless they have
+ * to wait for a writer.  These do nothing for PMF_READ_ONLY segments,
+ * since we can't write the lock; such readers can use
+ * pa_mmap_read_begin() instead:
+ *
+ *     do {
+ *         seq = pa_mmap_read_begin(pmp);
+ *         ... read, copying out what's needed ...
+ *     } while (pa_mmap_read_retry(pmp, seq));
+ */
+void
+pa_mmap_read_lock (pa_mmap_t *pmp);
+
+void
+pa_mmap_read_unlock (pa_mmap_t *pmp);
+
+void
+pa_mmap_write_lock (pa_mmap_t *pmp);
+
+void
+pa_mmap_write_unlock (pa_mmap_t *pmp);
+
+uint32_t
+pa_mmap_read_begin (pa_mmap_t *pmp);
+
+psu_boolean_t
+pa_mmap_read_retry (pa_mmap_t *pmp, uint32_t seq);
+
 #endif /* PARROTDB_PAMMAP_H */
@@ -234,8 +234,12 @@ pa_pat_root_init (pa_pat_t *root, pa_pat_info_t *ppip, pa_mmap_t *pmp,
 
     if (root) {
 	root->pp_infop = ppip;
-	root->pp_root = pa_pat_null_atom();
-	root->pp_key_bytes = klen;
+
+	/* A new tree starts empty; an existing one keeps its root */
+	if (ppip->ppi_key_bytes == 0) {
+	    root->pp_root = pa_pat_null_atom();
+	    root->pp_key_bytes = klen;
+	}
 
 	root->pp_mmap = pmp;
 	root->pp_nodes = nodes;
@@ -247,10 +251,10 @@ pa_pat_root_init (pa_pat_t *root, pa_pat_info_t *ppip, pa_mmap_t *pmp,
 }
 
 const uint8_t *
-pa_pat_istr_key_func (pa_pat_t *pp, pa_pat_node_t *node)
+pa_pat_istr_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom)
 {
     /* Need to "convert" the data atom to an istr data */
-    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(node->ppn_data));
+    pa_istr_atom_t atom = pa_istr_atom(pa_pat_data_atom_of(datom));
     return (const uint8_t *) pa_istr_atom_string(pp->pp_data, atom);
 }
 
@@ -272,7 +276,7 @@ pa_pat_open_nodes (pa_mmap_t *pmp, const char *name, pa_fixed_t *nodes,
 pa_pat_t *
 pa_pat_open (pa_mmap_t *pmp, const char *name,
 	     void *data_store, pa_pat_key_func_t key_func,
-	     uint16_t klen, pa_shift_t shift, uint32_t max_atoms)
+	     uint16_t klen, pa_shift_t shift, pa_atom_t max_atoms)
 {
     char namebuf[PA_MMAP_HEADER_NAME_LEN];
     pa_fixed_t *pfp;
@@ -451,6 +455,127 @@ pa_pat_add (pa_pat_t *root, pa_pat_data_atom_t datom, uint16_t key_bytes)
     return pa_pat_add_node(root, atom, node);
 }
 
+/*
+ * pa_pat_bulk_load()
+ * Build a tree from sorted keys.  The internal node that separates
+ * two neighboring keys tests the first bit where they differ, and
+ * the node with the smallest bit is the parent of the others, so the
+ * tree is the "Cartesian tree" of these bits, which we can build in
+ * one pass with a stack holding the right edge of the tree so far.
+ *
+ * Each node does double duty as an internal node and a leaf.  We use
+ * the node for the key on the left of each split as the internal node,
+ * which always sits above (or at) its own leaf, as a search requires.
+ * That leaves the last key as the one PA_PAT_NOBIT leaf.
+ */
+psu_boolean_t
+pa_pat_bulk_load (pa_pat_t *root, pa_pat_bulk_func_t func, void *opaque)
+{
+    pa_pat_atom_t stack[PA_PAT_MAXKEY * PA_NBBY];
+    int depth = 0;
+    pa_pat_atom_t prev = pa_pat_null_atom(), atom, top = pa_pat_null_atom();
+    pa_pat_node_t *prev_node = NULL, *node, *top_node;
+    pa_pat_data_atom_t datom;
+    const uint8_t *key, *prev_key = NULL;
+    uint16_t key_bytes, bit, diff_bit;
+    psu_boolean_t rc = TRUE;
+
+    /* If there's already a tree, we can't build it from scratch */
+    if (!pa_pat_is_null(root->pp_root)) {
+	for (;;) {
+	    key_bytes = 0;
+	    datom = func(root, opaque, &key_bytes);
+	    if (pa_pat_data_is_null(datom))
+		break;
+
+	    if (!pa_pat_add(root, datom, key_bytes))
+		rc = FALSE;
+	}
+
+	return rc;
+    }
+
+    for (;;) {
+	key_bytes = 0;
+	datom = func(root, opaque, &key_bytes);
+	if (pa_pat_data_is_null(datom))
+	    break;
+
+	node = pa_pat_node_alloc(root, datom, key_bytes, &atom);
+	if (node == NULL) {
+	    rc = FALSE;
+	    break;
+	}
+
+	if (node->ppn_length == PA_PAT_NOBIT)
+	    node->ppn_length = pa_pat_length_to_bit(root->pp_key_bytes);
+
+	key = pa_pat_key(root, node);
+
+	if (prev_node == NULL) {
+	    prev = atom;
+	    prev_node = node;
+	    prev_key = key;
+	    continue;
+	}
+
+	/*
+	 * Find the bit that separates us from the previous key.  It
+	 * must be inside both keys, and we must be the one with it set.
+	 */
+	bit = (node->ppn_length < prev_node->ppn_length)
+	    ? node->ppn_length : prev_node->ppn_length;
+	diff_bit = pa_pat_mismatch(prev_key, key, bit);
+	if (diff_bit >= bit || !pat_key_test(key, diff_bit)) {
+	    pa_fixed_free_atom(root->pp_nodes, pa_pat_to_fixed(atom));
+	    rc = FALSE;
+	    break;
+	}
+
+	/*
+	 * The previous node becomes the internal node for diff_bit.
+	 * Nodes on the right edge that test later bits go under it, on
+	 * its left.  Its right is our leaf, until something deeper
+	 * arrives to take its place.
+	 */
+	prev_node->ppn_bit = diff_bit;
+	prev_node->ppn_left = prev;
+	prev_node->ppn_right = atom;
+
+	while (depth > 0) {
+	    top = stack[depth - 1];
+	    top_node = pa_pat_node(root, top);
+	    if (top_node->ppn_bit < diff_bit)
+		break;
+
+	    prev_node->ppn_left = top;
+	    depth -= 1;
+	}
+
+	if (depth > 0) {
+	    top_node = pa_pat_node(root, stack[depth - 1]);
+	    top_node->ppn_right = prev;
+	}
+
+	stack[depth++] = prev;
+
+	prev = atom;
+	prev_node = node;
+	prev_key = key;
+    }
+
+    if (prev_node == NULL)
+	return rc;
+
+    /* The last key is our PA_PAT_NOBIT leaf */
+    prev_node->ppn_bit = PA_PAT_NOBIT;
+    prev_node->ppn_left = prev_node->ppn_right = prev;
+
+    root->pp_root = depth ? stack[0] : prev;
+
+    return rc;
+}
+
 /*
  * pa_pat_get()
  * Given a key and its length, find a node which matches.
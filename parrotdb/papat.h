@@ -158,7 +158,7 @@ pa_pat_root_init (pa_pat_t *root, pa_pat_info_t *ppip, pa_mmap_t *pmp,
 		  pa_pat_key_func_t key_func, uint16_t klen);
 
 const psu_byte_t *
-pa_pat_istr_key_func (pa_pat_t *pp, pa_pat_node_t *node);
+pa_pat_istr_key_func (pa_pat_t *pp, pa_pat_data_atom_t datom);
 
 /*
  * Add a node to the patricia tree.
@@ -213,6 +213,42 @@ pa_pat_node_init_length (pa_pat_node_t *node, uint16_t key_bytes,
 psu_boolean_t
 pa_pat_add (pa_pat_t *root, pa_pat_data_atom_t datom, uint16_t key_bytes);
 
+/**
+ * @brief
+ * Iterator for pa_pat_bulk_load().  Returns the next data atom,
+ * and sets the length of its key, or returns a null atom when there
+ * are no more.
+ */
+typedef pa_pat_data_atom_t (*pa_pat_bulk_func_t)(pa_pat_t *root,
+						 void *opaque,
+						 uint16_t *key_bytesp);
+
+/**
+ * @brief
+ * Builds a tree from a stream of keys that are already in sorted
+ * order.  The tree is built bottom-up, without searching, and the
+ * nodes are allocated in key order, so walking the tree with
+ * pa_pat_find_next() or pa_pat_subtree_next() moves through the
+ * node pages sequentially.
+ *
+ * If the tree isn't empty, the keys are added one at a time with
+ * pa_pat_add().
+ *
+ * @param[in] root
+ *     Pointer to patricia tree root
+ * @param[in] func
+ *     Iterator returning the data atoms, in key order
+ * @param[in] opaque
+ *     Opaque value passed to the iterator
+ *
+ * @return
+ *     @c TRUE if all the keys were added;
+ *     @c FALSE if a key was out of order, duplicated, or a prefix
+ *     of its neighbor.  The keys before it are left in the tree.
+ */
+psu_boolean_t
+pa_pat_bulk_load (pa_pat_t *root, pa_pat_bulk_func_t func, void *opaque);
+
 /**
  * @brief
  * Deletes a node from the tree.
@@ -864,7 +900,7 @@ pa_pat_open_c (pa_mmap_t *pmp, const char *name,
 pa_pat_t *
 pa_pat_open (pa_mmap_t *pmp, const char *name,
 	     void *data_store, pa_pat_key_func_t key_func,
-	     uint16_t klen, pa_shift_t shift, uint32_t max_atoms);
+	     uint16_t klen, pa_shift_t shift, pa_atom_t max_atoms);
 
 void
 pa_pat_close (pa_pat_t *ppp);
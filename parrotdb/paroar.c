@@ -0,0 +1,1608 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Compressed bitmaps, built from array, bitmap, and run containers.
+ *
+ * We keep the container types honest, the way the portable format
+ * expects them: a container that isn't a run container is an array
+ * if it has up to PA_ROAR_ARRAY_MAX values, and a bitmap otherwise.
+ * Run containers are picked when they're smaller than either.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <strings.h>
+
+#include <libpsu/psucommon.h>
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/pabitmap.h>
+#include <parrotdb/paroar.h>
+
+/* Cookies for the portable format */
+#define PA_ROAR_COOKIE		12347 /* Has run containers */
+#define PA_ROAR_COOKIE_NO_RUNS	12346 /* Has no run containers */
+#define PA_ROAR_NO_OFFSETS	4 /* Run cookie: fewer containers have no offsets */
+
+#define PA_ROAR_ROOT_SHIFT	8 /* Roots per page of our pa_fixed */
+#define PA_ROAR_DIR_MIN		4 /* Smallest directory we allocate */
+#define PA_ROAR_ARRAY_MIN	4 /* Smallest array we allocate */
+#define PA_ROAR_UNIT_BITS	((unsigned) PA_BITMAP_BITS_PER_UNIT)
+
+/* Set operations, for pa_roar_combine */
+#define PA_ROAR_OP_AND		0
+#define PA_ROAR_OP_OR		1
+#define PA_ROAR_OP_ANDNOT	2
+#define PA_ROAR_OP_XOR		3
+
+static inline void *
+pa_roar_data (pa_roar_t *prp, pa_arb_atom_t atom)
+{
+    return pa_arb_is_null(atom) ? NULL : pa_arb_atom_addr(prp->pro_arb, atom);
+}
+
+static inline pa_roar_cont_t *
+pa_roar_dir (pa_roar_t *prp, pa_roar_root_t *rootp)
+{
+    return pa_roar_data(prp, rootp->prt_dir);
+}
+
+/*
+ * Bit twiddling for bitmap containers
+ */
+static inline int
+pa_roar_bits_test (const pa_bitunit_t *bits, unsigned low)
+{
+    return (bits[low / PA_ROAR_UNIT_BITS] >> (low % PA_ROAR_UNIT_BITS)) & 1;
+}
+
+static inline void
+pa_roar_bits_set (pa_bitunit_t *bits, unsigned low)
+{
+    bits[low / PA_ROAR_UNIT_BITS] |= 1U << (low % PA_ROAR_UNIT_BITS);
+}
+
+static inline void
+pa_roar_bits_clear (pa_bitunit_t *bits, unsigned low)
+{
+    bits[low / PA_ROAR_UNIT_BITS] &= ~(1U << (low % PA_ROAR_UNIT_BITS));
+}
+
+/*
+ * Set the bits from "lo" to "hi", inclusive
+ */
+static void
+pa_roar_bits_range (pa_bitunit_t *bits, unsigned lo, unsigned hi)
+{
+    unsigned lu = lo / PA_ROAR_UNIT_BITS, hu = hi / PA_ROAR_UNIT_BITS, u;
+    pa_bitunit_t lmask = ~0U << (lo % PA_ROAR_UNIT_BITS);
+    pa_bitunit_t hmask = ~0U >> (PA_ROAR_UNIT_BITS - 1 - hi % PA_ROAR_UNIT_BITS);
+
+    if (lu == hu) {
+	bits[lu] |= lmask & hmask;
+	return;
+    }
+
+    bits[lu] |= lmask;
+    for (u = lu + 1; u < hu; u++)
+	bits[u] = ~0U;
+    bits[hu] |= hmask;
+}
+
+/*
+ * Find the first bit at or after "low" that's set (or, with a "flip"
+ * of ~0, clear).  Returns PA_ROAR_BITMAP_BITS if there's none.
+ */
+static unsigned
+pa_roar_bits_next (const pa_bitunit_t *bits, unsigned low, pa_bitunit_t flip)
+{
+    unsigned unit = low / PA_ROAR_UNIT_BITS;
+    pa_bitunit_t word;
+
+    if (low >= PA_ROAR_BITMAP_BITS)
+	return PA_ROAR_BITMAP_BITS;
+
+    word = (bits[unit] ^ flip) & (~0U << (low % PA_ROAR_UNIT_BITS));
+    while (word == 0) {
+	if (++unit == PA_ROAR_BITMAP_UNITS)
+	    return PA_ROAR_BITMAP_BITS;
+	word = bits[unit] ^ flip;
+    }
+
+    return unit * PA_ROAR_UNIT_BITS + __builtin_ctz(word);
+}
+
+/*
+ * Count the runs in a bitmap: each set bit whose lower neighbor is
+ * clear starts one
+ */
+static uint32_t
+pa_roar_bits_runs (const pa_bitunit_t *bits)
+{
+    pa_bitunit_t carry = 0, word;
+    uint32_t runs = 0;
+    unsigned unit;
+
+    for (unit = 0; unit < PA_ROAR_BITMAP_UNITS; unit++) {
+	word = bits[unit];
+	runs += __builtin_popcount(word & ~((word << 1) | carry));
+	carry = word >> (PA_ROAR_UNIT_BITS - 1);
+    }
+
+    return runs;
+}
+
+/*
+ * Return the index of the first array value that's >= low
+ */
+static uint32_t
+pa_roar_array_find (const uint16_t *values, uint32_t count, unsigned low)
+{
+    uint32_t lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (values[mid] < low)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * Return the index of the first run that ends at or after low
+ */
+static uint32_t
+pa_roar_run_find (const pa_roar_run_t *runs, uint32_t count, unsigned low)
+{
+    uint32_t lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if ((unsigned) runs[mid].prn_start + runs[mid].prn_length < low)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * Return the index of the container for "key", or the index where it
+ * would go if it's not there
+ */
+static uint32_t
+pa_roar_find (const pa_roar_cont_t *dir, uint32_t count, unsigned key,
+	      psu_boolean_t *foundp)
+{
+    uint32_t lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (dir[mid].prc_key < key)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+
+    *foundp = (lo < count && dir[lo].prc_key == key);
+    return lo;
+}
+
+/*
+ * Return the number of bytes of data a container has in use
+ */
+static size_t
+pa_roar_cont_bytes (const pa_roar_cont_t *contp)
+{
+    switch (contp->prc_type) {
+    case PA_ROAR_ARRAY:
+	return contp->prc_card * sizeof(uint16_t);
+
+    case PA_ROAR_BITMAP:
+	return PA_ROAR_BITMAP_SIZE;
+
+    case PA_ROAR_RUN:
+	return contp->prc_runs * sizeof(pa_roar_run_t);
+    }
+
+    return 0;
+}
+
+static void
+pa_roar_cont_free (pa_roar_t *prp, pa_roar_cont_t *contp)
+{
+    if (!pa_arb_is_null(contp->prc_data))
+	pa_arb_free_atom(prp->pro_arb, contp->prc_data);
+    contp->prc_data = pa_arb_null_atom();
+}
+
+/*
+ * Replace a container's data with a copy of "src"
+ */
+static psu_boolean_t
+pa_roar_cont_store (pa_roar_t *prp, pa_roar_cont_t *contp, uint8_t type,
+		    const void *src, size_t bytes, uint32_t card, uint32_t runs)
+{
+    pa_arb_atom_t atom = pa_arb_alloc(prp->pro_arb, bytes);
+    void *data = pa_roar_data(prp, atom);
+
+    if (data == NULL)
+	return FALSE;
+
+    memcpy(data, src, bytes);
+    pa_roar_cont_free(prp, contp);
+
+    contp->prc_type = type;
+    contp->prc_card = card;
+    contp->prc_runs = runs;
+    contp->prc_data = atom;
+
+    return TRUE;
+}
+
+/*
+ * Make sure a container's data has room for "bytes", doubling as
+ * needed so a string of inserts doesn't copy the data each time
+ */
+static void *
+pa_roar_cont_grow (pa_roar_t *prp, pa_roar_cont_t *contp, size_t bytes)
+{
+    size_t have = pa_arb_atom_size(prp->pro_arb, contp->prc_data);
+    pa_arb_atom_t atom;
+
+    if (bytes > have) {
+	size_t want = have * 2;
+	if (want > PA_ROAR_BITMAP_SIZE)
+	    want = PA_ROAR_BITMAP_SIZE;
+	if (want < bytes)
+	    want = bytes;
+
+	atom = pa_arb_realloc(prp->pro_arb, contp->prc_data, want);
+	if (pa_arb_is_null(atom))
+	    return NULL;
+	contp->prc_data = atom;
+    }
+
+    return pa_roar_data(prp, contp->prc_data);
+}
+
+/*
+ * Fill a bitmap with a container's values
+ */
+static void
+pa_roar_cont_bits (pa_roar_t *prp, const pa_roar_cont_t *contp,
+		   pa_bitunit_t *bits)
+{
+    const void *data = pa_roar_data(prp, contp->prc_data);
+    const uint16_t *values = data;
+    const pa_roar_run_t *runs = data;
+    uint32_t i;
+
+    if (contp->prc_type == PA_ROAR_BITMAP && data) {
+	memcpy(bits, data, PA_ROAR_BITMAP_SIZE);
+	return;
+    }
+
+    bzero(bits, PA_ROAR_BITMAP_SIZE);
+    if (data == NULL)
+	return;
+
+    if (contp->prc_type == PA_ROAR_ARRAY) {
+	for (i = 0; i < contp->prc_card; i++)
+	    pa_roar_bits_set(bits, values[i]);
+
+    } else if (contp->prc_type == PA_ROAR_RUN) {
+	for (i = 0; i < contp->prc_runs; i++)
+	    pa_roar_bits_range(bits, runs[i].prn_start,
+			       runs[i].prn_start + runs[i].prn_length);
+    }
+}
+
+/*
+ * Store the "card" bits of a bitmap into a container, in whichever
+ * form is smallest.  The bitmap may be the container's own data.
+ */
+static psu_boolean_t
+pa_roar_cont_from_bits (pa_roar_t *prp, pa_roar_cont_t *contp,
+			const pa_bitunit_t *bits, uint32_t card)
+{
+    uint32_t runs = pa_roar_bits_runs(bits), n = 0;
+    size_t plain = (card <= PA_ROAR_ARRAY_MAX)
+	? card * sizeof(uint16_t) : PA_ROAR_BITMAP_SIZE;
+    unsigned low, end;
+
+    /* Runs are serialized with a count in front, so we count it too */
+    if (runs * sizeof(pa_roar_run_t) + sizeof(uint16_t) < plain) {
+	pa_roar_run_t *runp = (pa_roar_run_t *) prp->pro_values;
+
+	for (low = pa_roar_bits_next(bits, 0, 0); low < PA_ROAR_BITMAP_BITS;
+	     low = pa_roar_bits_next(bits, end, 0)) {
+	    end = pa_roar_bits_next(bits, low, ~0U);
+	    runp[n].prn_start = low;
+	    runp[n].prn_length = end - low - 1;
+	    n += 1;
+	}
+
+	return pa_roar_cont_store(prp, contp, PA_ROAR_RUN, runp,
+				  n * sizeof(*runp), card, n);
+    }
+
+    if (card > PA_ROAR_ARRAY_MAX)
+	return pa_roar_cont_store(prp, contp, PA_ROAR_BITMAP, bits,
+				  PA_ROAR_BITMAP_SIZE, card, 0);
+
+    for (low = pa_roar_bits_next(bits, 0, 0); low < PA_ROAR_BITMAP_BITS;
+	 low = pa_roar_bits_next(bits, low + 1, 0))
+	prp->pro_values[n++] = low;
+
+    return pa_roar_cont_store(prp, contp, PA_ROAR_ARRAY, prp->pro_values,
+			      n * sizeof(uint16_t), card, 0);
+}
+
+static psu_boolean_t
+pa_roar_cont_test (pa_roar_t *prp, const pa_roar_cont_t *contp, unsigned low)
+{
+    const void *data = pa_roar_data(prp, contp->prc_data);
+    uint32_t i;
+
+    if (data == NULL)
+	return FALSE;
+
+    switch (contp->prc_type) {
+    case PA_ROAR_ARRAY: {
+	const uint16_t *values = data;
+
+	i = pa_roar_array_find(values, contp->prc_card, low);
+	return (i < contp->prc_card && values[i] == low);
+    }
+
+    case PA_ROAR_BITMAP:
+	return pa_roar_bits_test(data, low);
+
+    case PA_ROAR_RUN: {
+	const pa_roar_run_t *runs = data;
+
+	i = pa_roar_run_find(runs, contp->prc_runs, low);
+	return (i < contp->prc_runs && runs[i].prn_start <= low);
+    }
+    }
+
+    return FALSE;
+}
+
+/*
+ * Return the first value in a container that's >= low, or
+ * PA_ROAR_BITMAP_BITS if there's none
+ */
+static unsigned
+pa_roar_cont_next (pa_roar_t *prp, const pa_roar_cont_t *contp, unsigned low)
+{
+    const void *data = pa_roar_data(prp, contp->prc_data);
+    uint32_t i;
+
+    if (data == NULL)
+	return PA_ROAR_BITMAP_BITS;
+
+    switch (contp->prc_type) {
+    case PA_ROAR_ARRAY: {
+	const uint16_t *values = data;
+
+	i = pa_roar_array_find(values, contp->prc_card, low);
+	return (i < contp->prc_card) ? values[i] : PA_ROAR_BITMAP_BITS;
+    }
+
+    case PA_ROAR_BITMAP:
+	return pa_roar_bits_next(data, low, 0);
+
+    case PA_ROAR_RUN: {
+	const pa_roar_run_t *runs = data;
+
+	i = pa_roar_run_find(runs, contp->prc_runs, low);
+	if (i == contp->prc_runs)
+	    return PA_ROAR_BITMAP_BITS;
+	return (runs[i].prn_start > low) ? runs[i].prn_start : low;
+    }
+    }
+
+    return PA_ROAR_BITMAP_BITS;
+}
+
+/*
+ * Add a value to a run container
+ */
+static int
+pa_roar_run_set (pa_roar_t *prp, pa_roar_cont_t *contp, pa_roar_run_t *runs,
+		 unsigned low)
+{
+    uint32_t count = contp->prc_runs;
+    uint32_t i = pa_roar_run_find(runs, count, low);
+    psu_boolean_t join_prev, join_next;
+
+    if (i < count && runs[i].prn_start <= low)
+	return 0;		/* Already there */
+
+    /* The run before us ends before "low"; does it end just before? */
+    join_prev = (i > 0 && (unsigned) runs[i - 1].prn_start
+		 + runs[i - 1].prn_length + 1 == low);
+    join_next = (i < count && runs[i].prn_start == low + 1);
+
+    if (join_prev && join_next) {
+	runs[i - 1].prn_length += runs[i].prn_length + 2;
+	memmove(&runs[i], &runs[i + 1], (count - i - 1) * sizeof(*runs));
+	contp->prc_runs -= 1;
+
+    } else if (join_prev) {
+	runs[i - 1].prn_length += 1;
+
+    } else if (join_next) {
+	runs[i].prn_start -= 1;
+	runs[i].prn_length += 1;
+
+    } else if (count >= PA_ROAR_RUN_MAX) {
+	/* Too many runs; turn it into something else */
+	pa_roar_cont_bits(prp, contp, prp->pro_bits);
+	pa_roar_bits_set(prp->pro_bits, low);
+	return pa_roar_cont_from_bits(prp, contp, prp->pro_bits,
+				      contp->prc_card + 1) ? 1 : -1;
+
+    } else {
+	runs = pa_roar_cont_grow(prp, contp, (count + 1) * sizeof(*runs));
+	if (runs == NULL)
+	    return -1;
+
+	memmove(&runs[i + 1], &runs[i], (count - i) * sizeof(*runs));
+	runs[i].prn_start = low;
+	runs[i].prn_length = 0;
+	contp->prc_runs += 1;
+    }
+
+    contp->prc_card += 1;
+    return 1;
+}
+
+/*
+ * Add a value to a container.  Returns 1 if it was added, 0 if it was
+ * already there, and -1 if we're out of memory.
+ */
+static int
+pa_roar_cont_set (pa_roar_t *prp, pa_roar_cont_t *contp, unsigned low)
+{
+    void *data = pa_roar_data(prp, contp->prc_data);
+    uint32_t card = contp->prc_card, i;
+
+    if (data == NULL)
+	return -1;
+
+    switch (contp->prc_type) {
+    case PA_ROAR_ARRAY: {
+	uint16_t *values = data;
+
+	i = pa_roar_array_find(values, card, low);
+	if (i < card && values[i] == low)
+	    return 0;
+
+	if (card >= PA_ROAR_ARRAY_MAX) {
+	    pa_roar_cont_bits(prp, contp, prp->pro_bits);
+	    pa_roar_bits_set(prp->pro_bits, low);
+	    return pa_roar_cont_from_bits(prp, contp, prp->pro_bits,
+					  card + 1) ? 1 : -1;
+	}
+
+	values = pa_roar_cont_grow(prp, contp, (card + 1) * sizeof(*values));
+	if (values == NULL)
+	    return -1;
+
+	memmove(&values[i + 1], &values[i], (card - i) * sizeof(*values));
+	values[i] = low;
+	contp->prc_card += 1;
+	return 1;
+    }
+
+    case PA_ROAR_BITMAP:
+	if (pa_roar_bits_test(data, low))
+	    return 0;
+
+	pa_roar_bits_set(data, low);
+	contp->prc_card += 1;
+	return 1;
+
+    case PA_ROAR_RUN:
+	return pa_roar_run_set(prp, contp, data, low);
+    }
+
+    return -1;
+}
+
+/*
+ * Remove a value from a container.  Returns 1 if it was removed, 0 if
+ * it wasn't there, and -1 if we're out of memory.
+ */
+static int
+pa_roar_cont_clear (pa_roar_t *prp, pa_roar_cont_t *contp, unsigned low)
+{
+    void *data = pa_roar_data(prp, contp->prc_data);
+    uint32_t card = contp->prc_card, count, i;
+
+    if (data == NULL)
+	return -1;
+
+    switch (contp->prc_type) {
+    case PA_ROAR_ARRAY: {
+	uint16_t *values = data;
+
+	i = pa_roar_array_find(values, card, low);
+	if (i == card || values[i] != low)
+	    return 0;
+
+	memmove(&values[i], &values[i + 1], (card - i - 1) * sizeof(*values));
+	contp->prc_card -= 1;
+	return 1;
+    }
+
+    case PA_ROAR_BITMAP:
+	if (!pa_roar_bits_test(data, low))
+	    return 0;
+
+	pa_roar_bits_clear(data, low);
+
+	/* Small enough for an array now? */
+	if (card - 1 <= PA_ROAR_ARRAY_MAX
+		&& !pa_roar_cont_from_bits(prp, contp, data, card - 1)) {
+	    pa_roar_bits_set(data, low);
+	    return -1;
+	}
+
+	contp->prc_card = card - 1;
+	return 1;
+
+    case PA_ROAR_RUN: {
+	pa_roar_run_t *runs = data;
+	unsigned start, end;
+
+	count = contp->prc_runs;
+	i = pa_roar_run_find(runs, count, low);
+	if (i == count || runs[i].prn_start > low)
+	    return 0;
+
+	start = runs[i].prn_start;
+	end = start + runs[i].prn_length;
+
+	if (start == end) {
+	    memmove(&runs[i], &runs[i + 1], (count - i - 1) * sizeof(*runs));
+	    contp->prc_runs -= 1;
+
+	} else if (low == start) {
+	    runs[i].prn_start += 1;
+	    runs[i].prn_length -= 1;
+
+	} else if (low == end) {
+	    runs[i].prn_length -= 1;
+
+	} else if (count >= PA_ROAR_RUN_MAX) {
+	    /* Splitting would make too many runs */
+	    pa_roar_cont_bits(prp, contp, prp->pro_bits);
+	    pa_roar_bits_clear(prp->pro_bits, low);
+	    return pa_roar_cont_from_bits(prp, contp, prp->pro_bits,
+					  card - 1) ? 1 : -1;
+
+	} else {
+	    runs = pa_roar_cont_grow(prp, contp, (count + 1) * sizeof(*runs));
+	    if (runs == NULL)
+		return -1;
+
+	    memmove(&runs[i + 1], &runs[i], (count - i) * sizeof(*runs));
+	    runs[i].prn_length = low - start - 1;
+	    runs[i + 1].prn_start = low + 1;
+	    runs[i + 1].prn_length = end - low - 1;
+	    contp->prc_runs += 1;
+	}
+
+	contp->prc_card -= 1;
+	return 1;
+    }
+    }
+
+    return -1;
+}
+
+/*
+ * Make sure the directory has room for "want" containers
+ */
+static pa_roar_cont_t *
+pa_roar_dir_reserve (pa_roar_t *prp, pa_roar_root_t *rootp, uint32_t want)
+{
+    pa_arb_atom_t atom;
+    size_t size;
+
+    if (want > rootp->prt_size) {
+	size = rootp->prt_size * 2;
+	if (size < PA_ROAR_DIR_MIN)
+	    size = PA_ROAR_DIR_MIN;
+	if (size < want)
+	    size = want;
+
+	atom = pa_arb_realloc(prp->pro_arb, rootp->prt_dir,
+			      size * sizeof(pa_roar_cont_t));
+	if (pa_arb_is_null(atom))
+	    return NULL;
+
+	rootp->prt_dir = atom;
+	rootp->prt_size = pa_arb_atom_size(prp->pro_arb, atom)
+	    / sizeof(pa_roar_cont_t);
+    }
+
+    return pa_roar_dir(prp, rootp);
+}
+
+/*
+ * Open a hole in the directory for a new container at "slot"
+ */
+static pa_roar_cont_t *
+pa_roar_dir_insert (pa_roar_t *prp, pa_roar_root_t *rootp, uint32_t slot)
+{
+    pa_roar_cont_t *dir = pa_roar_dir_reserve(prp, rootp,
+					      rootp->prt_count + 1);
+    if (dir == NULL)
+	return NULL;
+
+    memmove(&dir[slot + 1], &dir[slot],
+	    (rootp->prt_count - slot) * sizeof(*dir));
+    bzero(&dir[slot], sizeof(*dir));
+    rootp->prt_count += 1;
+
+    return dir;
+}
+
+static void
+pa_roar_dir_remove (pa_roar_t *prp, pa_roar_root_t *rootp,
+		    pa_roar_cont_t *dir, uint32_t slot)
+{
+    pa_roar_cont_free(prp, &dir[slot]);
+    memmove(&dir[slot], &dir[slot + 1],
+	    (rootp->prt_count - slot - 1) * sizeof(*dir));
+    rootp->prt_count -= 1;
+}
+
+/*
+ * Free all the containers in a set, leaving it empty
+ */
+static void
+pa_roar_empty (pa_roar_t *prp, pa_roar_root_t *rootp)
+{
+    pa_roar_cont_t *dir = pa_roar_dir(prp, rootp);
+    uint32_t i;
+
+    if (dir)
+	for (i = 0; i < rootp->prt_count; i++)
+	    pa_roar_cont_free(prp, &dir[i]);
+
+    rootp->prt_count = 0;
+    rootp->prt_card = 0;
+}
+
+pa_roar_id_t
+pa_roar_alloc (pa_roar_t *prp)
+{
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(prp->pro_roots);
+    pa_roar_id_t id = pa_roar_atom(pa_fixed_atom_of(atom));
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+
+    if (rootp == NULL)
+	return pa_roar_null_atom();
+
+    bzero(rootp, sizeof(*rootp));
+    return id;
+}
+
+void
+pa_roar_free (pa_roar_t *prp, pa_roar_id_t id)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+
+    if (rootp == NULL)
+	return;
+
+    pa_roar_empty(prp, rootp);
+    if (!pa_arb_is_null(rootp->prt_dir))
+	pa_arb_free_atom(prp->pro_arb, rootp->prt_dir);
+
+    pa_fixed_free_atom(prp->pro_roots, pa_fixed_atom(pa_roar_atom_of(id)));
+}
+
+psu_boolean_t
+pa_roar_test (pa_roar_t *prp, pa_roar_id_t id, uint32_t value)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir;
+    psu_boolean_t found;
+    uint32_t slot;
+
+    if (rootp == NULL || rootp->prt_count == 0)
+	return FALSE;
+
+    dir = pa_roar_dir(prp, rootp);
+    if (dir == NULL)
+	return FALSE;
+
+    slot = pa_roar_find(dir, rootp->prt_count, value >> 16, &found);
+    return found && pa_roar_cont_test(prp, &dir[slot], value & 0xffff);
+}
+
+psu_boolean_t
+pa_roar_set (pa_roar_t *prp, pa_roar_id_t id, uint32_t value)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir;
+    psu_boolean_t found = FALSE;
+    uint32_t slot = 0;
+    uint16_t *values;
+    pa_arb_atom_t atom;
+    int rc;
+
+    if (rootp == NULL)
+	return FALSE;
+
+    dir = pa_roar_dir(prp, rootp);
+    if (dir)
+	slot = pa_roar_find(dir, rootp->prt_count, value >> 16, &found);
+
+    if (found) {
+	rc = pa_roar_cont_set(prp, &dir[slot], value & 0xffff);
+	if (rc < 0)
+	    return FALSE;
+
+	rootp->prt_card += rc;
+	return TRUE;
+    }
+
+    /* A new container, holding just this value */
+    atom = pa_arb_alloc(prp->pro_arb, PA_ROAR_ARRAY_MIN * sizeof(*values));
+    values = pa_roar_data(prp, atom);
+    if (values == NULL)
+	return FALSE;
+
+    dir = pa_roar_dir_insert(prp, rootp, slot);
+    if (dir == NULL) {
+	pa_arb_free_atom(prp->pro_arb, atom);
+	return FALSE;
+    }
+
+    values[0] = value & 0xffff;
+    dir[slot].prc_key = value >> 16;
+    dir[slot].prc_type = PA_ROAR_ARRAY;
+    dir[slot].prc_card = 1;
+    dir[slot].prc_data = atom;
+    rootp->prt_card += 1;
+
+    return TRUE;
+}
+
+psu_boolean_t
+pa_roar_clear (pa_roar_t *prp, pa_roar_id_t id, uint32_t value)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir;
+    psu_boolean_t found;
+    uint32_t slot;
+    int rc;
+
+    if (rootp == NULL || rootp->prt_count == 0)
+	return TRUE;
+
+    dir = pa_roar_dir(prp, rootp);
+    if (dir == NULL)
+	return TRUE;
+
+    slot = pa_roar_find(dir, rootp->prt_count, value >> 16, &found);
+    if (!found)
+	return TRUE;
+
+    rc = pa_roar_cont_clear(prp, &dir[slot], value & 0xffff);
+    if (rc < 0)
+	return FALSE;
+
+    rootp->prt_card -= rc;
+    if (dir[slot].prc_card == 0)
+	pa_roar_dir_remove(prp, rootp, dir, slot);
+
+    return TRUE;
+}
+
+psu_boolean_t
+pa_roar_next (pa_roar_t *prp, pa_roar_id_t id, uint32_t value,
+	      uint32_t *valuep)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir;
+    psu_boolean_t found;
+    uint32_t slot;
+    unsigned low, next;
+
+    if (rootp == NULL || rootp->prt_count == 0)
+	return FALSE;
+
+    dir = pa_roar_dir(prp, rootp);
+    if (dir == NULL)
+	return FALSE;
+
+    slot = pa_roar_find(dir, rootp->prt_count, value >> 16, &found);
+    low = found ? (value & 0xffff) : 0;
+
+    for ( ; slot < rootp->prt_count; slot++, low = 0) {
+	next = pa_roar_cont_next(prp, &dir[slot], low);
+	if (next < PA_ROAR_BITMAP_BITS) {
+	    *valuep = ((uint32_t) dir[slot].prc_key << 16) | next;
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+/*
+ * Merge two sorted arrays under an operation, into "out", returning
+ * the number of values.  AND and ANDNOT never write past what they've
+ * read, so "out" may be "a" for them.
+ */
+static uint32_t
+pa_roar_array_merge (const uint16_t *a, uint32_t na, const uint16_t *b,
+		     uint32_t nb, uint16_t *out, int op)
+{
+    uint32_t i = 0, j = 0, n = 0;
+    psu_boolean_t keep_a = (op != PA_ROAR_OP_AND);
+    psu_boolean_t keep_b = (op == PA_ROAR_OP_OR || op == PA_ROAR_OP_XOR);
+    psu_boolean_t keep_both = (op == PA_ROAR_OP_AND || op == PA_ROAR_OP_OR);
+    unsigned va, vb;
+
+    /*
+     * AND and ANDNOT are the common cases, and random values make the
+     * branches below a coin toss, so these loops avoid them: we always
+     * store a's value, but only count it when it's wanted.
+     */
+    if (op == PA_ROAR_OP_AND) {
+	while (i < na && j < nb) {
+	    va = a[i];
+	    vb = b[j];
+	    out[n] = va;
+	    n += (va == vb);
+	    i += (va <= vb);
+	    j += (vb <= va);
+	}
+	return n;
+    }
+
+    if (op == PA_ROAR_OP_ANDNOT) {
+	while (i < na && j < nb) {
+	    va = a[i];
+	    vb = b[j];
+	    out[n] = va;
+	    n += (va < vb);
+	    i += (va <= vb);
+	    j += (vb <= va);
+	}
+	while (i < na)
+	    out[n++] = a[i++];
+	return n;
+    }
+
+    while (i < na && j < nb) {
+	if (a[i] < b[j]) {
+	    if (keep_a)
+		out[n++] = a[i];
+	    i += 1;
+	} else if (a[i] > b[j]) {
+	    if (keep_b)
+		out[n++] = b[j];
+	    j += 1;
+	} else {
+	    if (keep_both)
+		out[n++] = a[i];
+	    i += 1;
+	    j += 1;
+	}
+    }
+
+    if (keep_a)
+	while (i < na)
+	    out[n++] = a[i++];
+
+    if (keep_b)
+	while (j < nb)
+	    out[n++] = b[j++];
+
+    return n;
+}
+
+/*
+ * Apply an operation to a pair of containers with the same key,
+ * updating "dp".  A card of zero means "dp" is now empty.
+ */
+static psu_boolean_t
+pa_roar_cont_op (pa_roar_t *prp, pa_roar_cont_t *dp,
+		 const pa_roar_cont_t *sp, int op)
+{
+    void *ddata = pa_roar_data(prp, dp->prc_data);
+    const void *sdata = pa_roar_data(prp, sp->prc_data);
+    pa_bitunit_t *dbits;
+    const pa_bitunit_t *sbits;
+    uint32_t card, n = 0, i;
+
+    if (ddata == NULL || sdata == NULL)
+	return FALSE;
+
+    /* AND and ANDNOT of an array keep some of its values, in place */
+    if (dp->prc_type == PA_ROAR_ARRAY
+	    && (op == PA_ROAR_OP_AND || op == PA_ROAR_OP_ANDNOT)) {
+	uint16_t *values = ddata;
+	psu_boolean_t want = (op == PA_ROAR_OP_AND);
+
+	/* Merge arrays of similar sizes; otherwise probe the other */
+	if (sp->prc_type == PA_ROAR_ARRAY && sp->prc_card < 32 * dp->prc_card) {
+	    n = pa_roar_array_merge(values, dp->prc_card, sdata,
+				    sp->prc_card, values, op);
+	} else {
+	    for (i = 0; i < dp->prc_card; i++)
+		if (pa_roar_cont_test(prp, sp, values[i]) == want)
+		    values[n++] = values[i];
+	}
+
+	dp->prc_card = n;
+	return TRUE;
+    }
+
+    /* AND with an array: probe ourselves with its values */
+    if (op == PA_ROAR_OP_AND && sp->prc_type == PA_ROAR_ARRAY) {
+	const uint16_t *svalues = sdata;
+
+	for (i = 0; i < sp->prc_card; i++)
+	    if (pa_roar_cont_test(prp, dp, svalues[i]))
+		prp->pro_values[n++] = svalues[i];
+
+	if (n == 0) {
+	    dp->prc_card = 0;
+	    return TRUE;
+	}
+
+	return pa_roar_cont_store(prp, dp, PA_ROAR_ARRAY, prp->pro_values,
+				  n * sizeof(uint16_t), n, 0);
+    }
+
+    /* OR and XOR of two arrays, as long as the result is an array */
+    if (dp->prc_type == PA_ROAR_ARRAY && sp->prc_type == PA_ROAR_ARRAY) {
+	n = pa_roar_array_merge(ddata, dp->prc_card, sdata, sp->prc_card,
+				prp->pro_values, op);
+	if (n == 0) {
+	    dp->prc_card = 0;
+	    return TRUE;
+	}
+
+	if (n <= PA_ROAR_ARRAY_MAX)
+	    return pa_roar_cont_store(prp, dp, PA_ROAR_ARRAY, prp->pro_values,
+				      n * sizeof(uint16_t), n, 0);
+    }
+
+    /*
+     * Everything else goes thru bitmaps.  A bitmap container is
+     * worked on in place.
+     */
+    dbits = prp->pro_bits;
+    if (dp->prc_type == PA_ROAR_BITMAP)
+	dbits = ddata;
+    else
+	pa_roar_cont_bits(prp, dp, dbits);
+
+    /* The kernels don't mind that arb data is only 4-byte aligned */
+    if (sp->prc_type == PA_ROAR_BITMAP) {
+	sbits = sdata;
+    } else {
+	pa_roar_cont_bits(prp, sp, prp->pro_bits + PA_ROAR_BITMAP_UNITS);
+	sbits = prp->pro_bits + PA_ROAR_BITMAP_UNITS;
+    }
+
+    switch (op) {
+    case PA_ROAR_OP_AND:
+	pa_bitmap_units_and(dbits, sbits, PA_ROAR_BITMAP_UNITS);
+	break;
+
+    case PA_ROAR_OP_OR:
+	pa_bitmap_units_or(dbits, sbits, PA_ROAR_BITMAP_UNITS);
+	break;
+
+    case PA_ROAR_OP_ANDNOT:
+	pa_bitmap_units_andnot(dbits, sbits, PA_ROAR_BITMAP_UNITS);
+	break;
+
+    default:
+	pa_bitmap_units_xor(dbits, sbits, PA_ROAR_BITMAP_UNITS);
+	break;
+    }
+
+    card = pa_bitmap_units_count(dbits, PA_ROAR_BITMAP_UNITS);
+    if (card == 0) {
+	dp->prc_card = 0;
+	return TRUE;
+    }
+
+    /* A bitmap that's still full enough stays as it is */
+    if (dbits == ddata && card > PA_ROAR_ARRAY_MAX) {
+	dp->prc_card = card;
+	return TRUE;
+    }
+
+    if (!pa_roar_cont_from_bits(prp, dp, dbits, card)) {
+	/* If we changed a bitmap in place, it's still right */
+	if (dbits == ddata)
+	    dp->prc_card = card;
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Give a container a copy of another's data
+ */
+static psu_boolean_t
+pa_roar_cont_copy (pa_roar_t *prp, pa_roar_cont_t *dp,
+		   const pa_roar_cont_t *sp)
+{
+    const void *sdata = pa_roar_data(prp, sp->prc_data);
+
+    *dp = *sp;
+    dp->prc_data = pa_arb_null_atom();
+
+    if (sdata == NULL)
+	return FALSE;
+
+    return pa_roar_cont_store(prp, dp, sp->prc_type, sdata,
+			      pa_roar_cont_bytes(sp), sp->prc_card,
+			      sp->prc_runs);
+}
+
+static psu_boolean_t
+pa_roar_combine (pa_roar_t *prp, pa_roar_id_t dst_id, pa_roar_id_t src_id,
+		 int op)
+{
+    pa_roar_root_t *dstp = pa_roar_root(prp, dst_id);
+    pa_roar_root_t *srcp = pa_roar_root(prp, src_id);
+    pa_roar_cont_t *ddir, *sdir, *out;
+    uint32_t dcount, scount, want, i = 0, j = 0, n = 0;
+    psu_boolean_t ok = TRUE;
+    uint64_t card = 0;
+
+    if (dstp == NULL || srcp == NULL)
+	return FALSE;
+
+    if (pa_roar_atom_of(dst_id) == pa_roar_atom_of(src_id)) {
+	if (op == PA_ROAR_OP_ANDNOT || op == PA_ROAR_OP_XOR)
+	    pa_roar_empty(prp, dstp);
+	return TRUE;
+    }
+
+    dcount = dstp->prt_count;
+    scount = srcp->prt_count;
+    want = dcount;
+    if (op == PA_ROAR_OP_OR || op == PA_ROAR_OP_XOR)
+	want += scount;
+
+    if (want == 0) {
+	pa_roar_empty(prp, dstp);
+	return TRUE;
+    }
+
+    /*
+     * Make room in the directory first, so we can't fail after
+     * we've started changing containers.  The new directory is built
+     * on the side, since OR and XOR add containers as they go.
+     */
+    ddir = pa_roar_dir_reserve(prp, dstp, want);
+    sdir = pa_roar_dir(prp, srcp);
+    out = psu_calloc(want * sizeof(*out));
+    if (ddir == NULL || out == NULL || (scount && sdir == NULL)) {
+	psu_free(out);
+	return FALSE;
+    }
+
+    while (i < dcount || j < scount) {
+	if (j == scount || (i < dcount && ddir[i].prc_key < sdir[j].prc_key)) {
+	    /* Only in dst; AND drops it */
+	    if (op == PA_ROAR_OP_AND)
+		pa_roar_cont_free(prp, &ddir[i]);
+	    else
+		out[n++] = ddir[i];
+	    i += 1;
+
+	} else if (i == dcount || sdir[j].prc_key < ddir[i].prc_key) {
+	    /* Only in src; OR and XOR copy it */
+	    if (op == PA_ROAR_OP_OR || op == PA_ROAR_OP_XOR) {
+		if (pa_roar_cont_copy(prp, &out[n], &sdir[j]))
+		    n += 1;
+		else
+		    ok = FALSE;
+	    }
+	    j += 1;
+
+	} else {
+	    out[n] = ddir[i];
+	    if (!pa_roar_cont_op(prp, &out[n], &sdir[j], op))
+		ok = FALSE;
+
+	    if (out[n].prc_card)
+		n += 1;
+	    else
+		pa_roar_cont_free(prp, &out[n]);
+	    i += 1;
+	    j += 1;
+	}
+    }
+
+    for (i = 0; i < n; i++)
+	card += out[i].prc_card;
+
+    memcpy(ddir, out, n * sizeof(*out));
+    dstp->prt_count = n;
+    dstp->prt_card = card;
+
+    psu_free(out);
+    return ok;
+}
+
+psu_boolean_t
+pa_roar_and (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src)
+{
+    return pa_roar_combine(prp, dst, src, PA_ROAR_OP_AND);
+}
+
+psu_boolean_t
+pa_roar_or (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src)
+{
+    return pa_roar_combine(prp, dst, src, PA_ROAR_OP_OR);
+}
+
+psu_boolean_t
+pa_roar_andnot (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src)
+{
+    return pa_roar_combine(prp, dst, src, PA_ROAR_OP_ANDNOT);
+}
+
+psu_boolean_t
+pa_roar_xor (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src)
+{
+    return pa_roar_combine(prp, dst, src, PA_ROAR_OP_XOR);
+}
+
+/*
+ * The portable format is little-endian, whatever we are
+ */
+static inline void
+pa_roar_put16 (psu_byte_t *cp, unsigned value)
+{
+    cp[0] = value & 0xff;
+    cp[1] = (value >> 8) & 0xff;
+}
+
+static inline void
+pa_roar_put32 (psu_byte_t *cp, uint32_t value)
+{
+    pa_roar_put16(cp, value & 0xffff);
+    pa_roar_put16(cp + 2, value >> 16);
+}
+
+static inline unsigned
+pa_roar_get16 (const psu_byte_t *cp)
+{
+    return cp[0] | (cp[1] << 8);
+}
+
+static inline uint32_t
+pa_roar_get32 (const psu_byte_t *cp)
+{
+    return pa_roar_get16(cp) | ((uint32_t) pa_roar_get16(cp + 2) << 16);
+}
+
+/*
+ * Return the number of bytes a container needs when serialized.  A
+ * bitmap that's shrunk to PA_ROAR_ARRAY_MAX values (which we let
+ * happen during set operations) is written as an array.
+ */
+static size_t
+pa_roar_cont_serial_bytes (const pa_roar_cont_t *contp)
+{
+    if (contp->prc_type == PA_ROAR_RUN)
+	return sizeof(uint16_t) + contp->prc_runs * 2 * sizeof(uint16_t);
+
+    if (contp->prc_card <= PA_ROAR_ARRAY_MAX)
+	return contp->prc_card * sizeof(uint16_t);
+
+    return PA_ROAR_BITMAP_SIZE;
+}
+
+size_t
+pa_roar_serialize (pa_roar_t *prp, pa_roar_id_t id, void *buf, size_t size)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir = rootp ? pa_roar_dir(prp, rootp) : NULL;
+    uint32_t count = dir ? rootp->prt_count : 0, i, k;
+    psu_boolean_t has_runs = FALSE, offsets = TRUE;
+    psu_byte_t *cp = buf, *desc, *offp = NULL;
+    size_t need, pos;
+
+    for (i = 0; i < count; i++)
+	if (dir[i].prc_type == PA_ROAR_RUN)
+	    has_runs = TRUE;
+
+    /* The header: cookie, descriptions, and (usually) offsets */
+    if (has_runs) {
+	need = sizeof(uint32_t) + (count + 7) / 8;
+	offsets = (count >= PA_ROAR_NO_OFFSETS);
+    } else {
+	need = 2 * sizeof(uint32_t);
+    }
+
+    pos = need;
+    need += count * 2 * sizeof(uint16_t);
+    if (offsets)
+	need += count * sizeof(uint32_t);
+
+    for (i = 0; i < count; i++)
+	need += pa_roar_cont_serial_bytes(&dir[i]);
+
+    if (buf == NULL || size < need)
+	return need;
+
+    if (has_runs) {
+	pa_roar_put32(cp, PA_ROAR_COOKIE | ((count - 1) << 16));
+	bzero(cp + sizeof(uint32_t), (count + 7) / 8);
+	for (i = 0; i < count; i++)
+	    if (dir[i].prc_type == PA_ROAR_RUN)
+		cp[sizeof(uint32_t) + i / 8] |= 1 << (i % 8);
+    } else {
+	pa_roar_put32(cp, PA_ROAR_COOKIE_NO_RUNS);
+	pa_roar_put32(cp + sizeof(uint32_t), count);
+    }
+
+    desc = cp + pos;
+    pos += count * 2 * sizeof(uint16_t);
+    if (offsets) {
+	offp = cp + pos;
+	pos += count * sizeof(uint32_t);
+    }
+
+    for (i = 0; i < count; i++) {
+	pa_roar_cont_t *contp = &dir[i];
+	const void *data = pa_roar_data(prp, contp->prc_data);
+	psu_byte_t *dp = cp + pos;
+
+	pa_roar_put16(desc + i * 4, contp->prc_key);
+	pa_roar_put16(desc + i * 4 + 2, contp->prc_card - 1);
+	if (offp)
+	    pa_roar_put32(offp + i * 4, pos);
+
+	if (contp->prc_type == PA_ROAR_RUN) {
+	    const pa_roar_run_t *runs = data;
+
+	    pa_roar_put16(dp, contp->prc_runs);
+	    for (k = 0; k < contp->prc_runs; k++) {
+		pa_roar_put16(dp + 2 + k * 4, runs[k].prn_start);
+		pa_roar_put16(dp + 4 + k * 4, runs[k].prn_length);
+	    }
+
+	} else if (contp->prc_type == PA_ROAR_ARRAY) {
+	    const uint16_t *values = data;
+
+	    for (k = 0; k < contp->prc_card; k++)
+		pa_roar_put16(dp + k * 2, values[k]);
+
+	} else if (contp->prc_card <= PA_ROAR_ARRAY_MAX) {
+	    unsigned low;
+
+	    k = 0;
+	    for (low = pa_roar_bits_next(data, 0, 0);
+		 low < PA_ROAR_BITMAP_BITS;
+		 low = pa_roar_bits_next(data, low + 1, 0))
+		pa_roar_put16(dp + 2 * k++, low);
+
+	} else {
+	    const pa_bitunit_t *bits = data;
+
+	    for (k = 0; k < PA_ROAR_BITMAP_UNITS; k++)
+		pa_roar_put32(dp + k * sizeof(*bits), bits[k]);
+	}
+
+	pos += pa_roar_cont_serial_bytes(contp);
+    }
+
+    return need;
+}
+
+/*
+ * Read one container's data, checking it as we go.  The container is
+ * already in the directory, so a failure leaves it for
+ * pa_roar_free to clean up.
+ */
+static psu_boolean_t
+pa_roar_cont_read (pa_roar_t *prp, pa_roar_cont_t *contp,
+		   const psu_byte_t *cp, size_t len, size_t *usedp)
+{
+    uint32_t card = contp->prc_card, k, total = 0;
+    unsigned prev = 0, start, length;
+    pa_arb_atom_t atom;
+    size_t bytes;
+
+    if (contp->prc_type == PA_ROAR_RUN) {
+	pa_roar_run_t *runs;
+	uint32_t count;
+
+	if (len < sizeof(uint16_t))
+	    return FALSE;
+
+	count = pa_roar_get16(cp);
+	bytes = sizeof(uint16_t) + count * 2 * sizeof(uint16_t);
+	if (count == 0 || len < bytes)
+	    return FALSE;
+
+	atom = pa_arb_alloc(prp->pro_arb, count * sizeof(*runs));
+	runs = pa_roar_data(prp, atom);
+	if (runs == NULL)
+	    return FALSE;
+	contp->prc_data = atom;
+	contp->prc_runs = count;
+
+	for (k = 0; k < count; k++) {
+	    start = pa_roar_get16(cp + 2 + k * 4);
+	    length = pa_roar_get16(cp + 4 + k * 4);
+	    if ((k > 0 && start <= prev) || start + length >= PA_ROAR_BITMAP_BITS)
+		return FALSE;
+
+	    runs[k].prn_start = start;
+	    runs[k].prn_length = length;
+	    prev = start + length + 1; /* Runs can't touch */
+	    total += length + 1;
+	}
+
+	*usedp = bytes;
+	return (total == card);
+    }
+
+    if (contp->prc_type == PA_ROAR_ARRAY) {
+	uint16_t *values;
+
+	bytes = card * sizeof(uint16_t);
+	if (len < bytes)
+	    return FALSE;
+
+	atom = pa_arb_alloc(prp->pro_arb, bytes);
+	values = pa_roar_data(prp, atom);
+	if (values == NULL)
+	    return FALSE;
+	contp->prc_data = atom;
+
+	for (k = 0; k < card; k++) {
+	    values[k] = pa_roar_get16(cp + k * 2);
+	    if (k > 0 && values[k] <= values[k - 1])
+		return FALSE;
+	}
+
+	*usedp = bytes;
+	return TRUE;
+    }
+
+    pa_bitunit_t *bits;
+
+    bytes = PA_ROAR_BITMAP_SIZE;
+    if (len < bytes)
+	return FALSE;
+
+    atom = pa_arb_alloc(prp->pro_arb, bytes);
+    bits = pa_roar_data(prp, atom);
+    if (bits == NULL)
+	return FALSE;
+    contp->prc_data = atom;
+
+    for (k = 0; k < PA_ROAR_BITMAP_UNITS; k++)
+	bits[k] = pa_roar_get32(cp + k * sizeof(*bits));
+
+    *usedp = bytes;
+    return (pa_bitmap_units_count(bits, PA_ROAR_BITMAP_UNITS) == card);
+}
+
+pa_roar_id_t
+pa_roar_deserialize (pa_roar_t *prp, const void *buf, size_t len)
+{
+    const psu_byte_t *cp = buf, *runflags = NULL, *desc, *offp = NULL;
+    pa_roar_id_t id = pa_roar_null_atom();
+    pa_roar_root_t *rootp;
+    pa_roar_cont_t *dir = NULL;
+    uint32_t cookie, count, i;
+    size_t pos, used;
+
+    if (cp == NULL || len < sizeof(uint32_t))
+	goto fail;
+
+    cookie = pa_roar_get32(cp);
+    if ((cookie & 0xffff) == PA_ROAR_COOKIE) {
+	count = (cookie >> 16) + 1;
+	runflags = cp + sizeof(uint32_t);
+	pos = sizeof(uint32_t) + (count + 7) / 8;
+
+    } else if (cookie == PA_ROAR_COOKIE_NO_RUNS && len >= 8) {
+	count = pa_roar_get32(cp + sizeof(uint32_t));
+	pos = 2 * sizeof(uint32_t);
+	if (count > PA_ROAR_BITMAP_BITS)
+	    goto fail;
+
+    } else {
+	goto fail;
+    }
+
+    desc = cp + pos;
+    pos += count * 2 * sizeof(uint16_t);
+    if (runflags == NULL || count >= PA_ROAR_NO_OFFSETS) {
+	offp = cp + pos;
+	pos += count * sizeof(uint32_t);
+    }
+
+    if (pos > len)
+	goto fail;
+
+    id = pa_roar_alloc(prp);
+    rootp = pa_roar_root(prp, id);
+    if (rootp == NULL)
+	goto fail;
+
+    if (count) {
+	dir = pa_roar_dir_reserve(prp, rootp, count);
+	if (dir == NULL)
+	    goto fail;
+    }
+
+    for (i = 0; i < count; i++) {
+	pa_roar_cont_t *contp = &dir[i];
+
+	bzero(contp, sizeof(*contp));
+	contp->prc_key = pa_roar_get16(desc + i * 4);
+	contp->prc_card = pa_roar_get16(desc + i * 4 + 2) + 1;
+	if (i > 0 && contp->prc_key <= dir[i - 1].prc_key)
+	    goto fail;
+
+	if (runflags && (runflags[i / 8] & (1 << (i % 8))))
+	    contp->prc_type = PA_ROAR_RUN;
+	else if (contp->prc_card > PA_ROAR_ARRAY_MAX)
+	    contp->prc_type = PA_ROAR_BITMAP;
+	else
+	    contp->prc_type = PA_ROAR_ARRAY;
+
+	if (offp) {
+	    pos = pa_roar_get32(offp + i * 4);
+	    if (pos > len)
+		goto fail;
+	}
+
+	rootp->prt_count = i + 1;
+	if (!pa_roar_cont_read(prp, contp, cp + pos, len - pos, &used))
+	    goto fail;
+
+	rootp->prt_card += contp->prc_card;
+	pos += used;
+    }
+
+    return id;
+
+ fail:
+    pa_warning(0, "pa_roar: bad serialized bitmap");
+    if (!pa_roar_is_null(id))
+	pa_roar_free(prp, id);
+    return pa_roar_null_atom();
+}
+
+void
+pa_roar_init (pa_mmap_t *pmp, pa_roar_t *prp, const char *name UNUSED)
+{
+    prp->pro_mmap = pmp;
+}
+
+pa_roar_t *
+pa_roar_setup (pa_mmap_t *pmp, pa_roar_info_t *proip, const char *name)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    pa_roar_t *prp = psu_calloc(sizeof(*prp));
+
+    if (prp == NULL)
+	return NULL;
+
+    prp->pro_infop = proip;
+    pa_roar_init(pmp, prp, name);
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "roots");
+    prp->pro_roots = pa_fixed_setup(pmp, &proip->proi_roots, namebuf,
+				    PA_ROAR_ROOT_SHIFT,
+				    sizeof(pa_roar_root_t), PA_ROAR_MAX_ATOMS);
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "arb");
+    prp->pro_arb = pa_arb_setup(pmp, &proip->proi_arb, namebuf);
+
+    prp->pro_bits = psu_calloc(2 * PA_ROAR_BITMAP_SIZE);
+    prp->pro_values = psu_calloc(2 * PA_ROAR_ARRAY_MAX * sizeof(uint16_t));
+
+    if (prp->pro_roots == NULL || prp->pro_arb == NULL
+	    || prp->pro_bits == NULL || prp->pro_values == NULL) {
+	pa_roar_close(prp);
+	return NULL;
+    }
+
+    return prp;
+}
+
+pa_roar_t *
+pa_roar_open (pa_mmap_t *pmp, const char *name)
+{
+    pa_roar_info_t *proip = NULL;
+
+    proip = pa_mmap_header(pmp, name, PA_TYPE_ROAR, 0, sizeof(*proip));
+    if (proip == NULL) {
+	pa_warning(0, "pa_roar header not found: %s", name);
+	return NULL;
+    }
+
+    return pa_roar_setup(pmp, proip, name);
+}
+
+void
+pa_roar_close (pa_roar_t *prp)
+{
+    if (prp->pro_roots)
+	pa_fixed_close(prp->pro_roots);
+    if (prp->pro_arb)
+	pa_arb_close(prp->pro_arb);
+
+    psu_free(prp->pro_bits);
+    psu_free(prp->pro_values);
+    psu_free(prp);
+}
+
+void
+pa_roar_dump (pa_roar_t *prp, pa_roar_id_t id, psu_boolean_t full)
+{
+    static const char *types[] = { "none", "array", "bitmap", "run" };
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir;
+    uint32_t i;
+
+    psu_log("begin pa_roar dump of %#" PA_ATOM_XFMT, pa_roar_atom_of(id));
+
+    if (rootp) {
+	psu_log("count %llu, containers %u (room for %u)",
+		(unsigned long long) rootp->prt_card, rootp->prt_count,
+		rootp->prt_size);
+
+	dir = pa_roar_dir(prp, rootp);
+	if (full && dir) {
+	    for (i = 0; i < rootp->prt_count; i++)
+		psu_log("  key %#x: %s, %u values, %u runs, %zu bytes",
+			dir[i].prc_key,
+			types[dir[i].prc_type <= PA_ROAR_RUN
+			      ? dir[i].prc_type : 0],
+			dir[i].prc_card, dir[i].prc_runs,
+			pa_arb_atom_size(prp->pro_arb, dir[i].prc_data));
+	}
+    }
+
+    psu_log("end pa_roar dump of %#" PA_ATOM_XFMT, pa_roar_atom_of(id));
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PAROAR_H
+#define PARROTDB_PAROAR_H
+
+/**
+ * @file paroar.h
+ * @brief Compressed ("roaring") bitmap APIs
+ *
+ * A pa_roar is a set of 32-bit values, kept the way Roaring bitmaps
+ * keep them.  Values are grouped by their high 16 bits, and each
+ * group lives in a "container" that holds just the low 16 bits, in
+ * whichever of three forms suits it:
+ *
+ *   - an array of sorted values, for up to 4096 values
+ *   - a 65536-bit (8k) bitmap, for more than that
+ *   - a list of runs (start and length), when the values clump
+ *
+ * Unlike a pa_bitmap, a set with one value costs a few dozen bytes,
+ * and values can go all the way to UINT32_MAX.  Intersections merge
+ * arrays, probe bitmaps and runs with array values, and combine
+ * bitmaps with the same kernels pa_bitmap uses.
+ *
+ * Each set ("id") is a small root record in a pa_fixed array.  The
+ * root points to a directory of containers, sorted by key, and the
+ * directory and containers are allocated from a pa_arb, so the whole
+ * set lives in the mmap segment.  pa_roar_serialize() writes a set in
+ * the portable Roaring format, for storing outside the segment or for
+ * handing to other Roaring libraries.  Like pa_bitmap, a pa_roar does
+ * no locking of its own.
+ */
+
+/* Wrapper for our "set root" atom */
+PA_ATOM_TYPE(pa_roar_atom_t, pa_roar_atom_s, proa_atom,
+	     pa_roar_is_null, pa_roar_atom, pa_roar_atom_of,
+	     pa_roar_null_atom);
+
+/* As with pa_bitmap, users see an "id" for each set */
+typedef pa_roar_atom_t pa_roar_id_t;
+
+/* Container types */
+#define PA_ROAR_ARRAY		1 /* Sorted array of uint16_t values */
+#define PA_ROAR_BITMAP		2 /* 65536 bits */
+#define PA_ROAR_RUN		3 /* Sorted array of runs */
+
+#define PA_ROAR_ARRAY_MAX	4096 /* Most values in an array container */
+#define PA_ROAR_BITMAP_BITS	65536 /* Bits in a bitmap container */
+#define PA_ROAR_BITMAP_UNITS	(PA_ROAR_BITMAP_BITS / PA_BITMAP_BITS_PER_UNIT)
+#define PA_ROAR_BITMAP_SIZE	(PA_ROAR_BITMAP_BITS / PA_NBBY)
+#define PA_ROAR_RUN_MAX		2048 /* Most runs, which fill 8k, like a bitmap */
+
+#define PA_ROAR_MAX_ATOMS	(1 << 24) /* Most sets */
+
+/*
+ * A run of values, from prn_start to (prn_start + prn_length)
+ */
+typedef struct pa_roar_run_s {
+    uint16_t prn_start;		/* First value in the run */
+    uint16_t prn_length;	/* Number of values, minus one */
+} pa_roar_run_t;
+
+/*
+ * A directory entry, describing one container
+ */
+typedef struct pa_roar_cont_s {
+    uint16_t prc_key;		/* High 16 bits of our values */
+    uint8_t prc_type;		/* Type of container (PA_ROAR_*) */
+    uint8_t prc_pad;		/* (Unused) */
+    uint32_t prc_card;		/* Number of values (1 to 65536) */
+    uint32_t prc_runs;		/* Number of runs (PA_ROAR_RUN) */
+    pa_arb_atom_t prc_data;	/* Array, bitmap, or runs */
+} pa_roar_cont_t;
+
+/*
+ * The root of a set, which is what a pa_roar_id_t refers to
+ */
+typedef struct pa_roar_root_s {
+    uint64_t prt_card;		/* Number of values in the set */
+    uint32_t prt_count;		/* Number of containers */
+    uint32_t prt_size;		/* Room in the directory (in containers) */
+    pa_arb_atom_t prt_dir;	/* Directory (pa_roar_cont_t[]) */
+    uint32_t prt_pad;		/* (Unused) */
+} pa_roar_root_t;
+
+typedef struct pa_roar_info_s {
+    pa_fixed_info_t proi_roots;	/* Roots of our sets */
+    pa_arb_info_t proi_arb;	/* Directories and containers */
+} pa_roar_info_t;
+
+typedef struct pa_roar_s {
+    pa_roar_info_t *pro_infop;	/* Pointer to info block */
+    pa_mmap_t *pro_mmap;	/* Underlaying mmap */
+    pa_fixed_t *pro_roots;	/* Roots of our sets */
+    pa_arb_t *pro_arb;		/* Directories and containers */
+    pa_bitunit_t *pro_bits;	/* Work space: two bitmap containers */
+    uint16_t *pro_values;	/* Work space: two array containers */
+} pa_roar_t;
+
+static inline pa_roar_root_t *
+pa_roar_root (pa_roar_t *prp, pa_roar_id_t id)
+{
+    if (pa_roar_is_null(id))
+	return NULL;
+
+    return pa_fixed_atom_addr(prp->pro_roots,
+			      pa_fixed_atom(pa_roar_atom_of(id)));
+}
+
+/**
+ * @brief
+ * Allocates a new, empty set
+ *
+ * @return
+ *     The id of the new set, or a null id if we're out of memory
+ */
+pa_roar_id_t
+pa_roar_alloc (pa_roar_t *prp);
+
+/**
+ * @brief
+ * Frees a set and all its containers
+ */
+void
+pa_roar_free (pa_roar_t *prp, pa_roar_id_t id);
+
+/**
+ * @brief
+ * Returns TRUE if the value is in the set
+ */
+psu_boolean_t
+pa_roar_test (pa_roar_t *prp, pa_roar_id_t id, uint32_t value);
+
+/**
+ * @brief
+ * Adds a value to the set
+ *
+ * @return
+ *     @c FALSE if we ran out of memory, in which case the set is
+ *     unchanged.
+ */
+psu_boolean_t
+pa_roar_set (pa_roar_t *prp, pa_roar_id_t id, uint32_t value);
+
+/**
+ * @brief
+ * Removes a value from the set.  Removing a value may need memory
+ * (splitting a run in two); if it can't be had, we return @c FALSE
+ * and the set is unchanged.
+ */
+psu_boolean_t
+pa_roar_clear (pa_roar_t *prp, pa_roar_id_t id, uint32_t value);
+
+/**
+ * @brief
+ * Returns the number of values in the set
+ */
+static inline uint64_t
+pa_roar_count (pa_roar_t *prp, pa_roar_id_t id)
+{
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+
+    return rootp ? rootp->prt_card : 0;
+}
+
+/**
+ * @brief
+ * Finds the first value in the set that's greater than or equal to
+ * the given value.  To walk a set:
+ *
+ *     for (ok = pa_roar_next(prp, id, 0, &value); ok && ...;
+ *          ok = (value != UINT32_MAX)
+ *              && pa_roar_next(prp, id, value + 1, &value))
+ *
+ * @return
+ *     @c TRUE if a value was found (and stored in *valuep)
+ */
+psu_boolean_t
+pa_roar_next (pa_roar_t *prp, pa_roar_id_t id, uint32_t value,
+	      uint32_t *valuep);
+
+/*
+ * Set operations.  Each updates "dst" in place, a container at a
+ * time, and returns FALSE if we ran out of memory part way thru.
+ */
+psu_boolean_t
+pa_roar_and (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src);
+
+psu_boolean_t
+pa_roar_or (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src);
+
+psu_boolean_t
+pa_roar_andnot (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src);
+
+psu_boolean_t
+pa_roar_xor (pa_roar_t *prp, pa_roar_id_t dst, pa_roar_id_t src);
+
+/**
+ * @brief
+ * Writes a set into a buffer in the portable Roaring format.  Like
+ * snprintf(), we return the number of bytes the set needs, and only
+ * write it if the buffer is big enough.
+ */
+size_t
+pa_roar_serialize (pa_roar_t *prp, pa_roar_id_t id, void *buf, size_t size);
+
+/**
+ * @brief
+ * Builds a new set from a buffer in the portable Roaring format
+ *
+ * @return
+ *     The id of the new set, or a null id if the buffer isn't valid
+ *     or we ran out of memory
+ */
+pa_roar_id_t
+pa_roar_deserialize (pa_roar_t *prp, const void *buf, size_t len);
+
+void
+pa_roar_init (pa_mmap_t *pmp, pa_roar_t *prp, const char *name);
+
+pa_roar_t *
+pa_roar_setup (pa_mmap_t *pmp, pa_roar_info_t *proip, const char *name);
+
+pa_roar_t *
+pa_roar_open (pa_mmap_t *pmp, const char *name);
+
+void
+pa_roar_close (pa_roar_t *prp);
+
+void
+pa_roar_dump (pa_roar_t *prp, pa_roar_id_t id, psu_boolean_t full);
+
+#endif /* PARROTDB_PAROAR_H */
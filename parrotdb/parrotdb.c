@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Registry of operations (pa_ops_t) for parrotdb types, and
+ * dispatching of descriptors (pa_dscr_t) thru them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <stddef.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/pabitmap.h>
+#include <parrotdb/paroar.h>
+#include <parrotdb/parrotdb.h>
+
+pa_dbase_t pa_dbases[PA_DBASE_MAX];
+
+/*
+ * Operations for the base types.  Each "table" handle is the
+ * allocator itself.
+ */
+static pa_atom_t
+pa_ops_fixed_alloc (pa_mmap_t *pmp UNUSED, void *table, size_t size UNUSED)
+{
+    return pa_fixed_atom_of(pa_fixed_alloc_atom(table));
+}
+
+static void
+pa_ops_fixed_free (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    pa_fixed_free_atom(table, pa_fixed_atom(dscr.pd_atom));
+}
+
+static void *
+pa_ops_fixed_addr (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    return pa_fixed_atom_addr(table, pa_fixed_atom(dscr.pd_atom));
+}
+
+static pa_atom_t
+pa_ops_arb_alloc (pa_mmap_t *pmp UNUSED, void *table, size_t size)
+{
+    return pa_arb_atom_of(pa_arb_alloc(table, size));
+}
+
+static void
+pa_ops_arb_free (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    pa_arb_free_atom(table, pa_arb_atom(dscr.pd_atom));
+}
+
+static void *
+pa_ops_arb_addr (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    return pa_arb_atom_addr(table, pa_arb_atom(dscr.pd_atom));
+}
+
+static pa_atom_t
+pa_ops_bitmap_alloc (pa_mmap_t *pmp UNUSED, void *table, size_t size UNUSED)
+{
+    return pa_bitmap_atom_of(pa_bitmap_alloc(table));
+}
+
+static void
+pa_ops_bitmap_free (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    pa_bitmap_free(table, pa_bitmap_atom(dscr.pd_atom));
+}
+
+static void *
+pa_ops_bitmap_addr (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    pa_bitmap_t *pbp = table;
+
+    return pa_fixed_atom_addr(pbp->pb_data, pa_fixed_atom(dscr.pd_atom));
+}
+
+static pa_atom_t
+pa_ops_roar_alloc (pa_mmap_t *pmp UNUSED, void *table, size_t size UNUSED)
+{
+    return pa_roar_atom_of(pa_roar_alloc(table));
+}
+
+static void
+pa_ops_roar_free (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    pa_roar_free(table, pa_roar_atom(dscr.pd_atom));
+}
+
+static void *
+pa_ops_roar_addr (pa_mmap_t *pmp UNUSED, void *table, pa_dscr_t dscr)
+{
+    return pa_roar_root(table, pa_roar_atom(dscr.pd_atom));
+}
+
+static const pa_ops_t pa_ops_fixed = {
+    .po_name = "fixed",
+    .po_type = PA_TYPE_FIXED,
+    .po_alloc = pa_ops_fixed_alloc,
+    .po_free = pa_ops_fixed_free,
+    .po_addr = pa_ops_fixed_addr,
+};
+
+static const pa_ops_t pa_ops_arb = {
+    .po_name = "arb",
+    .po_type = PA_TYPE_ARB,
+    .po_alloc = pa_ops_arb_alloc,
+    .po_free = pa_ops_arb_free,
+    .po_addr = pa_ops_arb_addr,
+};
+
+static const pa_ops_t pa_ops_bitmap = {
+    .po_name = "bitmap",
+    .po_type = PA_TYPE_BITMAP,
+    .po_alloc = pa_ops_bitmap_alloc,
+    .po_free = pa_ops_bitmap_free,
+    .po_addr = pa_ops_bitmap_addr,
+};
+
+static const pa_ops_t pa_ops_roar = {
+    .po_name = "roar",
+    .po_type = PA_TYPE_ROAR,
+    .po_alloc = pa_ops_roar_alloc,
+    .po_free = pa_ops_roar_free,
+    .po_addr = pa_ops_roar_addr,
+};
+
+static const pa_ops_t *pa_ops_table[PA_TYPE_MAX] = {
+    [PA_TYPE_FIXED] = &pa_ops_fixed,
+    [PA_TYPE_ARB] = &pa_ops_arb,
+    [PA_TYPE_BITMAP] = &pa_ops_bitmap,
+    [PA_TYPE_ROAR] = &pa_ops_roar,
+};
+
+int
+pa_ops_register (const pa_ops_t *ops)
+{
+    if (ops == NULL || ops->po_type == PA_TYPE_UNKNOWN
+	    || ops->po_type >= PA_TYPE_MAX) {
+	pa_warning(0, "pa_ops_register: bad type");
+	return -1;
+    }
+
+    pa_ops_table[ops->po_type] = ops;
+    return 0;
+}
+
+const pa_ops_t *
+pa_ops_find (unsigned type)
+{
+    return (type < PA_TYPE_MAX) ? pa_ops_table[type] : NULL;
+}
+
+int
+pa_dbase_attach (pa_mmap_t *pmp)
+{
+    unsigned i;
+
+    for (i = 0; i < PA_DBASE_MAX; i++) {
+	if (pa_dbases[i].pdb_mmap == NULL) {
+	    bzero(&pa_dbases[i], sizeof(pa_dbases[i]));
+	    pa_dbases[i].pdb_mmap = pmp;
+	    return i;
+	}
+    }
+
+    pa_warning(0, "pa_dbase_attach: too many databases (%u)", PA_DBASE_MAX);
+    return -1;
+}
+
+void
+pa_dbase_detach (unsigned dbase)
+{
+    if (dbase < PA_DBASE_MAX)
+	bzero(&pa_dbases[dbase], sizeof(pa_dbases[dbase]));
+}
+
+int
+pa_table_attach (unsigned dbase, unsigned type, void *handle)
+{
+    const pa_ops_t *ops = pa_ops_find(type);
+    pa_dbase_t *pdbp;
+
+    if (dbase >= PA_DBASE_MAX || pa_dbases[dbase].pdb_mmap == NULL) {
+	pa_warning(0, "pa_table_attach: bad database (%u)", dbase);
+	return -1;
+    }
+
+    if (ops == NULL) {
+	pa_warning(0, "pa_table_attach: no operations for type %u", type);
+	return -1;
+    }
+
+    pdbp = &pa_dbases[dbase];
+    if (pdbp->pdb_count >= PA_TABLE_MAX) {
+	pa_warning(0, "pa_table_attach: too many tables (%u)", PA_TABLE_MAX);
+	return -1;
+    }
+
+    pdbp->pdb_tables[pdbp->pdb_count].pt_ops = ops;
+    pdbp->pdb_tables[pdbp->pdb_count].pt_handle = handle;
+    return pdbp->pdb_count++;
+}
+
+pa_dscr_t
+pa_dscr_alloc (unsigned dbase, unsigned table, size_t size)
+{
+    pa_dscr_t dscr = { dbase, PA_TYPE_UNKNOWN, table, PA_NULL_ATOM };
+    pa_table_t *ptp = pa_dscr_table(dscr);
+
+    if (ptp == NULL)
+	return dscr;
+
+    dscr.pd_type = ptp->pt_ops->po_type;
+    dscr.pd_atom = ptp->pt_ops->po_alloc(pa_dbases[dbase].pdb_mmap,
+					 ptp->pt_handle, size);
+    return dscr;
+}
+
+void
+pa_dscr_free (pa_dscr_t dscr)
+{
+    pa_table_t *ptp = pa_dscr_table(dscr);
+
+    if (ptp == NULL || pa_dscr_is_null(dscr)
+	    || dscr.pd_type != ptp->pt_ops->po_type)
+	return;
+
+    ptp->pt_ops->po_free(pa_dbases[dscr.pd_dbase].pdb_mmap,
+			 ptp->pt_handle, dscr);
+}
+
+void
+pa_dscr_lock (pa_dscr_t dscr, unsigned mode)
+{
+    pa_table_t *ptp = pa_dscr_table(dscr);
+    pa_mmap_t *pmp;
+
+    if (ptp == NULL)
+	return;
+
+    pmp = pa_dbases[dscr.pd_dbase].pdb_mmap;
+    if (ptp->pt_ops->po_lock)
+	ptp->pt_ops->po_lock(pmp, dscr, mode);
+    else if (mode == PA_LOCK_WRITE)
+	pa_mmap_write_lock(pmp);
+    else
+	pa_mmap_read_lock(pmp);
+}
+
+void
+pa_dscr_unlock (pa_dscr_t dscr, unsigned mode)
+{
+    pa_table_t *ptp = pa_dscr_table(dscr);
+    pa_mmap_t *pmp;
+
+    if (ptp == NULL)
+	return;
+
+    pmp = pa_dbases[dscr.pd_dbase].pdb_mmap;
+    if (ptp->pt_ops->po_unlock)
+	ptp->pt_ops->po_unlock(pmp, dscr, mode);
+    else if (mode == PA_LOCK_WRITE)
+	pa_mmap_write_unlock(pmp);
+    else
+	pa_mmap_read_unlock(pmp);
+}
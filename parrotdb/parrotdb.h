@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2016-2017, Juniper Networks, Inc.
+ * Copyright (c) 2016-2026, Juniper Networks, Inc.
  * All rights reserved.
  * This SOFTWARE is licensed under the LICENSE provided in the
  * ../Copyright file. By downloading, installing, copying, or otherwise
@@ -16,6 +16,17 @@
  * A pa_dscr_t is meant to provide some abstraction between
  * the operations on an atom and the atom itself, allowing
  * a layered set of features on top of a simple datatype.
+ *
+ * A database is a pa_mmap_t that's been given a number with
+ * pa_dbase_attach().  Each allocator opened in it (a pa_fixed_t,
+ * pa_arb_t, etc) can then be attached as a numbered "table", and a
+ * descriptor names an atom in one of those tables.  Operations on a
+ * descriptor are dispatched thru the pa_ops_t registered for the
+ * table's type.  Database and table numbers are local to the process,
+ * so descriptors shouldn't be stored in the segment itself.
+ *
+ * Attaching and detaching aren't thread safe; do them before other
+ * threads start using the database.
  */
 typedef struct pa_dscr_s {
     uint8_t pd_dbase;		/* Number of the database */
@@ -24,20 +35,160 @@ typedef struct pa_dscr_s {
     pa_atom_t pd_atom;		/* Atom number */
 } pa_dscr_t;
 
+#define PA_DBASE_MAX	16	/* Max number of attached databases */
+#define PA_TABLE_MAX	64	/* Max number of tables per database */
+
+/* Lock modes, for pa_dscr_lock() */
+#define PA_LOCK_READ	1	/* Shared, for readers */
+#define PA_LOCK_WRITE	2	/* Exclusive, for writers */
 
 struct pa_ops_s;		/* Forward declaration */
 
 /* Typedefs for pa_ops_t functions */
-typedef int (*pa_op_lock_t)(pa_mmap_t *dbase, pa_dscr_t atom, 
+typedef void (*pa_op_lock_t)(pa_mmap_t *dbase, pa_dscr_t atom,
+			     unsigned mode);
+typedef void (*pa_op_unlock_t)(pa_mmap_t *dbase, pa_dscr_t atom,
+			       unsigned mode);
+typedef pa_atom_t (*pa_op_alloc_t)(pa_mmap_t *dbase, void *table,
+				   size_t size);
+typedef void (*pa_op_free_t)(pa_mmap_t *dbase, void *table, pa_dscr_t atom);
+typedef void *(*pa_op_addr_t)(pa_mmap_t *dbase, void *table, pa_dscr_t atom);
 
 /**
  * The "pa_ops_t" defines the operations one may perform on
- * any base parrotdb data type.
+ * any base parrotdb data type.  The lock operations may be NULL,
+ * meaning the segment-wide reader/writer lock (pa_mmap_read_lock()
+ * and friends) is used.  The "size" given to po_alloc is ignored by
+ * types with a fixed size.
  */
 typedef struct pa_ops_s {
     const char *po_name;	/* Printable name of the type */
-    
+    uint8_t po_type;		/* Type (PA_TYPE_*) */
+    pa_op_lock_t po_lock;	/* Lock an atom (or its table) */
+    pa_op_unlock_t po_unlock;	/* Unlock it */
+    pa_op_alloc_t po_alloc;	/* Allocate a new atom */
+    pa_op_free_t po_free;	/* Free an atom */
+    pa_op_addr_t po_addr;	/* Turn an atom into an address */
 } pa_ops_t;
 
-#endif /* PARROTDB_PARROTDB_H */
+/*
+ * An attached table: the allocator and the operations for its type
+ */
+typedef struct pa_table_s {
+    const pa_ops_t *pt_ops;	/* Operations for this table's type */
+    void *pt_handle;		/* The allocator (pa_fixed_t *, etc) */
+} pa_table_t;
+
+/*
+ * An attached database
+ */
+typedef struct pa_dbase_s {
+    pa_mmap_t *pdb_mmap;	/* Underlaying mmap (NULL if unused) */
+    unsigned pdb_count;		/* Number of tables attached */
+    pa_table_t pdb_tables[PA_TABLE_MAX]; /* Our tables */
+} pa_dbase_t;
+
+extern pa_dbase_t pa_dbases[PA_DBASE_MAX];
+
+/**
+ * @brief
+ * Registers the operations for a type, replacing any earlier ones.
+ * The base types (pa_fixed, pa_arb, pa_bitmap, pa_roar) are
+ * registered for us.
+ *
+ * @return
+ *     0 on success, or -1 if the type is out of range
+ */
+int
+pa_ops_register (const pa_ops_t *ops);
+
+const pa_ops_t *
+pa_ops_find (unsigned type);
+
+/**
+ * @brief
+ * Gives a database a number, for use in descriptors
+ *
+ * @return
+ *     The number, or -1 if we've no room
+ */
+int
+pa_dbase_attach (pa_mmap_t *pmp);
+
+void
+pa_dbase_detach (unsigned dbase);
+
+/**
+ * @brief
+ * Attaches an allocator (of the given PA_TYPE_* type) as a table in
+ * a database
+ *
+ * @return
+ *     The table number, or -1 if there's no room or no operations for
+ *     the type
+ */
+int
+pa_table_attach (unsigned dbase, unsigned type, void *handle);
+
+static inline pa_table_t *
+pa_dscr_table (pa_dscr_t dscr)
+{
+    pa_dbase_t *pdbp;
+
+    if (dscr.pd_dbase >= PA_DBASE_MAX || dscr.pd_table >= PA_TABLE_MAX)
+	return NULL;
+
+    pdbp = &pa_dbases[dscr.pd_dbase];
+    if (pdbp->pdb_mmap == NULL || dscr.pd_table >= pdbp->pdb_count)
+	return NULL;
+
+    return &pdbp->pdb_tables[dscr.pd_table];
+}
+
+static inline psu_boolean_t
+pa_dscr_is_null (pa_dscr_t dscr)
+{
+    return (dscr.pd_atom == PA_NULL_ATOM);
+}
+
+/**
+ * @brief
+ * Allocates an atom from a table
+ *
+ * @return
+ *     The atom's descriptor, which is null (pa_dscr_is_null) if we
+ *     couldn't allocate one
+ */
+pa_dscr_t
+pa_dscr_alloc (unsigned dbase, unsigned table, size_t size);
 
+void
+pa_dscr_free (pa_dscr_t dscr);
+
+/*
+ * Turn a descriptor into an address, or NULL if it's not valid
+ */
+static inline void *
+pa_dscr_addr (pa_dscr_t dscr)
+{
+    pa_table_t *ptp = pa_dscr_table(dscr);
+
+    if (ptp == NULL || pa_dscr_is_null(dscr)
+	    || dscr.pd_type != ptp->pt_ops->po_type)
+	return NULL;
+
+    return ptp->pt_ops->po_addr(pa_dbases[dscr.pd_dbase].pdb_mmap,
+				ptp->pt_handle, dscr);
+}
+
+/*
+ * Lock the descriptor's atom, in the given mode (PA_LOCK_*), using the
+ * type's lock operation or the database's reader/writer lock
+ */
+void
+pa_dscr_lock (pa_dscr_t dscr, unsigned mode);
+
+void
+pa_dscr_unlock (pa_dscr_t dscr, unsigned mode);
+
+#endif /* PARROTDB_PARROTDB_H */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Support for using parrotdb from multiple threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/pathread.h>
+#include <libpsu/psualloc.h>
+
+THREAD_LOCAL(int) pa_thread_slot;
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_THREAD_LOCAL)
+static pthread_mutex_t pa_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pa_thread_once = PTHREAD_ONCE_INIT;
+static pthread_key_t pa_thread_key;
+static uint8_t pa_thread_inuse[PA_THREAD_MAX];
+
+/*
+ * When a thread exits, we give back its index.  Its magazines stay
+ * where they are, to be inherited by the next thread to get the index.
+ */
+static void
+pa_thread_exit (void *arg)
+{
+    intptr_t slot = (intptr_t) arg;
+
+    pthread_mutex_lock(&pa_thread_mutex);
+    pa_thread_inuse[slot - 1] = 0;
+    pthread_mutex_unlock(&pa_thread_mutex);
+}
+
+static void
+pa_thread_key_init (void)
+{
+    if (pthread_key_create(&pa_thread_key, pa_thread_exit) != 0)
+	pa_warning(errno, "could not create thread key");
+}
+
+int
+pa_thread_index_assign (void)
+{
+    intptr_t slot;
+
+    pthread_once(&pa_thread_once, pa_thread_key_init);
+
+    pthread_mutex_lock(&pa_thread_mutex);
+    for (slot = 0; slot < PA_THREAD_MAX; slot++)
+	if (!pa_thread_inuse[slot])
+	    break;
+    if (slot < PA_THREAD_MAX)
+	pa_thread_inuse[slot] = 1;
+    pthread_mutex_unlock(&pa_thread_mutex);
+
+    if (slot >= PA_THREAD_MAX) {
+	pa_thread_slot = -1;
+	return -1;
+    }
+
+    pa_thread_slot = slot + 1;
+    pthread_setspecific(pa_thread_key, (void *) (slot + 1));
+
+    return slot;
+}
+
+#else /* HAVE_PTHREAD_H && HAVE_THREAD_LOCAL */
+
+/*
+ * Without thread-local storage, all threads would share a single
+ * index (and its magazines), so we don't give out any.
+ */
+int
+pa_thread_index_assign (void)
+{
+    return -1;
+}
+
+#endif /* HAVE_PTHREAD_H && HAVE_THREAD_LOCAL */
+
+pa_lock_t *
+pa_lock_create (void)
+{
+#ifdef HAVE_PTHREAD_H
+    pa_lock_t *plp = psu_calloc(sizeof(*plp));
+    if (plp == NULL)
+	return NULL;
+
+    if (pthread_mutex_init(&plp->pl_mutex, NULL) != 0) {
+	pa_warning(errno, "could not initialize mutex");
+	psu_free(plp);
+	return NULL;
+    }
+
+    return plp;
+#else /* HAVE_PTHREAD_H */
+    pa_warning(0, "thread support is not available");
+    return NULL;
+#endif /* HAVE_PTHREAD_H */
+}
+
+void
+pa_lock_destroy (pa_lock_t *plp)
+{
+    if (plp == NULL)
+	return;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_destroy(&plp->pl_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+    psu_free(plp);
+}
+
+pa_lock_t *
+pa_lock_create_stripes (unsigned count)
+{
+#ifdef HAVE_PTHREAD_H
+    pa_lock_t *plp = psu_calloc(count * sizeof(*plp));
+    unsigned i;
+
+    if (plp == NULL)
+	return NULL;
+
+    for (i = 0; i < count; i++) {
+	if (pthread_mutex_init(&plp[i].pl_mutex, NULL) != 0) {
+	    pa_warning(errno, "could not initialize mutex");
+	    pa_lock_destroy_stripes(plp, i);
+	    return NULL;
+	}
+    }
+
+    return plp;
+#else /* HAVE_PTHREAD_H */
+    pa_warning(0, "thread support is not available");
+    return NULL;
+#endif /* HAVE_PTHREAD_H */
+}
+
+void
+pa_lock_destroy_stripes (pa_lock_t *plp, unsigned count UNUSED)
+{
+    if (plp == NULL)
+	return;
+
+#ifdef HAVE_PTHREAD_H
+    unsigned i;
+
+    for (i = 0; i < count; i++)
+	pthread_mutex_destroy(&plp[i].pl_mutex);
+#endif /* HAVE_PTHREAD_H */
+
+    psu_free(plp);
+}
+
+pa_depot_t *
+pa_depot_create (unsigned count)
+{
+    pa_depot_t *pdp = psu_calloc(sizeof(*pdp));
+
+    if (pdp)
+	pdp->pd_count = count;
+
+    return pdp;
+}
+
+void
+pa_depot_destroy (pa_depot_t *pdp)
+{
+    int i;
+
+    if (pdp == NULL)
+	return;
+
+    for (i = 0; i < PA_THREAD_MAX; i++)
+	if (pdp->pd_mags[i])
+	    psu_free(pdp->pd_mags[i]);
+
+    psu_free(pdp);
+}
+
+/*
+ * Allocate magazines for a thread.  Only the thread that owns 'idx'
+ * calls this, so there's no one to race with.
+ */
+pa_magazine_t *
+pa_depot_magazines_alloc (pa_depot_t *pdp, int idx)
+{
+    pa_magazine_t *mags = psu_calloc(pdp->pd_count * sizeof(*mags));
+
+    pdp->pd_mags[idx] = mags;
+    return mags;
+}
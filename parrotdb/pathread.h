@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Support for using parrotdb from multiple threads.
+ */
+
+#ifndef PARROTDB_PATHREAD_H
+#define PARROTDB_PATHREAD_H
+
+#include <libpsu/psucommon.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
+
+#include <libpsu/psuthread.h>
+
+/*
+ * parrotdb is single threaded by default.  When a segment is opened
+ * with PMF_THREAD_SAFE, each allocator built on it gets a lock (a
+ * pa_lock_t) for its central state.  pa_arb's central state is
+ * striped instead: each size class has its own free pages and its
+ * own lock, so threads working on different sizes don't contend.
+ * pa_fixed has a single free chain, kept in the segment, so it keeps
+ * a single lock; a lock-free chain would need ABA protection (a
+ * generation count next to the head) that the on-disk format doesn't
+ * have room for.  Allocators with free lists
+ * (pa_fixed and pa_arb) also get a "depot" of per-thread magazines,
+ * small stacks of free atoms that a thread can allocate from and
+ * free to without touching the central lock.  A thread only takes
+ * the lock when its magazine runs dry (to fill it half way) or fills
+ * up (to empty it half way), so the lock is hit once for every
+ * PA_MAGAZINE_SIZE / 2 operations, at worst.
+ *
+ * Magazines are indexed by a small per-thread number, kept in a
+ * THREAD_LOCAL variable.  When a thread exits, its number is given
+ * back, and the next thread to start inherits the magazines (and the
+ * free atoms in them).  Threads beyond PA_THREAD_MAX, or platforms
+ * without thread-local storage, skip the magazines and use the
+ * central lock for every operation.
+ *
+ * Atoms sitting in a magazine look allocated to the central free
+ * list.  pa_fixed_flush() and pa_arb_flush() return the calling
+ * thread's atoms, and closing an allocator returns everyone's.
+ */
+
+#define PA_THREAD_MAX		64 /* Max number of threads with magazines */
+#define PA_MAGAZINE_SIZE	32 /* Atoms per magazine */
+
+typedef struct pa_lock_s {
+#ifdef HAVE_PTHREAD_H
+    pthread_mutex_t pl_mutex;	/* The real lock */
+#else /* HAVE_PTHREAD_H */
+    int pl_unused;		/* Placeholder */
+#endif /* HAVE_PTHREAD_H */
+} pa_lock_t;
+
+/*
+ * A magazine is a stack of free atoms.  The atoms' meaning is
+ * up to the owning allocator.
+ */
+typedef struct pa_magazine_s {
+    uint32_t pmg_count;		/* Number of atoms in pmg_atoms */
+    pa_atom_t pmg_atoms[PA_MAGAZINE_SIZE]; /* Free atoms */
+} pa_magazine_t;
+
+/*
+ * The depot holds magazines for each thread, with pd_count magazines
+ * per thread (e.g. one per size class).  They are allocated as each
+ * thread first uses them.
+ */
+typedef struct pa_depot_s {
+    unsigned pd_count;		/* Number of magazines per thread */
+    pa_magazine_t *pd_mags[PA_THREAD_MAX]; /* Per-thread magazines */
+} pa_depot_t;
+
+/*
+ * Our thread number, plus one, so zero means "not assigned yet" and
+ * -1 means "none available"
+ */
+extern THREAD_LOCAL(int) pa_thread_slot;
+
+int
+pa_thread_index_assign (void);
+
+/*
+ * Return the calling thread's index, or -1 if it has none
+ */
+static inline int
+pa_thread_index (void)
+{
+    int slot = pa_thread_slot;
+    if (slot > 0)
+	return slot - 1;
+    return slot ? -1 : pa_thread_index_assign();
+}
+
+pa_lock_t *
+pa_lock_create (void);
+
+void
+pa_lock_destroy (pa_lock_t *plp);
+
+/*
+ * Create (and destroy) an array of "count" locks, for allocators that
+ * stripe their central state
+ */
+pa_lock_t *
+pa_lock_create_stripes (unsigned count);
+
+void
+pa_lock_destroy_stripes (pa_lock_t *plp, unsigned count);
+
+static inline void
+pa_lock (pa_lock_t *plp)
+{
+#ifdef HAVE_PTHREAD_H
+    if (plp)
+	pthread_mutex_lock(&plp->pl_mutex);
+#endif /* HAVE_PTHREAD_H */
+}
+
+static inline void
+pa_unlock (pa_lock_t *plp)
+{
+#ifdef HAVE_PTHREAD_H
+    if (plp)
+	pthread_mutex_unlock(&plp->pl_mutex);
+#endif /* HAVE_PTHREAD_H */
+}
+
+pa_depot_t *
+pa_depot_create (unsigned count);
+
+void
+pa_depot_destroy (pa_depot_t *pdp);
+
+pa_magazine_t *
+pa_depot_magazines_alloc (pa_depot_t *pdp, int idx);
+
+/*
+ * Return the calling thread's magazines, or NULL if this thread
+ * can't have any.
+ */
+static inline pa_magazine_t *
+pa_depot_magazines (pa_depot_t *pdp)
+{
+    int idx = pa_thread_index();
+    if (idx < 0)
+	return NULL;
+
+    pa_magazine_t *mags = pdp->pd_mags[idx];
+    return mags ?: pa_depot_magazines_alloc(pdp, idx);
+}
+
+#endif /* PARROTDB_PATHREAD_H */
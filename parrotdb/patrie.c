@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#include <sys/types.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <libpsu/psualloc.h>
+#include <libpsu/psulog.h>
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/patrie.h>
+
+/*
+ * A stack of the nodes we passed through on the way down, so
+ * getnext can back up to find the next larger subtree.
+ */
+typedef struct pa_trie_path_s {
+    pa_trie_node_t *ptpa_node;	/* Node we passed through */
+    unsigned ptpa_slot;		/* Child we took */
+} pa_trie_path_t;
+
+/*
+ * Return the number of the first nibble where two keys differ.  If
+ * one key is a prefix of the other, that's the nibble after the end
+ * of the shorter one.  If they are identical, return PA_TRIE_NO_NIBBLE.
+ */
+static uint16_t
+pa_trie_mismatch (const psu_byte_t *k1, uint16_t len1,
+		  const psu_byte_t *k2, uint16_t len2)
+{
+    uint16_t len = (len1 < len2) ? len1 : len2;
+    uint16_t i;
+
+    for (i = 0; i < len; i++) {
+	if (k1[i] != k2[i])
+	    return i * 2 + (((k1[i] ^ k2[i]) & 0xf0) ? 0 : 1);
+    }
+
+    return (len1 == len2) ? PA_TRIE_NO_NIBBLE : len * 2;
+}
+
+/*
+ * Return the first child of a node that's at or after the given slot,
+ * or PA_TRIE_FANOUT if there's none
+ */
+static inline unsigned
+pa_trie_next_slot (pa_trie_node_t *node, unsigned slot)
+{
+    for ( ; slot < PA_TRIE_FANOUT; slot++)
+	if (node->ptn_child[slot])
+	    break;
+
+    return slot;
+}
+
+/*
+ * Return the leaf with the smallest key under a reference
+ */
+static pa_trie_data_atom_t
+pa_trie_leftmost (pa_trie_t *ptp, pa_trie_ref_t ref)
+{
+    pa_trie_node_t *node;
+
+    while (pa_trie_ref_is_node(ref)) {
+	node = pa_trie_ref_node_addr(ptp, ref);
+	if (node == NULL)
+	    return pa_trie_data_null_atom();
+
+	ref = node->ptn_child[pa_trie_next_slot(node, 0)];
+    }
+
+    return ref ? pa_trie_ref_data(ref) : pa_trie_data_null_atom();
+}
+
+/*
+ * Walk down the trie, following the key where we can and taking any
+ * child where we can't, and return the leaf we end up at.  Any key in
+ * the trie that shares a prefix with our key will share it with this
+ * leaf, so it tells us where the key diverges from the trie.
+ */
+static pa_trie_data_atom_t
+pa_trie_closest (pa_trie_t *ptp, const psu_byte_t *key, uint16_t key_bytes)
+{
+    pa_trie_ref_t ref = ptp->pt_root;
+    pa_trie_node_t *node;
+    unsigned slot;
+
+    while (pa_trie_ref_is_node(ref)) {
+	node = pa_trie_ref_node_addr(ptp, ref);
+	if (node == NULL)
+	    return pa_trie_data_null_atom();
+
+	slot = pa_trie_nibble(key, key_bytes, node->ptn_nibble);
+	if (node->ptn_child[slot] == 0)
+	    slot = pa_trie_next_slot(node, 0);
+	ref = node->ptn_child[slot];
+    }
+
+    return ref ? pa_trie_ref_data(ref) : pa_trie_data_null_atom();
+}
+
+static pa_trie_atom_t
+pa_trie_node_alloc (pa_trie_t *ptp, pa_trie_node_t **nodep)
+{
+    pa_fixed_atom_t fatom = pa_fixed_alloc_atom(ptp->pt_nodes);
+    pa_trie_atom_t atom = pa_trie_atom(pa_fixed_atom_of(fatom));
+
+    *nodep = pa_trie_is_null(atom) ? NULL : pa_trie_node(ptp, atom);
+    if (*nodep) {
+	bzero(*nodep, sizeof(**nodep));
+	ptp->pt_infop->pti_nodes += 1;
+    }
+
+    return atom;
+}
+
+static void
+pa_trie_node_free (pa_trie_t *ptp, pa_trie_atom_t atom)
+{
+    pa_fixed_free_atom(ptp->pt_nodes, pa_fixed_atom(pa_trie_atom_of(atom)));
+    ptp->pt_infop->pti_nodes -= 1;
+}
+
+psu_boolean_t
+pa_trie_add (pa_trie_t *ptp, pa_trie_data_atom_t datom)
+{
+    const psu_byte_t *key, *lkey;
+    uint16_t key_bytes = 0, lkey_bytes = 0;
+
+    key = pa_trie_key(ptp, datom, &key_bytes);
+    if (key == NULL || key_bytes == 0 || key_bytes > PA_TRIE_MAXKEY)
+	return FALSE;
+
+    /* The low bit of a reference is our leaf flag */
+    if (pa_trie_data_atom_of(datom) >> (sizeof(pa_trie_ref_t) * PA_NBBY - 1))
+	return FALSE;
+
+    pa_trie_ref_t leaf = pa_trie_ref_of_data(datom);
+
+    if (ptp->pt_root == 0) {
+	ptp->pt_root = leaf;
+	ptp->pt_infop->pti_count += 1;
+	return TRUE;
+    }
+
+    /* Find where our key parts ways with the keys in the trie */
+    pa_trie_data_atom_t closest = pa_trie_closest(ptp, key, key_bytes);
+    if (pa_trie_data_is_null(closest))
+	return FALSE;
+
+    lkey = pa_trie_key(ptp, closest, &lkey_bytes);
+    if (lkey == NULL)
+	return FALSE;
+
+    uint16_t diff = pa_trie_mismatch(key, key_bytes, lkey, lkey_bytes);
+    if (diff == PA_TRIE_NO_NIBBLE)
+	return FALSE;		/* Duplicate */
+
+    /* Prefixes aren't allowed; we'd have no nibble to tell them apart */
+    if ((diff >> 1) >= key_bytes || (diff >> 1) >= lkey_bytes)
+	return FALSE;
+
+    unsigned kslot = pa_trie_nibble(key, key_bytes, diff);
+    unsigned lslot = pa_trie_nibble(lkey, lkey_bytes, diff);
+
+    /*
+     * Walk down again, to the first node that tests 'diff' or a
+     * later nibble.  If it tests 'diff', we just fill in our slot.
+     * Otherwise, we need a new node between it and its parent.
+     */
+    pa_trie_node_t *parent = NULL, *node = NULL;
+    pa_trie_atom_t parent_atom = pa_trie_null_atom();
+    unsigned parent_slot = 0;
+    pa_trie_ref_t ref = ptp->pt_root;
+
+    while (pa_trie_ref_is_node(ref)) {
+	node = pa_trie_ref_node_addr(ptp, ref);
+	if (node == NULL)
+	    return FALSE;
+
+	if (node->ptn_nibble >= diff)
+	    break;
+
+	parent = node;
+	parent_atom = pa_trie_ref_node(ref);
+	parent_slot = pa_trie_nibble(key, key_bytes, node->ptn_nibble);
+	ref = node->ptn_child[parent_slot];
+    }
+
+    if (pa_trie_ref_is_node(ref) && node->ptn_nibble == diff) {
+	node->ptn_child[kslot] = leaf;
+	node->ptn_count += 1;
+	ptp->pt_infop->pti_count += 1;
+	return TRUE;
+    }
+
+    pa_trie_node_t *new_node;
+    pa_trie_atom_t new_atom = pa_trie_node_alloc(ptp, &new_node);
+    if (new_node == NULL)
+	return FALSE;
+
+    new_node->ptn_nibble = diff;
+    new_node->ptn_count = 2;
+    new_node->ptn_child[kslot] = leaf;
+    new_node->ptn_child[lslot] = ref;
+
+    /* Refetch our parent, since allocating may have grown the segment */
+    if (parent) {
+	parent = pa_trie_node(ptp, parent_atom);
+	parent->ptn_child[parent_slot] = pa_trie_ref_of_node(new_atom);
+    } else {
+	ptp->pt_root = pa_trie_ref_of_node(new_atom);
+    }
+
+    ptp->pt_infop->pti_count += 1;
+    return TRUE;
+}
+
+pa_trie_data_atom_t
+pa_trie_delete (pa_trie_t *ptp, uint16_t key_bytes, const void *v_key)
+{
+    const psu_byte_t *key = v_key;
+    pa_trie_ref_t *refp = &ptp->pt_root, *parent_refp = NULL;
+    pa_trie_node_t *parent = NULL;
+
+    while (pa_trie_ref_is_node(*refp)) {
+	parent_refp = refp;
+	parent = pa_trie_ref_node_addr(ptp, *refp);
+	if (parent == NULL)
+	    return pa_trie_data_null_atom();
+
+	refp = &parent->ptn_child[pa_trie_nibble(key, key_bytes,
+						 parent->ptn_nibble)];
+    }
+
+    if (*refp == 0)
+	return pa_trie_data_null_atom();
+
+    pa_trie_data_atom_t datom = pa_trie_ref_data(*refp);
+    uint16_t len = 0;
+    const psu_byte_t *dkey = pa_trie_key(ptp, datom, &len);
+
+    if (dkey == NULL || len != key_bytes || memcmp(dkey, key, len) != 0)
+	return pa_trie_data_null_atom();
+
+    *refp = 0;
+    ptp->pt_infop->pti_count -= 1;
+
+    /* A node with a single child isn't needed; hoist the child */
+    if (parent && --parent->ptn_count == 1) {
+	pa_trie_atom_t atom = pa_trie_ref_node(*parent_refp);
+
+	*parent_refp = parent->ptn_child[pa_trie_next_slot(parent, 0)];
+	pa_trie_node_free(ptp, atom);
+    }
+
+    return datom;
+}
+
+pa_trie_data_atom_t
+pa_trie_getnext (pa_trie_t *ptp, uint16_t key_bytes, const void *v_key,
+		 psu_boolean_t return_eq)
+{
+    const psu_byte_t *key = v_key;
+    const psu_byte_t *lkey;
+    uint16_t lkey_bytes = 0;
+    pa_trie_path_t path[PA_TRIE_MAXDEPTH];
+    int depth = 0;
+    unsigned slot;
+
+    if (ptp->pt_root == 0)
+	return pa_trie_data_null_atom();
+
+    pa_trie_data_atom_t closest = pa_trie_closest(ptp, key, key_bytes);
+    if (pa_trie_data_is_null(closest))
+	return closest;
+
+    lkey = pa_trie_key(ptp, closest, &lkey_bytes);
+    if (lkey == NULL)
+	return pa_trie_data_null_atom();
+
+    uint16_t diff = pa_trie_mismatch(key, key_bytes, lkey, lkey_bytes);
+    if (diff == PA_TRIE_NO_NIBBLE && return_eq)
+	return closest;
+
+    /*
+     * Walk down to the subtree where our key would go.  Every key
+     * under it matches our key before 'diff'.  Remember the path,
+     * since the answer may be in a later subtree.
+     */
+    pa_trie_ref_t ref = ptp->pt_root;
+    pa_trie_node_t *node = NULL;
+
+    while (pa_trie_ref_is_node(ref)) {
+	node = pa_trie_ref_node_addr(ptp, ref);
+	if (node == NULL)
+	    return pa_trie_data_null_atom();
+
+	if (node->ptn_nibble >= diff)
+	    break;
+
+	slot = pa_trie_nibble(key, key_bytes, node->ptn_nibble);
+	path[depth].ptpa_node = node;
+	path[depth].ptpa_slot = slot;
+	depth += 1;
+	ref = node->ptn_child[slot];
+    }
+
+    if (diff != PA_TRIE_NO_NIBBLE) {
+	/* Our key ran out first, so it's smaller than everything here */
+	if ((diff >> 1) >= key_bytes)
+	    return pa_trie_leftmost(ptp, ref);
+
+	unsigned kslot = pa_trie_nibble(key, key_bytes, diff);
+
+	if (pa_trie_ref_is_node(ref) && node->ptn_nibble == diff) {
+	    /* The node splits on our nibble; take the next larger child */
+	    slot = pa_trie_next_slot(node, kslot + 1);
+	    if (slot < PA_TRIE_FANOUT)
+		return pa_trie_leftmost(ptp, node->ptn_child[slot]);
+
+	} else if ((diff >> 1) >= lkey_bytes
+		   || kslot < pa_trie_nibble(lkey, lkey_bytes, diff)) {
+	    /* Everything in this subtree is larger than our key */
+	    return pa_trie_leftmost(ptp, ref);
+	}
+    }
+
+    /* Everything here is smaller (or equal); back up to a later subtree */
+    while (--depth >= 0) {
+	node = path[depth].ptpa_node;
+	slot = pa_trie_next_slot(node, path[depth].ptpa_slot + 1);
+	if (slot < PA_TRIE_FANOUT)
+	    return pa_trie_leftmost(ptp, node->ptn_child[slot]);
+    }
+
+    return pa_trie_data_null_atom();
+}
+
+pa_trie_data_atom_t
+pa_trie_find_next (pa_trie_t *ptp, pa_trie_data_atom_t datom)
+{
+    if (pa_trie_data_is_null(datom))
+	return pa_trie_leftmost(ptp, ptp->pt_root);
+
+    uint16_t key_bytes = 0;
+    const psu_byte_t *key = pa_trie_key(ptp, datom, &key_bytes);
+    if (key == NULL)
+	return pa_trie_data_null_atom();
+
+    return pa_trie_getnext(ptp, key_bytes, key, FALSE);
+}
+
+/*
+ * Does the key start with the first 'prefix_len' bits of the prefix?
+ */
+static psu_boolean_t
+pa_trie_prefix_match (const psu_byte_t *key, uint16_t key_bytes,
+		      const psu_byte_t *prefix, uint16_t prefix_len)
+{
+    uint16_t bytes = prefix_len / PA_NBBY;
+    uint16_t bits = prefix_len % PA_NBBY;
+
+    if (key_bytes < bytes + (bits ? 1 : 0))
+	return FALSE;
+
+    if (memcmp(key, prefix, bytes) != 0)
+	return FALSE;
+
+    if (bits) {
+	uint8_t mask = 0xff << (PA_NBBY - bits);
+	if ((key[bytes] ^ prefix[bytes]) & mask)
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+pa_trie_data_atom_t
+pa_trie_subtree_match (pa_trie_t *ptp, uint16_t prefix_len,
+		       const void *v_prefix)
+{
+    const psu_byte_t *prefix = v_prefix;
+    psu_byte_t buf[PA_TRIE_MAXKEY];
+    uint16_t bytes = (prefix_len + PA_NBBY - 1) / PA_NBBY;
+    pa_trie_data_atom_t datom;
+
+    if (bytes > PA_TRIE_MAXKEY)
+	return pa_trie_data_null_atom();
+
+    if (bytes == 0)
+	return pa_trie_leftmost(ptp, ptp->pt_root);
+
+    /*
+     * The smallest key that's at least the prefix (with any trailing
+     * bits cleared) is our answer, if it matches at all.
+     */
+    memcpy(buf, prefix, bytes);
+    if (prefix_len % PA_NBBY)
+	buf[bytes - 1] &= 0xff << (PA_NBBY - prefix_len % PA_NBBY);
+
+    datom = pa_trie_getnext(ptp, bytes, buf, TRUE);
+    if (pa_trie_data_is_null(datom))
+	return datom;
+
+    uint16_t key_bytes = 0;
+    const psu_byte_t *key = pa_trie_key(ptp, datom, &key_bytes);
+    if (key == NULL || !pa_trie_prefix_match(key, key_bytes,
+					     prefix, prefix_len))
+	return pa_trie_data_null_atom();
+
+    return datom;
+}
+
+pa_trie_data_atom_t
+pa_trie_subtree_next (pa_trie_t *ptp, pa_trie_data_atom_t datom,
+		      uint16_t prefix_len)
+{
+    uint16_t prefix_bytes = 0, key_bytes = 0;
+    const psu_byte_t *prefix = pa_trie_key(ptp, datom, &prefix_bytes);
+    if (prefix == NULL)
+	return pa_trie_data_null_atom();
+
+    pa_trie_data_atom_t next = pa_trie_getnext(ptp, prefix_bytes,
+					       prefix, FALSE);
+    if (pa_trie_data_is_null(next))
+	return next;
+
+    const psu_byte_t *key = pa_trie_key(ptp, next, &key_bytes);
+    if (key == NULL || !pa_trie_prefix_match(key, key_bytes,
+					     prefix, prefix_len))
+	return pa_trie_data_null_atom();
+
+    return next;
+}
+
+const psu_byte_t *
+pa_trie_istr_key_func (pa_trie_t *ptp, pa_trie_data_atom_t datom,
+		       uint16_t *key_bytesp)
+{
+    /* Need to "convert" the data atom to an istr data */
+    pa_istr_atom_t atom = pa_istr_atom(pa_trie_data_atom_of(datom));
+    const char *key = pa_istr_atom_string(ptp->pt_data, atom);
+
+    /* Our keys include the trailing NUL, so none is a prefix of another */
+    *key_bytesp = key ? strlen(key) + 1 : 0;
+    return (const psu_byte_t *) key;
+}
+
+pa_trie_t *
+pa_trie_open (pa_mmap_t *pmp, const char *name, void *data_store,
+	      pa_trie_key_func_t key_func, pa_shift_t shift,
+	      pa_atom_t max_atoms)
+{
+    char namebuf[PA_MMAP_HEADER_NAME_LEN];
+    pa_trie_info_t *ptip;
+    pa_fixed_t *pfp;
+    pa_trie_t *ptp;
+
+    pfp = pa_fixed_open(pmp, name, shift, sizeof(pa_trie_node_t), max_atoms);
+    if (pfp == NULL)
+	return NULL;
+
+    pa_config_name(namebuf, sizeof(namebuf), name, "root");
+    ptip = pa_mmap_header(pmp, namebuf, PA_TYPE_TRIE, 0, sizeof(*ptip));
+    if (ptip == NULL) {
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    ptp = psu_calloc(sizeof(*ptp));
+    if (ptp == NULL) {
+	pa_fixed_close(pfp);
+	return NULL;
+    }
+
+    ptp->pt_infop = ptip;
+    ptp->pt_mmap = pmp;
+    ptp->pt_nodes = pfp;
+    ptp->pt_data = data_store;
+    ptp->pt_key_func = key_func;
+
+    return ptp;
+}
+
+void
+pa_trie_close (pa_trie_t *ptp)
+{
+    if (ptp == NULL)
+	return;
+
+    pa_fixed_close(ptp->pt_nodes);
+    psu_free(ptp);
+}
+
+/*
+ * Count the nodes at each depth, and the depth of each leaf
+ */
+static void
+pa_trie_depths (pa_trie_t *ptp, pa_trie_ref_t ref, unsigned depth,
+		unsigned *leaf_depths, unsigned *max_depthp)
+{
+    pa_trie_node_t *node;
+    unsigned slot;
+
+    if (ref == 0)
+	return;
+
+    if (depth > *max_depthp)
+	*max_depthp = depth;
+
+    if (pa_trie_ref_is_data(ref)) {
+	*leaf_depths += depth;
+	return;
+    }
+
+    node = pa_trie_ref_node_addr(ptp, ref);
+    if (node == NULL)
+	return;
+
+    for (slot = 0; slot < PA_TRIE_FANOUT; slot++)
+	pa_trie_depths(ptp, node->ptn_child[slot], depth + 1,
+		       leaf_depths, max_depthp);
+}
+
+void
+pa_trie_dump (pa_trie_t *ptp, psu_boolean_t full)
+{
+    pa_trie_info_t *ptip = ptp->pt_infop;
+
+    psu_log("begin pa_trie dump of %p", ptip);
+
+    psu_log("root %#x, keys %u, nodes %u (%zu bytes each)",
+	    ptip->pti_root, ptip->pti_count, ptip->pti_nodes,
+	    sizeof(pa_trie_node_t));
+
+    if (full && ptip->pti_count) {
+	unsigned leaf_depths = 0, max_depth = 0;
+
+	pa_trie_depths(ptp, ptip->pti_root, 0, &leaf_depths, &max_depth);
+	psu_log("depth: average %u.%02u, max %u",
+		leaf_depths / ptip->pti_count,
+		(leaf_depths % ptip->pti_count) * 100 / ptip->pti_count,
+		max_depth);
+    }
+
+    psu_log("end pa_trie dump of %p", ptip);
+}
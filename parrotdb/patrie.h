@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ */
+
+#ifndef PARROTDB_PATRIE_H
+#define PARROTDB_PATRIE_H
+
+/**
+ * @file patrie.h
+ * @brief Multi-bit trie APIs
+ *
+ * A pa_trie is a path-compressed trie with a four-bit stride.  Each
+ * node tests one nibble of the key and has sixteen children.  Like a
+ * patricia tree, a node only records the nibble where its keys
+ * differ, so a lookup visits roughly log16(n) nodes instead of
+ * log2(n) and compares the full key once, at the end.  Leaves are not
+ * nodes; a child slot holds either a node atom or a data atom, with
+ * the low bit telling them apart.
+ *
+ * Keys live in the caller's data store and are found using a key
+ * function, as with pa_pat.  Keys may vary in length, but no key may
+ * be a prefix of another (null-terminated strings have this property
+ * if you include the '\\0' in the key).  Keys are ordered bytewise,
+ * so pa_trie_find_next() walks them in the same order as
+ * pa_pat_find_next().
+ *
+ * Nodes are bigger than pa_pat nodes (68 bytes vs 16), so the trie
+ * trades space for fewer dependent loads on long keys.
+ */
+
+/* Wrapper for our "trie node" atom */
+PA_ATOM_TYPE(pa_trie_atom_t, pa_trie_atom_s, pta_atom,
+	     pa_trie_is_null, pa_trie_atom, pa_trie_atom_of,
+	     pa_trie_null_atom);
+
+/* Wrapper for our "data node" atom */
+PA_ATOM_TYPE(pa_trie_data_atom_t, pa_trie_data_atom_s, ptd_atom,
+	     pa_trie_data_is_null, pa_trie_data_atom, pa_trie_data_atom_of,
+	     pa_trie_data_null_atom);
+
+/*
+ * A reference to a child: zero for none, a node atom shifted up one
+ * bit, or a data atom shifted up one bit with the low bit set.
+ */
+typedef uint32_t pa_trie_ref_t;
+
+#define PA_TRIE_REF_DATA	0x1 /* Reference is a data atom (leaf) */
+
+#define PA_TRIE_STRIDE		4 /* Bits tested by each node */
+#define PA_TRIE_FANOUT		(1 << PA_TRIE_STRIDE) /* Children per node */
+#define PA_TRIE_MAXKEY		256 /* Maximum key length, in bytes */
+#define PA_TRIE_MAXDEPTH	(PA_TRIE_MAXKEY * PA_NBBY / PA_TRIE_STRIDE)
+#define PA_TRIE_NO_NIBBLE	0xffff /* Keys are identical */
+
+typedef struct pa_trie_node_s {
+    uint16_t ptn_nibble;	/* Nibble number to test */
+    uint16_t ptn_count;		/* Number of children in use */
+    pa_trie_ref_t ptn_child[PA_TRIE_FANOUT]; /* Children, by nibble value */
+} pa_trie_node_t;
+
+typedef struct pa_trie_info_s {
+    pa_trie_ref_t pti_root;	/* Root of the trie */
+    uint32_t pti_count;		/* Number of keys in the trie */
+    uint32_t pti_nodes;		/* Number of nodes in the trie */
+} pa_trie_info_t;
+
+struct pa_trie_s;		/* Forward declaration */
+typedef const psu_byte_t *(*pa_trie_key_func_t)(struct pa_trie_s *,
+						pa_trie_data_atom_t,
+						uint16_t *key_bytesp);
+
+typedef struct pa_trie_s {
+    pa_trie_info_t *pt_infop;	/* Pointer to root info */
+    pa_mmap_t *pt_mmap;		/* Underlaying mmap */
+    pa_fixed_t *pt_nodes;	/* Fixed paged array of nodes */
+    void *pt_data;		/* Opaque data store */
+    pa_trie_key_func_t pt_key_func; /* Find the key for a data atom */
+} pa_trie_t;
+
+/* Shorthand for fields */
+#define pt_root pt_infop->pti_root
+
+static inline psu_boolean_t
+pa_trie_ref_is_data (pa_trie_ref_t ref)
+{
+    return (ref & PA_TRIE_REF_DATA) ? TRUE : FALSE;
+}
+
+static inline psu_boolean_t
+pa_trie_ref_is_node (pa_trie_ref_t ref)
+{
+    return (ref != 0 && !(ref & PA_TRIE_REF_DATA)) ? TRUE : FALSE;
+}
+
+static inline pa_trie_ref_t
+pa_trie_ref_of_node (pa_trie_atom_t atom)
+{
+    return pa_trie_atom_of(atom) << 1;
+}
+
+static inline pa_trie_ref_t
+pa_trie_ref_of_data (pa_trie_data_atom_t datom)
+{
+    return (pa_trie_data_atom_of(datom) << 1) | PA_TRIE_REF_DATA;
+}
+
+static inline pa_trie_atom_t
+pa_trie_ref_node (pa_trie_ref_t ref)
+{
+    return pa_trie_atom(ref >> 1);
+}
+
+static inline pa_trie_data_atom_t
+pa_trie_ref_data (pa_trie_ref_t ref)
+{
+    return pa_trie_data_atom(ref >> 1);
+}
+
+/**
+ * @brief
+ * Turn an atom into a node pointer
+ */
+static inline pa_trie_node_t *
+pa_trie_node (pa_trie_t *ptp, pa_trie_atom_t atom)
+{
+    return pa_fixed_atom_addr(ptp->pt_nodes,
+			      pa_fixed_atom(pa_trie_atom_of(atom)));
+}
+
+static inline pa_trie_node_t *
+pa_trie_ref_node_addr (pa_trie_t *ptp, pa_trie_ref_t ref)
+{
+    return pa_trie_node(ptp, pa_trie_ref_node(ref));
+}
+
+/*
+ * Return the key (and its length) for a data atom
+ */
+static inline const psu_byte_t *
+pa_trie_key (pa_trie_t *ptp, pa_trie_data_atom_t datom, uint16_t *key_bytesp)
+{
+    return ptp->pt_key_func(ptp, datom, key_bytesp);
+}
+
+/*
+ * Return the given nibble of a key, or zero if the key isn't that
+ * long.  Nibble zero is the high half of the first byte.
+ */
+static inline unsigned
+pa_trie_nibble (const psu_byte_t *key, uint16_t key_bytes, uint16_t nibble)
+{
+    unsigned offset = nibble >> 1;
+
+    if (offset >= key_bytes)
+	return 0;
+
+    return (key[offset] >> ((~nibble & 1) * PA_TRIE_STRIDE))
+	& (PA_TRIE_FANOUT - 1);
+}
+
+/**
+ * @brief
+ * Looks up the data atom with the given key
+ *
+ * @param[in] ptp
+ *     Pointer to the trie
+ * @param[in] key_bytes
+ *     Number of bytes in key
+ * @param[in] v_key
+ *     Pointer to key value
+ *
+ * @return
+ *     The data atom with the key, or a null atom if there's none
+ */
+static inline pa_trie_data_atom_t
+pa_trie_get (pa_trie_t *ptp, uint16_t key_bytes, const void *v_key)
+{
+    const psu_byte_t *key = v_key;
+    pa_trie_ref_t ref = ptp->pt_root;
+    pa_trie_node_t *node;
+
+    while (pa_trie_ref_is_node(ref)) {
+	node = pa_trie_ref_node_addr(ptp, ref);
+	if (node == NULL)
+	    return pa_trie_data_null_atom();
+
+	ref = node->ptn_child[pa_trie_nibble(key, key_bytes,
+					     node->ptn_nibble)];
+    }
+
+    if (ref == 0)
+	return pa_trie_data_null_atom();
+
+    /* Path compression means we've only seen some nibbles; check it all */
+    pa_trie_data_atom_t datom = pa_trie_ref_data(ref);
+    uint16_t len = 0;
+    const psu_byte_t *dkey = pa_trie_key(ptp, datom, &len);
+
+    if (dkey == NULL || len != key_bytes || memcmp(dkey, key, len) != 0)
+	return pa_trie_data_null_atom();
+
+    return datom;
+}
+
+static inline psu_boolean_t
+pa_trie_isempty (pa_trie_t *ptp)
+{
+    return (ptp->pt_root == 0);
+}
+
+/**
+ * @brief
+ * Adds a data atom to the trie, under the key returned by the
+ * key function.
+ *
+ * @return
+ *     @c TRUE if the atom was added;
+ *     @c FALSE if its key is already in the trie, is a prefix of
+ *     a key in the trie (or vice versa), or is too long.
+ */
+psu_boolean_t
+pa_trie_add (pa_trie_t *ptp, pa_trie_data_atom_t datom);
+
+/**
+ * @brief
+ * Removes the given key from the trie
+ *
+ * @return
+ *     The data atom that was removed, or a null atom if the key
+ *     wasn't in the trie.
+ */
+pa_trie_data_atom_t
+pa_trie_delete (pa_trie_t *ptp, uint16_t key_bytes, const void *key);
+
+/**
+ * @brief
+ * Given a key, return the data atom with the smallest key that's at
+ * least as large as it.  If @c return_eq is FALSE, an exact match is
+ * skipped (a la SNMP getnext).
+ */
+pa_trie_data_atom_t
+pa_trie_getnext (pa_trie_t *ptp, uint16_t key_bytes, const void *key,
+		 psu_boolean_t return_eq);
+
+/**
+ * @brief
+ * Return the data atom with the next larger key, or the smallest
+ * key in the trie if @c datom is null.  Good for tree walks.
+ */
+pa_trie_data_atom_t
+pa_trie_find_next (pa_trie_t *ptp, pa_trie_data_atom_t datom);
+
+/**
+ * @brief
+ * Given a prefix and a prefix length in bits, return the data atom
+ * with the smallest key that starts with the prefix, or a null atom
+ * if there's none.
+ */
+pa_trie_data_atom_t
+pa_trie_subtree_match (pa_trie_t *ptp, uint16_t prefix_len,
+		       const void *prefix);
+
+/**
+ * @brief
+ * Return the data atom after @c datom whose key shares the first
+ * @c prefix_len bits with @c datom's key, or a null atom if there's
+ * none.
+ */
+pa_trie_data_atom_t
+pa_trie_subtree_next (pa_trie_t *ptp, pa_trie_data_atom_t datom,
+		      uint16_t prefix_len);
+
+/*
+ * A key function for tries whose data store is a pa_istr_t
+ */
+const psu_byte_t *
+pa_trie_istr_key_func (pa_trie_t *ptp, pa_trie_data_atom_t datom,
+		       uint16_t *key_bytesp);
+
+pa_trie_t *
+pa_trie_open (pa_mmap_t *pmp, const char *name, void *data_store,
+	      pa_trie_key_func_t key_func, pa_shift_t shift,
+	      pa_atom_t max_atoms);
+
+void
+pa_trie_close (pa_trie_t *ptp);
+
+void
+pa_trie_dump (pa_trie_t *ptp, psu_boolean_t full);
+
+#endif /* PARROTDB_PATRIE_H */
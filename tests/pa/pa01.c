@@ -60,7 +60,8 @@ test_alloc (unsigned slot, unsigned size UNUSED)
     }
 
     if (!opt_quiet)
-	printf("in %u : %u -> %p (%u)\n", slot, pa_fixed_atom_of(atom),
+	printf("in %u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")\n",
+	       slot, pa_fixed_atom_of(atom),
 	       tp, pa_fixed_atom_of(pfp->pf_free));
 }
 
@@ -68,7 +69,8 @@ void
 test_free (unsigned slot)
 {
     pa_fixed_atom_t atom = pa_fixed_atom(trec[slot]->t_id);
-    printf("free %u : %u -> %p (%u)\n", slot, pa_fixed_atom_of(atom),
+    printf("free %u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")\n",
+	   slot, pa_fixed_atom_of(atom),
 	   trec[slot], pa_fixed_atom_of(pfp->pf_free));
 
     pa_fixed_free_atom(pfp, atom);
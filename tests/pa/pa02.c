@@ -24,6 +24,7 @@
 #include <parrotdb/pammap.h>
 
 #define NEED_T_SIZE
+#define NEED_FULL_DUMP
 #define TEST_PRINT_DULL
 #include "pamain.h"
 
@@ -58,7 +59,8 @@ test_alloc (unsigned slot, unsigned size)
     }
 
     if (!opt_quiet)
-	printf("in %u : %u -> %p\n", slot, pa_mmap_atom_of(atom), tp);
+	printf("in %u : %" PA_ATOM_FMT " -> %p\n",
+	       slot, pa_mmap_atom_of(atom), tp);
 }
 
 void
@@ -67,7 +69,7 @@ test_free (unsigned slot)
     pa_mmap_atom_t atom = pa_mmap_atom(trec[slot]->t_id);
 
     if (!opt_quiet)
-	printf("free %u : %u -> %p\n",
+	printf("free %u : %" PA_ATOM_FMT " -> %p\n",
 	       slot, pa_mmap_atom_of(atom), trec[slot]);
 
     pa_mmap_free(pmp, atom, trec[slot]->t_size);
@@ -81,3 +83,9 @@ test_close (void)
     pa_mmap_close(pmp);
 }
 
+
+void
+test_full_dump (psu_boolean_t full UNUSED)
+{
+    pa_mmap_dump(pmp, TRUE);
+}
@@ -59,7 +59,8 @@ test_alloc (unsigned slot, unsigned size UNUSED)
     }
 
     if (!opt_quiet)
-	printf("in %u : %u -> %p (%u)\n", slot, pa_fixed_atom_of(atom),
+	printf("in %u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")\n",
+	       slot, pa_fixed_atom_of(atom),
 	       tp, pa_fixed_atom_of(pfp->pf_free));
 }
 
@@ -70,7 +71,7 @@ test_free (unsigned slot)
     if (tp) {
 	pa_fixed_atom_t atom = pa_fixed_atom(trec[slot]->t_id);
 	if (!opt_quiet)
-	    printf("free %u : %u -> %p (%u)\n",
+	    printf("free %u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")\n",
 		   slot, pa_fixed_atom_of(atom), trec[slot],
 		   pa_fixed_atom_of(pfp->pf_free));
 	pa_fixed_free_atom(pfp, atom);
@@ -87,7 +88,7 @@ test_print (unsigned slot)
     if (tp) {
 	pa_fixed_atom_t atom = pa_fixed_atom(trec[slot]->t_id);
 	if (!opt_quiet)
-	    printf("%u : %u -> %p (%u)\n",
+	    printf("%u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")\n",
 		   slot, pa_fixed_atom_of(atom), trec[slot],
 		   pa_fixed_atom_of(pfp->pf_free));
     } else {
@@ -107,7 +108,7 @@ test_dump (void)
 	tp = trec[slot];
 	if (tp) {
 	    atom = pa_fixed_atom(trec[slot]->t_id);
-	    printf("%u : %u -> %p (%u)%s%s%s\n",
+	    printf("%u : %" PA_ATOM_FMT " -> %p (%" PA_ATOM_FMT ")%s%s%s\n",
 		   slot, pa_fixed_atom_of(atom), trec[slot],
 		   pa_fixed_atom_of(pfp->pf_free),
 		   (tp->t_magic != opt_magic) ? " bad-magic" : "",
@@ -22,8 +22,10 @@
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
 #include <parrotdb/paarb.h>
 
+#define NEED_REALLOC
 #include "pamain.h"
 
 void
@@ -40,10 +42,14 @@ test_init (void)
 
 pa_mmap_t *pmp;
 pa_arb_t *prp;
+unsigned *tlen;			/* Bytes we've written in each slot */
 
 void
 test_open (void)
 {
+    tlen = psu_calloc(opt_count * sizeof(*tlen));
+    assert(tlen);
+
     pmp = pa_mmap_open(opt_filename, "pa04", 0, 0644);
     assert(pmp);
 
@@ -67,30 +73,69 @@ test_alloc (unsigned slot, unsigned this_size)
 	tp->t_id = pa_arb_atom_of(atom);
 	tp->t_slot = slot;
 	memset(tp->t_val, opt_value, opt_size - sizeof(*tp));
+	tlen[slot] = (this_size > opt_size) ? this_size : opt_size;
     }
 
     if (!opt_quiet)
-	printf("in %u (%u) : %#x -> %p\n",
+	printf("in %u (%u) : %#" PA_ATOM_XFMT " -> %p\n",
 	       slot, this_size, pa_arb_atom_of(atom), tp);
 }
 
+void
+test_realloc (unsigned slot, unsigned this_size)
+{
+    test_t *tp = trec[slot];
+    if (tp == NULL) {
+	printf("%u : free already\n", slot);
+	return;
+    }
+
+    pa_arb_atom_t old_atom = pa_arb_atom(tp->t_id);
+    pa_arb_atom_t atom = pa_arb_realloc(prp, old_atom, this_size);
+    tp = pa_arb_atom_addr(prp, atom);
+    if (tp == NULL) {
+	printf("realloc %u (%u) : failed\n", slot, this_size);
+	return;
+    }
+
+    printf("realloc %u (%u) : %#" PA_ATOM_XFMT " -> %#" PA_ATOM_XFMT "%s%s%s\n",
+	   slot, this_size, pa_arb_atom_of(old_atom), pa_arb_atom_of(atom),
+	   (pa_arb_atom_of(atom) == pa_arb_atom_of(old_atom))
+	   ? " in-place" : " moved",
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "");
+
+    tp->t_id = pa_arb_atom_of(atom);
+    trec[slot] = tp;
+
+    /* Shrinking drops our tail; growing adds an unwritten one */
+    if (tlen[slot] > this_size)
+	tlen[slot] = this_size;
+}
+
 void
 test_dump (void)
 {
     unsigned slot;
     test_t *tp;
     pa_arb_atom_t atom;
+    size_t need = sizeof(*tp) + 3 * sizeof(tp->t_val[0]);
+    int value;
+
+    /* Values were filled in with memset, a byte at a time */
+    memset(&value, opt_value, sizeof(value));
 
     printf("dumping: (%u) len:%zu\n", opt_count, prp->pr_mmap->pm_len);
     for (slot = 0; slot < opt_count; slot++) {
 	tp = trec[slot];
 	if (tp) {
 	    atom = pa_arb_atom(trec[slot]->t_id);
-	    printf("%u : %#x -> %p%s%s%s\n",
+	    printf("%u : %#" PA_ATOM_XFMT " -> %p%s%s%s\n",
 		   slot, pa_arb_atom_of(atom), trec[slot],
 		   (tp->t_magic != opt_magic) ? " bad-magic" : "",
 		   (tp->t_slot != slot) ? " bad-slot" : "",
-		   (tp->t_val[2] != opt_value) ? " bad-value" : "");
+		   (tlen[slot] >= need && tp->t_val[2] != value)
+		   ? " bad-value" : "");
 	}
     }
 
@@ -105,7 +150,7 @@ test_free (unsigned slot)
     if (tp) {
 	atom = pa_arb_atom(tp->t_id);
 	if (!opt_quiet)
-	    printf("free %u : %#x -> %p\n",
+	    printf("free %u : %#" PA_ATOM_XFMT " -> %p\n",
 		   slot, pa_arb_atom_of(atom), tp);
 	pa_arb_free_atom(prp, atom);
 	trec[slot] = NULL;
@@ -123,7 +168,7 @@ test_print (unsigned slot)
     if (tp) {
 	atom = pa_arb_atom(trec[slot]->t_id);
 	if (!opt_quiet)
-	    printf("%u : %#x -> %p\n",
+	    printf("%u : %#" PA_ATOM_XFMT " -> %p\n",
 		   slot, pa_arb_atom_of(atom), trec[slot]);
     } else {
 	printf("%u : free\n", slot);
@@ -22,8 +22,8 @@
 #include <parrotdb/pacommon.h>
 #include <parrotdb/paconfig.h>
 #include <parrotdb/pammap.h>
-#include <parrotdb/paarb.h>
 #include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
 #include <parrotdb/paistr.h>
 #include <parrotdb/papat.h>
 
@@ -100,7 +100,7 @@ test_key (unsigned slot, const char *key)
     }
 
     if (!opt_quiet)
-	printf("in %u (%zu) : %s -> (%#x)\n",
+	printf("in %u (%zu) : %s -> (%#" PA_ATOM_XFMT ")\n",
 	       slot, len, key, pa_istr_atom_of(atom));
 }
 
@@ -118,7 +118,7 @@ test_list (const char *key)
 	atom = pa_pat_node_data(ppp, node);
 	iatom = pa_istr_atom(pa_pat_data_atom_of(atom));
 	data = pa_istr_atom_string(pip, iatom);
-	printf("  %p %#x -> %p [%s]\n",
+	printf("  %p %#" PA_ATOM_XFMT " -> %p [%s]\n",
 	       node, pa_istr_atom_of(iatom), data, data ?: "");
 	node = pa_pat_subtree_next(ppp, node, plen);
     }
@@ -139,7 +139,7 @@ test_dump (void)
 
 	    data = pa_istr_atom_string(pip, iatom);
 
-	    printf("%u : %#x -> %p [%s]\n",
+	    printf("%u : %#" PA_ATOM_XFMT " -> %p [%s]\n",
 		   slot, pa_istr_atom_of(iatom), data, data);
 	}
     }
@@ -151,7 +151,7 @@ test_dump (void)
 	atom = pa_pat_node_data(ppp, node);
 	iatom = pa_istr_atom(pa_pat_data_atom_of(atom));
 	data = pa_istr_atom_string(pip, iatom);
-	printf("  %p %#x -> %p [%s]\n",
+	printf("  %p %#" PA_ATOM_XFMT " -> %p [%s]\n",
 	       node, pa_istr_atom_of(iatom), data, data ?: "");
     }
 }
@@ -189,7 +189,7 @@ test_print (unsigned slot)
 	const char *data = pa_istr_atom_string(pip, iatom);
 
 	if (!opt_quiet)
-	    printf("%u : %#x -> %p [%s]\n",
+	    printf("%u : %#" PA_ATOM_XFMT " -> %p [%s]\n",
 		   slot, pa_istr_atom_of(iatom), data, data);
     } else {
 	printf("%u : free\n", slot);
@@ -89,7 +89,7 @@ test_key (unsigned slot, const char *key)
     const char *str = pa_istr_atom_string(pip, atom);
 
     if (!opt_quiet)
-	printf("in %u (%u) : %s -> (%#x) -> %p/%s\n",
+	printf("in %u (%u) : %s -> (%#" PA_ATOM_XFMT ") -> %p/%s\n",
 	       slot, len, key, pa_istr_atom_of(atom), test_pr(str), str);
 }
 
@@ -110,7 +110,7 @@ test_dump (void)
 	const char *str;
 	str = pa_istr_is_null(atom) ? "" : pa_istr_atom_string(pip, atom);
 
-	printf("%u : %#x -> %p [%s]\n",
+	printf("%u : %#" PA_ATOM_XFMT " -> %p [%s]\n",
 	       slot, pa_istr_atom_of(atom), test_pr(str), str);
     }
 }
@@ -138,7 +138,7 @@ test_print (unsigned slot)
 	str = pa_istr_is_null(atom) ? "" : pa_istr_atom_string(pip, atom);
 
 	if (!opt_quiet)
-	    printf("%u : %#x -> %p [%s]\n",
+	    printf("%u : %#" PA_ATOM_XFMT " -> %p [%s]\n",
 		   slot, pa_istr_atom_of(atom), test_pr(str), str);
     } else {
 	printf("%u : free\n", slot);
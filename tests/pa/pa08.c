@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test the pa_istr hash index (pa_istr_intern/pa_istr_find)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+
+#define NEED_T_ATOM
+#define NEED_KEY
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+char **keys;			/* Copies of our keys, for test_close */
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa08", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    keys = calloc(opt_count, sizeof(*keys));
+    assert(keys);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    pa_istr_atom_t old = pa_istr_find(pip, key);
+    pa_istr_atom_t atom = pa_istr_intern(pip, key);
+    if (pa_istr_is_null(atom)) {
+	printf("in %u : %s -> failed\n", slot, key);
+	return;
+    }
+
+    test_t *tp = calloc(1, sizeof(*tp));
+
+    trec[slot] = tp;
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_slot = slot;
+	tp->t_atom = pa_istr_atom_of(atom);
+    }
+
+    free(keys[slot]);
+    keys[slot] = strdup(key);
+
+    const char *str = pa_istr_atom_string(pip, atom);
+
+    printf("in %u : %s -> %#" PA_ATOM_XFMT " [%s]%s%s\n",
+	   slot, key, pa_istr_atom_of(atom), str,
+	   pa_istr_is_null(old) ? " new" : " existing",
+	   (!pa_istr_is_null(old) && pa_istr_atom_of(old)
+	    != pa_istr_atom_of(atom)) ? " mismatch" : "");
+}
+
+void
+test_list (const char *key)
+{
+    pa_istr_atom_t atom = pa_istr_find(pip, key);
+
+    if (pa_istr_is_null(atom))
+	printf("find %s -> not found\n", key);
+    else
+	printf("find %s -> %#" PA_ATOM_XFMT " [%s]\n",
+	       key, pa_istr_atom_of(atom), pa_istr_atom_string(pip, atom));
+}
+
+void
+test_dump (void)
+{
+    pa_istr_dump(pip, TRUE);
+}
+
+void
+test_free (unsigned slot UNUSED)
+{
+    return;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp) {
+	pa_istr_atom_t atom = pa_istr_atom(tp->t_atom);
+	printf("%u : %#" PA_ATOM_XFMT " [%s]\n", slot, pa_istr_atom_of(atom),
+	       pa_istr_atom_string(pip, atom));
+    } else {
+	printf("%u : free\n", slot);
+    }
+}
+
+/*
+ * Close our map, and if it's a file, reopen it read-only to make
+ * sure we can still find all our strings.
+ */
+void
+test_close (void)
+{
+    unsigned slot, found = 0, missing = 0;
+
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+
+    if (opt_filename == NULL)
+	return;
+
+    pmp = pa_mmap_open(opt_filename, "pa08", PMF_READ_ONLY, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    for (slot = 0; slot < opt_count; slot++) {
+	if (keys[slot] == NULL || trec[slot] == NULL)
+	    continue;
+
+	pa_istr_atom_t atom = pa_istr_find(pip, keys[slot]);
+	if (pa_istr_atom_of(atom) == trec[slot]->t_atom)
+	    found += 1;
+	else {
+	    printf("read-only: %u : %s -> %#" PA_ATOM_XFMT
+		   " (expected %#" PA_ATOM_XFMT ")\n",
+		   slot, keys[slot], pa_istr_atom_of(atom),
+		   trec[slot]->t_atom);
+	    missing += 1;
+	}
+    }
+
+    printf("read-only: found %u, missing %u\n", found, missing);
+
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
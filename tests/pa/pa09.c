@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test the multi-bit trie (pa_trie)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/patrie.h>
+
+#define NEED_T_ATOM
+#define NEED_KEY
+#define NEED_FULL_DUMP
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+pa_trie_t *ptp;
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa09", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    ptp = pa_trie_open(pmp, "trie", pip, pa_trie_istr_key_func,
+		       opt_shift, opt_max_atoms);
+    assert(ptp);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+static const char *
+test_string (pa_trie_data_atom_t datom)
+{
+    return pa_istr_atom_string(pip, pa_istr_atom(pa_trie_data_atom_of(datom)));
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    size_t len = key ? strlen(key) : 0;
+
+    if (len == 0 || trec[slot] != NULL)
+	return;
+
+    pa_istr_atom_t atom = pa_istr_string(pip, key);
+    pa_trie_data_atom_t datom = pa_trie_data_atom(pa_istr_atom_of(atom));
+
+    if (!pa_trie_add(ptp, datom)) {
+	printf("in %u : %s -> duplicate\n", slot, key);
+	return;
+    }
+
+    test_t *tp = calloc(1, sizeof(*tp));
+
+    trec[slot] = tp;
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_slot = slot;
+	tp->t_atom = pa_istr_atom_of(atom);
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %s -> %#" PA_ATOM_XFMT "\n",
+	       slot, key, pa_istr_atom_of(atom));
+}
+
+void
+test_list (const char *key)
+{
+    uint16_t plen = strlen(key) * PA_NBBY;
+    pa_trie_data_atom_t datom;
+
+    printf("list %s:\n", key);
+
+    datom = pa_trie_subtree_match(ptp, plen, key);
+    while (!pa_trie_data_is_null(datom)) {
+	printf("  %#" PA_ATOM_XFMT " [%s]\n",
+	       pa_trie_data_atom_of(datom), test_string(datom));
+	datom = pa_trie_subtree_next(ptp, datom, plen);
+    }
+
+    /* getnext should land on the first key that's larger */
+    datom = pa_trie_getnext(ptp, strlen(key), key, FALSE);
+    printf("getnext %s -> [%s]\n", key,
+	   pa_trie_data_is_null(datom) ? "" : test_string(datom));
+}
+
+/*
+ * Walk the trie, making sure the keys come out in order and that each
+ * one can be found
+ */
+void
+test_dump (void)
+{
+    pa_trie_data_atom_t datom = pa_trie_data_null_atom();
+    const char *last = NULL, *str;
+    unsigned count = 0;
+
+    while (!pa_trie_data_is_null(datom = pa_trie_find_next(ptp, datom))) {
+	str = test_string(datom);
+	count += 1;
+
+	printf("  %#" PA_ATOM_XFMT " [%s]%s%s\n",
+	       pa_trie_data_atom_of(datom), str,
+	       (last && strcmp(last, str) >= 0) ? " out-of-order" : "",
+	       (pa_trie_data_atom_of(pa_trie_get(ptp, strlen(str) + 1, str))
+		!= pa_trie_data_atom_of(datom)) ? " not-found" : "");
+	last = str;
+    }
+
+    printf("walked %u of %u keys\n", count, ptp->pt_infop->pti_count);
+}
+
+void
+test_free (unsigned slot)
+{
+    test_t *tp = trec[slot];
+    if (tp == NULL) {
+	printf("%u : free\n", slot);
+	return;
+    }
+
+    pa_istr_atom_t atom = pa_istr_atom(tp->t_atom);
+    const char *key = pa_istr_atom_string(pip, atom);
+    pa_trie_data_atom_t datom = pa_trie_delete(ptp, strlen(key) + 1, key);
+
+    if (pa_trie_data_atom_of(datom) != tp->t_atom)
+	printf("delete %u : %s -> failed\n", slot, key);
+    else if (!opt_quiet)
+	printf("delete %u : %s\n", slot, key);
+
+    free(tp);
+    trec[slot] = NULL;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp) {
+	pa_istr_atom_t atom = pa_istr_atom(tp->t_atom);
+	const char *key = pa_istr_atom_string(pip, atom);
+	pa_trie_data_atom_t datom = pa_trie_get(ptp, strlen(key) + 1, key);
+
+	printf("%u : %#" PA_ATOM_XFMT " [%s]%s\n", slot, tp->t_atom, key,
+	       (pa_trie_data_atom_of(datom) != tp->t_atom) ? " not-found" : "");
+    } else {
+	printf("%u : free\n", slot);
+    }
+}
+
+void
+test_close (void)
+{
+    pa_trie_dump(ptp, TRUE);
+
+    pa_trie_close(ptp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
+
+void
+test_full_dump (psu_boolean_t full)
+{
+    pa_trie_dump(ptp, full);
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test building a patricia tree from sorted keys (pa_pat_bulk_load)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+
+#define NEED_T_ATOM
+#define NEED_KEY
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+pa_pat_t *ppp;
+int loaded;			/* Have we loaded the tree yet? */
+
+typedef struct test_bulk_s {
+    pa_istr_atom_t *tb_atoms;	/* Sorted atoms */
+    unsigned tb_count;		/* Number of atoms */
+    unsigned tb_next;		/* Next one to return */
+} test_bulk_t;
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa10", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    ppp = pa_pat_open(pmp, "pat", pip, pa_pat_istr_key_func,
+		      PA_PAT_MAXKEY, opt_shift, opt_max_atoms);
+    assert(ppp);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+static const char *
+test_string (pa_pat_node_t *node)
+{
+    pa_pat_data_atom_t datom = pa_pat_node_data(ppp, node);
+    return pa_istr_atom_string(pip, pa_istr_atom(pa_pat_data_atom_of(datom)));
+}
+
+/*
+ * Keys are stashed in trec[] until the first dump, when we sort them
+ * and bulk load them.  After that, they are added one by one.
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    size_t len = key ? strlen(key) : 0;
+
+    if (len == 0)
+	return;
+
+    pa_istr_atom_t atom = pa_istr_string(pip, key);
+
+    if (loaded && !pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atom)),
+			      len + 1)) {
+	printf("in %u : %s -> duplicate\n", slot, key);
+	return;
+    }
+
+    test_t *tp = calloc(1, sizeof(*tp));
+
+    free(trec[slot]);
+    trec[slot] = tp;
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_slot = slot;
+	tp->t_atom = pa_istr_atom_of(atom);
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %s -> %#" PA_ATOM_XFMT "%s\n",
+	       slot, key, pa_istr_atom_of(atom), loaded ? " added" : "");
+}
+
+static int
+test_compare (const void *v1, const void *v2)
+{
+    const pa_istr_atom_t *a1 = v1, *a2 = v2;
+
+    return strcmp(pa_istr_atom_string(pip, *a1),
+		  pa_istr_atom_string(pip, *a2));
+}
+
+static pa_pat_data_atom_t
+test_bulk_next (pa_pat_t *root UNUSED, void *opaque, uint16_t *key_bytesp)
+{
+    test_bulk_t *tbp = opaque;
+
+    if (tbp->tb_next >= tbp->tb_count)
+	return pa_pat_data_null_atom();
+
+    pa_istr_atom_t atom = tbp->tb_atoms[tbp->tb_next++];
+    *key_bytesp = strlen(pa_istr_atom_string(pip, atom)) + 1;
+
+    return pa_pat_data_atom(pa_istr_atom_of(atom));
+}
+
+static void
+test_load (void)
+{
+    test_bulk_t tb;
+    unsigned slot;
+
+    bzero(&tb, sizeof(tb));
+    tb.tb_atoms = calloc(opt_count, sizeof(*tb.tb_atoms));
+    assert(tb.tb_atoms);
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (trec[slot])
+	    tb.tb_atoms[tb.tb_count++] = pa_istr_atom(trec[slot]->t_atom);
+
+    qsort(tb.tb_atoms, tb.tb_count, sizeof(*tb.tb_atoms), test_compare);
+
+    psu_boolean_t rc = pa_pat_bulk_load(ppp, test_bulk_next, &tb);
+    printf("bulk load: %s, used %u of %u keys\n", rc ? "success" : "failed",
+	   tb.tb_next, tb.tb_count);
+
+    free(tb.tb_atoms);
+    loaded = 1;
+}
+
+void
+test_list (const char *key)
+{
+    uint16_t plen = strlen(key) * PA_NBBY;
+    pa_pat_node_t *node;
+
+    if (!loaded)
+	test_load();
+
+    printf("list %s:\n", key);
+
+    node = pa_pat_subtree_match(ppp, plen, key);
+    while (node != NULL) {
+	printf("  [%s]\n", test_string(node));
+	node = pa_pat_subtree_next(ppp, node, plen);
+    }
+}
+
+/*
+ * Walk the tree, making sure the keys come out in order and can be
+ * found.  We also count how many nodes directly follow the one
+ * before them, to show the bulk loaded nodes are in key order.
+ */
+void
+test_dump (void)
+{
+    pa_pat_node_t *node = NULL, *last = NULL;
+    unsigned count = 0, sequential = 0;
+    const char *str, *last_str = NULL;
+
+    if (!loaded)
+	test_load();
+
+    while ((node = pa_pat_find_next(ppp, node)) != NULL) {
+	str = test_string(node);
+	count += 1;
+	if (last && node == last + 1)
+	    sequential += 1;
+
+	printf("  [%s]%s%s\n", str,
+	       (last_str && strcmp(last_str, str) >= 0) ? " out-of-order" : "",
+	       (pa_pat_get(ppp, strlen(str) + 1, str) != node)
+	       ? " not-found" : "");
+	last = node;
+	last_str = str;
+    }
+
+    printf("walked %u keys, %u sequential nodes\n", count, sequential);
+}
+
+void
+test_free (unsigned slot UNUSED)
+{
+    return;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp) {
+	const char *str = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+	pa_pat_node_t *node = pa_pat_get(ppp, strlen(str) + 1, str);
+
+	printf("%u : %#" PA_ATOM_XFMT " [%s]%s\n", slot, tp->t_atom, str,
+	       node ? "" : " not-found");
+    } else {
+	printf("%u : free\n", slot);
+    }
+}
+
+void
+test_close (void)
+{
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
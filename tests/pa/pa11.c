@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test the hash table (pa_hash)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/pahash.h>
+
+#define NEED_T_ATOM
+#define NEED_KEY
+#define NEED_FULL_DUMP
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+pa_hash_t *php;
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa11", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    php = pa_hash_open(pmp, "hash", pip, pa_hash_istr_key_func,
+		       opt_shift, opt_max_atoms);
+    assert(php);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+static const char *
+test_string (pa_hash_data_atom_t datom)
+{
+    return pa_istr_atom_string(pip, pa_istr_atom(pa_hash_data_atom_of(datom)));
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    size_t len = key ? strlen(key) : 0;
+
+    if (len == 0 || trec[slot] != NULL)
+	return;
+
+    pa_istr_atom_t atom = pa_istr_string(pip, key);
+    if (!pa_hash_add(php, pa_hash_data_atom(pa_istr_atom_of(atom)))) {
+	printf("in %u : %s -> duplicate\n", slot, key);
+	return;
+    }
+
+    test_t *tp = calloc(1, sizeof(*tp));
+
+    trec[slot] = tp;
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_slot = slot;
+	tp->t_atom = pa_istr_atom_of(atom);
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %s -> %#" PA_ATOM_XFMT "\n",
+	       slot, key, pa_istr_atom_of(atom));
+}
+
+void
+test_list (const char *key)
+{
+    pa_hash_data_atom_t datom = pa_hash_get(php, strlen(key), key);
+
+    if (pa_hash_data_is_null(datom))
+	printf("get %s -> not found\n", key);
+    else
+	printf("get %s -> %#" PA_ATOM_XFMT " [%s]\n",
+	       key, pa_hash_data_atom_of(datom), test_string(datom));
+}
+
+/*
+ * Make sure every key we've added can be found, and that a walk
+ * sees each of them once
+ */
+void
+test_dump (void)
+{
+    pa_hash_cursor_t cursor;
+    pa_hash_data_atom_t datom;
+    unsigned slot, live = 0, found = 0, walked = 0;
+
+    for (slot = 0; slot < opt_count; slot++) {
+	test_t *tp = trec[slot];
+	if (tp == NULL)
+	    continue;
+
+	live += 1;
+	const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+	datom = pa_hash_get(php, strlen(key), key);
+	if (pa_hash_data_atom_of(datom) == tp->t_atom)
+	    found += 1;
+	else
+	    printf("%u : %s -> not found\n", slot, key);
+    }
+
+    pa_hash_cursor_init(php, &cursor);
+    while (!pa_hash_data_is_null(pa_hash_cursor_next(php, &cursor)))
+	walked += 1;
+
+    printf("keys %u, found %u, walked %u, count %u, buckets %u\n",
+	   live, found, walked, php->ph_count, pa_hash_buckets(php));
+}
+
+void
+test_free (unsigned slot)
+{
+    test_t *tp = trec[slot];
+    if (tp == NULL) {
+	printf("%u : free\n", slot);
+	return;
+    }
+
+    const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+    pa_hash_data_atom_t datom = pa_hash_delete(php, strlen(key), key);
+
+    if (pa_hash_data_atom_of(datom) != tp->t_atom)
+	printf("delete %u : %s -> failed\n", slot, key);
+    else if (!opt_quiet)
+	printf("delete %u : %s\n", slot, key);
+
+    free(tp);
+    trec[slot] = NULL;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp) {
+	const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+	pa_hash_data_atom_t datom = pa_hash_get(php, strlen(key), key);
+
+	printf("%u : %#" PA_ATOM_XFMT " [%s]%s\n", slot, tp->t_atom, key,
+	       (pa_hash_data_atom_of(datom) != tp->t_atom) ? " not-found" : "");
+    } else {
+	printf("%u : free\n", slot);
+    }
+}
+
+void
+test_close (void)
+{
+    pa_hash_dump(php, TRUE);
+
+    pa_hash_close(php);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
+
+void
+test_full_dump (psu_boolean_t full)
+{
+    pa_hash_dump(php, full);
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test the B+tree (pa_btree)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/pabtree.h>
+
+#define NEED_T_ATOM
+#define NEED_KEY
+#define NEED_RANGE
+#define NEED_FULL_DUMP
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_istr_t *pip;
+pa_btree_t *pbp;
+
+void
+test_init (void)
+{
+    return;
+}
+
+/*
+ * The "size" option gives the node size, so small tests can still
+ * build a tree with a few levels
+ */
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa12", 0, 0644);
+    assert(pmp);
+
+    pip = pa_istr_open(pmp, "istr", opt_shift, 2, opt_max_atoms);
+    assert(pip);
+
+    pbp = pa_btree_open(pmp, "btree", opt_size, opt_shift, opt_max_atoms);
+    assert(pbp);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+static const char *
+test_string (pa_btree_data_atom_t datom)
+{
+    return pa_istr_atom_string(pip,
+			       pa_istr_atom(pa_btree_data_atom_of(datom)));
+}
+
+/*
+ * Keys don't include the trailing NUL, so one key can be a prefix of
+ * another
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    size_t len = key ? strlen(key) : 0;
+
+    if (len == 0 || trec[slot] != NULL)
+	return;
+
+    pa_istr_atom_t atom = pa_istr_string(pip, key);
+    pa_btree_data_atom_t datom = pa_btree_data_atom(pa_istr_atom_of(atom));
+
+    if (!pa_btree_add(pbp, len, key, datom)) {
+	printf("in %u : %s -> failed\n", slot, key);
+	return;
+    }
+
+    test_t *tp = calloc(1, sizeof(*tp));
+
+    trec[slot] = tp;
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_slot = slot;
+	tp->t_atom = pa_istr_atom_of(atom);
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %s -> %#" PA_ATOM_XFMT "\n",
+	       slot, key, pa_istr_atom_of(atom));
+}
+
+/*
+ * List the keys that start with the given prefix
+ */
+void
+test_list (const char *key)
+{
+    size_t len = strlen(key);
+    pa_btree_cursor_t cursor;
+    pa_btree_data_atom_t datom;
+    const psu_byte_t *found;
+    uint16_t found_len;
+
+    printf("list %s:\n", key);
+
+    pa_btree_cursor_seek(pbp, &cursor, len, key);
+    for (;;) {
+	datom = pa_btree_cursor_next(pbp, &cursor, &found_len, &found);
+	if (pa_btree_data_is_null(datom))
+	    break;
+
+	if (found_len < len || memcmp(found, key, len) != 0)
+	    break;
+
+	printf("  %#" PA_ATOM_XFMT " [%.*s]\n", pa_btree_data_atom_of(datom),
+	       (int) found_len, found);
+    }
+}
+
+void
+test_range (const char *lo, const char *hi)
+{
+    uint32_t count = pa_btree_delete_range(pbp, strlen(lo), lo,
+					   hi ? strlen(hi) : 0, hi);
+    unsigned slot;
+
+    printf("delete range [%s, %s): %u keys\n", lo, hi ?: "", count);
+
+    /* Forget the slots whose keys went away */
+    for (slot = 0; slot < opt_count; slot++) {
+	test_t *tp = trec[slot];
+	if (tp == NULL)
+	    continue;
+
+	const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+	if (strcmp(key, lo) >= 0 && (hi == NULL || strcmp(key, hi) < 0)) {
+	    free(tp);
+	    trec[slot] = NULL;
+	}
+    }
+}
+
+/*
+ * Walk the tree, making sure the keys come out in order, that each
+ * one can be found, and that we see every key we think we have
+ */
+void
+test_dump (void)
+{
+    pa_btree_cursor_t cursor;
+    pa_btree_data_atom_t datom;
+    const psu_byte_t *key, *last = NULL;
+    uint16_t key_len, last_len = 0;
+    unsigned count = 0, slot, live = 0, bad = 0;
+    psu_boolean_t out_of_order, bad_data, not_found;
+
+    pa_btree_cursor_seek(pbp, &cursor, 0, NULL);
+    for (;;) {
+	datom = pa_btree_cursor_next(pbp, &cursor, &key_len, &key);
+	if (pa_btree_data_is_null(datom))
+	    break;
+
+	count += 1;
+	int rc = last ? memcmp(last, key, (last_len < key_len)
+			       ? last_len : key_len) : -1;
+	if (rc == 0)
+	    rc = (int) last_len - (int) key_len;
+
+	const char *str = test_string(datom);
+	out_of_order = (rc >= 0);
+	bad_data = (strlen(str) != key_len || memcmp(str, key, key_len) != 0);
+	not_found = (pa_btree_data_atom_of(pa_btree_get(pbp, key_len, key))
+		     != pa_btree_data_atom_of(datom));
+	if (out_of_order || bad_data || not_found)
+	    bad += 1;
+
+	if (!opt_quiet)
+	    printf("  %#" PA_ATOM_XFMT " [%.*s]%s%s%s\n",
+		   pa_btree_data_atom_of(datom),
+		   (int) key_len, key, out_of_order ? " out-of-order" : "",
+		   bad_data ? " bad-data" : "", not_found ? " not-found" : "");
+	last = key;
+	last_len = key_len;
+    }
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (trec[slot])
+	    live += 1;
+
+    printf("walked %u of %u keys, expected %u, %u bad\n", count,
+	   pbp->pb_infop->pbi_count, live, bad);
+}
+
+void
+test_free (unsigned slot)
+{
+    test_t *tp = trec[slot];
+    if (tp == NULL) {
+	printf("%u : free\n", slot);
+	return;
+    }
+
+    const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+    pa_btree_data_atom_t datom = pa_btree_delete(pbp, strlen(key), key);
+
+    if (pa_btree_data_atom_of(datom) != tp->t_atom)
+	printf("delete %u : %s -> failed\n", slot, key);
+    else if (!opt_quiet)
+	printf("delete %u : %s\n", slot, key);
+
+    free(tp);
+    trec[slot] = NULL;
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = trec[slot];
+
+    if (tp) {
+	const char *key = pa_istr_atom_string(pip, pa_istr_atom(tp->t_atom));
+	pa_btree_data_atom_t datom = pa_btree_get(pbp, strlen(key), key);
+
+	printf("%u : %#" PA_ATOM_XFMT " [%s]%s\n", slot, tp->t_atom, key,
+	       (pa_btree_data_atom_of(datom) != tp->t_atom) ? " not-found" : "");
+    } else {
+	printf("%u : free\n", slot);
+    }
+}
+
+void
+test_close (void)
+{
+    pa_btree_dump(pbp, TRUE);
+
+    pa_btree_close(pbp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+}
+
+void
+test_full_dump (psu_boolean_t full)
+{
+    pa_btree_dump(pbp, full);
+}
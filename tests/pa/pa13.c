@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test whole-bitmap operations (pa_bitmap_and() and friends)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/pabitmap.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_BITMAPS	4	/* Number of bitmaps ("slots") */
+#define TEST_BITS	PA_BITMAP_MAX_BIT /* Bits we shadow (all of them) */
+
+pa_mmap_t *pmp;
+pa_bitmap_t *pbp;
+pa_bitmap_id_t bitmaps[TEST_BITMAPS];
+
+/*
+ * We keep a plain array of bits alongside each bitmap, and check the
+ * bitmap against it after every change.
+ */
+uint8_t shadow[TEST_BITMAPS][TEST_BITS / PA_NBBY];
+
+static const char *impls[] = { "scalar", "sse2", "avx2", NULL };
+
+static inline int
+shadow_test (uint8_t *sp, unsigned bit)
+{
+    return (sp[bit / PA_NBBY] >> (bit % PA_NBBY)) & 1;
+}
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    unsigned i;
+
+    pmp = pa_mmap_open(opt_filename, "pa13", 0, 0644);
+    assert(pmp);
+
+    pbp = pa_bitmap_open(pmp, "pa13.bitmap");
+    assert(pbp);
+
+    for (i = 0; i < TEST_BITMAPS; i++)
+	bitmaps[i] = pa_bitmap_alloc(pbp);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+/*
+ * Compare a bitmap with a shadow, returning the number of problems
+ */
+static unsigned
+test_compare (pa_bitmap_id_t id, uint8_t *sp)
+{
+    pa_bitnumber_t num = PA_BITMAP_FIND_START;
+    unsigned bit = 0, bad = 0, count = 0;
+
+    for (;;) {
+	num = pa_bitmap_find_next(pbp, id, num);
+	if (num == PA_BITMAP_FIND_DONE)
+	    break;
+
+	/* Every shadow bit between the last one and this one is off */
+	for ( ; bit < num && bit < TEST_BITS; bit++)
+	    if (shadow_test(sp, bit))
+		bad += 1;
+
+	if (num >= TEST_BITS || !shadow_test(sp, num))
+	    bad += 1;
+
+	bit = num + 1;
+	count += 1;
+    }
+
+    for ( ; bit < TEST_BITS; bit++)
+	if (shadow_test(sp, bit))
+	    bad += 1;
+
+    if (pa_bitmap_count(pbp, id) != count)
+	bad += 1;
+
+    return bad;
+}
+
+static void
+test_show (unsigned slot)
+{
+    pa_bitmap_id_t id = bitmaps[slot];
+    pa_bitnumber_t num = PA_BITMAP_FIND_START;
+    unsigned shown = 0;
+
+    printf("%u : count %u [", slot, pa_bitmap_count(pbp, id));
+
+    for (;;) {
+	num = pa_bitmap_find_next(pbp, id, num);
+	if (num == PA_BITMAP_FIND_DONE)
+	    break;
+	if (shown++ == 8) {
+	    printf(" ...");
+	    break;
+	}
+	printf("%s%u", (shown > 1) ? " " : "", num);
+    }
+
+    unsigned bad = test_compare(id, shadow[slot]);
+    printf("]%s\n", bad ? " mismatch" : "");
+}
+
+/*
+ * The key is a list of bit numbers and ranges ("1-100 5000") to set
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    const char *cp = key;
+    char *ep;
+    unsigned long lo, hi, bit;
+
+    if (slot >= TEST_BITMAPS) {
+	printf("bad bitmap %u\n", slot);
+	return;
+    }
+
+    while (*cp) {
+	lo = strtoul(cp, &ep, 0);
+	if (ep == cp)
+	    break;
+
+	hi = lo;
+	if (*ep == '-')
+	    hi = strtoul(ep + 1, &ep, 0);
+
+	for (bit = lo; bit <= hi && bit < TEST_BITS; bit++) {
+	    pa_bitmap_set(pbp, bitmaps[slot], bit);
+	    shadow[slot][bit / PA_NBBY] |= 1 << (bit % PA_NBBY);
+	}
+
+	for (cp = ep; isspace((int) *cp); cp++)
+	    continue;
+    }
+
+    if (!opt_quiet)
+	test_show(slot);
+}
+
+typedef psu_boolean_t (*test_op_func_t)(pa_bitmap_t *, pa_bitmap_id_t,
+					pa_bitmap_id_t);
+
+static struct {
+    const char *to_name;
+    test_op_func_t to_func;
+} test_ops[] = {
+    { "and", pa_bitmap_and },
+    { "or", pa_bitmap_or },
+    { "andnot", pa_bitmap_andnot },
+    { "xor", pa_bitmap_xor },
+    { NULL, NULL },
+};
+
+static uint8_t
+test_op_byte (unsigned op, uint8_t d, uint8_t s)
+{
+    switch (op) {
+    case 0: return d & s;
+    case 1: return d | s;
+    case 2: return d & ~s;
+    default: return d ^ s;
+    }
+}
+
+/*
+ * "l op dst src": run the operation with every kernel set this CPU
+ * has, on a copy of dst, checking each against the shadow.  Then run
+ * it on dst with the default kernels.
+ */
+void
+test_list (const char *key)
+{
+    static uint8_t expect[TEST_BITS / PA_NBBY];
+    char name[16];
+    unsigned op, dst, src, i, bad = 0;
+
+    if (sscanf(key, "%15s %u %u", name, &dst, &src) != 3
+	|| dst >= TEST_BITMAPS || src >= TEST_BITMAPS) {
+	printf("bad op: %s\n", key);
+	return;
+    }
+
+    for (op = 0; test_ops[op].to_name; op++)
+	if (strcmp(test_ops[op].to_name, name) == 0)
+	    break;
+
+    if (test_ops[op].to_name == NULL) {
+	printf("bad op: %s\n", name);
+	return;
+    }
+
+    for (i = 0; i < sizeof(expect); i++)
+	expect[i] = test_op_byte(op, shadow[dst][i], shadow[src][i]);
+
+    for (i = 0; impls[i]; i++) {
+	if (!pa_bitmap_impl_select(impls[i]))
+	    continue;
+
+	pa_bitmap_id_t tmp = pa_bitmap_alloc(pbp);
+	pa_bitmap_or(pbp, tmp, bitmaps[dst]);
+	test_ops[op].to_func(pbp, tmp,
+			     (src == dst) ? tmp : bitmaps[src]);
+
+	if (test_compare(tmp, expect)) {
+	    printf("  %s: mismatch\n", impls[i]);
+	    bad += 1;
+	}
+
+	pa_bitmap_free(pbp, tmp);
+    }
+
+    pa_bitmap_impl_select(NULL);
+    test_ops[op].to_func(pbp, bitmaps[dst], bitmaps[src]);
+    memcpy(shadow[dst], expect, sizeof(expect));
+
+    printf("%s %u %u%s\n", name, dst, src, bad ? " failed" : "");
+    if (!opt_quiet)
+	test_show(dst);
+}
+
+void
+test_free (unsigned slot)
+{
+    if (slot >= TEST_BITMAPS) {
+	printf("bad bitmap %u\n", slot);
+	return;
+    }
+
+    pa_bitmap_free(pbp, bitmaps[slot]);
+    bitmaps[slot] = pa_bitmap_alloc(pbp);
+    bzero(shadow[slot], sizeof(shadow[slot]));
+
+    if (!opt_quiet)
+	test_show(slot);
+}
+
+void
+test_print (unsigned slot)
+{
+    if (slot >= TEST_BITMAPS) {
+	printf("bad bitmap %u\n", slot);
+	return;
+    }
+
+    test_show(slot);
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < TEST_BITMAPS; slot++)
+	test_show(slot);
+}
+
+void
+test_close (void)
+{
+    pa_bitmap_close(pbp);
+    pa_mmap_close(pmp);
+}
@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test compressed bitmaps (pa_roar)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/pabitmap.h>
+#include <parrotdb/paroar.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_SETS	4	/* Number of sets ("slots") */
+#define TEST_PAGES	(1U << 16) /* Shadow pages, one per container */
+#define TEST_PAGE_SIZE	(PA_ROAR_BITMAP_BITS / PA_NBBY)
+
+pa_mmap_t *pmp;
+pa_roar_t *prp;
+pa_roar_id_t sets[TEST_SETS];
+
+/*
+ * Each set has a shadow: a plain two-level bitmap, with a page of
+ * 65536 bits for each container's worth of values
+ */
+typedef struct test_shadow_s {
+    uint8_t *ts_page[TEST_PAGES];
+} test_shadow_t;
+
+test_shadow_t shadow[TEST_SETS];
+
+static int
+shadow_test (test_shadow_t *tsp, uint32_t value)
+{
+    uint8_t *page = tsp->ts_page[value >> 16];
+    unsigned low = value & 0xffff;
+
+    return page ? (page[low / PA_NBBY] >> (low % PA_NBBY)) & 1 : 0;
+}
+
+static void
+shadow_set (test_shadow_t *tsp, uint32_t value, int on)
+{
+    uint8_t **pagep = &tsp->ts_page[value >> 16];
+    unsigned low = value & 0xffff;
+
+    if (*pagep == NULL) {
+	if (!on)
+	    return;
+	*pagep = calloc(1, TEST_PAGE_SIZE);
+	assert(*pagep);
+    }
+
+    if (on)
+	(*pagep)[low / PA_NBBY] |= 1 << (low % PA_NBBY);
+    else
+	(*pagep)[low / PA_NBBY] &= ~(1 << (low % PA_NBBY));
+}
+
+static void
+shadow_clear (test_shadow_t *tsp)
+{
+    unsigned i;
+
+    for (i = 0; i < TEST_PAGES; i++) {
+	free(tsp->ts_page[i]);
+	tsp->ts_page[i] = NULL;
+    }
+}
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    unsigned i;
+
+    pmp = pa_mmap_open(opt_filename, "pa14", 0, 0644);
+    assert(pmp);
+
+    prp = pa_roar_open(pmp, "pa14.roar");
+    assert(prp);
+
+    for (i = 0; i < TEST_SETS; i++)
+	sets[i] = pa_roar_alloc(prp);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+/*
+ * Walk a set and its shadow side by side, returning the number of
+ * problems
+ */
+static unsigned
+test_compare (pa_roar_id_t id, test_shadow_t *tsp)
+{
+    unsigned bad = 0, page, low;
+    uint64_t count = 0;
+    uint32_t value, expect;
+    psu_boolean_t ok;
+
+    ok = pa_roar_next(prp, id, 0, &value);
+
+    for (page = 0; page < TEST_PAGES; page++) {
+	if (tsp->ts_page[page] == NULL)
+	    continue;
+
+	for (low = 0; low < PA_ROAR_BITMAP_BITS; low++) {
+	    expect = (page << 16) | low;
+	    if (!shadow_test(tsp, expect))
+		continue;
+
+	    if (!ok || value != expect || !pa_roar_test(prp, id, expect))
+		bad += 1;
+
+	    /* Skip ahead to the next shadow value, if we're lost */
+	    if (ok && value <= expect)
+		ok = (value != UINT32_MAX)
+		    && pa_roar_next(prp, id, expect + 1, &value);
+	    count += 1;
+	}
+    }
+
+    if (ok)
+	bad += 1;		/* Extra values */
+
+    if (pa_roar_count(prp, id) != count)
+	bad += 1;
+
+    return bad;
+}
+
+static void
+test_show (unsigned slot)
+{
+    pa_roar_id_t id = sets[slot];
+    pa_roar_root_t *rootp = pa_roar_root(prp, id);
+    pa_roar_cont_t *dir = NULL;
+    unsigned types[PA_ROAR_RUN + 1] = { 0 }, shown = 0, i;
+    uint32_t value;
+    psu_boolean_t ok;
+
+    if (rootp && !pa_arb_is_null(rootp->prt_dir))
+	dir = pa_arb_atom_addr(prp->pro_arb, rootp->prt_dir);
+    if (dir)
+	for (i = 0; i < rootp->prt_count; i++)
+	    if (dir[i].prc_type <= PA_ROAR_RUN)
+		types[dir[i].prc_type] += 1;
+
+    printf("%u : count %llu, array %u, bitmap %u, run %u, bytes %zu [",
+	   slot, (unsigned long long) pa_roar_count(prp, id),
+	   types[PA_ROAR_ARRAY], types[PA_ROAR_BITMAP], types[PA_ROAR_RUN],
+	   pa_roar_serialize(prp, id, NULL, 0));
+
+    for (ok = pa_roar_next(prp, id, 0, &value); ok;
+	 ok = (value != UINT32_MAX) && pa_roar_next(prp, id, value + 1, &value)) {
+	if (shown++ == 8) {
+	    printf(" ...");
+	    break;
+	}
+	printf("%s%u", (shown > 1) ? " " : "", value);
+    }
+
+    unsigned bad = test_compare(id, &shadow[slot]);
+    printf("]%s\n", bad ? " mismatch" : "");
+}
+
+/*
+ * The key is a list of values and ranges ("1-100 5000"), with an
+ * optional step ("0-1000/3"), to set; a leading "~" clears them
+ * instead
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    const char *cp = key;
+    char *ep;
+    unsigned long long lo, hi, step, value;
+    int on;
+
+    if (slot >= TEST_SETS) {
+	printf("bad set %u\n", slot);
+	return;
+    }
+
+    while (*cp) {
+	on = (*cp != '~');
+	if (!on)
+	    cp += 1;
+
+	lo = strtoull(cp, &ep, 0);
+	if (ep == cp)
+	    break;
+
+	hi = lo;
+	if (*ep == '-')
+	    hi = strtoull(ep + 1, &ep, 0);
+
+	step = 1;
+	if (*ep == '/')
+	    step = strtoull(ep + 1, &ep, 0) ?: 1;
+
+	for (value = lo; value <= hi && value <= UINT32_MAX; value += step) {
+	    psu_boolean_t rc = on ? pa_roar_set(prp, sets[slot], value)
+		: pa_roar_clear(prp, sets[slot], value);
+	    if (!rc)
+		printf("%s %llu failed\n", on ? "set" : "clear", value);
+	    shadow_set(&shadow[slot], value, on);
+	}
+
+	for (cp = ep; isspace((int) *cp); cp++)
+	    continue;
+    }
+
+    if (!opt_quiet)
+	test_show(slot);
+}
+
+typedef psu_boolean_t (*test_op_func_t)(pa_roar_t *, pa_roar_id_t,
+					pa_roar_id_t);
+
+static struct {
+    const char *to_name;
+    test_op_func_t to_func;
+} test_ops[] = {
+    { "and", pa_roar_and },
+    { "or", pa_roar_or },
+    { "andnot", pa_roar_andnot },
+    { "xor", pa_roar_xor },
+    { NULL, NULL },
+};
+
+static uint8_t
+test_op_byte (unsigned op, uint8_t d, uint8_t s)
+{
+    switch (op) {
+    case 0: return d & s;
+    case 1: return d | s;
+    case 2: return d & ~s;
+    default: return d ^ s;
+    }
+}
+
+/*
+ * "l copy src dst" serializes one set and rebuilds another from it;
+ * "l op dst src" runs a set operation
+ */
+void
+test_list (const char *key)
+{
+    static uint8_t zero[TEST_PAGE_SIZE];
+    char name[16];
+    unsigned op, dst, src, page, i;
+
+    if (sscanf(key, "%15s %u %u", name, &dst, &src) != 3
+	|| dst >= TEST_SETS || src >= TEST_SETS) {
+	printf("bad op: %s\n", key);
+	return;
+    }
+
+    if (strcmp(name, "copy") == 0) {
+	/* Here "dst" is the one we read, and "src" the one we build */
+	size_t len = pa_roar_serialize(prp, sets[dst], NULL, 0);
+	psu_byte_t *buf = malloc(len);
+	assert(buf);
+
+	if (pa_roar_serialize(prp, sets[dst], buf, len) != len)
+	    printf("serialize failed\n");
+
+	pa_roar_id_t id = pa_roar_deserialize(prp, buf, len);
+	free(buf);
+	if (pa_roar_is_null(id)) {
+	    printf("deserialize failed\n");
+	    return;
+	}
+
+	pa_roar_free(prp, sets[src]);
+	sets[src] = id;
+
+	shadow_clear(&shadow[src]);
+	for (page = 0; page < TEST_PAGES; page++) {
+	    if (shadow[dst].ts_page[page] == NULL)
+		continue;
+	    shadow[src].ts_page[page] = malloc(TEST_PAGE_SIZE);
+	    assert(shadow[src].ts_page[page]);
+	    memcpy(shadow[src].ts_page[page], shadow[dst].ts_page[page],
+		   TEST_PAGE_SIZE);
+	}
+
+	printf("copy %u %u: %zu bytes\n", dst, src, len);
+	if (!opt_quiet)
+	    test_show(src);
+	return;
+    }
+
+    for (op = 0; test_ops[op].to_name; op++)
+	if (strcmp(test_ops[op].to_name, name) == 0)
+	    break;
+
+    if (test_ops[op].to_name == NULL) {
+	printf("bad op: %s\n", name);
+	return;
+    }
+
+    psu_boolean_t rc = test_ops[op].to_func(prp, sets[dst], sets[src]);
+
+    /* Work out what the shadow should be, a page at a time */
+    for (page = 0; page < TEST_PAGES; page++) {
+	uint8_t *dp = shadow[dst].ts_page[page];
+	uint8_t *sp = shadow[src].ts_page[page];
+
+	if (dp == NULL && sp == NULL)
+	    continue;
+
+	if (dp == NULL) {
+	    dp = shadow[dst].ts_page[page] = calloc(1, TEST_PAGE_SIZE);
+	    assert(dp);
+	}
+
+	for (i = 0; i < TEST_PAGE_SIZE; i++)
+	    dp[i] = test_op_byte(op, dp[i], sp ? sp[i] : 0);
+
+	if (memcmp(dp, zero, TEST_PAGE_SIZE) == 0) {
+	    free(dp);
+	    shadow[dst].ts_page[page] = NULL;
+	}
+    }
+
+    printf("%s %u %u%s\n", name, dst, src, rc ? "" : " failed");
+    if (!opt_quiet) {
+	test_show(dst);
+	if (dst != src && test_compare(sets[src], &shadow[src]))
+	    printf("%u : changed\n", src);
+    }
+}
+
+void
+test_free (unsigned slot)
+{
+    if (slot >= TEST_SETS) {
+	printf("bad set %u\n", slot);
+	return;
+    }
+
+    pa_roar_free(prp, sets[slot]);
+    sets[slot] = pa_roar_alloc(prp);
+    shadow_clear(&shadow[slot]);
+
+    if (!opt_quiet)
+	test_show(slot);
+}
+
+void
+test_print (unsigned slot)
+{
+    if (slot >= TEST_SETS) {
+	printf("bad set %u\n", slot);
+	return;
+    }
+
+    test_show(slot);
+    pa_roar_dump(prp, sets[slot], TRUE);
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < TEST_SETS; slot++)
+	test_show(slot);
+}
+
+void
+test_close (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < TEST_SETS; slot++)
+	shadow_clear(&shadow[slot]);
+
+    pa_roar_close(prp);
+    pa_mmap_close(pmp);
+}
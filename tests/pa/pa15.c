@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test descriptors (pa_dscr_t), the ops registry, and the segment's
+ * reader/writer lock
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/pabitmap.h>
+#include <parrotdb/paroar.h>
+#include <parrotdb/parrotdb.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_WAIT	100000	/* Time to let a child block (usecs) */
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_arb_t *pap;
+pa_bitmap_t *pbp;
+pa_roar_t *prp;
+int dbase;
+
+pa_dscr_t *dscrs;		/* One per slot */
+pa_dscr_t flag;			/* Shared word for the lock tests */
+
+/*
+ * A home-made type, to check that registered ops are used, lock
+ * operations included
+ */
+static uint32_t test_opaque_data[16];
+static unsigned test_opaque_next;
+
+static pa_atom_t
+test_opaque_alloc (pa_mmap_t *pmp_arg UNUSED, void *table UNUSED,
+		   size_t size UNUSED)
+{
+    if (test_opaque_next + 1 >= sizeof(test_opaque_data) / sizeof(uint32_t))
+	return PA_NULL_ATOM;
+
+    return ++test_opaque_next;
+}
+
+static void
+test_opaque_free (pa_mmap_t *pmp_arg UNUSED, void *table UNUSED,
+		  pa_dscr_t dscr)
+{
+    printf("opaque free %" PA_ATOM_FMT "\n", dscr.pd_atom);
+}
+
+static void *
+test_opaque_addr (pa_mmap_t *pmp_arg UNUSED, void *table UNUSED,
+		  pa_dscr_t dscr)
+{
+    return &test_opaque_data[dscr.pd_atom];
+}
+
+static void
+test_opaque_lock (pa_mmap_t *pmp_arg UNUSED, pa_dscr_t dscr, unsigned mode)
+{
+    printf("opaque lock %" PA_ATOM_FMT " (%s)\n", dscr.pd_atom,
+	   (mode == PA_LOCK_WRITE) ? "write" : "read");
+}
+
+static void
+test_opaque_unlock (pa_mmap_t *pmp_arg UNUSED, pa_dscr_t dscr, unsigned mode)
+{
+    printf("opaque unlock %" PA_ATOM_FMT " (%s)\n", dscr.pd_atom,
+	   (mode == PA_LOCK_WRITE) ? "write" : "read");
+}
+
+static const pa_ops_t test_opaque_ops = {
+    .po_name = "opaque",
+    .po_type = PA_TYPE_OPAQUE,
+    .po_lock = test_opaque_lock,
+    .po_unlock = test_opaque_unlock,
+    .po_alloc = test_opaque_alloc,
+    .po_free = test_opaque_free,
+    .po_addr = test_opaque_addr,
+};
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa15", 0, 0644);
+    assert(pmp);
+
+    pfp = pa_fixed_open(pmp, "pa15.fixed", opt_shift, opt_size,
+			opt_max_atoms);
+    pap = pa_arb_open(pmp, "pa15.arb");
+    pbp = pa_bitmap_open(pmp, "pa15.bitmap");
+    prp = pa_roar_open(pmp, "pa15.roar");
+    assert(pfp && pap && pbp && prp);
+
+    dbase = pa_dbase_attach(pmp);
+    assert(dbase >= 0);
+
+    /* Tables 0 thru 3 are the base types; 4 is our own */
+    pa_table_attach(dbase, PA_TYPE_FIXED, pfp);
+    pa_table_attach(dbase, PA_TYPE_ARB, pap);
+    pa_table_attach(dbase, PA_TYPE_BITMAP, pbp);
+    pa_table_attach(dbase, PA_TYPE_ROAR, prp);
+
+    pa_ops_register(&test_opaque_ops);
+    pa_table_attach(dbase, PA_TYPE_OPAQUE, NULL);
+
+    /* These should fail */
+    if (pa_table_attach(dbase, PA_TYPE_PAT, NULL) >= 0)
+	printf("attached a type without ops\n");
+    if (pa_table_attach(PA_DBASE_MAX - 1, PA_TYPE_FIXED, pfp) >= 0)
+	printf("attached to a missing database\n");
+
+    dscrs = psu_calloc(opt_count * sizeof(*dscrs));
+    assert(dscrs);
+
+    flag = pa_dscr_alloc(dbase, 0, sizeof(uint32_t));
+    assert(!pa_dscr_is_null(flag));
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+/*
+ * "k<slot> <table> [size]" allocates an atom from a table and puts
+ * something in it
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    unsigned table = 0, size = 0;
+    pa_dscr_t dscr;
+    void *addr;
+
+    if (sscanf(key, "%u %u", &table, &size) < 1) {
+	printf("bad key: %s\n", key);
+	return;
+    }
+
+    if (!pa_dscr_is_null(dscrs[slot]))
+	pa_dscr_free(dscrs[slot]);
+
+    if (size == 0)
+	size = opt_size;
+
+    dscr = dscrs[slot] = pa_dscr_alloc(dbase, table, size);
+    addr = pa_dscr_addr(dscr);
+    if (addr == NULL) {
+	printf("%u : alloc from table %u failed\n", slot, table);
+	return;
+    }
+
+    pa_dscr_lock(dscr, PA_LOCK_WRITE);
+
+    switch (dscr.pd_type) {
+    case PA_TYPE_FIXED:
+    case PA_TYPE_ARB:
+	snprintf(addr, size, "slot %u", slot);
+	break;
+
+    case PA_TYPE_BITMAP:
+	pa_bitmap_set(pbp, pa_bitmap_atom(dscr.pd_atom), slot);
+	break;
+
+    case PA_TYPE_ROAR:
+	pa_roar_set(prp, pa_roar_atom(dscr.pd_atom), slot);
+	break;
+
+    default:
+	*(uint32_t *) addr = slot;
+	break;
+    }
+
+    pa_dscr_unlock(dscr, PA_LOCK_WRITE);
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+/*
+ * Start a child that takes the lock in "mode" and sets our flag to
+ * "value", giving it time to finish (or block)
+ */
+static pid_t
+test_child (unsigned mode, uint32_t value)
+{
+    volatile uint32_t *flagp = pa_dscr_addr(flag);
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+	printf("fork failed\n");
+	return pid;
+    }
+
+    if (pid == 0) {
+	pa_dscr_lock(flag, mode);
+	*flagp = value;
+	pa_dscr_unlock(flag, mode);
+	_exit(0);
+    }
+
+    usleep(TEST_WAIT);
+    return pid;
+}
+
+static void
+test_reap (pid_t pid)
+{
+    int status;
+
+    if (pid > 0)
+	waitpid(pid, &status, 0);
+}
+
+/*
+ * Reopen a segment whose file has grown past 4GB (sparsely), to make
+ * sure we map all of it
+ */
+static void
+test_big (void)
+{
+    char big_name[PATH_MAX];
+    off_t big_len;
+    pa_mmap_t *big;
+
+    snprintf(big_name, sizeof(big_name), "%s.big", opt_filename);
+    unlink(big_name);
+
+    big = pa_mmap_open(big_name, "pa15", 0, 0644);
+    if (big == NULL) {
+	printf("big: open failed\n");
+	return;
+    }
+
+    big_len = ((off_t) 1 << 32) + (off_t) big->pm_len;
+    pa_mmap_close(big);
+
+    if (truncate(big_name, big_len) < 0) {
+	printf("big: truncate failed\n");
+	unlink(big_name);
+	return;
+    }
+
+    fflush(stdout);
+    big = pa_mmap_open(big_name, "pa15", 0, 0644);
+    if (big == NULL) {
+	printf("big: reopen failed\n");
+    } else {
+	printf("big: mapped %s\n",
+	       (big->pm_len == (size_t) big_len) ? "all" : "short");
+	pa_mmap_close(big);
+    }
+
+    unlink(big_name);
+}
+
+/*
+ * "l readers" checks that readers share the lock, "l writer" that a
+ * writer waits for readers, "l reader" that readers wait for a
+ * writer, "l seq" that optimistic readers see writes, and "l big"
+ * that files past 4GB are mapped whole
+ */
+void
+test_list (const char *key)
+{
+    volatile uint32_t *flagp = pa_dscr_addr(flag);
+    uint32_t seq;
+    pid_t pid;
+
+    *flagp = 0;
+
+    if (strcmp(key, "readers") == 0) {
+	pa_dscr_lock(flag, PA_LOCK_READ);
+	pid = test_child(PA_LOCK_READ, 1);
+	test_reap(pid);
+	printf("readers: second reader got in: %s\n",
+	       (*flagp == 1) ? "yes" : "no");
+	pa_dscr_unlock(flag, PA_LOCK_READ);
+
+    } else if (strcmp(key, "writer") == 0) {
+	pa_dscr_lock(flag, PA_LOCK_READ);
+	pid = test_child(PA_LOCK_WRITE, 2);
+	printf("writer: blocked by reader: %s\n",
+	       (*flagp == 0) ? "yes" : "no");
+	pa_dscr_unlock(flag, PA_LOCK_READ);
+	test_reap(pid);
+	printf("writer: done after reader left: %s\n",
+	       (*flagp == 2) ? "yes" : "no");
+
+    } else if (strcmp(key, "reader") == 0) {
+	pa_dscr_lock(flag, PA_LOCK_WRITE);
+	pid = test_child(PA_LOCK_READ, 3);
+	printf("reader: blocked by writer: %s\n",
+	       (*flagp == 0) ? "yes" : "no");
+	pa_dscr_unlock(flag, PA_LOCK_WRITE);
+	test_reap(pid);
+	printf("reader: done after writer left: %s\n",
+	       (*flagp == 3) ? "yes" : "no");
+
+    } else if (strcmp(key, "seq") == 0) {
+	seq = pa_mmap_read_begin(pmp);
+	printf("seq: quiet segment needs retry: %s\n",
+	       pa_mmap_read_retry(pmp, seq) ? "yes" : "no");
+
+	seq = pa_mmap_read_begin(pmp);
+	test_reap(test_child(PA_LOCK_WRITE, 5));
+	printf("seq: write seen: %s, needs retry: %s\n",
+	       (*flagp == 5) ? "yes" : "no",
+	       pa_mmap_read_retry(pmp, seq) ? "yes" : "no");
+
+    } else if (strcmp(key, "big") == 0) {
+	test_big();
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_free (unsigned slot)
+{
+    if (pa_dscr_is_null(dscrs[slot]))
+	return;
+
+    pa_dscr_free(dscrs[slot]);
+    bzero(&dscrs[slot], sizeof(dscrs[slot]));
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+void
+test_print (unsigned slot)
+{
+    pa_dscr_t dscr = dscrs[slot];
+    pa_table_t *ptp = pa_dscr_table(dscr);
+    void *addr;
+
+    if (pa_dscr_is_null(dscr)) {
+	printf("%u : empty\n", slot);
+	return;
+    }
+
+    pa_dscr_lock(dscr, PA_LOCK_READ);
+
+    addr = pa_dscr_addr(dscr);
+    printf("%u : dbase %u, table %u (%s), type %u, atom %" PA_ATOM_FMT,
+	   slot, dscr.pd_dbase, dscr.pd_table,
+	   ptp ? ptp->pt_ops->po_name : "none", dscr.pd_type, dscr.pd_atom);
+
+    if (addr == NULL) {
+	printf(" [no address]\n");
+	pa_dscr_unlock(dscr, PA_LOCK_READ);
+	return;
+    }
+
+    switch (dscr.pd_type) {
+    case PA_TYPE_FIXED:
+    case PA_TYPE_ARB:
+	printf(" [%s]\n", (char *) addr);
+	break;
+
+    case PA_TYPE_BITMAP:
+	printf(" [bit %u]\n",
+	       pa_bitmap_test(pbp, pa_bitmap_atom(dscr.pd_atom), slot));
+	break;
+
+    case PA_TYPE_ROAR:
+	printf(" [count %llu]\n", (unsigned long long)
+	       pa_roar_count(prp, pa_roar_atom(dscr.pd_atom)));
+	break;
+
+    default:
+	printf(" [%u]\n", *(uint32_t *) addr);
+	break;
+    }
+
+    pa_dscr_unlock(dscr, PA_LOCK_READ);
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (!pa_dscr_is_null(dscrs[slot]))
+	    test_print(slot);
+}
+
+void
+test_close (void)
+{
+    pa_dbase_detach(dbase);
+    psu_free(dscrs);
+
+    pa_roar_close(prp);
+    pa_bitmap_close(pbp);
+    pa_arb_close(pap);
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+}
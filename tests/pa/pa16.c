@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test crash-consistent commits (PMF_COMMIT)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_VALUE_SIZE	32	/* Size of each value (and atom) */
+#define TEST_GROW_SIZE	(1 << 16) /* Size of each "l grow" chunk */
+#define TEST_LOCK_WAIT	5	/* Seconds before a lock is "stuck" */
+#define TEST_FORGED_OFFSET 16	/* Where the log header keeps the length */
+#define TEST_FORGED_LEN	(1 << 20) /* A length nobody committed */
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_atom_t *slots;		/* Atoms for each slot, in the segment */
+char log_name[PATH_MAX];
+
+/*
+ * Open (or reopen) the database, which recovers any commit in
+ * progress
+ */
+static void
+test_reopen (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa16", PMF_COMMIT, 0644);
+    assert(pmp);
+
+    pfp = pa_fixed_open(pmp, "pa16.values", opt_shift, TEST_VALUE_SIZE,
+			opt_max_atoms);
+    assert(pfp);
+
+    slots = pa_mmap_header(pmp, "pa16.slots", PA_TYPE_OPAQUE, 0,
+			   opt_count * sizeof(*slots));
+    assert(slots);
+}
+
+static void
+test_shut (void)
+{
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+}
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    assert(opt_filename);
+    snprintf(log_name, sizeof(log_name), "%s.log", opt_filename);
+    if (opt_clean)
+	unlink(log_name);
+
+    test_reopen();
+
+    /* Our headers are part of the first commit */
+    if (pa_mmap_commit(pmp) < 0)
+	printf("commit failed\n");
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+    char *value;
+
+    if (pa_fixed_is_null(atom)) {
+	atom = pa_fixed_alloc_atom(pfp);
+	if (pa_fixed_is_null(atom)) {
+	    printf("%u : alloc failed\n", slot);
+	    return;
+	}
+	slots[slot] = pa_fixed_atom_of(atom);
+    }
+
+    value = pa_fixed_atom_addr(pfp, atom);
+    snprintf(value, TEST_VALUE_SIZE, "%s", key);
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+static void
+test_status (void)
+{
+    struct stat st;
+
+    if (stat(opt_filename, &st) < 0)
+	st.st_size = 0;
+
+    printf("file size %lld, log %s\n", (long long) st.st_size,
+	   (access(log_name, F_OK) == 0) ? "present" : "absent");
+}
+
+static void
+test_stuck (int sig UNUSED)
+{
+    static const char msg[] = "lockcheck: stuck\n";
+
+    fflush(stdout);
+    if (write(1, msg, sizeof(msg) - 1) < 0)
+	_exit(2);
+    _exit(1);
+}
+
+/*
+ * Take and drop each lock, and read a snapshot optimistically, none
+ * of which should wait, since nobody holds the lock
+ */
+static void
+test_lockcheck (void)
+{
+    pa_mmap_t *snap;
+    uint32_t seq;
+
+    signal(SIGALRM, test_stuck);
+    alarm(TEST_LOCK_WAIT);
+
+    pa_mmap_read_lock(pmp);
+    pa_mmap_read_unlock(pmp);
+    pa_mmap_write_lock(pmp);
+    pa_mmap_write_unlock(pmp);
+
+    snap = pa_mmap_snapshot(pmp);
+    if (snap == NULL) {
+	printf("lockcheck: snapshot failed\n");
+    } else {
+	do {
+	    seq = pa_mmap_read_begin(snap);
+	} while (pa_mmap_read_retry(snap, seq));
+	pa_mmap_close(snap);
+    }
+
+    alarm(0);
+    printf("lockcheck: ok\n");
+}
+
+/*
+ * Another process may read the file, but not write it
+ */
+static void
+test_second (void)
+{
+    pa_mmap_t *other;
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+	printf("other: fork failed\n");
+	return;
+    }
+
+    if (pid == 0) {
+	other = pa_mmap_open(opt_filename, "pa16", PMF_COMMIT, 0644);
+	printf("other: open %s\n", other ? "succeeded" : "failed");
+	if (other)
+	    pa_mmap_close(other);
+
+	other = pa_mmap_open(opt_filename, "pa16",
+			     PMF_COMMIT | PMF_READ_ONLY, 0644);
+	printf("other: read-only open %s\n", other ? "succeeded" : "failed");
+	if (other)
+	    pa_mmap_close(other);
+
+	fflush(stdout);
+	fflush(stderr);
+	_exit(0);
+    }
+
+    waitpid(pid, &status, 0);
+}
+
+/*
+ * "l commit", "l prepare", "l crash" (close without committing and
+ * reopen, which is what the file sees when we're killed), "l torn"
+ * (leave half a log behind, then crash), "l forged" (prepare, change
+ * the length in the log's header, then crash), "l grow N" (grow the
+ * segment), "l locked" (commit while holding the write lock),
+ * "l lockcheck" (make sure nobody holds the lock), and "l other"
+ * (open the file from another process)
+ */
+void
+test_list (const char *key)
+{
+    unsigned count, i;
+    int fd;
+
+    if (strcmp(key, "commit") == 0) {
+	printf("commit: %s\n", (pa_mmap_commit(pmp) < 0) ? "failed" : "ok");
+	test_status();
+
+    } else if (strcmp(key, "prepare") == 0) {
+	printf("prepare: %s\n",
+	       (pa_mmap_commit_prepare(pmp) < 0) ? "failed" : "ok");
+	test_status();
+
+    } else if (strcmp(key, "crash") == 0) {
+	test_shut();
+	test_reopen();
+	printf("crash: reopened\n");
+	test_status();
+
+    } else if (strcmp(key, "torn") == 0) {
+	fd = open(log_name, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd >= 0) {
+	    char junk[100];
+	    memset(junk, 0x5a, sizeof(junk));
+	    if (write(fd, junk, sizeof(junk)) != sizeof(junk))
+		printf("torn: write failed\n");
+	    close(fd);
+	}
+
+	test_shut();
+	test_reopen();
+	printf("torn: reopened\n");
+	test_status();
+
+    } else if (strcmp(key, "forged") == 0) {
+	printf("forged: prepare %s\n",
+	       (pa_mmap_commit_prepare(pmp) < 0) ? "failed" : "ok");
+
+	/* The length follows the magic, page size, and count */
+	fd = open(log_name, O_WRONLY);
+	if (fd >= 0) {
+	    uint64_t len = TEST_FORGED_LEN;
+	    if (pwrite(fd, &len, sizeof(len), TEST_FORGED_OFFSET)
+		    != sizeof(len))
+		printf("forged: write failed\n");
+	    close(fd);
+	}
+
+	test_shut();
+	test_reopen();
+	printf("forged: reopened\n");
+	test_status();
+
+    } else if (strcmp(key, "locked") == 0) {
+	pa_mmap_write_lock(pmp);
+	test_key(opt_count - 1, "locked");
+	printf("locked: commit %s\n",
+	       (pa_mmap_commit(pmp) < 0) ? "failed" : "ok");
+	pa_mmap_write_unlock(pmp);
+
+    } else if (strcmp(key, "lockcheck") == 0) {
+	test_lockcheck();
+
+    } else if (strcmp(key, "other") == 0) {
+	test_second();
+
+    } else if (sscanf(key, "grow %u", &count) == 1) {
+	for (i = 0; i < count; i++)
+	    if (pa_mmap_is_null(pa_mmap_alloc(pmp, TEST_GROW_SIZE)))
+		printf("grow: alloc failed\n");
+	printf("grow: %u chunks\n", count);
+	test_status();
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_free (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+
+    if (pa_fixed_is_null(atom))
+	return;
+
+    pa_fixed_free_atom(pfp, atom);
+    slots[slot] = PA_NULL_ATOM;
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+void
+test_print (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+
+    if (pa_fixed_is_null(atom))
+	printf("%u : empty\n", slot);
+    else
+	printf("%u : atom %" PA_ATOM_FMT " [%s]\n",
+	       slot, pa_fixed_atom_of(atom),
+	       (char *) pa_fixed_atom_addr(pfp, atom));
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (slots[slot] != PA_NULL_ATOM)
+	    test_print(slot);
+
+    test_status();
+}
+
+void
+test_close (void)
+{
+    test_shut();
+}
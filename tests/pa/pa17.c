@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test snapshots (pa_mmap_snapshot)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_VALUE_SIZE	32	/* Size of each value (and atom) */
+#define TEST_GROW_SIZE	(1 << 16) /* Size of each "l grow" chunk */
+#define TEST_WAIT	100000	/* Time (usecs) to let a child get going */
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_atom_t *slots;		/* Atoms for each slot, in the segment */
+
+/* Our snapshot, and the view of the values thru it */
+pa_mmap_t *snap_pmp;
+pa_fixed_t *snap_pfp;
+pa_atom_t *snap_slots;
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    char log_name[PATH_MAX];
+
+    if (opt_filename && opt_clean) {
+	snprintf(log_name, sizeof(log_name), "%s.log", opt_filename);
+	unlink(log_name);
+    }
+
+    pmp = pa_mmap_open(opt_filename, "pa17", PMF_COMMIT, 0644);
+    assert(pmp);
+
+    pfp = pa_fixed_open(pmp, "pa17.values", opt_shift, TEST_VALUE_SIZE,
+			opt_max_atoms);
+    assert(pfp);
+
+    slots = pa_mmap_header(pmp, "pa17.slots", PA_TYPE_OPAQUE, 0,
+			   opt_count * sizeof(*slots));
+    assert(slots);
+
+    if (pa_mmap_commit(pmp) < 0)
+	printf("commit failed\n");
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+void
+test_key (unsigned slot, const char *key)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+    char *value;
+
+    if (pa_fixed_is_null(atom)) {
+	atom = pa_fixed_alloc_atom(pfp);
+	if (pa_fixed_is_null(atom)) {
+	    printf("%u : alloc failed\n", slot);
+	    return;
+	}
+	slots[slot] = pa_fixed_atom_of(atom);
+    }
+
+    value = pa_fixed_atom_addr(pfp, atom);
+    snprintf(value, TEST_VALUE_SIZE, "%s", key);
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+static void
+test_unsnap (void)
+{
+    if (snap_pmp == NULL)
+	return;
+
+    pa_fixed_close(snap_pfp);
+    pa_mmap_close(snap_pmp);
+    snap_pmp = NULL;
+    snap_pfp = NULL;
+    snap_slots = NULL;
+}
+
+static int
+test_snap (void)
+{
+    test_unsnap();
+
+    snap_pmp = pa_mmap_snapshot(pmp);
+    if (snap_pmp == NULL)
+	return -1;
+
+    snap_pfp = pa_fixed_open(snap_pmp, "pa17.values", opt_shift,
+			     TEST_VALUE_SIZE, opt_max_atoms);
+    snap_slots = pa_mmap_header(snap_pmp, "pa17.slots", 0, 0, 0);
+    assert(snap_pfp && snap_slots);
+    return 0;
+}
+
+/*
+ * A child process rewrites a value in two steps under the write
+ * lock while we take a snapshot, which should see only the result.
+ * The lock of a PMF_COMMIT segment isn't shared with children, so
+ * this wants an anonymous segment.
+ */
+static void
+test_busy (unsigned slot)
+{
+    pa_fixed_atom_t atom;
+    char *value;
+    int status;
+    pid_t pid;
+
+    if (slot >= opt_count || slots[slot] == PA_NULL_ATOM) {
+	printf("busy: bad slot %u\n", slot);
+	return;
+    }
+
+    atom = pa_fixed_atom(slots[slot]);
+    value = pa_fixed_atom_addr(pfp, atom);
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid = fork();
+    if (pid < 0) {
+	printf("busy: fork failed\n");
+	return;
+    }
+
+    if (pid == 0) {
+	pa_mmap_write_lock(pmp);
+	snprintf(value, TEST_VALUE_SIZE, "half");
+	usleep(2 * TEST_WAIT);
+	snprintf(value, TEST_VALUE_SIZE, "whole");
+	pa_mmap_write_unlock(pmp);
+	_exit(0);
+    }
+
+    usleep(TEST_WAIT);
+    if (test_snap() < 0)
+	printf("busy: snap failed\n");
+    else
+	printf("busy: snapshot saw [%s]\n",
+	       (char *) pa_fixed_atom_addr(snap_pfp, atom));
+
+    waitpid(pid, &status, 0);
+}
+
+/*
+ * "l snap" takes a snapshot (replacing any earlier one), "l unsnap"
+ * drops it, "l commit" commits, "l grow N" grows the segment, and
+ * "l busy N" takes a snapshot while another process rewrites slot N
+ */
+void
+test_list (const char *key)
+{
+    unsigned count, i, slot;
+
+    if (strcmp(key, "snap") == 0) {
+	if (test_snap() < 0) {
+	    printf("snap: failed\n");
+	    return;
+	}
+
+	printf("snap: ok\n");
+
+    } else if (strcmp(key, "unsnap") == 0) {
+	test_unsnap();
+	printf("unsnap: ok\n");
+
+    } else if (strcmp(key, "commit") == 0) {
+	printf("commit: %s\n", (pa_mmap_commit(pmp) < 0) ? "failed" : "ok");
+
+    } else if (sscanf(key, "busy %u", &slot) == 1) {
+	test_busy(slot);
+
+    } else if (sscanf(key, "grow %u", &count) == 1) {
+	for (i = 0; i < count; i++)
+	    if (pa_mmap_is_null(pa_mmap_alloc(pmp, TEST_GROW_SIZE)))
+		printf("grow: alloc failed\n");
+	printf("grow: %u chunks\n", count);
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_free (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+
+    if (pa_fixed_is_null(atom))
+	return;
+
+    pa_fixed_free_atom(pfp, atom);
+    slots[slot] = PA_NULL_ATOM;
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+static void
+test_print_one (const char *tag, pa_fixed_t *fp, pa_atom_t *sp,
+		unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(sp[slot]);
+
+    if (pa_fixed_is_null(atom))
+	printf("%s%u : empty\n", tag, slot);
+    else
+	printf("%s%u : atom %" PA_ATOM_FMT " [%s]\n",
+	       tag, slot, pa_fixed_atom_of(atom),
+	       (char *) pa_fixed_atom_addr(fp, atom));
+}
+
+void
+test_print (unsigned slot)
+{
+    test_print_one("", pfp, slots, slot);
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (slots[slot] != PA_NULL_ATOM)
+	    test_print_one("live ", pfp, slots, slot);
+
+    if (snap_pmp == NULL)
+	return;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (snap_slots[slot] != PA_NULL_ATOM)
+	    test_print_one("snap ", snap_pfp, snap_slots, slot);
+}
+
+void
+test_close (void)
+{
+    test_unsnap();
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+}
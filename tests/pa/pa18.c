@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test offline compaction (pa_compact)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/pacompact.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_TEXT_SIZE	64	/* Room for each text value */
+#define TEST_JUNK_SIZE	200	/* Size of each "l junk" chunk */
+
+/*
+ * A record in our fixed table, referring to the other tables
+ */
+typedef struct test_rec_s {
+    pa_atom_t tr_name;		/* Name (in pa18.names) */
+    pa_atom_t tr_text;		/* Text (in pa18.text) */
+    pa_atom_t tr_next;		/* Another record (in pa18.recs) */
+} test_rec_t;
+
+/* Tables in our type map */
+#define TEST_NAMES	0
+#define TEST_INDEX	1
+#define TEST_TEXT	2
+#define TEST_RECS	3
+#define TEST_SLOTS	4
+
+pa_mmap_t *pmp;
+pa_istr_t *names;
+pa_pat_t *names_index;
+pa_arb_t *text;
+pa_fixed_t *recs;
+pa_atom_t *slots;		/* Records for each slot, in the segment */
+char new_name[PATH_MAX];
+const char *cur_name;		/* The file we have open */
+
+/*
+ * Our slots are an opaque array of record atoms
+ */
+static void
+test_fixup_slots (pa_compact_t *pcp, unsigned table UNUSED,
+		  void *data, size_t size)
+{
+    pa_atom_t *ap = data;
+    unsigned i;
+
+    for (i = 0; i < size / sizeof(*ap); i++)
+	ap[i] = pa_compact_map(pcp, TEST_RECS, ap[i]);
+}
+
+static const pa_compact_type_t test_map[] = {
+    [TEST_NAMES] = {
+	.pct_name = "pa18.names",
+	.pct_type = PA_TYPE_ISTR,
+    },
+    [TEST_INDEX] = {
+	.pct_name = "pa18.index",
+	.pct_type = PA_TYPE_PAT,
+	.pct_data = TEST_NAMES,
+	.pct_key_func = pa_pat_istr_key_func,
+    },
+    [TEST_TEXT] = {
+	.pct_name = "pa18.text",
+	.pct_type = PA_TYPE_ARB,
+    },
+    [TEST_RECS] = {
+	.pct_name = "pa18.recs",
+	.pct_type = PA_TYPE_FIXED,
+	.pct_nfields = 3,
+	.pct_fields = {
+	    { offsetof(test_rec_t, tr_name), TEST_NAMES },
+	    { offsetof(test_rec_t, tr_text), TEST_TEXT },
+	    { offsetof(test_rec_t, tr_next), TEST_RECS },
+	},
+    },
+    [TEST_SLOTS] = {
+	.pct_name = "pa18.slots",
+	.pct_type = PA_TYPE_OPAQUE,
+	.pct_fixup = test_fixup_slots,
+    },
+    { .pct_name = NULL },
+};
+
+static void
+test_reopen (const char *filename)
+{
+    pmp = pa_mmap_open(filename, "pa18", 0, 0644);
+    assert(pmp);
+
+    names = pa_istr_open(pmp, "pa18.names", opt_shift, 2, opt_max_atoms);
+    assert(names);
+
+    names_index = pa_pat_open(pmp, "pa18.index", names, pa_pat_istr_key_func,
+			      PA_PAT_MAXKEY, opt_shift, opt_max_atoms);
+    assert(names_index);
+
+    text = pa_arb_open(pmp, "pa18.text");
+    assert(text);
+
+    recs = pa_fixed_open(pmp, "pa18.recs", opt_shift, sizeof(test_rec_t),
+			 opt_max_atoms);
+    assert(recs);
+
+    slots = pa_mmap_header(pmp, "pa18.slots", PA_TYPE_OPAQUE, 0,
+			   opt_count * sizeof(*slots));
+    assert(slots);
+}
+
+static void
+test_shut (void)
+{
+    pa_fixed_close(recs);
+    pa_arb_close(text);
+    pa_fixed_close(names_index->pp_nodes);
+    pa_pat_close(names_index);
+    pa_istr_close(names);
+    pa_mmap_close(pmp);
+}
+
+void
+test_init (void)
+{
+    return;
+}
+
+void
+test_open (void)
+{
+    assert(opt_filename);
+    snprintf(new_name, sizeof(new_name), "%s.new", opt_filename);
+
+    cur_name = opt_filename;
+    test_reopen(cur_name);
+}
+
+void
+test_alloc (unsigned slot UNUSED, unsigned this_size UNUSED)
+{
+    return;
+}
+
+/*
+ * Each record gets an interned name, a copy of the key as text, and
+ * points at the record of the slot before it
+ */
+void
+test_key (unsigned slot, const char *key)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+    pa_istr_atom_t name;
+    pa_arb_atom_t tatom;
+    test_rec_t *trp;
+    char *cp;
+
+    if (pa_fixed_is_null(atom)) {
+	atom = pa_fixed_alloc_atom(recs);
+	if (pa_fixed_is_null(atom)) {
+	    printf("%u : alloc failed\n", slot);
+	    return;
+	}
+	slots[slot] = pa_fixed_atom_of(atom);
+    }
+
+    trp = pa_fixed_atom_addr(recs, atom);
+
+    name = pa_istr_intern(names, key);
+    if (pa_pat_data_is_null(pa_pat_get_atom(names_index, strlen(key) + 1,
+					    key)))
+	pa_pat_add(names_index, pa_pat_data_atom(pa_istr_atom_of(name)),
+		   strlen(key) + 1);
+
+    tatom = pa_arb_alloc(text, TEST_TEXT_SIZE);
+    cp = pa_arb_atom_addr(text, tatom);
+    snprintf(cp, TEST_TEXT_SIZE, "text of %s", key);
+
+    trp->tr_name = pa_istr_atom_of(name);
+    trp->tr_text = pa_arb_atom_of(tatom);
+    trp->tr_next = slot ? slots[slot - 1] : PA_NULL_ATOM;
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+/*
+ * "l junk N" leaves N unreferenced text chunks behind; "l compact"
+ * compacts the file and reopens the new one (we flip between two
+ * files)
+ */
+void
+test_list (const char *key)
+{
+    pa_compact_stats_t *pcsp;
+    pa_compact_t *pcp;
+    const char *to;
+    unsigned count, i;
+
+    if (sscanf(key, "junk %u", &count) == 1) {
+	for (i = 0; i < count; i++)
+	    if (pa_arb_is_null(pa_arb_alloc(text, TEST_JUNK_SIZE)))
+		printf("junk: alloc failed\n");
+	printf("junk: %u chunks\n", count);
+
+    } else if (strcmp(key, "compact") == 0) {
+	pa_mmap_commit(pmp);
+
+	to = (cur_name == opt_filename) ? new_name : opt_filename;
+	pcp = pa_compact(cur_name, to, test_map);
+	if (pcp == NULL) {
+	    printf("compact: failed\n");
+	    return;
+	}
+
+	for (i = 0; i <= TEST_SLOTS; i++) {
+	    pcsp = pa_compact_stats(pcp, i);
+	    printf("compact: %s: live %llu, dropped %llu, renumbered %llu\n",
+		   test_map[i].pct_name,
+		   (unsigned long long) pcsp->pcs_live,
+		   (unsigned long long) pcsp->pcs_dropped,
+		   (unsigned long long) pcsp->pcs_renumbered);
+	}
+
+	printf("compact: dangling %llu, dropped headers %u, size %zu -> %zu\n",
+	       (unsigned long long) pcp->pc_dangling, pcp->pc_dropped_headers,
+	       pcp->pc_old_size, pcp->pc_new_size);
+	pa_compact_close(pcp);
+
+	test_shut();
+	cur_name = to;
+	test_reopen(cur_name);
+	printf("compact: reopened\n");
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_free (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+    test_rec_t *trp;
+
+    if (pa_fixed_is_null(atom))
+	return;
+
+    trp = pa_fixed_atom_addr(recs, atom);
+    pa_arb_free_atom(text, pa_arb_atom(trp->tr_text));
+    pa_fixed_free_atom(recs, atom);
+    slots[slot] = PA_NULL_ATOM;
+
+    if (!opt_quiet)
+	test_print(slot);
+}
+
+void
+test_print (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(slots[slot]);
+    test_rec_t *trp;
+    const char *name;
+
+    if (pa_fixed_is_null(atom)) {
+	printf("%u : empty\n", slot);
+	return;
+    }
+
+    trp = pa_fixed_atom_addr(recs, atom);
+    name = pa_istr_atom_string(names, pa_istr_atom(trp->tr_name));
+
+    printf("%u : atom %" PA_ATOM_FMT " name %" PA_ATOM_FMT
+	   " [%s] text [%s] next %" PA_ATOM_FMT " index %s\n",
+	   slot, pa_fixed_atom_of(atom), trp->tr_name, name ?: "",
+	   (char *) pa_arb_atom_addr(text, pa_arb_atom(trp->tr_text)),
+	   trp->tr_next,
+	   (name && pa_pat_data_atom_of(pa_pat_get_atom(names_index,
+				strlen(name) + 1, name)) == trp->tr_name)
+	   ? "ok" : "missing");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    for (slot = 0; slot < opt_count; slot++)
+	if (slots[slot] != PA_NULL_ATOM)
+	    test_print(slot);
+}
+
+void
+test_close (void)
+{
+    test_shut();
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test page reclamation in pa_fixed (PFF_RECLAIM)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_atom_t *atoms;		/* Atom for each slot */
+
+static void
+test_reopen (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa19", 0, 0644);
+    assert(pmp != NULL);
+
+    pfp = pa_fixed_open(pmp, "pa19", opt_shift, opt_size, opt_max_atoms);
+    assert(pfp != NULL);
+}
+
+void
+test_init (void)
+{
+    atoms = psu_calloc(opt_count * sizeof(*atoms));
+    assert(atoms);
+}
+
+void
+test_open (void)
+{
+    test_reopen();
+}
+
+static void
+test_stats (const char *what)
+{
+    pa_fixed_reclaim_t *pfrp = pfp->pf_reclaim;
+    unsigned bin;
+
+    if (pfrp == NULL) {
+	printf("%s: no reclaim\n", what);
+	return;
+    }
+
+    printf("%s: pages %u, released %u, hint %u, bins [", what,
+	   pfrp->pfr_pages, pfrp->pfr_released, pfrp->pfr_hint);
+    for (bin = 0; bin < PA_FIXED_RECLAIM_BINS; bin++) {
+	if (pfrp->pfr_bins[bin] == PA_FIXED_NO_PAGE)
+	    printf("%s-", bin ? " " : "");
+	else
+	    printf("%s%u", bin ? " " : "", pfrp->pfr_bins[bin]);
+    }
+    printf("]\n");
+}
+
+void
+test_alloc (unsigned slot, unsigned size UNUSED)
+{
+    pa_fixed_atom_t atom = pa_fixed_alloc_atom(pfp);
+    test_t *tp = pa_fixed_atom_addr(pfp, atom);
+
+    atoms[slot] = pa_fixed_atom_of(atom);
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_id = pa_fixed_atom_of(atom);
+	tp->t_slot = slot;
+    }
+
+    if (!opt_quiet)
+	printf("in %u : %" PA_ATOM_FMT " (page %" PA_ATOM_FMT ")\n",
+	       slot, atoms[slot], atoms[slot] >> pfp->pf_shift);
+}
+
+void
+test_free (unsigned slot)
+{
+    pa_fixed_atom_t atom = pa_fixed_atom(atoms[slot]);
+
+    if (pa_fixed_is_null(atom))
+	return;
+
+    pa_fixed_free_atom(pfp, atom);
+    atoms[slot] = PA_NULL_ATOM;
+
+    if (!opt_quiet)
+	printf("free %u : %" PA_ATOM_FMT "\n",
+	       slot, pa_fixed_atom_of(atom));
+}
+
+void
+test_key (unsigned slot UNUSED, const char *key UNUSED)
+{
+    return;
+}
+
+/*
+ * "l reclaim" enables PFF_RECLAIM, "l stats" shows the accounting,
+ * "l reopen" closes and reopens the file, and "l alloc N M" / "l free
+ * N M" work on slots N thru M (quietly)
+ */
+void
+test_list (const char *key)
+{
+    unsigned lo, hi, slot;
+    int quiet = opt_quiet;
+
+    if (strcmp(key, "reclaim") == 0) {
+	if (pa_fixed_reclaim_enable(pfp))
+	    printf("reclaim: failed\n");
+	test_stats("reclaim");
+
+    } else if (strcmp(key, "stats") == 0) {
+	test_stats("stats");
+
+    } else if (strcmp(key, "reopen") == 0) {
+	pa_fixed_close(pfp);
+	pa_mmap_close(pmp);
+	test_reopen();
+	test_stats("reopen");
+
+    } else if (sscanf(key, "alloc %u %u", &lo, &hi) == 2 && hi < opt_count) {
+	opt_quiet = 1;
+	for (slot = lo; slot <= hi; slot++)
+	    test_alloc(slot, opt_size);
+	opt_quiet = quiet;
+	test_stats("alloc");
+
+    } else if (sscanf(key, "free %u %u", &lo, &hi) == 2 && hi < opt_count) {
+	opt_quiet = 1;
+	for (slot = lo; slot <= hi; slot++)
+	    test_free(slot);
+	opt_quiet = quiet;
+	test_stats("free");
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = pa_fixed_atom_addr(pfp, pa_fixed_atom(atoms[slot]));
+
+    if (tp == NULL)
+	return;
+
+    printf("%u : %" PA_ATOM_FMT "%s%s\n", slot, atoms[slot],
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    printf("dumping: (%u)\n", opt_count);
+    for (slot = 0; slot < opt_count; slot++)
+	test_print(slot);
+}
+
+void
+test_close (void)
+{
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test batch allocation (pa_fixed_alloc_atoms() and friends)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+
+#define NEED_KEY
+#include "pamain.h"
+
+#define TEST_ARB_MAX	64	/* Most arb chunks per "l arb" */
+
+pa_mmap_t *pmp;
+pa_fixed_t *pfp;
+pa_arb_t *prp;
+pa_fixed_atom_t *atoms;		/* Atom for each slot */
+
+void
+test_init (void)
+{
+    atoms = psu_calloc(opt_count * sizeof(*atoms));
+    assert(atoms);
+}
+
+void
+test_open (void)
+{
+    pmp = pa_mmap_open(opt_filename, "pa20", 0, 0644);
+    assert(pmp != NULL);
+
+    pfp = pa_fixed_open(pmp, "pa20.fixed", opt_shift, opt_size,
+			opt_max_atoms);
+    assert(pfp != NULL);
+
+    prp = pa_arb_open(pmp, "pa20.arb");
+    assert(prp != NULL);
+}
+
+static void
+test_fill (unsigned slot)
+{
+    test_t *tp = pa_fixed_atom_addr(pfp, atoms[slot]);
+
+    if (tp) {
+	tp->t_magic = opt_magic;
+	tp->t_id = pa_fixed_atom_of(atoms[slot]);
+	tp->t_slot = slot;
+    }
+}
+
+void
+test_alloc (unsigned slot, unsigned size UNUSED)
+{
+    atoms[slot] = pa_fixed_alloc_atom(pfp);
+    test_fill(slot);
+
+    if (!opt_quiet)
+	printf("in %u : %" PA_ATOM_FMT "\n",
+	       slot, pa_fixed_atom_of(atoms[slot]));
+}
+
+void
+test_free (unsigned slot)
+{
+    if (pa_fixed_is_null(atoms[slot]))
+	return;
+
+    pa_fixed_free_atom(pfp, atoms[slot]);
+    atoms[slot] = pa_fixed_null_atom();
+
+    if (!opt_quiet)
+	printf("free %u\n", slot);
+}
+
+void
+test_key (unsigned slot UNUSED, const char *key UNUSED)
+{
+    return;
+}
+
+/* Show a range of slots on one line */
+static void
+test_show (const char *what, unsigned lo, unsigned hi, unsigned count)
+{
+    unsigned slot;
+
+    printf("%s %u-%u: %u [", what, lo, hi, count);
+    for (slot = lo; slot <= hi; slot++)
+	printf("%s%" PA_ATOM_FMT, (slot == lo) ? "" : " ",
+	       pa_fixed_atom_of(atoms[slot]));
+    printf("]\n");
+}
+
+/*
+ * "l batch N M" and "l run N M" allocate slots N thru M,
+ * "l free N M" frees them, and "l arb SIZE COUNT" allocates (and then
+ * frees) a batch of arb chunks
+ */
+void
+test_list (const char *key)
+{
+    pa_arb_atom_t arb[TEST_ARB_MAX];
+    pa_fixed_atom_t atom;
+    unsigned lo, hi, slot, count, size, i, same;
+
+    if (sscanf(key, "batch %u %u", &lo, &hi) == 2
+	    && lo <= hi && hi < opt_count) {
+	count = pa_fixed_alloc_atoms(pfp, &atoms[lo], hi - lo + 1);
+	for (slot = lo; slot < lo + count; slot++)
+	    test_fill(slot);
+	test_show("batch", lo, hi, count);
+
+    } else if (sscanf(key, "run %u %u", &lo, &hi) == 2
+	       && lo <= hi && hi < opt_count) {
+	atom = pa_fixed_alloc_run(pfp, hi - lo + 1);
+	if (pa_fixed_is_null(atom)) {
+	    printf("run %u-%u: none\n", lo, hi);
+	    return;
+	}
+
+	for (slot = lo; slot <= hi; slot++) {
+	    atoms[slot] = pa_fixed_atom(pa_fixed_atom_of(atom) + slot - lo);
+	    test_fill(slot);
+	}
+	test_show("run", lo, hi, hi - lo + 1);
+
+    } else if (sscanf(key, "free %u %u", &lo, &hi) == 2
+	       && lo <= hi && hi < opt_count) {
+	pa_fixed_free_atoms(pfp, &atoms[lo], hi - lo + 1);
+	for (slot = lo; slot <= hi; slot++)
+	    atoms[slot] = pa_fixed_null_atom();
+	printf("free %u-%u\n", lo, hi);
+
+    } else if (sscanf(key, "arb %u %u", &size, &count) == 2
+	       && count <= TEST_ARB_MAX) {
+	count = pa_arb_alloc_atoms(prp, size, arb, count);
+
+	/* Count the chunks that follow the one before them */
+	for (i = 0, same = 0; i < count; i++) {
+	    memset(pa_arb_atom_addr(prp, arb[i]), 'x', size);
+	    if (i > 0 && pa_arb_atom_of(arb[i]) > pa_arb_atom_of(arb[i - 1]))
+		same += 1;
+	}
+
+	printf("arb %u: %u allocated, %u ascending\n", size, count, same);
+	for (i = 0; i < count; i++)
+	    pa_arb_free_atom(prp, arb[i]);
+
+    } else {
+	printf("bad list: %s\n", key);
+    }
+}
+
+void
+test_print (unsigned slot)
+{
+    test_t *tp = pa_fixed_atom_addr(pfp, atoms[slot]);
+
+    if (tp == NULL)
+	return;
+
+    printf("%u : %" PA_ATOM_FMT "%s%s\n", slot, pa_fixed_atom_of(atoms[slot]),
+	   (tp->t_magic != opt_magic) ? " bad-magic" : "",
+	   (tp->t_slot != slot) ? " bad-slot" : "");
+}
+
+void
+test_dump (void)
+{
+    unsigned slot;
+
+    printf("dumping: (%u)\n", opt_count);
+    for (slot = 0; slot < opt_count; slot++)
+	test_print(slot);
+}
+
+void
+test_close (void)
+{
+    pa_arb_close(prp);
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+}
@@ -0,0 +1,1778 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Benchmarks for parrotdb.  These aren't regression tests (timings
+ * vary too much to be compared against saved output); run them by
+ * hand, or via "make bench":
+ *
+ *     pabench [threads] [nthreads N] [count N] [batch N]
+ *     pabench strings file.xml ...
+ *     pabench intern [count N] [unique N]
+ *     pabench trie [count N]
+ *     pabench bulk [count N]
+ *     pabench hash [count N]
+ *     pabench btree [count N]
+ *     pabench bitmap
+ *     pabench roar
+ *     pabench lock [count N]
+ *     pabench snapshot [count N]
+ *     pabench compact [count N]
+ *     pabench atoms [count N]
+ *     pabench reclaim [count N]
+ *     pabench refill [count N] [batch N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stddef.h>
+#include <time.h>
+#include <ctype.h>
+#include <fcntl.h>
+
+#include <parrotdb/pacommon.h>
+#include <parrotdb/paconfig.h>
+#include <parrotdb/pammap.h>
+#include <parrotdb/pafixed.h>
+#include <parrotdb/paarb.h>
+#include <parrotdb/paistr.h>
+#include <parrotdb/papat.h>
+#include <parrotdb/patrie.h>
+#include <parrotdb/pahash.h>
+#include <parrotdb/pabtree.h>
+#include <parrotdb/pabitmap.h>
+#include <parrotdb/paroar.h>
+#include <parrotdb/pathread.h>
+#include <parrotdb/pacompact.h>
+#include <libpsu/psulog.h>
+
+unsigned opt_threads = 8;
+unsigned opt_count = 1000000;
+unsigned opt_batch = 64;
+unsigned opt_unique = 100000;
+char **opt_files;		/* Input files (NULL terminated) */
+
+static double
+bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef HAVE_PTHREAD_H
+
+typedef struct bench_thread_s {
+    pthread_t bt_thread;	/* Our thread */
+    pa_fixed_t *bt_fixed;	/* Fixed pool under test (or NULL) */
+    pa_arb_t *bt_arb;		/* Arb pool under test (or NULL) */
+    unsigned bt_count;		/* Number of alloc/free pairs */
+    unsigned bt_id;		/* Thread number */
+} bench_thread_t;
+
+/*
+ * Allocate a batch of atoms, touch them, and free them, until we've
+ * done our share of the work.
+ */
+static void *
+bench_thread_main (void *arg)
+{
+    bench_thread_t *btp = arg;
+    pa_atom_t atoms[opt_batch];
+    unsigned done, i;
+
+    for (done = 0; done < btp->bt_count; done += opt_batch) {
+	for (i = 0; i < opt_batch; i++) {
+	    if (btp->bt_fixed) {
+		pa_fixed_atom_t fa = pa_fixed_alloc_atom(btp->bt_fixed);
+		uint32_t *up = pa_fixed_atom_addr(btp->bt_fixed, fa);
+		assert(up);
+		*up = btp->bt_id;
+		atoms[i] = pa_fixed_atom_of(fa);
+	    } else {
+		/* Vary the size, so we use several slots */
+		pa_arb_atom_t aa = pa_arb_alloc(btp->bt_arb, 16 << (i & 3));
+		uint32_t *up = pa_arb_atom_addr(btp->bt_arb, aa);
+		assert(up);
+		*up = btp->bt_id;
+		atoms[i] = pa_arb_atom_of(aa);
+	    }
+	}
+
+	for (i = 0; i < opt_batch; i++) {
+	    if (btp->bt_fixed)
+		pa_fixed_free_atom(btp->bt_fixed, pa_fixed_atom(atoms[i]));
+	    else
+		pa_arb_free_atom(btp->bt_arb, pa_arb_atom(atoms[i]));
+	}
+    }
+
+    if (btp->bt_fixed)
+	pa_fixed_flush(btp->bt_fixed);
+    else
+	pa_arb_flush(btp->bt_arb);
+
+    return NULL;
+}
+
+static double
+bench_threads_run (const char *kind, pa_mmap_flags_t flags, unsigned nthreads)
+{
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", flags, 0);
+    assert(pmp);
+
+    pa_fixed_t *pfp = NULL;
+    pa_arb_t *prp = NULL;
+
+    if (strcmp(kind, "fixed") == 0) {
+	pfp = pa_fixed_open(pmp, "pabench.fixed", 10, 32, 1 << 20);
+	assert(pfp);
+    } else {
+	prp = pa_arb_open(pmp, "pabench.arb");
+	assert(prp);
+    }
+
+    bench_thread_t threads[nthreads];
+    unsigned i;
+    double start = bench_now();
+
+    for (i = 0; i < nthreads; i++) {
+	threads[i].bt_fixed = pfp;
+	threads[i].bt_arb = prp;
+	threads[i].bt_count = opt_count / nthreads;
+	threads[i].bt_id = i;
+	pthread_create(&threads[i].bt_thread, NULL, bench_thread_main,
+		       &threads[i]);
+    }
+
+    for (i = 0; i < nthreads; i++)
+	pthread_join(threads[i].bt_thread, NULL);
+
+    double secs = bench_now() - start;
+
+    if (pfp)
+	pa_fixed_close(pfp);
+    if (prp)
+	pa_arb_close(prp);
+    pa_mmap_close(pmp);
+
+    return secs;
+}
+
+static void
+bench_threads (void)
+{
+    static const char *kinds[] = { "fixed", "arb", NULL };
+    const char **kp;
+    unsigned n;
+    double secs, base;
+
+    printf("threads: %u alloc/free pairs, batches of %u\n",
+	   opt_count, opt_batch);
+
+    for (kp = kinds; *kp; kp++) {
+	secs = bench_threads_run(*kp, 0, 1);
+	printf("  %-5s unlocked  1 thread : %7.3f Mops/s\n",
+	       *kp, opt_count / secs / 1e6);
+
+	base = 0;
+	for (n = 1; n <= opt_threads; n *= 2) {
+	    secs = bench_threads_run(*kp, PMF_THREAD_SAFE, n);
+	    if (base == 0)
+		base = secs;
+	    printf("  %-5s safe     %2u threads: %7.3f Mops/s (%.2fx)\n",
+		   *kp, n, opt_count / secs / 1e6, base / secs);
+	}
+    }
+}
+
+#else /* HAVE_PTHREAD_H */
+
+static void
+bench_threads (void)
+{
+    printf("threads: not supported on this platform\n");
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+typedef struct bench_strings_s {
+    unsigned bs_count;		/* Number of strings */
+    size_t bs_bytes;		/* Bytes requested (with NUL) */
+    size_t bs_pow2;		/* Bytes used with power-of-two chunks */
+    size_t bs_used;		/* Bytes used with our size classes */
+} bench_strings_t;
+
+/*
+ * Store a string in the pool, the way xi_parse does, and add up
+ * what it cost, both with our size classes and with the power-of-two
+ * chunks that pa_arb used to use.
+ */
+static void
+bench_strings_store (pa_arb_t *prp, bench_strings_t *bsp,
+		     const char *data, size_t len)
+{
+    pa_arb_atom_t atom = pa_arb_alloc(prp, len + 1);
+    char *cp = pa_arb_atom_addr(prp, atom);
+    assert(cp);
+
+    memcpy(cp, data, len);
+    cp[len] = '\0';
+
+    size_t full_size = len + 1 + sizeof(pa_arb_header_t);
+    size_t pow2 = 1 << PA_ARB_ATOM_SHIFT;
+    while (pow2 < full_size)
+	pow2 <<= 1;
+
+    bsp->bs_count += 1;
+    bsp->bs_bytes += len + 1;
+    bsp->bs_pow2 += pow2;
+    bsp->bs_used += pa_arb_atom_size(prp, atom) + sizeof(pa_arb_header_t);
+}
+
+/*
+ * Pull the strings that would land in xw_textpool out of an XML
+ * document: the attribute text of each start tag, and each text
+ * node that isn't just whitespace.  We're not a real parser, but
+ * this is close enough to size the strings.
+ */
+static void
+bench_strings_file (pa_arb_t *prp, bench_strings_t *bsp, const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    if (fp == NULL) {
+	fprintf(stderr, "could not open '%s'\n", file);
+	return;
+    }
+
+    char *buf = NULL;
+    size_t size = 0, len = 0;
+    int ch;
+
+    while ((ch = getc(fp)) != EOF) {
+	if (len + 1 >= size) {
+	    size = size ? size * 2 : BUFSIZ;
+	    buf = realloc(buf, size);
+	    assert(buf);
+	}
+	buf[len++] = ch;
+    }
+    fclose(fp);
+
+    char *cp, *start, *end = buf + len;
+
+    for (cp = buf; cp < end; ) {
+	if (*cp != '<') {
+	    /* Text node */
+	    for (start = cp; cp < end && *cp != '<'; cp++)
+		continue;
+
+	    char *tp;
+	    for (tp = start; tp < cp; tp++)
+		if (!isspace((int) *tp))
+		    break;
+	    if (tp < cp)
+		bench_strings_store(prp, bsp, start, cp - start);
+	    continue;
+	}
+
+	/* Skip end tags, comments, PIs and DTD bits */
+	if (cp + 1 < end && (cp[1] == '/' || cp[1] == '!' || cp[1] == '?')) {
+	    while (cp < end && *cp != '>')
+		cp++;
+	    cp++;
+	    continue;
+	}
+
+	/* Skip the element name, then store the attributes */
+	for (cp++; cp < end && !isspace((int) *cp) && *cp != '>'
+		 && *cp != '/'; cp++)
+	    continue;
+	while (cp < end && isspace((int) *cp))
+	    cp++;
+	for (start = cp; cp < end && *cp != '>'; cp++)
+	    continue;
+
+	char *ep = cp;
+	if (ep > start && ep[-1] == '/')
+	    ep -= 1;
+	while (ep > start && isspace((int) ep[-1]))
+	    ep -= 1;
+	if (ep > start)
+	    bench_strings_store(prp, bsp, start, ep - start);
+	cp++;
+    }
+
+    free(buf);
+}
+
+static void
+bench_strings (void)
+{
+    bench_strings_t bs;
+    char **fpp;
+
+    if (opt_files == NULL) {
+	printf("strings: no input files\n");
+	return;
+    }
+
+    bzero(&bs, sizeof(bs));
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_arb_t *prp = pa_arb_open(pmp, "pabench.strings");
+    assert(prp);
+
+    for (fpp = opt_files; *fpp; fpp++)
+	bench_strings_file(prp, &bs, *fpp);
+
+    if (bs.bs_count) {
+	printf("strings: %u strings, %.1f bytes each (with NUL)\n",
+	       bs.bs_count, (double) bs.bs_bytes / bs.bs_count);
+	printf("  power-of-two: %7.1f bytes per string (%.1f%% overhead)\n",
+	       (double) bs.bs_pow2 / bs.bs_count,
+	       100.0 * (bs.bs_pow2 - bs.bs_bytes) / bs.bs_bytes);
+	printf("  size classes: %7.1f bytes per string (%.1f%% overhead)\n",
+	       (double) bs.bs_used / bs.bs_count,
+	       100.0 * (bs.bs_used - bs.bs_bytes) / bs.bs_bytes);
+    }
+
+    pa_arb_close(prp);
+    pa_mmap_close(pmp);
+}
+
+#define BENCH_SHIFT	12	/* Page shift for our pa_istr and pa_pat */
+#define BENCH_MAX_ATOMS	(1 << 26)
+
+/*
+ * Build the list of keys for the intern benchmark: opt_count keys,
+ * drawn from opt_unique distinct names
+ */
+static char **
+bench_intern_keys (void)
+{
+    char **keys = calloc(opt_count, sizeof(*keys));
+    char buf[64];
+    unsigned i;
+
+    assert(keys);
+    srandom(opt_unique);
+
+    for (i = 0; i < opt_count; i++) {
+	snprintf(buf, sizeof(buf), "name-%lu", random() % opt_unique);
+	keys[i] = strdup(buf);
+	assert(keys[i]);
+    }
+
+    return keys;
+}
+
+/*
+ * Intern strings, first using the patricia tree (as xi_namepool_atom
+ * does) and then the pa_istr hash index
+ */
+static void
+bench_intern (void)
+{
+    char **keys = bench_intern_keys();
+    unsigned i;
+    double start, secs;
+
+    printf("intern: %u lookups of %u unique names\n", opt_count, opt_unique);
+
+    /* Patricia tree on top of pa_istr */
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_istr_t *pip = pa_istr_open(pmp, "pabench.pat-names", BENCH_SHIFT,
+				  2, BENCH_MAX_ATOMS);
+    assert(pip);
+    pa_pat_t *ppp = pa_pat_open(pmp, "pabench.pat", pip,
+				pa_pat_istr_key_func, PA_PAT_MAXKEY,
+				BENCH_SHIFT, BENCH_MAX_ATOMS);
+    assert(ppp);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	uint16_t len = strlen(keys[i]) + 1;
+	pa_pat_data_atom_t datom = pa_pat_get_atom(ppp, len, keys[i]);
+	if (pa_pat_data_is_null(datom)) {
+	    pa_istr_atom_t iatom = pa_istr_string(pip, keys[i]);
+	    datom = pa_pat_data_atom(pa_istr_atom_of(iatom));
+	    pa_pat_add(ppp, datom, len);
+	}
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat + pa_istr:  %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+
+    /* pa_istr hash index */
+    pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pip = pa_istr_open(pmp, "pabench.names", BENCH_SHIFT, 2,
+		       BENCH_MAX_ATOMS);
+    assert(pip);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++)
+	pa_istr_intern(pip, keys[i]);
+    secs = bench_now() - start;
+    printf("  pa_istr_intern:    %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++)
+	pa_istr_find(pip, keys[i]);
+    secs = bench_now() - start;
+    printf("  pa_istr_find:      %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+
+    for (i = 0; i < opt_count; i++)
+	free(keys[i]);
+    free(keys);
+}
+
+/*
+ * Make a long-ish key that looks like the ones we really store:
+ * namespace URIs and configuration paths
+ */
+static void
+bench_trie_key (char *buf, size_t bufsiz, unsigned i)
+{
+    static const char *prefixes[] = {
+	"http://xml.juniper.net/junos/%u.%u/junos-interface/%u",
+	"/configuration/interfaces/interface/ge-%u/%u/%u/unit/name",
+	"/configuration/protocols/bgp/group/peers-%u/neighbor/%u.%u",
+	"http://www.w3.org/%u/XSL/Transform/%u/%u",
+    };
+    unsigned n = i / 4;
+
+    snprintf(buf, bufsiz, prefixes[i % 4], n % 97, n / 97 % 251, n / 97 / 251);
+}
+
+/*
+ * Compare lookups in a patricia tree and a multi-bit trie, using
+ * the same keys in the same pa_istr
+ */
+static void
+bench_trie (void)
+{
+    char buf[PA_PAT_MAXKEY];
+    pa_istr_atom_t *atoms = calloc(opt_count, sizeof(*atoms));
+    unsigned *order = calloc(opt_count, sizeof(*order));
+    unsigned i, found;
+    double start, secs;
+
+    assert(atoms && order);
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_istr_t *pip = pa_istr_open(pmp, "pabench.keys", BENCH_SHIFT,
+				  2, BENCH_MAX_ATOMS);
+    assert(pip);
+    pa_pat_t *ppp = pa_pat_open(pmp, "pabench.pat", pip,
+				pa_pat_istr_key_func, PA_PAT_MAXKEY,
+				BENCH_SHIFT, BENCH_MAX_ATOMS);
+    assert(ppp);
+    pa_trie_t *ptp = pa_trie_open(pmp, "pabench.trie", pip,
+				  pa_trie_istr_key_func,
+				  BENCH_SHIFT, BENCH_MAX_ATOMS);
+    assert(ptp);
+
+    size_t total = 0;
+    for (i = 0; i < opt_count; i++) {
+	bench_trie_key(buf, sizeof(buf), i);
+	total += strlen(buf);
+	atoms[i] = pa_istr_string(pip, buf);
+	order[i] = i;
+    }
+
+    printf("trie: %u keys, %zu bytes on average\n", opt_count,
+	   total / (opt_count ?: 1));
+
+    /* Look keys up in a random order, so we're not just hitting cache */
+    srandom(opt_count);
+    for (i = opt_count; i > 1; i--) {
+	unsigned j = random() % i, t = order[i - 1];
+	order[i - 1] = order[j];
+	order[j] = t;
+    }
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+	pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atoms[i])),
+		   strlen(key) + 1);
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat add:      %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++)
+	pa_trie_add(ptp, pa_trie_data_atom(pa_istr_atom_of(atoms[i])));
+    secs = bench_now() - start;
+    printf("  pa_trie add:     %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    found = 0;
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[order[i]]);
+	if (pa_pat_get(ppp, strlen(key) + 1, key))
+	    found += 1;
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat get:      %7.3f Mops/s (%u found)\n",
+	   opt_count / secs / 1e6, found);
+
+    found = 0;
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[order[i]]);
+	if (!pa_trie_data_is_null(pa_trie_get(ptp, strlen(key) + 1, key)))
+	    found += 1;
+    }
+    secs = bench_now() - start;
+    printf("  pa_trie get:     %7.3f Mops/s (%u found)\n",
+	   opt_count / secs / 1e6, found);
+
+    found = 0;
+    start = bench_now();
+    for (pa_pat_node_t *node = pa_pat_find_next(ppp, NULL); node;
+	 node = pa_pat_find_next(ppp, node))
+	found += 1;
+    secs = bench_now() - start;
+    printf("  pa_pat walk:     %7.3f Mops/s (%u keys)\n",
+	   found / secs / 1e6, found);
+
+    found = 0;
+    start = bench_now();
+    pa_trie_data_atom_t datom = pa_trie_data_null_atom();
+    while (!pa_trie_data_is_null(datom = pa_trie_find_next(ptp, datom)))
+	found += 1;
+    secs = bench_now() - start;
+    printf("  pa_trie walk:    %7.3f Mops/s (%u keys)\n",
+	   found / secs / 1e6, found);
+
+    printf("  memory: pa_pat %zu bytes, pa_trie %zu bytes\n",
+	   opt_count * sizeof(pa_pat_node_t),
+	   ptp->pt_infop->pti_nodes * sizeof(pa_trie_node_t));
+
+    pa_trie_close(ptp);
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+    free(order);
+    free(atoms);
+}
+
+static pa_istr_t *bench_bulk_istr; /* For qsort */
+
+static int
+bench_bulk_compare (const void *v1, const void *v2)
+{
+    const pa_istr_atom_t *a1 = v1, *a2 = v2;
+
+    return strcmp(pa_istr_atom_string(bench_bulk_istr, *a1),
+		  pa_istr_atom_string(bench_bulk_istr, *a2));
+}
+
+typedef struct bench_bulk_s {
+    pa_istr_atom_t *bb_atoms;	/* Sorted atoms */
+    unsigned bb_next;		/* Next one to return */
+} bench_bulk_t;
+
+static pa_pat_data_atom_t
+bench_bulk_next (pa_pat_t *root UNUSED, void *opaque, uint16_t *key_bytesp)
+{
+    bench_bulk_t *bbp = opaque;
+
+    if (bbp->bb_next >= opt_count)
+	return pa_pat_data_null_atom();
+
+    pa_istr_atom_t atom = bbp->bb_atoms[bbp->bb_next++];
+    *key_bytesp = strlen(pa_istr_atom_string(bench_bulk_istr, atom)) + 1;
+
+    return pa_pat_data_atom(pa_istr_atom_of(atom));
+}
+
+/*
+ * Build a patricia tree one key at a time with pa_pat_add(), in
+ * sorted and in random order, and then with pa_pat_bulk_load()
+ */
+static void
+bench_bulk (void)
+{
+    char buf[PA_PAT_MAXKEY];
+    bench_bulk_t bb = { NULL, 0 };
+    pa_istr_atom_t *shuffled = calloc(opt_count, sizeof(*shuffled));
+    unsigned i;
+    double start, secs;
+
+    bb.bb_atoms = calloc(opt_count, sizeof(*bb.bb_atoms));
+    assert(bb.bb_atoms && shuffled);
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_istr_t *pip = pa_istr_open(pmp, "pabench.keys", BENCH_SHIFT,
+				  2, BENCH_MAX_ATOMS);
+    assert(pip);
+
+    pa_pat_t *trees[3];
+    static const char *names[3] = {
+	"pa_pat_add (sorted)", "pa_pat_add (random)", "pa_pat_bulk_load",
+    };
+
+    for (i = 0; i < 3; i++) {
+	snprintf(buf, sizeof(buf), "pabench.pat%u", i);
+	trees[i] = pa_pat_open(pmp, buf, pip, pa_pat_istr_key_func,
+			       PA_PAT_MAXKEY, BENCH_SHIFT, BENCH_MAX_ATOMS);
+	assert(trees[i]);
+    }
+
+    for (i = 0; i < opt_count; i++) {
+	bench_trie_key(buf, sizeof(buf), i);
+	bb.bb_atoms[i] = shuffled[i] = pa_istr_string(pip, buf);
+    }
+
+    bench_bulk_istr = pip;
+    qsort(bb.bb_atoms, opt_count, sizeof(*bb.bb_atoms), bench_bulk_compare);
+
+    srandom(opt_count);
+    for (i = opt_count; i > 1; i--) {
+	unsigned j = random() % i;
+	pa_istr_atom_t t = shuffled[i - 1];
+	shuffled[i - 1] = shuffled[j];
+	shuffled[j] = t;
+    }
+
+    printf("bulk: %u keys\n", opt_count);
+
+    for (unsigned t = 0; t < 3; t++) {
+	pa_istr_atom_t *atoms = (t == 0) ? bb.bb_atoms : shuffled;
+
+	start = bench_now();
+	if (t == 2) {
+	    pa_pat_bulk_load(trees[t], bench_bulk_next, &bb);
+	} else {
+	    for (i = 0; i < opt_count; i++) {
+		const char *key = pa_istr_atom_string(pip, atoms[i]);
+		pa_pat_add(trees[t], pa_pat_data_atom(pa_istr_atom_of(atoms[i])),
+			   strlen(key) + 1);
+	    }
+	}
+	secs = bench_now() - start;
+	printf("  %-20s build %7.3f Mops/s", names[t], opt_count / secs / 1e6);
+
+	unsigned count = 0;
+	start = bench_now();
+	for (pa_pat_node_t *node = pa_pat_find_next(trees[t], NULL); node;
+	     node = pa_pat_find_next(trees[t], node))
+	    count += 1;
+	secs = bench_now() - start;
+	printf(", walk %7.3f Mops/s (%u keys)\n", count / secs / 1e6, count);
+    }
+
+    for (i = 0; i < 3; i++)
+	pa_pat_close(trees[i]);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+    free(bb.bb_atoms);
+    free(shuffled);
+}
+
+/*
+ * Compare pa_hash with pa_pat for exact-match lookups.  We also time
+ * each insert, to compare pa_hash's worst case with pa_istr's hash
+ * index, which doubles its table in one go.
+ */
+static void
+bench_hash (void)
+{
+    char buf[PA_PAT_MAXKEY];
+    pa_istr_atom_t *atoms = calloc(opt_count, sizeof(*atoms));
+    unsigned *order = calloc(opt_count, sizeof(*order));
+    unsigned i, found;
+    double start, secs, now, worst;
+
+    assert(atoms && order);
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_istr_t *pip = pa_istr_open(pmp, "pabench.keys", BENCH_SHIFT,
+				  2, BENCH_MAX_ATOMS);
+    assert(pip);
+    pa_pat_t *ppp = pa_pat_open(pmp, "pabench.pat", pip,
+				pa_pat_istr_key_func, PA_PAT_MAXKEY,
+				BENCH_SHIFT, BENCH_MAX_ATOMS);
+    pa_hash_t *php = pa_hash_open(pmp, "pabench.hash", pip,
+				  pa_hash_istr_key_func,
+				  BENCH_SHIFT, BENCH_MAX_ATOMS);
+    pa_istr_t *interned = pa_istr_open(pmp, "pabench.interned",
+				       BENCH_SHIFT, 2, BENCH_MAX_ATOMS);
+    assert(ppp && php && interned);
+
+    for (i = 0; i < opt_count; i++) {
+	bench_trie_key(buf, sizeof(buf), i);
+	atoms[i] = pa_istr_string(pip, buf);
+	order[i] = i;
+    }
+
+    srandom(opt_count);
+    for (i = opt_count; i > 1; i--) {
+	unsigned j = random() % i, t = order[i - 1];
+	order[i - 1] = order[j];
+	order[j] = t;
+    }
+
+    printf("hash: %u keys\n", opt_count);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+	pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atoms[i])),
+		   strlen(key) + 1);
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat add:      %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    worst = 0;
+    start = now = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	pa_hash_add(php, pa_hash_data_atom(pa_istr_atom_of(atoms[i])));
+
+	double then = bench_now();
+	if (then - now > worst)
+	    worst = then - now;
+	now = then;
+    }
+    secs = bench_now() - start;
+    printf("  pa_hash add:     %7.3f Mops/s (worst %.1f us)\n",
+	   opt_count / secs / 1e6, worst * 1e6);
+
+    worst = 0;
+    start = now = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	pa_istr_intern(interned, pa_istr_atom_string(pip, atoms[i]));
+
+	double then = bench_now();
+	if (then - now > worst)
+	    worst = then - now;
+	now = then;
+    }
+    secs = bench_now() - start;
+    printf("  pa_istr_intern:  %7.3f Mops/s (worst %.1f us)\n",
+	   opt_count / secs / 1e6, worst * 1e6);
+
+    found = 0;
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[order[i]]);
+	if (pa_pat_get(ppp, strlen(key) + 1, key))
+	    found += 1;
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat get:      %7.3f Mops/s (%u found)\n",
+	   opt_count / secs / 1e6, found);
+
+    found = 0;
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[order[i]]);
+	if (!pa_hash_data_is_null(pa_hash_get(php, strlen(key), key)))
+	    found += 1;
+    }
+    secs = bench_now() - start;
+    printf("  pa_hash get:     %7.3f Mops/s (%u found)\n",
+	   opt_count / secs / 1e6, found);
+
+    pa_istr_close(interned);
+    pa_hash_close(php);
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+    free(order);
+    free(atoms);
+}
+
+/*
+ * Compare ordered scans over pa_pat and pa_btree: a full walk, and
+ * short range scans starting at random keys
+ */
+static void
+bench_btree (void)
+{
+    char buf[PA_PAT_MAXKEY];
+    pa_istr_atom_t *atoms = calloc(opt_count, sizeof(*atoms));
+    unsigned i, j, count, ranges = opt_count / 1000 ?: 1;
+    double start, secs;
+
+    assert(atoms);
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    pa_istr_t *pip = pa_istr_open(pmp, "pabench.keys", BENCH_SHIFT,
+				  2, BENCH_MAX_ATOMS);
+    assert(pip);
+    pa_pat_t *ppp = pa_pat_open(pmp, "pabench.pat", pip,
+				pa_pat_istr_key_func, PA_PAT_MAXKEY,
+				BENCH_SHIFT, BENCH_MAX_ATOMS);
+    pa_btree_t *pbp = pa_btree_open(pmp, "pabench.btree", 0,
+				    4, BENCH_MAX_ATOMS >> 8);
+    assert(ppp && pbp);
+
+    for (i = 0; i < opt_count; i++) {
+	bench_trie_key(buf, sizeof(buf), i);
+	atoms[i] = pa_istr_string(pip, buf);
+    }
+
+    srandom(opt_count);
+    for (i = opt_count; i > 1; i--) {
+	unsigned k = random() % i;
+	pa_istr_atom_t t = atoms[i - 1];
+	atoms[i - 1] = atoms[k];
+	atoms[k] = t;
+    }
+
+    printf("btree: %u keys\n", opt_count);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+	pa_pat_add(ppp, pa_pat_data_atom(pa_istr_atom_of(atoms[i])),
+		   strlen(key) + 1);
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat add:          %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+	pa_btree_add(pbp, strlen(key), key,
+		     pa_btree_data_atom(pa_istr_atom_of(atoms[i])));
+    }
+    secs = bench_now() - start;
+    printf("  pa_btree add:        %7.3f Mops/s\n", opt_count / secs / 1e6);
+
+    count = 0;
+    start = bench_now();
+    for (pa_pat_node_t *node = pa_pat_find_next(ppp, NULL); node;
+	 node = pa_pat_find_next(ppp, node))
+	count += 1;
+    secs = bench_now() - start;
+    printf("  pa_pat walk:         %7.3f Mops/s (%u keys)\n",
+	   count / secs / 1e6, count);
+
+    pa_btree_cursor_t cursor;
+    count = 0;
+    start = bench_now();
+    pa_btree_cursor_seek(pbp, &cursor, 0, NULL);
+    while (!pa_btree_data_is_null(pa_btree_cursor_next(pbp, &cursor,
+							NULL, NULL)))
+	count += 1;
+    secs = bench_now() - start;
+    printf("  pa_btree walk:       %7.3f Mops/s (%u keys)\n",
+	   count / secs / 1e6, count);
+
+    /* Range scans: 1000 keys after each of a set of random keys */
+    count = 0;
+    start = bench_now();
+    for (i = 0; i < ranges; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+	pa_pat_node_t *node = pa_pat_getnext(ppp, strlen(key) + 1, key, TRUE);
+
+	for (j = 0; node && j < 1000; j++) {
+	    count += 1;
+	    node = pa_pat_find_next(ppp, node);
+	}
+    }
+    secs = bench_now() - start;
+    printf("  pa_pat range scan:   %7.3f Mops/s (%u keys)\n",
+	   count / secs / 1e6, count);
+
+    count = 0;
+    start = bench_now();
+    for (i = 0; i < ranges; i++) {
+	const char *key = pa_istr_atom_string(pip, atoms[i]);
+
+	pa_btree_cursor_seek(pbp, &cursor, strlen(key), key);
+	for (j = 0; j < 1000; j++) {
+	    if (pa_btree_data_is_null(pa_btree_cursor_next(pbp, &cursor,
+							   NULL, NULL)))
+		break;
+	    count += 1;
+	}
+    }
+    secs = bench_now() - start;
+    printf("  pa_btree range scan: %7.3f Mops/s (%u keys)\n",
+	   count / secs / 1e6, count);
+
+    pa_btree_close(pbp);
+    pa_pat_close(ppp);
+    pa_istr_close(pip);
+    pa_mmap_close(pmp);
+    free(atoms);
+}
+
+/*
+ * Fill a bitmap with random bits, about "percent" of them set
+ */
+static void
+bench_bitmap_fill (pa_bitmap_t *pbp, pa_bitmap_id_t id, unsigned percent)
+{
+    pa_bitnumber_t num;
+
+    for (num = 0; num < PA_BITMAP_MAX_BIT; num++)
+	if ((unsigned) (random() % 100) < percent)
+	    pa_bitmap_set(pbp, id, num);
+}
+
+/*
+ * Time the whole-bitmap operations with each set of kernels this CPU
+ * can run, on full-sized bitmaps that are dense and then sparse
+ */
+static void
+bench_bitmap (void)
+{
+    static const char *impls[] = { "scalar", "sse2", "avx2", NULL };
+    static const unsigned densities[] = { 50, 1, 0 };
+    static const char *op_names[] = { "and", "or", "andnot", "xor" };
+    psu_boolean_t (*op_funcs[])(pa_bitmap_t *, pa_bitmap_id_t,
+				pa_bitmap_id_t) = {
+	pa_bitmap_and, pa_bitmap_or, pa_bitmap_andnot, pa_bitmap_xor,
+    };
+    const unsigned reps = 50;
+    double start, secs;
+    unsigned d, i, op, rep;
+    uint32_t count;
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+
+    pa_bitmap_t *pbp = pa_bitmap_open(pmp, "pabench.bitmap");
+    assert(pbp);
+
+    printf("bitmap: %u bits, %u reps (Gbits/s)\n", PA_BITMAP_MAX_BIT, reps);
+
+    srandom(1);
+    for (d = 0; densities[d]; d++) {
+	pa_bitmap_id_t a = pa_bitmap_alloc(pbp);
+	pa_bitmap_id_t b = pa_bitmap_alloc(pbp);
+
+	bench_bitmap_fill(pbp, a, densities[d]);
+	bench_bitmap_fill(pbp, b, densities[d]);
+	printf("  %u%% set:\n", densities[d]);
+
+	for (i = 0; impls[i]; i++) {
+	    if (!pa_bitmap_impl_select(impls[i]))
+		continue;
+
+	    printf("    %-7s", impls[i]);
+
+	    for (op = 0; op < 4; op++) {
+		pa_bitmap_id_t tmp = pa_bitmap_alloc(pbp);
+		pa_bitmap_or(pbp, tmp, a);
+
+		start = bench_now();
+		for (rep = 0; rep < reps; rep++)
+		    op_funcs[op](pbp, tmp, b);
+		secs = bench_now() - start;
+
+		printf(" %s %6.2f", op_names[op],
+		       (double) PA_BITMAP_MAX_BIT * reps / secs / 1e9);
+		pa_bitmap_free(pbp, tmp);
+	    }
+
+	    count = 0;
+	    start = bench_now();
+	    for (rep = 0; rep < reps; rep++)
+		count += pa_bitmap_count(pbp, a);
+	    secs = bench_now() - start;
+	    printf(" count %6.2f",
+		   (double) PA_BITMAP_MAX_BIT * reps / secs / 1e9);
+
+	    pa_bitnumber_t num = PA_BITMAP_FIND_START;
+	    count = 0;
+	    start = bench_now();
+	    for (;;) {
+		num = pa_bitmap_find_next(pbp, a, num);
+		if (num == PA_BITMAP_FIND_DONE)
+		    break;
+		count += 1;
+	    }
+	    secs = bench_now() - start;
+	    printf(" find %6.2f\n", (double) PA_BITMAP_MAX_BIT / secs / 1e9);
+	}
+
+	pa_bitmap_free(pbp, a);
+	pa_bitmap_free(pbp, b);
+    }
+
+    pa_bitmap_impl_select(NULL);
+    pa_bitmap_close(pbp);
+    pa_mmap_close(pmp);
+}
+
+/*
+ * Compare pa_roar with pa_bitmap on the same bits, at a range of
+ * densities (in tenths of a percent): how much room each takes and
+ * how fast each can intersect two sets
+ */
+static void
+bench_roar (void)
+{
+    static const unsigned densities[] = { 500, 10, 1, 0 };
+    const unsigned reps = 50;
+    double start, secs;
+    unsigned d, rep;
+    pa_bitnumber_t num;
+    uint64_t count;
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+
+    pa_bitmap_t *pbp = pa_bitmap_open(pmp, "pabench.bitmap");
+    pa_roar_t *prp = pa_roar_open(pmp, "pabench.roar");
+    assert(pbp && prp);
+
+    printf("roar: %u bits, %u reps\n", PA_BITMAP_MAX_BIT, reps);
+
+    srandom(1);
+    for (d = 0; densities[d]; d++) {
+	pa_bitmap_id_t ba = pa_bitmap_alloc(pbp), bb = pa_bitmap_alloc(pbp);
+	pa_roar_id_t ra = pa_roar_alloc(prp), rb = pa_roar_alloc(prp);
+
+	for (num = 0; num < PA_BITMAP_MAX_BIT; num++) {
+	    if ((unsigned) (random() % 1000) < densities[d]) {
+		pa_bitmap_set(pbp, ba, num);
+		pa_roar_set(prp, ra, num);
+	    }
+	    if ((unsigned) (random() % 1000) < densities[d]) {
+		pa_bitmap_set(pbp, bb, num);
+		pa_roar_set(prp, rb, num);
+	    }
+	}
+
+	printf("  %u.%u%% set (%llu values):\n", densities[d] / 10,
+	       densities[d] % 10, (unsigned long long) pa_roar_count(prp, ra));
+	printf("    bytes: bitmap %u, roar %zu\n", PA_BITMAP_MAX_BIT / PA_NBBY,
+	       pa_roar_serialize(prp, ra, NULL, 0));
+
+	start = bench_now();
+	for (rep = 0; rep < reps; rep++) {
+	    pa_bitmap_id_t tmp = pa_bitmap_alloc(pbp);
+	    pa_bitmap_or(pbp, tmp, ba);
+	    pa_bitmap_and(pbp, tmp, bb);
+	    pa_bitmap_free(pbp, tmp);
+	}
+	secs = bench_now() - start;
+	printf("    and: bitmap %8.1f us", secs / reps * 1e6);
+
+	count = 0;
+	start = bench_now();
+	for (rep = 0; rep < reps; rep++) {
+	    pa_roar_id_t tmp = pa_roar_alloc(prp);
+	    pa_roar_or(prp, tmp, ra);
+	    pa_roar_and(prp, tmp, rb);
+	    count += pa_roar_count(prp, tmp);
+	    pa_roar_free(prp, tmp);
+	}
+	secs = bench_now() - start;
+	printf(", roar %8.1f us (%llu values)\n", secs / reps * 1e6,
+	       (unsigned long long) (count / reps));
+
+	pa_bitmap_free(pbp, ba);
+	pa_bitmap_free(pbp, bb);
+	pa_roar_free(prp, ra);
+	pa_roar_free(prp, rb);
+    }
+
+    pa_roar_close(prp);
+    pa_bitmap_close(pbp);
+    pa_mmap_close(pmp);
+}
+
+/*
+ * Time the segment's reader/writer lock when nobody else wants it,
+ * which is the case readers care most about
+ */
+static void
+bench_lock (void)
+{
+    double start, secs;
+    unsigned i;
+    uint32_t seq, retries = 0;
+
+    pa_mmap_t *pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+
+    printf("lock: %u lock/unlock pairs\n", opt_count);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	pa_mmap_read_lock(pmp);
+	pa_mmap_read_unlock(pmp);
+    }
+    secs = bench_now() - start;
+    printf("  read lock:  %7.2f ns/pair\n", secs / opt_count * 1e9);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	pa_mmap_write_lock(pmp);
+	pa_mmap_write_unlock(pmp);
+    }
+    secs = bench_now() - start;
+    printf("  write lock: %7.2f ns/pair\n", secs / opt_count * 1e9);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	seq = pa_mmap_read_begin(pmp);
+	retries += pa_mmap_read_retry(pmp, seq);
+    }
+    secs = bench_now() - start;
+    printf("  seq read:   %7.2f ns/pair (%u retries)\n",
+	   secs / opt_count * 1e9, retries);
+
+    pa_mmap_close(pmp);
+}
+
+/*
+ * Fill a segment with "count" 32-byte values, returning the slots
+ */
+#define BENCH_SNAP_SIZE	32	/* Size of each value */
+#define BENCH_SNAP_FILE	"pabench-snap.db"
+
+static pa_fixed_atom_t *
+bench_snapshot_fill (pa_mmap_t *pmp, pa_fixed_t **pfpp)
+{
+    pa_fixed_atom_t *atoms = psu_calloc(opt_count * sizeof(*atoms));
+    pa_fixed_t *pfp;
+    unsigned i;
+
+    pfp = pa_fixed_open(pmp, "bench.values", 12, BENCH_SNAP_SIZE,
+			opt_count + 1);
+    assert(atoms && pfp);
+
+    for (i = 0; i < opt_count; i++) {
+	atoms[i] = pa_fixed_alloc_atom(pfp);
+	snprintf(pa_fixed_atom_addr(pfp, atoms[i]), BENCH_SNAP_SIZE,
+		 "value %u", i);
+    }
+
+    *pfpp = pfp;
+    return atoms;
+}
+
+/* Change every "stride"th value, returning the time taken */
+static double
+bench_snapshot_touch (pa_fixed_t *pfp, pa_fixed_atom_t *atoms,
+		      unsigned stride, unsigned pass)
+{
+    double start = bench_now();
+    unsigned i;
+
+    for (i = 0; i < opt_count; i += stride)
+	snprintf(pa_fixed_atom_addr(pfp, atoms[i]), BENCH_SNAP_SIZE,
+		 "pass %u", pass);
+
+    return bench_now() - start;
+}
+
+/*
+ * Time taking snapshots, and what a live snapshot costs the writer
+ */
+static void
+bench_snapshot (void)
+{
+    pa_fixed_atom_t *atoms;
+    pa_mmap_t *pmp, *snap;
+    pa_fixed_t *pfp;
+    double start, secs, touch;
+    unsigned stride = 100;
+    unsigned changes = (opt_count + stride - 1) / stride;
+
+    unlink(BENCH_SNAP_FILE);
+    unlink(BENCH_SNAP_FILE ".log");
+
+    pmp = pa_mmap_open(BENCH_SNAP_FILE, "pabench", PMF_COMMIT, 0644);
+    assert(pmp);
+    atoms = bench_snapshot_fill(pmp, &pfp);
+    pa_mmap_commit(pmp);
+
+    printf("snapshot: %u values, %zu MB segment (PMF_COMMIT)\n",
+	   opt_count, pmp->pm_len >> 20);
+
+    start = bench_now();
+    snap = pa_mmap_snapshot(pmp);
+    secs = bench_now() - start;
+    assert(snap);
+    pa_mmap_close(snap);
+    printf("  create, just committed:   %9.1f us\n", secs * 1e6);
+
+    bench_snapshot_touch(pfp, atoms, stride, 0);
+    start = bench_now();
+    snap = pa_mmap_snapshot(pmp);
+    secs = bench_now() - start;
+    assert(snap);
+    pa_mmap_close(snap);
+    printf("  create, %u uncommitted:  %9.1f us\n", changes, secs * 1e6);
+    pa_mmap_commit(pmp);
+
+    /* The same changes and commit, without and then with a snapshot */
+    touch = bench_snapshot_touch(pfp, atoms, stride, 1);
+    start = bench_now();
+    pa_mmap_commit(pmp);
+    secs = bench_now() - start;
+    printf("  no snapshot:   stores %6.1f ns each, commit %8.1f us\n",
+	   touch / changes * 1e9, secs * 1e6);
+
+    snap = pa_mmap_snapshot(pmp);
+    assert(snap);
+    touch = bench_snapshot_touch(pfp, atoms, stride, 2);
+    start = bench_now();
+    pa_mmap_commit(pmp);
+    secs = bench_now() - start;
+    printf("  with snapshot: stores %6.1f ns each, commit %8.1f us\n",
+	   touch / changes * 1e9, secs * 1e6);
+    pa_mmap_close(snap);
+
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+    psu_free(atoms);
+    unlink(BENCH_SNAP_FILE);
+
+    /* Segments without PMF_COMMIT are copied */
+    pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    atoms = bench_snapshot_fill(pmp, &pfp);
+
+    start = bench_now();
+    snap = pa_mmap_snapshot(pmp);
+    secs = bench_now() - start;
+    assert(snap);
+    printf("  create, anonymous (copy): %9.1f us\n", secs * 1e6);
+
+    touch = bench_snapshot_touch(pfp, atoms, stride, 3);
+    printf("  anonymous stores with snapshot: %6.1f ns each\n",
+	   touch / changes * 1e9);
+
+    pa_mmap_close(snap);
+    pa_fixed_close(pfp);
+    pa_mmap_close(pmp);
+    psu_free(atoms);
+}
+
+/*
+ * A record for the compaction benchmark: a chain of them, each with
+ * some text
+ */
+typedef struct bench_rec_s {
+    pa_atom_t br_text;		/* Text (in bench.text) */
+    pa_atom_t br_next;		/* Next record (in bench.recs) */
+} bench_rec_t;
+
+#define BENCH_COMPACT_FILE	"pabench-compact.db"
+#define BENCH_COMPACT_NEW	"pabench-compact.db.new"
+#define BENCH_COMPACT_KEEP	4 /* Keep one record in this many */
+
+static const pa_compact_type_t bench_compact_map[] = {
+    {
+	.pct_name = "bench.text",
+	.pct_type = PA_TYPE_ARB,
+    },
+    {
+	.pct_name = "bench.recs",
+	.pct_type = PA_TYPE_FIXED,
+	.pct_nfields = 2,
+	.pct_fields = {
+	    { offsetof(bench_rec_t, br_text), 0 },
+	    { offsetof(bench_rec_t, br_next), 1 },
+	},
+    },
+    {
+	.pct_name = "bench.head",
+	.pct_type = PA_TYPE_OPAQUE,
+	.pct_nfields = 1,
+	.pct_fields = { { 0, 1 } },
+    },
+    { .pct_name = NULL },
+};
+
+/*
+ * Walk the chain in a file we haven't touched, after asking the
+ * kernel to drop its pages, returning the time taken and the number
+ * of pages we touched
+ */
+static double
+bench_compact_scan (const char *filename, unsigned *pagesp, unsigned *countp)
+{
+    pa_mmap_t *pmp;
+    pa_fixed_t *recs;
+    pa_arb_t *text;
+    pa_atom_t *headp, atom;
+    bench_rec_t *brp;
+    uint8_t *seen;
+    size_t page, len = 0;
+    unsigned pages = 0, count = 0;
+    double start;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+    }
+
+    start = bench_now();
+
+    pmp = pa_mmap_open(filename, "pabench", PMF_READ_ONLY, 0);
+    assert(pmp);
+    recs = pa_fixed_open(pmp, "bench.recs", 0, 0, 0);
+    text = pa_arb_open(pmp, "bench.text");
+    headp = pa_mmap_header(pmp, "bench.head", 0, 0, 0);
+    assert(recs && text && headp);
+
+    seen = psu_calloc(pmp->pm_len / 4096 / 8 + 1);
+    assert(seen);
+
+#define BENCH_SEEN(_addr) \
+    do { \
+	page = ((const char *) (_addr) - (const char *) pmp->pm_addr) / 4096; \
+	if (page < pmp->pm_len / 4096 && !(seen[page / 8] & (1 << (page & 7)))) { \
+	    seen[page / 8] |= 1 << (page & 7); \
+	    pages += 1; \
+	} \
+    } while (0)
+
+    for (atom = *headp; atom != PA_NULL_ATOM; atom = brp->br_next) {
+	const char *cp;
+
+	brp = pa_fixed_atom_addr(recs, pa_fixed_atom(atom));
+	cp = pa_arb_atom_addr(text, pa_arb_atom(brp->br_text));
+	BENCH_SEEN(brp);
+	BENCH_SEEN(cp);
+	len += strlen(cp);
+	count += 1;
+    }
+
+#undef BENCH_SEEN
+
+    start = bench_now() - start;
+    assert(len > 0);
+
+    psu_free(seen);
+    pa_arb_close(text);
+    pa_fixed_close(recs);
+    pa_mmap_close(pmp);
+
+    *pagesp = pages;
+    *countp = count;
+    return start;
+}
+
+/*
+ * Build a file with lots of churn (interleaved allocations, most of
+ * which are freed), compact it, and compare a cold scan of each
+ */
+static void
+bench_compact (void)
+{
+    pa_atom_t *atoms = psu_calloc(opt_count * sizeof(*atoms));
+    pa_compact_t *pcp;
+    pa_mmap_t *pmp;
+    pa_fixed_t *recs;
+    pa_arb_t *text;
+    pa_atom_t *headp, prev = PA_NULL_ATOM;
+    pa_arb_atom_t aa;
+    bench_rec_t *brp;
+    unsigned i, size, pages, count;
+    double start, secs;
+
+    assert(atoms);
+    unlink(BENCH_COMPACT_FILE);
+
+    pmp = pa_mmap_open(BENCH_COMPACT_FILE, "pabench", 0, 0644);
+    assert(pmp);
+    recs = pa_fixed_open(pmp, "bench.recs", 12, sizeof(bench_rec_t),
+			 opt_count + 1);
+    text = pa_arb_open(pmp, "bench.text");
+    headp = pa_mmap_header(pmp, "bench.head", PA_TYPE_OPAQUE, 0,
+			   sizeof(*headp));
+    assert(recs && text && headp);
+
+    srandom(1);
+    for (i = 0; i < opt_count; i++) {
+	pa_fixed_atom_t fa = pa_fixed_alloc_atom(recs);
+
+	size = 16 + (random() % 112);
+	aa = pa_arb_alloc(text, size);
+	assert(!pa_fixed_is_null(fa) && !pa_arb_is_null(aa));
+
+	memset(pa_arb_atom_addr(text, aa), 'a' + (i % 26), size - 1);
+	((char *) pa_arb_atom_addr(text, aa))[size - 1] = '\0';
+
+	brp = pa_fixed_atom_addr(recs, fa);
+	brp->br_text = pa_arb_atom_of(aa);
+	brp->br_next = PA_NULL_ATOM;
+	atoms[i] = pa_fixed_atom_of(fa);
+    }
+
+    /* Keep a random quarter, chained in allocation order */
+    for (i = 0; i < opt_count; i++) {
+	brp = pa_fixed_atom_addr(recs, pa_fixed_atom(atoms[i]));
+	if (random() % BENCH_COMPACT_KEEP) {
+	    pa_arb_free_atom(text, pa_arb_atom(brp->br_text));
+	    pa_fixed_free_atom(recs, pa_fixed_atom(atoms[i]));
+	    continue;
+	}
+
+	if (prev == PA_NULL_ATOM)
+	    *headp = atoms[i];
+	else
+	    ((bench_rec_t *) pa_fixed_atom_addr(recs,
+				pa_fixed_atom(prev)))->br_next = atoms[i];
+	prev = atoms[i];
+    }
+
+    pa_arb_close(text);
+    pa_fixed_close(recs);
+    pa_mmap_close(pmp);
+    psu_free(atoms);
+
+    start = bench_now();
+    pcp = pa_compact(BENCH_COMPACT_FILE, BENCH_COMPACT_NEW,
+		     bench_compact_map);
+    secs = bench_now() - start;
+    assert(pcp);
+
+    printf("compact: %u records, %u kept; %zu MB -> %zu MB in %.1f ms\n",
+	   opt_count, (unsigned) pa_compact_stats(pcp, 1)->pcs_live,
+	   pcp->pc_old_size >> 20, pcp->pc_new_size >> 20, secs * 1e3);
+    pa_compact_close(pcp);
+
+    secs = bench_compact_scan(BENCH_COMPACT_FILE, &pages, &count);
+    printf("  cold scan, before: %8.1f ms, %u records, %u pages\n",
+	   secs * 1e3, count, pages);
+
+    secs = bench_compact_scan(BENCH_COMPACT_NEW, &pages, &count);
+    printf("  cold scan, after:  %8.1f ms, %u records, %u pages\n",
+	   secs * 1e3, count, pages);
+
+    unlink(BENCH_COMPACT_FILE);
+    unlink(BENCH_COMPACT_NEW);
+}
+
+/*
+ * A node, shaped like a libxi node: every field is an atom, so it
+ * doubles in size with wide atoms
+ */
+typedef struct bench_node_s {
+    pa_atom_t bn_parent;	/* Parent node */
+    pa_atom_t bn_next;		/* Next sibling (our walk order) */
+    pa_atom_t bn_child;		/* First child */
+    pa_atom_t bn_name;		/* Name (in bench.names) */
+} bench_node_t;
+
+/*
+ * The cost of the atom width (PA_WIDE_ATOMS): build a shuffled
+ * chain of nodes, then chase it, which is bound by cache misses
+ */
+static void
+bench_atoms (void)
+{
+    pa_atom_t *atoms = psu_calloc(opt_count * sizeof(*atoms));
+    pa_mmap_t *pmp;
+    pa_fixed_t *nodes;
+    pa_istr_t *names;
+    bench_node_t *bnp;
+    pa_atom_t atom, sum = 0;
+    unsigned i, j, hops;
+    char buf[32];
+    double start, secs;
+
+    assert(atoms);
+
+    pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+    assert(pmp);
+    nodes = pa_fixed_open(pmp, "bench.nodes", BENCH_SHIFT,
+			  sizeof(bench_node_t), opt_count + 1);
+    names = pa_istr_open(pmp, "bench.names", BENCH_SHIFT, 2,
+			 BENCH_MAX_ATOMS);
+    assert(nodes && names);
+
+    start = bench_now();
+    for (i = 0; i < opt_count; i++) {
+	pa_fixed_atom_t fa = pa_fixed_alloc_atom(nodes);
+	assert(!pa_fixed_is_null(fa));
+
+	snprintf(buf, sizeof(buf), "name%u", i % 1000);
+	bnp = pa_fixed_atom_addr(nodes, fa);
+	bnp->bn_parent = i ? atoms[i / 2] : PA_NULL_ATOM;
+	bnp->bn_child = PA_NULL_ATOM;
+	bnp->bn_name = pa_istr_atom_of(pa_istr_intern(names, buf));
+	atoms[i] = pa_fixed_atom_of(fa);
+    }
+    printf("atoms: %zu-bit atoms, %u nodes of %zu bytes, "
+	   "%zu MB segment\n", PA_ATOM_BITS, opt_count,
+	   sizeof(bench_node_t), pmp->pm_len >> 20);
+    printf("  build:   %7.1f ns/node\n",
+	   (bench_now() - start) / opt_count * 1e9);
+
+    /* Walk up from each node (in allocation order) to the root */
+    start = bench_now();
+    hops = 0;
+    for (i = 0; i < opt_count; i++) {
+	for (atom = atoms[i]; atom != PA_NULL_ATOM; atom = bnp->bn_parent) {
+	    bnp = pa_fixed_atom_addr(nodes, pa_fixed_atom(atom));
+	    sum += bnp->bn_name;
+	    hops += 1;
+	}
+    }
+    secs = bench_now() - start;
+    printf("  parents: %7.1f ns/hop (%u hops, sum %" PA_ATOM_FMT ")\n",
+	   secs / hops * 1e9, hops, sum);
+
+    /* Shuffle, then chain the nodes in the shuffled order */
+    srandom(1);
+    for (i = opt_count - 1; i > 0; i--) {
+	j = random() % (i + 1);
+	atom = atoms[i];
+	atoms[i] = atoms[j];
+	atoms[j] = atom;
+    }
+
+    for (i = 0; i < opt_count; i++) {
+	bnp = pa_fixed_atom_addr(nodes, pa_fixed_atom(atoms[i]));
+	bnp->bn_next = (i + 1 < opt_count) ? atoms[i + 1] : PA_NULL_ATOM;
+    }
+
+    start = bench_now();
+    hops = 0;
+    sum = 0;
+    for (atom = atoms[0]; atom != PA_NULL_ATOM; atom = bnp->bn_next) {
+	bnp = pa_fixed_atom_addr(nodes, pa_fixed_atom(atom));
+	sum += bnp->bn_name;
+	hops += 1;
+    }
+    secs = bench_now() - start;
+    printf("  chase:   %7.1f ns/hop (%u hops, sum %" PA_ATOM_FMT ")\n",
+	   secs / hops * 1e9, hops, sum);
+
+    pa_istr_close(names);
+    pa_fixed_close(nodes);
+    pa_mmap_close(pmp);
+    psu_free(atoms);
+}
+
+/*
+ * Count the pages a pa_fixed has allocated
+ */
+static unsigned
+bench_reclaim_pages (pa_fixed_t *pfp)
+{
+    pa_page_t page, max_page = pfp->pf_max_atoms >> pfp->pf_shift;
+    unsigned count = 0;
+
+    for (page = 0; page < max_page; page++)
+	if (pa_fixed_page_get(pfp, page))
+	    count += 1;
+
+    return count;
+}
+
+/*
+ * A peak and a trough: allocate opt_count atoms, free nine tenths of
+ * them, then allocate a tenth again, with and without PFF_RECLAIM.
+ * The freed atoms are either a transient peak (allocated after the
+ * ones we keep) or scattered at random.
+ */
+static void
+bench_reclaim (void)
+{
+    pa_atom_t *atoms = psu_calloc(opt_count * sizeof(*atoms));
+    pa_mmap_t *pmp;
+    pa_fixed_t *pfp;
+    unsigned i, pass, peak, kept, keep;
+    double start, secs;
+
+    assert(atoms);
+    printf("reclaim: %u atoms of 64 bytes, keeping a tenth\n", opt_count);
+
+    for (pass = 0; pass < 4; pass++) {
+	pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+	pfp = pa_fixed_open(pmp, "bench.fixed", BENCH_SHIFT, 64,
+			    opt_count + 1);
+	assert(pmp && pfp);
+	if (pass & 1)
+	    pa_fixed_reclaim_enable(pfp);
+
+	srandom(1);
+	start = bench_now();
+	for (i = 0; i < opt_count; i++)
+	    atoms[i] = pa_fixed_atom_of(pa_fixed_alloc_atom(pfp));
+	peak = bench_reclaim_pages(pfp);
+
+	for (i = 0; i < opt_count; i++) {
+	    keep = (pass & 2) ? (random() % 10 == 0) : (i < opt_count / 10);
+	    if (!keep) {
+		pa_fixed_free_atom(pfp, pa_fixed_atom(atoms[i]));
+		atoms[i] = PA_NULL_ATOM;
+	    }
+	}
+	kept = bench_reclaim_pages(pfp);
+
+	for (i = 0; i < opt_count; i++)
+	    if (atoms[i] == PA_NULL_ATOM && i % 9 == 0)
+		atoms[i] = pa_fixed_atom_of(pa_fixed_alloc_atom(pfp));
+	secs = bench_now() - start;
+
+	printf("  %s, %s: pages %u at peak, %u after frees, "
+	       "%u after reallocating; %.1f ns/op\n",
+	       (pass & 2) ? "scattered" : "transient",
+	       (pass & 1) ? "reclaim" : "default", peak, kept,
+	       bench_reclaim_pages(pfp), secs / (opt_count * 2.1) * 1e9);
+
+	pa_fixed_close(pfp);
+	pa_mmap_close(pmp);
+    }
+
+    psu_free(atoms);
+}
+
+/*
+ * One-at-a-time allocation against pa_fixed_alloc_atoms() and
+ * pa_arb_alloc_atoms(), "batch" at a time
+ */
+static void
+bench_refill (void)
+{
+    pa_fixed_atom_t *fatoms = psu_calloc(opt_count * sizeof(*fatoms));
+    pa_arb_atom_t *aatoms = psu_calloc(opt_count * sizeof(*aatoms));
+    unsigned i, n, pass, batch = opt_batch;
+    pa_mmap_t *pmp;
+    pa_fixed_t *pfp;
+    pa_arb_t *prp;
+    double start, fsecs, asecs;
+
+    assert(fatoms && aatoms);
+    printf("refill: %u allocations, %u at a time\n", opt_count, batch);
+
+    for (pass = 0; pass < 2; pass++) {
+	pmp = pa_mmap_open(NULL, "pabench", 0, 0);
+	pfp = pa_fixed_open(pmp, "bench.fixed", BENCH_SHIFT, 32,
+			    opt_count + 1);
+	prp = pa_arb_open(pmp, "bench.arb");
+	assert(pmp && pfp && prp);
+
+	start = bench_now();
+	for (i = 0; i < opt_count; i += n) {
+	    if (pass == 0) {
+		fatoms[i] = pa_fixed_alloc_atom(pfp);
+		n = 1;
+	    } else {
+		n = pa_fixed_alloc_atoms(pfp, &fatoms[i],
+			(opt_count - i < batch) ? opt_count - i : batch);
+		assert(n);
+	    }
+	}
+	fsecs = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < opt_count; i += n) {
+	    if (pass == 0) {
+		aatoms[i] = pa_arb_alloc(prp, 40);
+		n = 1;
+	    } else {
+		n = pa_arb_alloc_atoms(prp, 40, &aatoms[i],
+			(opt_count - i < batch) ? opt_count - i : batch);
+		assert(n);
+	    }
+	}
+	asecs = bench_now() - start;
+
+	printf("  %s: pa_fixed %6.1f ns/atom, pa_arb (40 bytes) %6.1f "
+	       "ns/atom\n", pass ? "batch " : "single",
+	       fsecs / opt_count * 1e9, asecs / opt_count * 1e9);
+
+	pa_arb_close(prp);
+	pa_fixed_close(pfp);
+	pa_mmap_close(pmp);
+    }
+
+    psu_free(fatoms);
+    psu_free(aatoms);
+}
+
+typedef struct bench_s {
+    const char *b_name;		/* Name of the benchmark */
+    void (*b_func)(void);	/* Function to run it */
+} bench_t;
+
+static bench_t bench_list[] = {
+    { "threads", bench_threads },
+    { "strings", bench_strings },
+    { "intern", bench_intern },
+    { "trie", bench_trie },
+    { "bulk", bench_bulk },
+    { "hash", bench_hash },
+    { "btree", bench_btree },
+    { "bitmap", bench_bitmap },
+    { "roar", bench_roar },
+    { "lock", bench_lock },
+    { "snapshot", bench_snapshot },
+    { "compact", bench_compact },
+    { "atoms", bench_atoms },
+    { "reclaim", bench_reclaim },
+    { "refill", bench_refill },
+    { NULL, NULL }
+};
+
+int
+main (int argc, char **argv)
+{
+    const char *name = NULL;
+    bench_t *bp;
+
+    for (argc = 1; argv[argc]; argc++) {
+	if (strcmp(argv[argc], "nthreads") == 0) {
+	    if (argv[argc + 1])
+		opt_threads = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "count") == 0) {
+	    if (argv[argc + 1])
+		opt_count = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "unique") == 0) {
+	    if (argv[argc + 1])
+		opt_unique = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "batch") == 0) {
+	    if (argv[argc + 1])
+		opt_batch = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "config") == 0) {
+	    if (argv[argc + 1])
+		pa_config_read(argv[++argc]);
+	} else if (name == NULL) {
+	    name = argv[argc];
+	} else {
+	    /* The rest of the arguments are input files */
+	    opt_files = &argv[argc];
+	    break;
+	}
+    }
+
+    for (bp = bench_list; bp->b_name; bp++)
+	if (name == NULL || strcmp(name, bp->b_name) == 0)
+	    bp->b_func();
+
+    return 0;
+}
@@ -61,7 +61,9 @@ void test_free(unsigned slot);
 void test_print(unsigned slot);
 void test_dump(void);
 void test_full_dump(psu_boolean_t);
+void test_realloc(unsigned slot, unsigned size);
 void test_other(char *buf);
+void test_range(const char *lo, const char *hi);
 
 static char *
 scan_uint32 (char *cp, uint32_t *valp)
@@ -212,6 +214,25 @@ main (int argc UNUSED, char **argv UNUSED)
 	    break;
 #endif /* NEED_FULL_DUMP */
 
+#ifdef NEED_REALLOC
+	case 'r':
+	    cp = scan_uint32(cp, &slot);
+	    if (cp == NULL)
+		break;
+
+	    cp = scan_uint32(cp, &this_size);
+	    if (cp == NULL)
+		this_size = opt_size;
+
+	    if (slot >= opt_count) {
+		printf("slot %u > count %u\n", slot, opt_count);
+		break;
+	    }
+
+	    test_realloc(slot, this_size);
+	    break;
+#endif /* NEED_REALLOC */
+
 	case 'f':
 	    cp = scan_uint32(cp, &slot);
 	    if (cp == NULL)
@@ -255,6 +276,30 @@ main (int argc UNUSED, char **argv UNUSED)
 	    break;
 #endif /* NEED_KEY */
 
+#ifdef NEED_RANGE
+	case 'x':
+	    while (isspace((int) *cp))
+		cp += 1;
+
+	    if (cp[0] == '\0') {
+		printf("missing range\n");
+		break;
+	    }
+
+	    /* "x lo [hi]"; a missing "hi" means "to the end" */
+	    char *hi = strchr(cp, ' ');
+	    if (hi) {
+		*hi++ = '\0';
+		while (isspace((int) *hi))
+		    hi += 1;
+		if (*hi == '\0')
+		    hi = NULL;
+	    }
+
+	    test_range(cp, hi);
+	    break;
+#endif /* NEED_RANGE */
+
 	case 'p':
 	    cp = scan_uint32(cp, &slot);
 	    if (cp == NULL)
@@ -295,7 +340,7 @@ test_print (unsigned slot)
     if (tp) {
 	pa_atom_t atom = trec[slot]->t_id;
 	
-	printf("%u : %u -> %p %s%s%s [%d]\n",
+	printf("%u : %" PA_ATOM_FMT " -> %p %s%s%s [%d]\n",
 	       slot, atom, trec[slot],
 	       (tp->t_magic != opt_magic) ? " bad-magic" : "",
 	       (tp->t_slot != slot) ? " bad-slot" : "",
@@ -17,6 +17,7 @@
 #include <string.h>
 #include <err.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
@@ -27,53 +28,105 @@
 #include <libxi/xicommon.h>
 #include <libxi/xisource.h>
 
-int
-main (int argc, char **argv)
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#include <zlib.h>
+
+/*
+ * Compress "len" bytes at "buf" into "out" as a gzip member,
+ * returning the compressed length
+ */
+static size_t
+test_gzip_member (const char *buf, size_t len, char *out, size_t size)
 {
-    const char *opt_filename = NULL;
-    int opt_quiet = FALSE;
-    int opt_log = FALSE;
-    int opt_unescape = FALSE;
-    int fd = 0;
-    xi_source_flags_t flags = 0;
+    z_stream zs;
 
-    for (argc = 1; argv[argc]; argc++) {
-	if (strcmp(argv[argc], "file") == 0
-	    || strcmp(argv[argc], "input") == 0) {
-	    if (argv[argc + 1])
-		opt_filename = argv[++argc];
-	} else if (strcmp(argv[argc], "quiet") == 0) {
-	    opt_quiet = TRUE;
-	} else if (strcmp(argv[argc], "unescape") == 0) {
-	    opt_unescape = TRUE;
-	} else if (strcmp(argv[argc], "line") == 0) {
-	    flags |= XPSF_LINE_NO;
-	} else if (strcmp(argv[argc], "trim") == 0) {
-	    flags |= XPSF_TRIM_WS;
-	} else if (strcmp(argv[argc], "log") == 0) {
-	    opt_log = TRUE;
-	} else if (strcmp(argv[argc], "ignore") == 0) {
-	    flags |= XPSF_IGNORE_WS;
-	} else if (strcmp(argv[argc], "ignore-comments") == 0) {
-	    flags |= XPSF_IGNORE_COMMENTS;
-	} else if (strcmp(argv[argc], "ignore-dtd") == 0) {
-	    flags |= XPSF_IGNORE_DTD;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS,
+		     8, Z_DEFAULT_STRATEGY) != Z_OK)
+	errx(1, "deflateInit2 failed");
+
+    zs.next_in = (Bytef *) const_drop(buf);
+    zs.avail_in = len;
+    zs.next_out = (Bytef *) out;
+    zs.avail_out = size;
+
+    if (deflate(&zs, Z_FINISH) != Z_STREAM_END)
+	errx(1, "deflate failed");
+
+    deflateEnd(&zs);
+    return size - zs.avail_out;
+}
+
+/*
+ * Return a pipe that gives the contents of "fd" gzip'd, as two
+ * members (to make sure we go on to the second), written "piece"
+ * bytes at a time by a child process (which exits when it's done)
+ */
+static int
+test_gzip_pipe (int fd, size_t piece)
+{
+    size_t len, half, zlen, size, off, count;
+    struct stat st;
+    char *buf, *zbuf;
+    int fds[2];
+    pid_t pid;
+
+    if (fstat(fd, &st) < 0)
+	err(1, "could not stat input");
+
+    len = st.st_size;
+    buf = malloc(len + 1);
+    size = compressBound(len) + 1024;
+    zbuf = malloc(size);
+    assert(buf && zbuf);
+
+    if (read(fd, buf, len) != (ssize_t) len)
+	err(1, "could not read input");
+
+    half = len / 2;
+    zlen = test_gzip_member(buf, half, zbuf, size);
+    zlen += test_gzip_member(buf + half, len - half, zbuf + zlen, size - zlen);
+
+    if (pipe(fds) < 0)
+	err(1, "pipe");
+
+    pid = fork();
+    if (pid < 0)
+	err(1, "fork");
+
+    if (pid == 0) {
+	close(fds[0]);
+	for (off = 0; off < zlen; off += count) {
+	    count = (zlen - off < piece) ? zlen - off : piece;
+	    if (write(fds[1], zbuf + off, count) != (ssize_t) count)
+		_exit(1);
 	}
+	_exit(0);
     }
 
-    if (opt_log)
-	psu_log_enable(TRUE);
+    close(fds[1]);
+    free(zbuf);
+    free(buf);
 
-    if (opt_filename != NULL) {
-	fd = open(opt_filename, O_RDONLY);
-	if (fd < 0)
-	    err(1, "could not open file: %s", opt_filename);
-    }
+    return fds[0];
+}
 
-    xi_source_t *srcp = xi_source_create(fd, flags);
-    if (srcp == NULL)
-	errx(1, "failed to create source");
+#else /* HAVE_ZLIB_H && HAVE_LIBZ */
+
+static int
+test_gzip_pipe (int fd UNUSED, size_t piece UNUSED)
+{
+    errx(1, "not built with zlib");
+}
 
+#endif /* HAVE_ZLIB_H && HAVE_LIBZ */
+
+/*
+ * Print the tokens from a source, returning zero at EOF
+ */
+static int
+test_tokens (xi_source_t *srcp, int opt_quiet, int opt_unescape)
+{
     char *data, *rest;
     xi_node_type_t type;
     for (;;) {
@@ -93,11 +146,14 @@ main (int argc, char **argv)
 
 	case XI_TYPE_TEXT:	/* Text content */
 	    if (!opt_quiet) {
-		int len;
-		if (opt_unescape && data && rest)
+		size_t len;
+		if (opt_unescape == 2 && data && rest)
+		    data = xi_source_unescape_copy(srcp, data, rest - data,
+						   &len);
+		else if (opt_unescape && data && rest)
 		    len = xi_source_unescape(srcp, data, rest - data);
 		else len = rest - data;
-		printf("data [%.*s]\n", len, data);
+		printf("data [%.*s]\n", (int) len, data);
 	    }
 	    break;
 
@@ -138,7 +194,120 @@ main (int argc, char **argv)
 	}
     }
 
+    return 0;
+}
+
+/*
+ * Split an mmap'd source into (at most) "max" pieces and print the
+ * tokens from each; the tokens should match the whole file's
+ */
+static int
+test_split (xi_source_t *srcp, unsigned max, int opt_quiet,
+	    int opt_unescape)
+{
+    xi_offset_t offsets[max], end;
+    xi_source_t *segp;
+    unsigned count, i;
+    int rc = 0;
+
+    count = xi_source_split(srcp, max, offsets);
+
+    for (i = 0; i < count && rc == 0; i++) {
+	end = (i + 1 < count) ? offsets[i + 1] : (xi_offset_t) srcp->xps_len;
+	printf("segment %u [%llu..%llu]\n", i,
+	       (unsigned long long) offsets[i], (unsigned long long) end);
+
+	segp = xi_source_segment(srcp, offsets[i], end);
+	if (segp == NULL)
+	    errx(1, "failed to create segment");
+
+	rc = test_tokens(segp, opt_quiet, opt_unescape);
+	xi_source_destroy(segp);
+    }
+
+    return rc;
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *opt_filename = NULL;
+    int opt_quiet = FALSE;
+    int opt_log = FALSE;
+    int opt_unescape = FALSE;
+    int opt_read_ahead = 0;	/* Chunk size for read-ahead */
+    int opt_gzip = 0;		/* Write size for gzip'd input */
+    int opt_split = 0;		/* Number of pieces to split into */
+    int fd = 0;
+    xi_source_flags_t flags = 0;
+
+    for (argc = 1; argv[argc]; argc++) {
+	if (strcmp(argv[argc], "file") == 0
+	    || strcmp(argv[argc], "input") == 0) {
+	    if (argv[argc + 1])
+		opt_filename = argv[++argc];
+	} else if (strcmp(argv[argc], "quiet") == 0) {
+	    opt_quiet = TRUE;
+	} else if (strcmp(argv[argc], "unescape") == 0) {
+	    opt_unescape = TRUE;
+	} else if (strcmp(argv[argc], "unescape-copy") == 0) {
+	    opt_unescape = 2;	/* Into scratch space */
+	} else if (strcmp(argv[argc], "mmap") == 0) {
+	    flags |= XPSF_MMAP_INPUT;
+	} else if (strcmp(argv[argc], "read-ahead") == 0) {
+	    if (argv[argc + 1])
+		opt_read_ahead = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "no-read-ahead") == 0) {
+	    flags |= XPSF_NO_READ_AHEAD;
+	} else if (strcmp(argv[argc], "gzip") == 0) {
+	    if (argv[argc + 1])
+		opt_gzip = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "split") == 0) {
+	    if (argv[argc + 1])
+		opt_split = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "line") == 0) {
+	    flags |= XPSF_LINE_NO;
+	} else if (strcmp(argv[argc], "trim") == 0) {
+	    flags |= XPSF_TRIM_WS;
+	} else if (strcmp(argv[argc], "log") == 0) {
+	    opt_log = TRUE;
+	} else if (strcmp(argv[argc], "ignore") == 0) {
+	    flags |= XPSF_IGNORE_WS;
+	} else if (strcmp(argv[argc], "ignore-comments") == 0) {
+	    flags |= XPSF_IGNORE_COMMENTS;
+	} else if (strcmp(argv[argc], "ignore-dtd") == 0) {
+	    flags |= XPSF_IGNORE_DTD;
+	}
+    }
+
+    if (opt_log)
+	psu_log_enable(TRUE);
+
+    if (opt_filename != NULL) {
+	fd = open(opt_filename, O_RDONLY);
+	if (fd < 0)
+	    err(1, "could not open file: %s", opt_filename);
+    }
+
+    /* Compressed input, trickling in */
+    if (opt_gzip > 0)
+	fd = test_gzip_pipe(fd, opt_gzip);
+
+    xi_source_t *srcp = xi_source_create(fd, flags);
+    if (srcp == NULL)
+	errx(1, "failed to create source");
+
+    /* Tiny chunks make tokens straddle them */
+    if (opt_read_ahead && xi_source_read_ahead(srcp, opt_read_ahead, 2) < 0)
+	errx(1, "failed to start read-ahead");
+
+    int rc;
+    if (opt_split > 0)
+	rc = test_split(srcp, opt_split, opt_quiet, opt_unescape);
+    else
+	rc = test_tokens(srcp, opt_quiet, opt_unescape);
+
     xi_source_destroy(srcp);
 
-    return 0;
+    return rc;
 }
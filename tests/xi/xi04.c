@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Test the delimiter scanning kernels (xi_scan_find/xi_scan_skip).
+ * Every kernel this CPU can run must give the same answers as the
+ * scalar one, at every starting offset and for every set of classes.
+ * Kernel names vary by CPU, so they only appear in the output when
+ * something goes wrong.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <err.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <limits.h>
+
+#include <libpsu/psucommon.h>
+#include <parrotdb/pacommon.h>
+#include <libxi/xicommon.h>
+#include <libxi/xiscan.h>
+
+#define TEST_SHORT	97	/* Vary short lengths over this range */
+
+static const struct {
+    const char *name;
+    unsigned classes;
+} test_classes[] = {
+    { "lt", XI_SCAN_LT },
+    { "gt", XI_SCAN_GT },
+    { "amp", XI_SCAN_AMP },
+    { "quote", XI_SCAN_QUOTE },
+    { "ws", XI_SCAN_WS },
+    { "eq", XI_SCAN_EQ },
+    { "lt|amp", XI_SCAN_LT | XI_SCAN_AMP },
+    { "ws|eq", XI_SCAN_WS | XI_SCAN_EQ },
+    { "all", XI_SCAN_ALL },
+    { NULL, 0 }
+};
+
+static size_t
+test_off (const char *base, const char *cp, size_t len)
+{
+    return cp ? (size_t) (cp - base) : len;
+}
+
+/*
+ * Check one kernel against the scalar results, for one set of
+ * classes, at each offset, for both the rest of the buffer and a
+ * shorter length.  Returns the number of mismatches.
+ */
+static unsigned
+test_check (const char *kernel, const char *buf, size_t len,
+	    unsigned classes, const size_t *want_find,
+	    const size_t *want_skip)
+{
+    unsigned bad = 0;
+    size_t off, slen, got;
+    const char *cp;
+
+    for (off = 0; off < len; off++) {
+	cp = buf + off;
+
+	got = test_off(buf, xi_scan_find(cp, len - off, classes), len);
+	if (got != want_find[off]) {
+	    if (bad++ < 5)
+		printf("%s: find 0x%x at %zu: %zu, wanted %zu\n",
+		       kernel, classes, off, got, want_find[off]);
+	}
+
+	got = test_off(buf, xi_scan_skip(cp, len - off, classes), len);
+	if (got != want_skip[off]) {
+	    if (bad++ < 5)
+		printf("%s: skip 0x%x at %zu: %zu, wanted %zu\n",
+		       kernel, classes, off, got, want_skip[off]);
+	}
+
+	/* A shorter length must stop at the same answer or at the end */
+	slen = off % TEST_SHORT;
+	if (slen > len - off)
+	    slen = len - off;
+	got = test_off(buf, xi_scan_find(cp, slen, classes), len);
+	if (got != ((want_find[off] < off + slen) ? want_find[off] : len)) {
+	    if (bad++ < 5)
+		printf("%s: find 0x%x at %zu len %zu: %zu\n",
+		       kernel, classes, off, slen, got);
+	}
+    }
+
+    return bad;
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *opt_filename = NULL;
+    const char **names;
+    size_t *want_find, *want_skip;
+    size_t len, off, sum;
+    unsigned i, in, bad = 0, kernels = 0;
+    struct stat st;
+    char *buf;
+    int fd;
+
+    for (argc = 1; argv[argc]; argc++) {
+	if (strcmp(argv[argc], "file") == 0
+	    || strcmp(argv[argc], "input") == 0) {
+	    if (argv[argc + 1])
+		opt_filename = argv[++argc];
+	}
+    }
+
+    if (opt_filename == NULL)
+	errx(1, "missing input file");
+
+    fd = open(opt_filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0)
+	err(1, "could not open file: %s", opt_filename);
+
+    len = st.st_size;
+    buf = malloc(len + 1);
+    want_find = calloc(len + 1, sizeof(*want_find));
+    want_skip = calloc(len + 1, sizeof(*want_skip));
+    assert(buf && want_find && want_skip);
+
+    if (read(fd, buf, len) != (ssize_t) len)
+	err(1, "could not read file: %s", opt_filename);
+    close(fd);
+
+    printf("input: %zu bytes\n", len);
+
+    names = xi_scan_impl_list();
+
+    for (i = 0; test_classes[i].name; i++) {
+	unsigned classes = test_classes[i].classes;
+
+	/* The scalar kernel gives us our answers */
+	if (!xi_scan_impl_select("scalar"))
+	    errx(1, "no scalar kernel");
+
+	for (off = 0, in = 0, sum = 0; off < len; off++) {
+	    want_find[off] = test_off(buf,
+			xi_scan_find(buf + off, len - off, classes), len);
+	    want_skip[off] = test_off(buf,
+			xi_scan_skip(buf + off, len - off, classes), len);
+	    if (want_find[off] == off)
+		in += 1;
+	    sum += want_find[off] - off;
+	}
+
+	printf("%s: %u bytes in, %zu bytes out, %zu to find (total)\n",
+	       test_classes[i].name, in, len - in, sum);
+
+	for (kernels = 0; names[kernels]; kernels++) {
+	    if (!xi_scan_impl_select(names[kernels]))
+		continue;	/* CPU can't run this one */
+
+	    bad += test_check(names[kernels], buf, len, classes,
+			      want_find, want_skip);
+	}
+    }
+
+    xi_scan_impl_select(NULL);
+
+    printf("kernels %s\n", bad ? "disagree" : "agree");
+
+    free(want_skip);
+    free(want_find);
+    free(buf);
+
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2026, Juniper Networks, Inc.
+ * All rights reserved.
+ * This SOFTWARE is licensed under the LICENSE provided in the
+ * ../Copyright file. By downloading, installing, copying, or otherwise
+ * using the SOFTWARE, you agree to be bound by the terms of that
+ * LICENSE.
+ *
+ * Benchmarks for libxi.  These aren't regression tests (timings vary
+ * too much to be compared against saved output); run them by hand,
+ * or via "make bench", which feeds them the files in this directory:
+ *
+ *     xibench [scan] [reps N] file ...
+ *     xibench tokens [reps N] file ...
+ *     xibench input [reps N] file ...
+ *     xibench pipe [reps N] file ...
+ *     xibench split [reps N] [threads N] file ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <stddef.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <err.h>
+
+#include <libpsu/psucommon.h>
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif /* HAVE_PTHREAD_H */
+
+#include <parrotdb/pacommon.h>
+#include <libxi/xicommon.h>
+#include <libxi/xiscan.h>
+#include <libxi/xisource.h>
+
+unsigned opt_reps = 2000;
+unsigned opt_threads = 4;	/* Threads for "split" */
+char **opt_files;		/* Input files (NULL terminated) */
+
+static double
+bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Read all the input files into one buffer, returning its length
+ */
+static char *
+bench_corpus (size_t *lenp)
+{
+    char *buf = NULL, *cp;
+    size_t len = 0;
+    struct stat st;
+    unsigned i;
+    int fd;
+
+    for (i = 0; opt_files && opt_files[i]; i++) {
+	fd = open(opt_files[i], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0)
+	    err(1, "could not open file: %s", opt_files[i]);
+
+	cp = realloc(buf, len + st.st_size);
+	assert(cp);
+	buf = cp;
+
+	if (read(fd, buf + len, st.st_size) != st.st_size)
+	    err(1, "could not read file: %s", opt_files[i]);
+	len += st.st_size;
+	close(fd);
+    }
+
+    *lenp = len;
+    return buf;
+}
+
+/*
+ * Walk the corpus from delimiter to delimiter, the way the tokenizer
+ * does, with each set of kernels this CPU can run
+ */
+static void
+bench_scan (void)
+{
+    static const struct {
+	const char *name;
+	unsigned classes;
+	int skip;
+    } walks[] = {
+	{ "find '<'", XI_SCAN_LT, FALSE },
+	{ "find markup", XI_SCAN_LT | XI_SCAN_GT | XI_SCAN_AMP
+	  | XI_SCAN_QUOTE, FALSE },
+	{ "find attrib", XI_SCAN_WS | XI_SCAN_EQ | XI_SCAN_QUOTE, FALSE },
+	{ "skip ws", XI_SCAN_WS, TRUE },
+	{ NULL, 0, FALSE }
+    };
+    const char **names = xi_scan_impl_list();
+    unsigned i, w, rep;
+    size_t len;
+    double start, secs;
+    const char *cp, *ep;
+    char *buf;
+
+    buf = bench_corpus(&len);
+    if (len == 0) {
+	printf("scan: no input files\n");
+	return;
+    }
+
+    printf("scan: %zu bytes, %u reps (GB/s)\n", len, opt_reps);
+
+    for (i = 0; names[i]; i++) {
+	if (!xi_scan_impl_select(names[i]))
+	    continue;
+
+	printf("  %-7s", names[i]);
+	for (w = 0; walks[w].name; w++) {
+	    start = bench_now();
+
+	    for (rep = 0; rep < opt_reps; rep++) {
+		for (cp = buf, ep = buf + len; cp < ep; cp++) {
+		    cp = walks[w].skip
+			? xi_scan_skip(cp, ep - cp, walks[w].classes)
+			: xi_scan_find(cp, ep - cp, walks[w].classes);
+		    if (cp == NULL)
+			break;
+		}
+	    }
+
+	    secs = bench_now() - start;
+	    printf(" %s %6.2f", walks[w].name,
+		   (double) len * opt_reps / secs / 1e9);
+	}
+	printf("\n");
+    }
+
+    xi_scan_impl_select(NULL);
+    free(buf);
+}
+
+/*
+ * Tokenize each input file, with each set of kernels
+ */
+static void
+bench_tokens (void)
+{
+    const char **names = xi_scan_impl_list();
+    unsigned i, f, rep, reps = opt_reps / 10 ?: 1;
+    size_t len = 0, tokens;
+    double start, secs;
+    xi_source_t *srcp;
+    char *data, *rest;
+    struct stat st;
+
+    for (f = 0; opt_files && opt_files[f]; f++)
+	if (stat(opt_files[f], &st) == 0)
+	    len += st.st_size;
+
+    if (len == 0) {
+	printf("tokens: no input files\n");
+	return;
+    }
+
+    printf("tokens: %zu bytes, %u reps (trim ignore)\n", len, reps);
+
+    for (i = 0; names[i]; i++) {
+	if (!xi_scan_impl_select(names[i]))
+	    continue;
+
+	tokens = 0;
+	start = bench_now();
+
+	for (rep = 0; rep < reps; rep++) {
+	    for (f = 0; opt_files[f]; f++) {
+		srcp = xi_source_open(opt_files[f],
+				      XPSF_TRIM_WS | XPSF_IGNORE_WS);
+		if (srcp == NULL)
+		    err(1, "could not open file: %s", opt_files[f]);
+
+		while (xi_source_next_token(srcp, &data, &rest) > XI_TYPE_FAIL)
+		    tokens += 1;
+		xi_source_destroy(srcp);
+	    }
+	}
+
+	secs = bench_now() - start;
+	printf("  %-7s %6.3f GB/s, %zu tokens\n", names[i],
+	       (double) len * reps / secs / 1e9, tokens / reps);
+    }
+
+    xi_scan_impl_select(NULL);
+}
+
+/*
+ * Tokenize each input file from a private mapping and thru read(),
+ * with the best kernels.  Compressed files can't be mapped; they're
+ * decompressed on the read-ahead thread, or in-line.
+ */
+static void
+bench_input (void)
+{
+    static const struct {
+	const char *name;
+	xi_source_flags_t flags;
+    } modes[] = {
+	{ "mmap", 0 },
+	{ "read", XPSF_NO_MMAP },
+	{ "inline", XPSF_NO_MMAP | XPSF_NO_READ_AHEAD },
+	{ NULL, 0 }
+    };
+    unsigned m, f, rep, reps = opt_reps / 10 ?: 1;
+    size_t len = 0, tokens;
+    double start, secs;
+    xi_source_t *srcp;
+    char *data, *rest;
+    struct stat st;
+
+    for (f = 0; opt_files && opt_files[f]; f++)
+	if (stat(opt_files[f], &st) == 0)
+	    len += st.st_size;
+
+    if (len == 0) {
+	printf("input: no input files\n");
+	return;
+    }
+
+    printf("input: %zu bytes, %u reps (trim ignore, unescaped)\n",
+	   len, reps);
+
+    for (m = 0; modes[m].name; m++) {
+	tokens = 0;
+	start = bench_now();
+
+	for (rep = 0; rep < reps; rep++) {
+	    for (f = 0; opt_files[f]; f++) {
+		srcp = xi_source_open(opt_files[f], modes[m].flags
+				      | XPSF_TRIM_WS | XPSF_IGNORE_WS);
+		if (srcp == NULL)
+		    err(1, "could not open file: %s", opt_files[f]);
+
+		for (;;) {
+		    xi_node_type_t type;
+
+		    type = xi_source_next_token(srcp, &data, &rest);
+		    if (type <= XI_TYPE_FAIL)
+			break;
+		    if (type == XI_TYPE_TEXT)
+			xi_source_unescape_copy(srcp, data, rest - data, NULL);
+		    tokens += 1;
+		}
+		xi_source_destroy(srcp);
+	    }
+	}
+
+	secs = bench_now() - start;
+	printf("  %-7s %6.3f GB/s, %zu tokens\n", modes[m].name,
+	       (double) len * reps / secs / 1e9, tokens / reps);
+    }
+}
+
+/*
+ * Write the corpus into a pipe from a child process, returning the
+ * read end
+ */
+static int
+bench_pipe_open (const char *buf, size_t len, pid_t *pidp)
+{
+    int fds[2];
+    ssize_t rc;
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+	err(1, "pipe");
+
+    pid = fork();
+    if (pid < 0)
+	err(1, "fork");
+
+    if (pid == 0) {
+	close(fds[0]);
+	while (len > 0) {
+	    rc = write(fds[1], buf, len);
+	    if (rc <= 0)
+		_exit(1);
+	    buf += rc;
+	    len -= rc;
+	}
+	_exit(0);
+    }
+
+    close(fds[1]);
+    *pidp = pid;
+    return fds[0];
+}
+
+/*
+ * Tokenize the corpus from a pipe, reading it inline and with the
+ * read-ahead thread
+ */
+static void
+bench_pipe (void)
+{
+    static const struct {
+	const char *name;
+	xi_source_flags_t flags;
+    } modes[] = {
+	{ "inline", 0 },
+	{ "ahead", XPSF_READ_AHEAD },
+	{ NULL, 0 }
+    };
+    unsigned m, rep, reps = opt_reps / 10 ?: 1;
+    size_t len, tokens;
+    double start, secs;
+    xi_source_t *srcp;
+    char *data, *rest, *buf;
+    pid_t pid;
+    int fd;
+
+    buf = bench_corpus(&len);
+    if (len == 0) {
+	printf("pipe: no input files\n");
+	return;
+    }
+
+    printf("pipe: %zu bytes, %u reps (trim ignore, unescaped)\n", len, reps);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (m = 0; modes[m].name; m++) {
+	tokens = 0;
+	start = bench_now();
+
+	for (rep = 0; rep < reps; rep++) {
+	    fd = bench_pipe_open(buf, len, &pid);
+	    srcp = xi_source_create(fd, modes[m].flags
+				    | XPSF_TRIM_WS | XPSF_IGNORE_WS);
+	    if (srcp == NULL)
+		errx(1, "could not create source");
+
+	    for (;;) {
+		xi_node_type_t type;
+
+		type = xi_source_next_token(srcp, &data, &rest);
+		if (type <= XI_TYPE_FAIL)
+		    break;
+		if (type == XI_TYPE_TEXT)
+		    xi_source_unescape_copy(srcp, data, rest - data, NULL);
+		tokens += 1;
+	    }
+	    xi_source_destroy(srcp);
+	    close(fd);
+	    waitpid(pid, NULL, 0);
+	}
+
+	secs = bench_now() - start;
+	printf("  %-7s %6.3f GB/s, %zu tokens\n", modes[m].name,
+	       (double) len * reps / secs / 1e9, tokens / reps);
+    }
+
+    free(buf);
+}
+
+#ifdef HAVE_PTHREAD_H
+
+#define BENCH_PIECES_MAX 64	/* Most pieces we'll split into */
+
+typedef struct bench_split_s {
+    xi_source_t *bs_srcp;	/* Whole (mmap'd) source */
+    xi_offset_t *bs_offsets;	/* Start of each piece */
+    unsigned bs_count;		/* Number of pieces */
+    unsigned bs_next;		/* Next piece to take */
+    size_t bs_tokens;		/* Tokens seen */
+} bench_split_t;
+
+/*
+ * A worker: take pieces until they're gone, tokenizing each
+ */
+static void *
+bench_split_worker (void *arg)
+{
+    bench_split_t *bsp = arg;
+    xi_source_t *segp;
+    xi_offset_t end;
+    char *data, *rest;
+    size_t tokens = 0;
+    unsigned i;
+
+    for (;;) {
+	i = __atomic_fetch_add(&bsp->bs_next, 1, __ATOMIC_RELAXED);
+	if (i >= bsp->bs_count)
+	    break;
+
+	end = (i + 1 < bsp->bs_count) ? bsp->bs_offsets[i + 1]
+	    : (xi_offset_t) bsp->bs_srcp->xps_len;
+	segp = xi_source_segment(bsp->bs_srcp, bsp->bs_offsets[i], end);
+	if (segp == NULL)
+	    errx(1, "could not make segment");
+
+	while (xi_source_next_token(segp, &data, &rest) > XI_TYPE_FAIL)
+	    tokens += 1;
+	xi_source_destroy(segp);
+    }
+
+    __atomic_add_fetch(&bsp->bs_tokens, tokens, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/*
+ * Split each (mmap'd) input file at the root's children and tokenize
+ * the pieces on 1 thru opt_threads threads.  The pre-scan is timed on
+ * its own, since it's the part that doesn't get faster with threads.
+ */
+static void
+bench_split (void)
+{
+    xi_offset_t offsets[BENCH_PIECES_MAX];
+    pthread_t tids[BENCH_PIECES_MAX];
+    unsigned f, rep, t, threads, reps = opt_reps / 10 ?: 1;
+    size_t len = 0;
+    double start, secs, scan = 0;
+    bench_split_t bs;
+    struct stat st;
+
+    for (f = 0; opt_files && opt_files[f]; f++)
+	if (stat(opt_files[f], &st) == 0)
+	    len += st.st_size;
+
+    if (len == 0) {
+	printf("split: no input files\n");
+	return;
+    }
+
+    if (opt_threads > BENCH_PIECES_MAX / 4)
+	opt_threads = BENCH_PIECES_MAX / 4;
+
+    printf("split: %zu bytes, %u reps (trim ignore)\n", len, reps);
+
+    for (threads = 1; threads <= opt_threads; threads <<= 1) {
+	memset(&bs, 0, sizeof(bs));
+	start = bench_now();
+
+	for (rep = 0; rep < reps; rep++) {
+	    for (f = 0; opt_files[f]; f++) {
+		double sstart;
+
+		bs.bs_srcp = xi_source_open(opt_files[f],
+					    XPSF_TRIM_WS | XPSF_IGNORE_WS);
+		if (bs.bs_srcp == NULL)
+		    err(1, "could not open file: %s", opt_files[f]);
+
+		/* A few pieces per thread evens out their sizes */
+		sstart = bench_now();
+		bs.bs_offsets = offsets;
+		bs.bs_count = xi_source_split(bs.bs_srcp, threads * 4, offsets);
+		bs.bs_next = 0;
+		if (threads == 1)
+		    scan += bench_now() - sstart;
+
+		for (t = 0; t < threads; t++)
+		    if (pthread_create(&tids[t], NULL, bench_split_worker,
+				       &bs) != 0)
+			errx(1, "could not start thread");
+		for (t = 0; t < threads; t++)
+		    pthread_join(tids[t], NULL);
+
+		xi_source_destroy(bs.bs_srcp);
+	    }
+	}
+
+	secs = bench_now() - start;
+	if (threads == 1)
+	    printf("  %-7s %6.3f GB/s\n", "pre-scan",
+		   (double) len * reps / scan / 1e9);
+	printf("  %2u thr  %6.3f GB/s, %zu tokens\n", threads,
+	       (double) len * reps / secs / 1e9, bs.bs_tokens / reps);
+    }
+}
+
+#else /* HAVE_PTHREAD_H */
+
+static void
+bench_split (void)
+{
+    printf("split: no threads\n");
+}
+
+#endif /* HAVE_PTHREAD_H */
+
+typedef struct bench_s {
+    const char *b_name;
+    void (*b_func)(void);
+} bench_t;
+
+bench_t bench_list[] = {
+    { "scan", bench_scan },
+    { "tokens", bench_tokens },
+    { "input", bench_input },
+    { "pipe", bench_pipe },
+    { "split", bench_split },
+    { NULL, NULL }
+};
+
+int
+main (int argc, char **argv)
+{
+    const char *name = NULL;
+    bench_t *bp;
+
+    for (argc = 1; argv[argc]; argc++) {
+	if (strcmp(argv[argc], "reps") == 0) {
+	    if (argv[argc + 1])
+		opt_reps = atoi(argv[++argc]);
+	} else if (strcmp(argv[argc], "threads") == 0) {
+	    if (argv[argc + 1])
+		opt_threads = atoi(argv[++argc]);
+	} else if (name == NULL && access(argv[argc], R_OK) != 0) {
+	    name = argv[argc];
+	} else {
+	    /* The rest of the arguments are input files */
+	    opt_files = &argv[argc];
+	    break;
+	}
+    }
+
+    for (bp = bench_list; bp->b_name; bp++)
+	if (name == NULL || strcmp(name, bp->b_name) == 0)
+	    bp->b_func();
+
+    return 0;
+}